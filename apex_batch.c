@@ -0,0 +1,463 @@
+/*
+ * apex_batch.c
+ * Contains the lockstep functional simulation of one program over many data
+ * memory images
+ *
+ * Up to BATCH_LANES instances run together. Registers, flags and data memory
+ * are kept as structure of arrays, so one decoded instruction is applied to
+ * every lane of a group by a loop over contiguous lanes, which the compiler
+ * turns into SIMD code at -O3 (the Makefile builds this file so even in the
+ * default build). On x86-64 the lane loops are compiled twice, for AVX2 and
+ * for the baseline, and the loader picks the clone the host supports. A group is the set of running lanes at the
+ * same pc. When a BZ/BNZ or a register indirect jump sends lanes to different
+ * pcs the group splits, the group at the lowest pc always goes next, so
+ * lanes reconverge as soon as they reach the same pc again.
+ *
+ * Instructions take effect in program order, the architectural result of a
+ * run of the timing pipeline: ADD, SUB, SUBL and CMP set the zero flag,
+ * which starts out neither set nor clear.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_batch.h"
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_memimage.h"
+#include "apex_options.h"
+
+/* Function multiversioning of the lane loops, 8 lanes per AVX2 instruction */
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define BATCH_CLONES __attribute__((target_clones("avx2", "default")))
+#endif
+#endif
+#ifndef BATCH_CLONES
+#define BATCH_CLONES
+#endif
+
+static const char *state_names[] = {"Idle", "Complete", "Complete", "Stopped", "Fault"};
+
+/* rd of the lanes in mask takes value */
+static void
+write_reg(APEX_Batch *b, int rd, const int *value, const int *mask)
+{
+    int *reg = b->regs[rd];
+
+    for (int l = 0; l < BATCH_LANES; l++)
+    {
+        reg[l] = mask[l] ? value[l] : reg[l];
+    }
+}
+
+static void
+write_flag(APEX_Batch *b, const int *value, const int *mask)
+{
+    for (int l = 0; l < BATCH_LANES; l++)
+    {
+        b->zero_flag[l] = mask[l] ? value[l] == 0 : b->zero_flag[l];
+    }
+}
+
+static void
+load(APEX_Batch *b, int rd, const int *address, const int *mask)
+{
+    int value[BATCH_LANES];
+
+    /* Gather, an address out of data memory reads 0 like the pipeline */
+    for (int l = 0; l < BATCH_LANES; l++)
+    {
+        value[l] = (address[l] >= 0 && address[l] < DATA_MEMORY_SIZE) ? b->memory[address[l]][l] : 0;
+    }
+    write_reg(b, rd, value, mask);
+}
+
+static void
+store(APEX_Batch *b, const int *value, const int *address, const int *mask)
+{
+    for (int l = 0; l < BATCH_LANES; l++)
+    {
+        if (mask[l] && address[l] >= 0 && address[l] < DATA_MEMORY_SIZE)
+        {
+            b->memory[address[l]][l] = value[l];
+            b->dirty[l][address[l] / DIRTY_BITS_PER_WORD] |= 1UL << (address[l] % DIRTY_BITS_PER_WORD);
+        }
+    }
+}
+
+/* Executes ins at pc for the lanes in mask and moves them to their next pc */
+BATCH_CLONES static void
+step_group(APEX_Batch *b, const APEX_Instruction *ins, int pc, const int *mask)
+{
+    const int *a = b->regs[ins->rs1];
+    const int *c = b->regs[ins->rs2];
+    const int *d = b->regs[ins->rs3];
+    int value[BATCH_LANES];
+    int next[BATCH_LANES];
+
+    for (int l = 0; l < BATCH_LANES; l++)
+    {
+        next[l] = pc + 4;
+    }
+
+    switch (ins->opcode)
+    {
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_CMP:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = ins->opcode == OPCODE_ADD ? a[l] + c[l] : a[l] - c[l];
+        }
+        if (ins->opcode != OPCODE_CMP)
+        {
+            write_reg(b, ins->rd, value, mask);
+        }
+        write_flag(b, value, mask);
+        break;
+    }
+    case OPCODE_SUBL:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = a[l] - ins->imm;
+        }
+        write_reg(b, ins->rd, value, mask);
+        write_flag(b, value, mask);
+        break;
+    }
+    case OPCODE_ADDL:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = a[l] + ins->imm;
+        }
+        write_reg(b, ins->rd, value, mask);
+        break;
+    }
+    case OPCODE_MUL:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = a[l] * c[l];
+        }
+        write_reg(b, ins->rd, value, mask);
+        break;
+    }
+    case OPCODE_AND:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = a[l] & c[l];
+        }
+        write_reg(b, ins->rd, value, mask);
+        break;
+    }
+    case OPCODE_OR:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = a[l] | c[l];
+        }
+        write_reg(b, ins->rd, value, mask);
+        break;
+    }
+    case OPCODE_XOR:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = a[l] ^ c[l];
+        }
+        write_reg(b, ins->rd, value, mask);
+        break;
+    }
+    case OPCODE_MOVC:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = ins->imm;
+        }
+        write_reg(b, ins->rd, value, mask);
+        break;
+    }
+    case OPCODE_LOAD:
+    case OPCODE_LDR:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = a[l] + (ins->opcode == OPCODE_LOAD ? ins->imm : c[l]);
+        }
+        load(b, ins->rd, value, mask);
+        break;
+    }
+    case OPCODE_STORE:
+    case OPCODE_STR:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            value[l] = c[l] + (ins->opcode == OPCODE_STORE ? ins->imm : d[l]);
+        }
+        store(b, a, value, mask);
+        break;
+    }
+    case OPCODE_BZ:
+    case OPCODE_BNZ:
+    {
+        int want = ins->opcode == OPCODE_BZ ? TRUE : FALSE;
+
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            next[l] = b->zero_flag[l] == want ? pc + ins->imm : pc + 4;
+        }
+        break;
+    }
+    case OPCODE_JUMP:
+    case OPCODE_JAL:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            next[l] = a[l] + ins->imm;
+            value[l] = pc + 4;
+        }
+        if (ins->opcode == OPCODE_JAL)
+        {
+            write_reg(b, ins->rd, value, mask);
+        }
+        break;
+    }
+    case OPCODE_HALT:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            next[l] = pc;
+        }
+        break;
+    }
+    case OPCODE_NOP:
+    {
+        break;
+    }
+    default:
+    {
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            b->state[l] = mask[l] ? BATCH_FAULT : b->state[l];
+        }
+        return;
+    }
+    }
+
+    for (int l = 0; l < BATCH_LANES; l++)
+    {
+        b->pc[l] = mask[l] ? next[l] : b->pc[l];
+        b->insns[l] += mask[l];
+        if (mask[l] && ins->opcode == OPCODE_HALT)
+        {
+            b->state[l] = BATCH_HALTED;
+        }
+    }
+}
+
+/*
+ * Runs the lanes until every one has halted, stopped or faulted, limit is the
+ * instruction limit of each instance, 0 for none
+ */
+static void
+run_lanes(APEX_Batch *b, const APEX_CPU *cpu, long limit)
+{
+    int mask[BATCH_LANES];
+
+    while (TRUE)
+    {
+        int pc = -1;
+        int running = 0;
+        int grouped = 0;
+
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            if (b->state[l] == BATCH_RUNNING && limit && b->insns[l] >= limit)
+            {
+                b->state[l] = BATCH_STOPPED;
+            }
+            if (b->state[l] == BATCH_RUNNING)
+            {
+                running++;
+                pc = (pc < 0 || b->pc[l] < pc) ? b->pc[l] : pc;
+            }
+        }
+        if (!running)
+        {
+            return;
+        }
+
+        for (int l = 0; l < BATCH_LANES; l++)
+        {
+            mask[l] = b->state[l] == BATCH_RUNNING && b->pc[l] == pc;
+            grouped += mask[l];
+        }
+        if (pc < 4000 || (pc - 4000) % 4 || (pc - 4000) / 4 >= cpu->code_memory_size)
+        {
+            for (int l = 0; l < BATCH_LANES; l++)
+            {
+                b->state[l] = mask[l] ? BATCH_FAULT : b->state[l];
+            }
+            continue;
+        }
+
+        step_group(b, &cpu->code_memory[(pc - 4000) / 4], pc, mask);
+        b->steps++;
+        b->groups += grouped < running;
+    }
+}
+
+/* Loads the instance's image over the --mem-load image into its lane */
+static int
+start_lane(APEX_Batch *b, APEX_CPU *cpu, const int *base, int lane, const char *image)
+{
+    memcpy(cpu->data_memory, base, sizeof(int) * DATA_MEMORY_SIZE);
+    if (APEX_memimage_load(cpu, image) < 0)
+    {
+        return -1;
+    }
+    for (int addr = 0; addr < DATA_MEMORY_SIZE; addr++)
+    {
+        b->memory[addr][lane] = cpu->data_memory[addr];
+    }
+    memset(b->dirty[lane], 0, sizeof(b->dirty[lane]));
+    for (int r = 0; r < REG_FILE_SIZE; r++)
+    {
+        b->regs[r][lane] = 0;
+    }
+    b->zero_flag[lane] = -1;
+    b->pc[lane] = 4000;
+    b->insns[lane] = 0;
+    b->state[lane] = BATCH_RUNNING;
+    return 0;
+}
+
+/*
+ * Prints the result of the instance in lane, and dumps its data memory to
+ * <mem_dump_file>.<index> when asked to
+ */
+static int
+finish_lane(const APEX_Batch *b, APEX_CPU *cpu, const APEX_Options *opts, int lane, int index,
+            const char *image)
+{
+    char filename[4096];
+
+    printf("Instance %d (%s): %s, instructions = %ld, pc = %d\n", index, image, state_names[b->state[lane]],
+           b->insns[lane], b->pc[lane]);
+    for (int r = 0; r < REG_FILE_SIZE; r++)
+    {
+        printf("%sR%d=%d", r ? " " : "  ", r, b->regs[r][lane]);
+    }
+    printf("\n");
+
+    if (!opts->mem_dump_file)
+    {
+        return 0;
+    }
+    for (int addr = 0; addr < DATA_MEMORY_SIZE; addr++)
+    {
+        cpu->data_memory[addr] = b->memory[addr][lane];
+    }
+    memcpy(cpu->data_memory_dirty, b->dirty[lane], sizeof(b->dirty[lane]));
+    snprintf(filename, sizeof(filename), "%s.%d", opts->mem_dump_file, index);
+    return APEX_memimage_dump(cpu, filename, opts->mem_dump_format);
+}
+
+/*
+ * Runs the program on every data memory image listed in opts->batch_file,
+ * BATCH_LANES at a time. steps is the instruction limit of each instance
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_batch_run(APEX_CPU *cpu, const APEX_Options *opts, const char *steps)
+{
+    APEX_Batch *b;
+    FILE *fp;
+    char images[BATCH_LANES][4096];
+    char line[4096];
+    int base[DATA_MEMORY_SIZE];
+    long limit = atol(steps);
+    long instances = 0, insns = 0, steps_total = 0, groups = 0;
+    int lanes = 0;
+    int ret = 0;
+    int eof = FALSE;
+
+    fp = fopen(opts->batch_file, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open batch list %s\n", opts->batch_file);
+        return -1;
+    }
+    b = calloc(1, sizeof(APEX_Batch));
+    if (!b)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate batch\n");
+        fclose(fp);
+        return -1;
+    }
+    memcpy(base, cpu->data_memory, sizeof(base));
+
+    while (!eof && ret == 0)
+    {
+        /* Fill the lanes, one image path per line of the list */
+        lanes = 0;
+        while (lanes < BATCH_LANES)
+        {
+            if (!fgets(line, sizeof(line), fp))
+            {
+                eof = TRUE;
+                break;
+            }
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0' || line[0] == '#')
+            {
+                continue;
+            }
+            strcpy(images[lanes], line);
+            if (start_lane(b, cpu, base, lanes, line) < 0)
+            {
+                ret = -1;
+                break;
+            }
+            lanes++;
+        }
+        for (int l = lanes; l < BATCH_LANES; l++)
+        {
+            b->state[l] = BATCH_IDLE;
+        }
+        if (ret < 0 || lanes == 0)
+        {
+            break;
+        }
+
+        b->steps = b->groups = 0;
+        run_lanes(b, cpu, limit);
+        steps_total += b->steps;
+        groups += b->groups;
+        for (int l = 0; l < lanes; l++)
+        {
+            insns += b->insns[l];
+            if (finish_lane(b, cpu, opts, l, instances + l, images[l]) < 0)
+            {
+                ret = -1;
+            }
+        }
+        instances += lanes;
+    }
+
+    printf("APEX_BATCH: %ld instances, %ld instructions in %ld lockstep steps (%.2f lanes per step, %ld split steps)\n",
+           instances, insns, steps_total, steps_total ? (double)insns / steps_total : 0.0, groups);
+    fclose(fp);
+    free(b);
+    return ret;
+}
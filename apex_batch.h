@@ -0,0 +1,45 @@
+/*
+ * apex_batch.h
+ * Contains declarations of the lockstep functional simulation of one program
+ * over many data memory images
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_BATCH_H_
+#define _APEX_BATCH_H_
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_options.h"
+
+/* Instances run together, state is laid out [..][BATCH_LANES] */
+#define BATCH_LANES 16
+
+/* States of a lane */
+enum
+{
+    BATCH_IDLE,     /* No instance in this lane */
+    BATCH_RUNNING,
+    BATCH_HALTED,   /* Committed HALT */
+    BATCH_STOPPED,  /* Reached the instruction limit */
+    BATCH_FAULT     /* Left code memory or met an unsupported opcode */
+};
+
+/* Architectural state of BATCH_LANES instances as structure of arrays */
+typedef struct APEX_Batch
+{
+    int regs[REG_FILE_SIZE][BATCH_LANES];
+    int zero_flag[BATCH_LANES];
+    int pc[BATCH_LANES];
+    int state[BATCH_LANES];
+    long insns[BATCH_LANES];
+    int memory[DATA_MEMORY_SIZE][BATCH_LANES];
+    unsigned long dirty[BATCH_LANES][DATA_MEMORY_SIZE / DIRTY_BITS_PER_WORD];
+    long steps;  /* Instructions decoded, once for all lanes of a group */
+    long groups; /* Steps whose group was only part of the running lanes */
+} APEX_Batch;
+
+int APEX_batch_run(APEX_CPU *cpu, const APEX_Options *opts, const char *steps);
+#endif
@@ -0,0 +1,285 @@
+/*
+ * apex_branchprof.c
+ * Contains the branch profile of a run
+ *
+ * Every BZ/BNZ committed feeds its outcome to four predictors simulated
+ * here, outside the pipeline, each updated right after its prediction:
+ *
+ *   BTFN     taken when the target is not after the branch
+ *   bimodal  a table of two-bit counters indexed by the code memory index
+ *   gshare   the same table size indexed by the index xor the last outcomes
+ *   last     the outcome of the previous instance of the same branch
+ *
+ * The pipeline predicts nothing: fetch waits behind a BZ/BNZ until it
+ * resolves, and a taken branch or jump holds decode from its redirect in
+ * JBU2 until it commits and flushes the ROB. At the end of every cycle the
+ * cycle is charged, like the CPI stack does, to the branch or jump whose
+ * flush is pending, or else to the unresolved BZ/BNZ fetch waits behind
+ * while decode has nothing. Both are cycles a predictor that was right, or
+ * code without the branch, would not lose.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_branchprof.h"
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+static const char *names[BRPROF_KINDS] = {"BTFN", "Bimodal", "Gshare", "Last"};
+
+APEX_BranchProf *
+APEX_branchprof_create(int code_memory_size)
+{
+    APEX_BranchProf *prof = calloc(1, sizeof(APEX_BranchProf));
+
+    if (!prof)
+    {
+        return NULL;
+    }
+    prof->size = code_memory_size;
+    prof->pcs = calloc(code_memory_size + 1, sizeof(BranchProfEntry));
+    if (!prof->pcs)
+    {
+        free(prof);
+        return NULL;
+    }
+    /* Weakly not taken, the way fetch goes on past a branch */
+    memset(prof->bimodal, 1, sizeof(prof->bimodal));
+    memset(prof->gshare, 1, sizeof(prof->gshare));
+    prof->flush_pc = -1;
+    return prof;
+}
+
+void
+APEX_branchprof_free(APEX_BranchProf *prof)
+{
+    if (prof)
+    {
+        free(prof->pcs);
+        free(prof);
+    }
+}
+
+/* Counters of the instruction at pc, NULL outside code memory */
+static BranchProfEntry *
+entry_of(const APEX_BranchProf *prof, int pc)
+{
+    int index = (pc - 4000) / 4;
+
+    if (pc < 4000 || index >= prof->size)
+    {
+        return NULL;
+    }
+    return &prof->pcs[index];
+}
+
+/* Predicts from a two-bit counter, then moves it towards taken */
+static int
+counter_predict(unsigned char *counter, int taken)
+{
+    int predicted = *counter >= 2;
+
+    if (taken && *counter < 3)
+    {
+        (*counter)++;
+    }
+    else if (!taken && *counter > 0)
+    {
+        (*counter)--;
+    }
+    return predicted;
+}
+
+/* Called for every instruction leaving the ROB, taken is the BZ/BNZ outcome */
+void
+APEX_branchprof_commit(APEX_BranchProf *prof, const ROB_ENTRY *rob_entry, int taken)
+{
+    BranchProfEntry *entry;
+    int index = (rob_entry->pc - 4000) / 4;
+    int predicted[BRPROF_KINDS];
+
+    switch (rob_entry->instruction_type)
+    {
+    case OPCODE_JUMP:
+    case OPCODE_JAL:
+    {
+        if ((entry = entry_of(prof, rob_entry->pc)))
+        {
+            entry->executed++;
+            entry->taken++;
+        }
+        return;
+    }
+    case OPCODE_BZ:
+    case OPCODE_BNZ:
+    {
+        break;
+    }
+    default:
+    {
+        return;
+    }
+    }
+    if (!(entry = entry_of(prof, rob_entry->pc)))
+    {
+        return;
+    }
+
+    predicted[BRPROF_BTFN] = rob_entry->imm <= 0;
+    predicted[BRPROF_BIMODAL] = counter_predict(&prof->bimodal[index & (BRPROF_TABLE - 1)], taken);
+    predicted[BRPROF_GSHARE] = counter_predict(&prof->gshare[(index ^ prof->history) & (BRPROF_TABLE - 1)], taken);
+    predicted[BRPROF_LAST] = entry->executed ? entry->last_taken : FALSE;
+    for (int i = 0; i < BRPROF_KINDS; i++)
+    {
+        entry->correct[i] += predicted[i] == taken;
+    }
+    prof->history = ((prof->history << 1) | taken) & ((1u << BRPROF_HISTORY) - 1);
+    entry->last_taken = taken;
+    entry->executed++;
+    entry->taken += taken;
+}
+
+/* Called when a taken branch or jump in JBU2 starts holding decode until it commits */
+void
+APEX_branchprof_redirect(APEX_BranchProf *prof, int pc)
+{
+    prof->flush_pc = pc;
+}
+
+/* Called at the end of every cycle, before the clock advances */
+void
+APEX_branchprof_cycle(APEX_BranchProf *prof, const APEX_CPU *cpu)
+{
+    const ROB_ENTRY *youngest;
+    BranchProfEntry *entry;
+
+    prof->cycles++;
+    if (cpu->flush_pending)
+    {
+        if (prof->flush_pc >= 0 && (entry = entry_of(prof, prof->flush_pc)))
+        {
+            entry->flush++;
+        }
+        return;
+    }
+    prof->flush_pc = -1;
+    if (cpu->rob_head == cpu->rob_tail || cpu->decode.has_insn)
+    {
+        return;
+    }
+    youngest = &cpu->ROB[(cpu->rob_tail + ROB_SIZE(cpu) - 1) % ROB_SIZE(cpu)];
+    if (!youngest->result_valid &&
+        (youngest->instruction_type == OPCODE_BZ || youngest->instruction_type == OPCODE_BNZ) &&
+        (entry = entry_of(prof, youngest->pc)))
+    {
+        entry->stall++;
+    }
+}
+
+/* Share of the n outcomes of a branch a predictor foresaw */
+static void
+print_rate(FILE *fp, long count, long n)
+{
+    if (n)
+    {
+        fprintf(fp, " %6.2f%%", 100.0 * count / n);
+    }
+    else
+    {
+        fprintf(fp, " %7s", "-");
+    }
+}
+
+/*
+ * Writes the branches and jumps of code memory with their counters to
+ * filename, "-" for standard output
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_branchprof_write(const APEX_BranchProf *prof, const APEX_CPU *cpu, const char *filename)
+{
+    FILE *fp = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    BranchProfEntry total = {0};
+    long conditional = 0;
+    char text[64];
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open branch profile %s\n", filename);
+        return -1;
+    }
+
+    for (int i = 0; i < prof->size; i++)
+    {
+        const BranchProfEntry *entry = &prof->pcs[i];
+        int opcode = cpu->code_memory[i].opcode;
+
+        total.executed += entry->executed;
+        total.taken += entry->taken;
+        total.stall += entry->stall;
+        total.flush += entry->flush;
+        if (opcode == OPCODE_BZ || opcode == OPCODE_BNZ)
+        {
+            conditional += entry->executed;
+            for (int k = 0; k < BRPROF_KINDS; k++)
+            {
+                total.correct[k] += entry->correct[k];
+            }
+        }
+    }
+
+    fprintf(fp, "Branch profile: %ld cycles, %ld branches and jumps committed, %ld taken\n", prof->cycles,
+            total.executed, total.taken);
+    fprintf(fp, "Percent: share of cycles fetch was held behind the branch (Stall) or decode by its flush "
+                "(Flush)\n");
+    fprintf(fp, "BTFN to Last: outcomes of BZ/BNZ each predictor foresees, bimodal and gshare with %d two-bit "
+                "counters, gshare with %d outcomes of history\n\n",
+            BRPROF_TABLE, BRPROF_HISTORY);
+    fprintf(fp, "%7s %9s %7s", "Percent", "Executed", "Taken");
+    for (int k = 0; k < BRPROF_KINDS; k++)
+    {
+        fprintf(fp, " %7s", names[k]);
+    }
+    fprintf(fp, " %9s %9s  %-5s %s\n", "Stall", "Flush", "PC", "Instruction");
+    for (int i = 0; i < prof->size; i++)
+    {
+        const BranchProfEntry *entry = &prof->pcs[i];
+        int opcode = cpu->code_memory[i].opcode;
+        int conditional_branch = opcode == OPCODE_BZ || opcode == OPCODE_BNZ;
+
+        if (!conditional_branch && opcode != OPCODE_JUMP && opcode != OPCODE_JAL)
+        {
+            continue;
+        }
+        fprintf(fp, "%6.2f%% %9ld",
+                prof->cycles ? 100.0 * (entry->stall + entry->flush) / prof->cycles : 0.0, entry->executed);
+        print_rate(fp, entry->taken, entry->executed);
+        for (int k = 0; k < BRPROF_KINDS; k++)
+        {
+            print_rate(fp, entry->correct[k], conditional_branch ? entry->executed : 0);
+        }
+        fprintf(fp, " %9ld %9ld  %-5d %s\n", entry->stall, entry->flush, 4000 + 4 * i,
+                APEX_format_instruction(&cpu->code_memory[i], text, sizeof(text)));
+    }
+    fprintf(fp, "%6.2f%% %9ld", prof->cycles ? 100.0 * (total.stall + total.flush) / prof->cycles : 0.0,
+            total.executed);
+    print_rate(fp, total.taken, total.executed);
+    for (int k = 0; k < BRPROF_KINDS; k++)
+    {
+        print_rate(fp, total.correct[k], conditional);
+    }
+    fprintf(fp, " %9ld %9ld  total\n", total.stall, total.flush);
+
+    if (fp != stdout && fclose(fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write branch profile %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
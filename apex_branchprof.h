@@ -0,0 +1,60 @@
+/*
+ * apex_branchprof.h
+ * Contains declarations of the branch profile, which describes every static
+ * BZ, BNZ, JUMP and JAL: how often it runs and is taken, how well common
+ * predictors would foresee it and the cycles it costs the pipeline today
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_BRANCHPROF_H_
+#define _APEX_BRANCHPROF_H_
+
+#include "apex_cpu.h"
+
+/* Two-bit counters of the bimodal and gshare tables, a power of two */
+#define BRPROF_TABLE 1024
+
+/* Outcomes of conditional branches in the gshare history */
+#define BRPROF_HISTORY 10
+
+/* Predictors run side by side on the committed outcomes */
+enum
+{
+    BRPROF_BTFN,     /* Backward taken, forward not taken */
+    BRPROF_BIMODAL,  /* Two-bit counter per table entry, indexed by the PC */
+    BRPROF_GSHARE,   /* Two-bit counter indexed by the PC xor the global history */
+    BRPROF_LAST,     /* Same outcome as the last time */
+    BRPROF_KINDS
+};
+
+/* Counters of one static branch or jump */
+typedef struct BranchProfEntry
+{
+    long executed;                  /* Dynamic instances committed */
+    long taken;
+    long correct[BRPROF_KINDS];     /* Outcomes each predictor foresaw, BZ/BNZ only */
+    int last_taken;                 /* Outcome of the last instance */
+    long stall;                     /* Cycles fetch was held behind it, decode empty */
+    long flush;                     /* Cycles decode was held by its flush */
+} BranchProfEntry;
+
+typedef struct APEX_BranchProf
+{
+    int size;                       /* Entries, one per code memory index */
+    long cycles;                    /* Cycles profiled */
+    BranchProfEntry *pcs;
+    unsigned char bimodal[BRPROF_TABLE];
+    unsigned char gshare[BRPROF_TABLE];
+    unsigned history;               /* Last outcomes, the newest in bit 0 */
+    int flush_pc;                   /* Branch or jump whose flush is pending, -1 if none */
+} APEX_BranchProf;
+
+APEX_BranchProf *APEX_branchprof_create(int code_memory_size);
+void APEX_branchprof_free(APEX_BranchProf *prof);
+void APEX_branchprof_commit(APEX_BranchProf *prof, const ROB_ENTRY *rob_entry, int taken);
+void APEX_branchprof_redirect(APEX_BranchProf *prof, int pc);
+void APEX_branchprof_cycle(APEX_BranchProf *prof, const APEX_CPU *cpu);
+int APEX_branchprof_write(const APEX_BranchProf *prof, const APEX_CPU *cpu, const char *filename);
+#endif
@@ -0,0 +1,246 @@
+/*
+ * apex_cache.c
+ * Contains the on-disk cache of simulation results
+ *
+ * The key of a run hashes the simulator stamp, the machine configuration,
+ * the cycle limit, the decoded code memory and the data memory after any
+ * preload, so the same program and image found under other file names still
+ * hit. Each result is a small file named after its key, in one of
+ * CACHE_SHARDS subdirectories picked by the key.
+ *
+ * Any number of processes may share a cache directory: an entry is written
+ * to a temporary file and renamed into place, so a reader sees a whole entry
+ * or none. A hit touches its entry, and a store which takes its shard over
+ * its share of the size bound removes the least recently used entries of
+ * that shard. An entry removed under a reader is still read in full.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "apex_cache.h"
+#include "apex_cpu.h"
+
+static void
+hash_bytes(APEX_CacheKey *key, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        key->h1 = (key->h1 ^ p[i]) * 1099511628211ull;
+        key->h2 = (key->h2 ^ p[i]) * 0x9e3779b97f4a7c15ull;
+        key->h2 = key->h2 << 27 | key->h2 >> 37;
+    }
+}
+
+static void
+hash_int(APEX_CacheKey *key, int value)
+{
+    hash_bytes(key, &value, sizeof(value));
+}
+
+/* Computes the key of running cpu, as initialized, for cycles (0 to HALT) */
+void
+APEX_cache_key(const APEX_CPU *cpu, int cycles, APEX_CacheKey *key)
+{
+    double version = VERSION;
+
+    key->h1 = 14695981039346656037ull;
+    key->h2 = 0x243f6a8885a308d3ull;
+    hash_int(key, CACHE_STAMP);
+    hash_bytes(key, &version, sizeof(version));
+
+    /* Through the macros, which hold the values of a specialized build */
+    hash_bytes(key, cpu->config.name, strlen(cpu->config.name) + 1);
+    hash_int(key, ROB_SIZE(cpu));
+    hash_int(key, IQ_SIZE(cpu));
+    hash_int(key, PHYS_REGS(cpu));
+    hash_int(key, INTFU_COUNT(cpu));
+    hash_int(key, MULFU_COUNT(cpu));
+    hash_int(key, INTFU_LATENCY(cpu));
+    hash_int(key, MUL_LATENCY(cpu));
+    hash_int(key, MEM_LATENCY(cpu));
+    hash_int(key, cpu->config.oracles);
+    hash_int(key, cycles);
+
+    hash_int(key, cpu->code_memory_size);
+    for (int i = 0; i < cpu->code_memory_size; i++)
+    {
+        const APEX_Instruction *ins = &cpu->code_memory[i];
+
+        hash_int(key, ins->opcode);
+        hash_int(key, ins->rd);
+        hash_int(key, ins->rs1);
+        hash_int(key, ins->rs2);
+        hash_int(key, ins->rs3);
+        hash_int(key, ins->imm);
+    }
+    hash_bytes(key, cpu->data_memory, sizeof(cpu->data_memory));
+}
+
+static void
+entry_path(const char *dir, const APEX_CacheKey *key, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%02x/%016llx%016llx", dir, (unsigned)(key->h1 % CACHE_SHARDS),
+             (unsigned long long)key->h1, (unsigned long long)key->h2);
+}
+
+/*
+ * Looks up key in the cache at dir
+ *
+ * Returns TRUE and fills entry on a hit, FALSE otherwise
+ */
+int
+APEX_cache_lookup(const char *dir, const APEX_CacheKey *key, APEX_CacheEntry *entry)
+{
+    char path[4096];
+    int fd, hit;
+
+    entry_path(dir, key, path, sizeof(path));
+    if ((fd = open(path, O_RDWR)) < 0)
+    {
+        return FALSE;
+    }
+    hit = read(fd, entry, sizeof(*entry)) == sizeof(*entry) &&
+          memcmp(entry->magic, CACHE_MAGIC, CACHE_MAGIC_LEN) == 0 && entry->key.h1 == key->h1 &&
+          entry->key.h2 == key->h2;
+    if (hit)
+    {
+        /* Recently used entries are evicted last */
+        futimens(fd, NULL);
+    }
+    close(fd);
+    return hit;
+}
+
+/* A file of a shard, for eviction */
+typedef struct ShardFile
+{
+    char name[64];
+    time_t mtime;
+    off_t bytes;
+} ShardFile;
+
+static int
+older_first(const void *a, const void *b)
+{
+    const ShardFile *fa = a, *fb = b;
+
+    return (fa->mtime > fb->mtime) - (fa->mtime < fb->mtime);
+}
+
+/* Removes least recently used entries of shard until it takes at most budget bytes */
+static void
+evict(const char *shard, off_t budget)
+{
+    DIR *dir = opendir(shard);
+    ShardFile *files = NULL;
+    struct dirent *de;
+    struct stat st;
+    char path[4096 + sizeof(files[0].name)];
+    size_t nfiles = 0, cap = 0;
+    off_t total = 0;
+
+    if (!dir)
+    {
+        return;
+    }
+    while ((de = readdir(dir)))
+    {
+        /* Temporary files of other processes start with a dot */
+        if (de->d_name[0] == '.' || strlen(de->d_name) >= sizeof(files[0].name))
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", shard, de->d_name);
+        if (stat(path, &st) < 0)
+        {
+            continue;
+        }
+        if (nfiles == cap)
+        {
+            ShardFile *grown = realloc(files, sizeof(ShardFile) * (cap = cap ? 2 * cap : 64));
+
+            if (!grown)
+            {
+                break;
+            }
+            files = grown;
+        }
+        strcpy(files[nfiles].name, de->d_name);
+        files[nfiles].mtime = st.st_mtime;
+        files[nfiles].bytes = (off_t)st.st_blocks * 512;
+        total += files[nfiles++].bytes;
+    }
+    closedir(dir);
+
+    if (total > budget)
+    {
+        qsort(files, nfiles, sizeof(ShardFile), older_first);
+        for (size_t i = 0; i < nfiles && total > budget; i++)
+        {
+            snprintf(path, sizeof(path), "%s/%s", shard, files[i].name);
+            /* Another process may have removed it first */
+            unlink(path);
+            total -= files[i].bytes;
+        }
+    }
+    free(files);
+}
+
+/*
+ * Stores the stats of the run of key in the cache at dir, keeping the
+ * directory within about size_mb MB
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_cache_store(const char *dir, const APEX_CacheKey *key, int halted, int cycles, int insns, int size_mb)
+{
+    APEX_CacheEntry entry;
+    char shard[4096], path[4096], tmp[4096 + 32];
+    int fd, ok;
+
+    snprintf(shard, sizeof(shard), "%s/%02x", dir, (unsigned)(key->h1 % CACHE_SHARDS));
+    if ((mkdir(dir, 0777) < 0 && errno != EEXIST) || (mkdir(shard, 0777) < 0 && errno != EEXIST))
+    {
+        fprintf(stderr, "APEX_Error: Unable to create cache directory %s\n", shard);
+        return -1;
+    }
+
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.magic, CACHE_MAGIC, CACHE_MAGIC_LEN);
+    entry.key = *key;
+    entry.halted = halted;
+    entry.cycles = cycles;
+    entry.insns = insns;
+
+    entry_path(dir, key, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s/.tmp.%d", shard, (int)getpid());
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write cache entry %s\n", tmp);
+        return -1;
+    }
+    ok = write(fd, &entry, sizeof(entry)) == sizeof(entry);
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp, path) < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write cache entry %s\n", path);
+        unlink(tmp);
+        return -1;
+    }
+
+    evict(shard, (off_t)size_mb * 1024 * 1024 / CACHE_SHARDS);
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * apex_cache.h
+ * Contains declarations of the on-disk cache of simulation results, keyed by
+ * the contents of everything a result depends on
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_CACHE_H_
+#define _APEX_CACHE_H_
+
+#include <stdint.h>
+
+#include "apex_cpu.h"
+
+/*
+ * Bump whenever a change to the pipeline changes the timing of any program,
+ * results cached by an older simulator are then never found again
+ */
+#define CACHE_STAMP 3
+
+/* Entries are spread over this many subdirectories, each evicts on its own */
+#define CACHE_SHARDS 256
+
+/* Default bound of the disk space taken by a cache directory, in MB */
+#define CACHE_DEFAULT_SIZE 64
+
+#define CACHE_MAGIC "APEXRES1"
+#define CACHE_MAGIC_LEN 8
+
+/* Two independent 64 bit hashes of the inputs of a run */
+typedef struct APEX_CacheKey
+{
+    uint64_t h1;
+    uint64_t h2;
+} APEX_CacheKey;
+
+/* Stats of a finished run, the contents of one cache entry */
+typedef struct APEX_CacheEntry
+{
+    char magic[CACHE_MAGIC_LEN];
+    APEX_CacheKey key;
+    int32_t halted;
+    int32_t cycles;
+    int32_t insns;
+    int32_t pad;
+} APEX_CacheEntry;
+
+void APEX_cache_key(const APEX_CPU *cpu, int cycles, APEX_CacheKey *key);
+int APEX_cache_lookup(const char *dir, const APEX_CacheKey *key, APEX_CacheEntry *entry);
+int APEX_cache_store(const char *dir, const APEX_CacheKey *key, int halted, int cycles, int insns, int size_mb);
+#endif
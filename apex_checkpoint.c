@@ -0,0 +1,396 @@
+/*
+ * apex_checkpoint.c
+ * Contains the checkpoint file which makes re-simulating an edited program
+ * incremental
+ *
+ * A run with --checkpoints=<file> takes a snapshot every snapshot interval
+ * and records the cycle each instruction was first fetched in. At the end
+ * both are written to the file together with the program, the machine
+ * configuration and the initial data memory. The next run of the same
+ * machine on the same data compares its program against the stored one:
+ * until the first cycle any changed instruction was fetched in, the two runs
+ * are cycle for cycle the same, so the run restores the newest snapshot at or
+ * before that cycle and only simulates from there. The state of a cycle
+ * depends on the program only through the instructions fetched so far.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apex_cache.h"
+#include "apex_checkpoint.h"
+#include "apex_cpu.h"
+#include "apex_snapshot.h"
+
+/* Instruction fields compared between two versions of a program */
+#define INSN_WORDS 6
+
+static void
+config_words(const APEX_CPU *cpu, int interval, int *words)
+{
+    int i = 0;
+
+    words[i++] = CACHE_STAMP;
+    words[i++] = (int)sizeof(APEX_CPU);
+    words[i++] = interval;
+    words[i++] = ROB_SIZE(cpu);
+    words[i++] = IQ_SIZE(cpu);
+    words[i++] = PHYS_REGS(cpu);
+    words[i++] = INTFU_COUNT(cpu);
+    words[i++] = MULFU_COUNT(cpu);
+    words[i++] = INTFU_LATENCY(cpu);
+    words[i++] = MUL_LATENCY(cpu);
+    words[i++] = MEM_LATENCY(cpu);
+    words[i++] = cpu->config.oracles;
+}
+
+static void
+insn_words(const APEX_Instruction *ins, int *words)
+{
+    words[0] = ins->opcode;
+    words[1] = ins->rd;
+    words[2] = ins->rs1;
+    words[3] = ins->rs2;
+    words[4] = ins->rs3;
+    words[5] = ins->imm;
+}
+
+/*
+ * Moves the ROB entry pointers of the latches by delta, snapshots hold them
+ * relative to the CPU so that another process can restore them
+ */
+static void
+relocate(APEX_CPU *cpu, intptr_t delta)
+{
+    CPU_Stage *single[] = {&cpu->fetch, &cpu->decode, &cpu->issuequeue, &cpu->jbu1, &cpu->jbu2,
+                           &cpu->memory1, &cpu->memory2, &cpu->instruction_commitment};
+    CPU_Stage *stages[sizeof(single) / sizeof(single[0]) + INTFU_CAPACITY + 3 * MULFU_CAPACITY];
+    int n = 0;
+
+    for (size_t i = 0; i < sizeof(single) / sizeof(single[0]); i++)
+    {
+        stages[n++] = single[i];
+    }
+    for (int i = 0; i < INTFU_CAPACITY; i++)
+    {
+        stages[n++] = &cpu->intfu[i];
+    }
+    for (int i = 0; i < MULFU_CAPACITY; i++)
+    {
+        stages[n++] = &cpu->mul1[i];
+        stages[n++] = &cpu->mul2[i];
+        stages[n++] = &cpu->mul3[i];
+    }
+    for (int i = 0; i < n; i++)
+    {
+        if (stages[i]->rob_entry)
+        {
+            stages[i]->rob_entry = (ROB_ENTRY *)((intptr_t)stages[i]->rob_entry + delta);
+        }
+    }
+}
+
+static int
+take(APEX_Checkpoints *ckpt, APEX_CPU *cpu)
+{
+    int ret;
+
+    relocate(cpu, -(intptr_t)cpu);
+    ret = APEX_snapshot_take(&ckpt->snaps, cpu);
+    relocate(cpu, (intptr_t)cpu);
+    return ret;
+}
+
+/* Previous run as read back from its checkpoint file */
+typedef struct PreviousRun
+{
+    int code_memory_size;
+    int *code;         /* INSN_WORDS per instruction */
+    int *first_fetch;
+    int end;           /* Clock when it ended, later snapshots may be past HALT */
+} PreviousRun;
+
+/*
+ * Reads the header, program and fetch record of the file in fp, then its
+ * snapshots into ckpt, the file must describe the machine and data of cpu
+ *
+ * Returns 0 on success, -1 when the file does not apply or is damaged
+ */
+static int
+read_previous(FILE *fp, const APEX_CPU *cpu, APEX_Checkpoints *ckpt, PreviousRun *prev)
+{
+    int words[CHECKPOINT_CONFIG_WORDS], stored[CHECKPOINT_CONFIG_WORDS];
+    char magic[CHECKPOINT_MAGIC_LEN], name[32], stored_name[32];
+    int memory[DATA_MEMORY_SIZE];
+    double version;
+    int size;
+
+    config_words(cpu, ckpt->snaps.interval, words);
+    memset(name, 0, sizeof(name));
+    snprintf(name, sizeof(name), "%s", cpu->config.name);
+    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) ||
+        fread(&version, sizeof(version), 1, fp) != 1 || version != VERSION ||
+        fread(stored, sizeof(int), CHECKPOINT_CONFIG_WORDS, fp) != CHECKPOINT_CONFIG_WORDS ||
+        memcmp(stored, words, sizeof(words)) || fread(stored_name, 1, sizeof(stored_name), fp) != sizeof(stored_name) ||
+        memcmp(stored_name, name, sizeof(name)))
+    {
+        return -1;
+    }
+
+    /* A different preload makes every cycle different */
+    if (fread(memory, sizeof(int), DATA_MEMORY_SIZE, fp) != DATA_MEMORY_SIZE ||
+        memcmp(memory, cpu->data_memory, sizeof(memory)) ||
+        fread(&size, sizeof(int), 1, fp) != 1 || size < 1)
+    {
+        return -1;
+    }
+    prev->code_memory_size = size;
+    prev->code = malloc(sizeof(int) * INSN_WORDS * size);
+    prev->first_fetch = malloc(sizeof(int) * (size + 1));
+    if (!prev->code || !prev->first_fetch ||
+        fread(prev->code, sizeof(int) * INSN_WORDS, size, fp) != (size_t)size ||
+        fread(prev->first_fetch, sizeof(int), size + 1, fp) != (size_t)size + 1 ||
+        fread(&prev->end, sizeof(int), 1, fp) != 1)
+    {
+        return -1;
+    }
+    return APEX_snapshots_read(&ckpt->snaps, fp);
+}
+
+/*
+ * First cycle the previous run fetched an instruction which differs in the
+ * program of cpu, -1 when it never did, the number of such instructions goes
+ * to *changed
+ */
+static int
+first_difference(const PreviousRun *prev, const APEX_CPU *cpu, int *changed)
+{
+    int size = prev->code_memory_size > cpu->code_memory_size ? prev->code_memory_size : cpu->code_memory_size;
+    int first = -1;
+
+    *changed = 0;
+    for (int i = 0; i < size; i++)
+    {
+        int words[INSN_WORDS];
+        /* Past its end the previous run fetched nothing but tried once */
+        int fetched = prev->first_fetch[i < prev->code_memory_size ? i : prev->code_memory_size];
+
+        if (i < prev->code_memory_size && i < cpu->code_memory_size)
+        {
+            insn_words(&cpu->code_memory[i], words);
+            if (memcmp(words, &prev->code[i * INSN_WORDS], sizeof(words)) == 0)
+            {
+                continue;
+            }
+        }
+        (*changed)++;
+        if (fetched >= 0 && (first < 0 || fetched < first))
+        {
+            first = fetched;
+        }
+    }
+    return first;
+}
+
+/* Resumes cpu from the newest snapshot of prev still valid for its program */
+static void
+resume(APEX_Checkpoints *ckpt, APEX_CPU *cpu, const PreviousRun *prev, int cycles)
+{
+    APEX_Instruction *code_memory = cpu->code_memory;
+    int code_memory_size = cpu->code_memory_size;
+    const char *name = cpu->config.name;
+    int first = first_difference(prev, cpu, &ckpt->changed);
+    /* The run loop stops on reaching its limit or HALT, so it must resume before both */
+    int limit = prev->end - 1;
+
+    if (first >= 0 && first < limit)
+    {
+        limit = first;
+    }
+    if (cycles > 0 && cycles - 1 < limit)
+    {
+        limit = cycles - 1;
+    }
+    if ((ckpt->resumed = APEX_snapshot_restore(&ckpt->snaps, cpu, limit)) < 0)
+    {
+        ckpt->resumed = 0;
+        return;
+    }
+
+    /* The restored pointers belong to the previous process */
+    cpu->code_memory = code_memory;
+    cpu->code_memory_size = code_memory_size;
+    cpu->config.name = name;
+    cpu->checkpoints = ckpt;
+    APEX_snapshots_truncate(&ckpt->snaps, ckpt->resumed, cpu);
+    relocate(cpu, (intptr_t)cpu);
+
+    for (int i = 0; i <= code_memory_size; i++)
+    {
+        int fetched = prev->first_fetch[i < prev->code_memory_size ? i : prev->code_memory_size];
+
+        ckpt->first_fetch[i] = (fetched >= 0 && fetched < ckpt->resumed) ? fetched : -1;
+    }
+}
+
+/*
+ * Sets up checkpointing of the run of cpu, as initialized, for cycles (0 to
+ * HALT), resuming from filename when it holds an earlier run which applies
+ *
+ * Returns the checkpoints, NULL on failure
+ */
+APEX_Checkpoints *
+APEX_checkpoints_open(const char *filename, APEX_CPU *cpu, int interval, int cycles)
+{
+    APEX_Checkpoints *ckpt = calloc(1, sizeof(APEX_Checkpoints));
+    PreviousRun prev = {0, NULL, NULL, 0};
+    FILE *fp;
+
+    if (!ckpt || !(ckpt->first_fetch = malloc(sizeof(int) * (cpu->code_memory_size + 1))))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate checkpoints\n");
+        free(ckpt);
+        return NULL;
+    }
+    ckpt->code_memory_size = cpu->code_memory_size;
+    memcpy(ckpt->initial_memory, cpu->data_memory, sizeof(ckpt->initial_memory));
+    memset(ckpt->first_fetch, -1, sizeof(int) * (cpu->code_memory_size + 1));
+    if (APEX_snapshots_init(&ckpt->snaps, interval) < 0)
+    {
+        free(ckpt->first_fetch);
+        free(ckpt);
+        return NULL;
+    }
+    cpu->checkpoints = ckpt;
+
+    if ((fp = fopen(filename, "rb")))
+    {
+        if (read_previous(fp, cpu, ckpt, &prev) == 0)
+        {
+            resume(ckpt, cpu, &prev, cycles);
+            fprintf(stderr, "APEX_Checkpoint: %d instructions changed, resuming at cycle %d\n", ckpt->changed,
+                    ckpt->resumed);
+        }
+        else
+        {
+            fprintf(stderr, "APEX_Checkpoint: %s is for another machine or data, simulating from cycle 0\n",
+                    filename);
+        }
+        fclose(fp);
+        free(prev.code);
+        free(prev.first_fetch);
+    }
+
+    /* A file which did not apply may have left snapshots behind */
+    if (!ckpt->resumed)
+    {
+        APEX_snapshots_free(&ckpt->snaps);
+        if (APEX_snapshots_init(&ckpt->snaps, interval) < 0 || take(ckpt, cpu) < 0)
+        {
+            cpu->checkpoints = NULL;
+            APEX_snapshots_free(&ckpt->snaps);
+            free(ckpt->first_fetch);
+            free(ckpt);
+            return NULL;
+        }
+    }
+    return ckpt;
+}
+
+/* Records that code memory index, past the end for code_memory_size, was fetched in cycle */
+void
+APEX_checkpoint_fetch(APEX_Checkpoints *ckpt, int index, int cycle)
+{
+    if (index >= 0 && index <= ckpt->code_memory_size && ckpt->first_fetch[index] < 0)
+    {
+        ckpt->first_fetch[index] = cycle;
+    }
+}
+
+/*
+ * Takes a snapshot at the end of a cycle when one is due
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_checkpoint_cycle(APEX_Checkpoints *ckpt, APEX_CPU *cpu)
+{
+    return take(ckpt, cpu);
+}
+
+static int
+write_file(const APEX_Checkpoints *ckpt, const APEX_CPU *cpu, FILE *fp)
+{
+    int words[CHECKPOINT_CONFIG_WORDS];
+    char name[32];
+    double version = VERSION;
+
+    config_words(cpu, ckpt->snaps.interval, words);
+    memset(name, 0, sizeof(name));
+    snprintf(name, sizeof(name), "%s", cpu->config.name);
+    if (fwrite(CHECKPOINT_MAGIC, 1, CHECKPOINT_MAGIC_LEN, fp) != CHECKPOINT_MAGIC_LEN ||
+        fwrite(&version, sizeof(version), 1, fp) != 1 ||
+        fwrite(words, sizeof(int), CHECKPOINT_CONFIG_WORDS, fp) != CHECKPOINT_CONFIG_WORDS ||
+        fwrite(name, 1, sizeof(name), fp) != sizeof(name) ||
+        fwrite(ckpt->initial_memory, sizeof(int), DATA_MEMORY_SIZE, fp) != DATA_MEMORY_SIZE ||
+        fwrite(&ckpt->code_memory_size, sizeof(int), 1, fp) != 1)
+    {
+        return -1;
+    }
+    for (int i = 0; i < ckpt->code_memory_size; i++)
+    {
+        insn_words(&cpu->code_memory[i], words);
+        if (fwrite(words, sizeof(int), INSN_WORDS, fp) != INSN_WORDS)
+        {
+            return -1;
+        }
+    }
+    if (fwrite(ckpt->first_fetch, sizeof(int), ckpt->code_memory_size + 1, fp) != (size_t)ckpt->code_memory_size + 1 ||
+        fwrite(&cpu->clock, sizeof(int), 1, fp) != 1)
+    {
+        return -1;
+    }
+    return APEX_snapshots_write(&ckpt->snaps, fp);
+}
+
+/*
+ * Writes the checkpoints of the run of cpu to filename, replacing the file
+ * only once it is complete, and frees them
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_checkpoints_close(APEX_Checkpoints *ckpt, const APEX_CPU *cpu, const char *filename)
+{
+    char tmp[4096];
+    FILE *fp;
+    int ok;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%d", filename, (int)getpid());
+    if (!(fp = fopen(tmp, "wb")))
+    {
+        fprintf(stderr, "APEX_Error: Unable to open %s\n", tmp);
+        ok = FALSE;
+    }
+    else
+    {
+        ok = write_file(ckpt, cpu, fp) == 0;
+        ok = fclose(fp) == 0 && ok;
+        if (!ok || rename(tmp, filename) < 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to write checkpoints to %s\n", filename);
+            unlink(tmp);
+            ok = FALSE;
+        }
+    }
+    APEX_snapshots_free(&ckpt->snaps);
+    free(ckpt->first_fetch);
+    free(ckpt);
+    return ok ? 0 : -1;
+}
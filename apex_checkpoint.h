@@ -0,0 +1,37 @@
+/*
+ * apex_checkpoint.h
+ * Contains declarations of the checkpoint file kept between runs, which lets
+ * a run of an edited program resume where the previous run was still equal
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_CHECKPOINT_H_
+#define _APEX_CHECKPOINT_H_
+
+#include "apex_cpu.h"
+#include "apex_snapshot.h"
+
+#define CHECKPOINT_MAGIC "APEXCKP1"
+#define CHECKPOINT_MAGIC_LEN 8
+
+/* Machine parameters a checkpoint file is only valid for */
+#define CHECKPOINT_CONFIG_WORDS 12
+
+typedef struct APEX_Checkpoints
+{
+    APEX_Snapshots snaps;     /* Periodic CPU state of the run */
+    int *first_fetch;         /* Cycle each code memory index was first fetched,
+                               * -1 if never, the last slot is past the end */
+    int code_memory_size;
+    int resumed;              /* Cycle the run resumed at, 0 for a full run */
+    int changed;              /* Instructions which differ from the previous run */
+    int initial_memory[DATA_MEMORY_SIZE]; /* Data memory before the first cycle */
+} APEX_Checkpoints;
+
+APEX_Checkpoints *APEX_checkpoints_open(const char *filename, APEX_CPU *cpu, int interval, int cycles);
+void APEX_checkpoint_fetch(APEX_Checkpoints *ckpt, int index, int cycle);
+int APEX_checkpoint_cycle(APEX_Checkpoints *ckpt, APEX_CPU *cpu);
+int APEX_checkpoints_close(APEX_Checkpoints *ckpt, const APEX_CPU *cpu, const char *filename);
+#endif
@@ -0,0 +1,178 @@
+/*
+ * apex_config.c
+ * Contains functions to set up and validate the APEX machine configuration
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "apex_config.h"
+#include "apex_macros.h"
+
+static const struct
+{
+    const char *name;
+    int oracle;
+} oracle_names[] = {
+    {"branch", ORACLE_BRANCH},
+    {"memory", ORACLE_MEMORY},
+    {"window", ORACLE_WINDOW},
+    {"fu", ORACLE_FU},
+};
+
+void
+APEX_config_default(APEX_Config *config)
+{
+#ifdef APEX_SPECIALIZED
+    config->name = APEX_SPEC_NAME;
+    config->rob_size = APEX_SPEC_ROB_SIZE;
+    config->iq_size = APEX_SPEC_IQ_SIZE;
+    config->phys_regs = APEX_SPEC_PHYS_REGS;
+    config->intfu_count = APEX_SPEC_INTFU_COUNT;
+    config->mulfu_count = APEX_SPEC_MULFU_COUNT;
+    config->intfu_latency = APEX_SPEC_INTFU_LATENCY;
+    config->mul_latency = APEX_SPEC_MUL_LATENCY;
+    config->mem_latency = APEX_SPEC_MEM_LATENCY;
+#else
+    config->name = "runtime";
+    config->rob_size = DEFAULT_ROB_SIZE;
+    config->iq_size = DEFAULT_IQ_SIZE;
+    config->phys_regs = DEFAULT_PHYS_REGS;
+    config->intfu_count = DEFAULT_INTFU_COUNT;
+    config->mulfu_count = DEFAULT_MULFU_COUNT;
+    config->intfu_latency = DEFAULT_INTFU_LATENCY;
+    config->mul_latency = DEFAULT_MUL_LATENCY;
+    config->mem_latency = DEFAULT_MEM_LATENCY;
+#endif
+    config->oracles = 0;
+}
+
+static int
+check_range(const char *what, int value, int min, int max)
+{
+    if (value < min || value > max)
+    {
+        fprintf(stderr, "APEX_Error: %s = %d, must be within [%d, %d]\n", what, value, min, max);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Checks that the configuration fits this build
+ *
+ * Returns 0 when valid, -1 otherwise
+ */
+int
+APEX_config_check(const APEX_Config *config)
+{
+    int ret = 0;
+
+#ifdef APEX_SPECIALIZED
+    APEX_Config spec;
+
+    APEX_config_default(&spec);
+    if (config->rob_size != spec.rob_size || config->iq_size != spec.iq_size ||
+        config->phys_regs != spec.phys_regs || config->intfu_count != spec.intfu_count ||
+        config->mulfu_count != spec.mulfu_count || config->intfu_latency != spec.intfu_latency ||
+        config->mul_latency != spec.mul_latency || config->mem_latency != spec.mem_latency)
+    {
+        fprintf(stderr, "APEX_Error: Machine configuration is fixed by specialization %s\n", spec.name);
+        return -1;
+    }
+    if (config->oracles & (ORACLE_WINDOW | ORACLE_FU))
+    {
+        fprintf(stderr, "APEX_Error: Window and FU oracles need a generic build\n");
+        return -1;
+    }
+#endif
+    ret |= check_range("rob-size", config->rob_size, 2, ROB_CAPACITY);
+    ret |= check_range("iq-size", config->iq_size, 1, IQ_CAPACITY);
+    /* Every architectural register keeps a physical one, rename needs one more */
+    ret |= check_range("phys-regs", config->phys_regs, REG_FILE_SIZE + 1, PHYS_REG_CAPACITY);
+    ret |= check_range("intfu-count", config->intfu_count, 1, INTFU_CAPACITY);
+    ret |= check_range("mulfu-count", config->mulfu_count, 1, MULFU_CAPACITY);
+    ret |= check_range("intfu-latency", config->intfu_latency, 1, 64);
+    ret |= check_range("mul-latency", config->mul_latency, 3, 64);
+    ret |= check_range("mem-latency", config->mem_latency, 2, 64);
+    return ret;
+}
+
+/* Records which machine produced the results printed before it */
+void
+APEX_config_print(const APEX_Config *config)
+{
+    printf("APEX_CPU: Configuration %s: rob=%d iq=%d prf=%d intfu=%dx%d mul=%dx%d mem=%d",
+           config->name, config->rob_size, config->iq_size, config->phys_regs,
+           config->intfu_count, config->intfu_latency, config->mulfu_count,
+           config->mul_latency, config->mem_latency);
+    for (size_t i = 0, n = 0; i < sizeof(oracle_names) / sizeof(oracle_names[0]); i++)
+    {
+        if (config->oracles & oracle_names[i].oracle)
+        {
+            printf("%s%s", n++ ? "+" : " oracle=", oracle_names[i].name);
+        }
+    }
+    printf("\n");
+}
+
+/*
+ * Parses a comma separated list of oracle names, or "all"
+ *
+ * Returns 0 on success, -1 for an unknown name
+ */
+int
+APEX_config_parse_oracles(const char *list, int *oracles)
+{
+    char buf[128];
+
+    if (strlen(list) >= sizeof(buf))
+    {
+        return -1;
+    }
+    strcpy(buf, list);
+    *oracles = 0;
+    for (char *name = strtok(buf, ","); name; name = strtok(NULL, ","))
+    {
+        size_t i;
+
+        if (strcmp(name, "all") == 0)
+        {
+            *oracles |= ORACLE_ALL;
+            continue;
+        }
+        for (i = 0; i < sizeof(oracle_names) / sizeof(oracle_names[0]); i++)
+        {
+            if (strcmp(name, oracle_names[i].name) == 0)
+            {
+                *oracles |= oracle_names[i].oracle;
+                break;
+            }
+        }
+        if (i == sizeof(oracle_names) / sizeof(oracle_names[0]))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Raises the sizes and unit counts the window and FU oracles make unlimited */
+void
+APEX_config_apply_oracles(APEX_Config *config)
+{
+    if (config->oracles & ORACLE_WINDOW)
+    {
+        config->rob_size = ROB_CAPACITY;
+        config->iq_size = IQ_CAPACITY;
+        config->phys_regs = PHYS_REG_CAPACITY;
+    }
+    if (config->oracles & ORACLE_FU)
+    {
+        config->intfu_count = INTFU_CAPACITY;
+        config->mulfu_count = MULFU_CAPACITY;
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * apex_config.h
+ * Contains the APEX machine configuration: sizes of the out-of-order
+ * structures, functional unit counts and latencies
+ *
+ * A generic build reads the configuration at run time from APEX_CPU.
+ * A specialized build is compiled with -DAPEX_SPEC_HEADER="<header>"
+ * (see `make variants`) and every accessor below becomes a compile time
+ * constant, so loops over the IQ, ROB and free lists get fixed trip counts
+ * and ROB index wrap-around becomes a mask for power of two sizes.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_CONFIG_H_
+#define _APEX_CONFIG_H_
+
+/* Default machine, the one described in the project handout */
+#define DEFAULT_ROB_SIZE 64
+#define DEFAULT_IQ_SIZE 24
+#define DEFAULT_PHYS_REGS 48
+#define DEFAULT_INTFU_COUNT 1
+#define DEFAULT_MULFU_COUNT 1
+#define DEFAULT_INTFU_LATENCY 1
+#define DEFAULT_MUL_LATENCY 3 /* MUL1 -> MUL2 -> MUL3 */
+#define DEFAULT_MEM_LATENCY 2 /* MEM1 -> MEM2 */
+
+#ifdef APEX_SPEC_HEADER
+#include APEX_SPEC_HEADER
+#define APEX_SPECIALIZED 1
+
+#ifndef APEX_SPEC_NAME
+#define APEX_SPEC_NAME "unnamed"
+#endif
+#ifndef APEX_SPEC_ROB_SIZE
+#define APEX_SPEC_ROB_SIZE DEFAULT_ROB_SIZE
+#endif
+#ifndef APEX_SPEC_IQ_SIZE
+#define APEX_SPEC_IQ_SIZE DEFAULT_IQ_SIZE
+#endif
+#ifndef APEX_SPEC_PHYS_REGS
+#define APEX_SPEC_PHYS_REGS DEFAULT_PHYS_REGS
+#endif
+#ifndef APEX_SPEC_INTFU_COUNT
+#define APEX_SPEC_INTFU_COUNT DEFAULT_INTFU_COUNT
+#endif
+#ifndef APEX_SPEC_MULFU_COUNT
+#define APEX_SPEC_MULFU_COUNT DEFAULT_MULFU_COUNT
+#endif
+#ifndef APEX_SPEC_INTFU_LATENCY
+#define APEX_SPEC_INTFU_LATENCY DEFAULT_INTFU_LATENCY
+#endif
+#ifndef APEX_SPEC_MUL_LATENCY
+#define APEX_SPEC_MUL_LATENCY DEFAULT_MUL_LATENCY
+#endif
+#ifndef APEX_SPEC_MEM_LATENCY
+#define APEX_SPEC_MEM_LATENCY DEFAULT_MEM_LATENCY
+#endif
+
+/* Arrays are sized exactly for the specialization */
+#define ROB_CAPACITY APEX_SPEC_ROB_SIZE
+#define IQ_CAPACITY APEX_SPEC_IQ_SIZE
+#define PHYS_REG_CAPACITY APEX_SPEC_PHYS_REGS
+#define INTFU_CAPACITY APEX_SPEC_INTFU_COUNT
+#define MULFU_CAPACITY APEX_SPEC_MULFU_COUNT
+
+#define ROB_SIZE(cpu) APEX_SPEC_ROB_SIZE
+#define IQ_SIZE(cpu) APEX_SPEC_IQ_SIZE
+#define PHYS_REGS(cpu) APEX_SPEC_PHYS_REGS
+#define INTFU_COUNT(cpu) APEX_SPEC_INTFU_COUNT
+#define MULFU_COUNT(cpu) APEX_SPEC_MULFU_COUNT
+#define INTFU_LATENCY(cpu) APEX_SPEC_INTFU_LATENCY
+#define MUL_LATENCY(cpu) APEX_SPEC_MUL_LATENCY
+#define MEM_LATENCY(cpu) APEX_SPEC_MEM_LATENCY
+
+#if (APEX_SPEC_ROB_SIZE & (APEX_SPEC_ROB_SIZE - 1)) == 0
+#define ROB_NEXT(cpu, i) (((i) + 1) & (APEX_SPEC_ROB_SIZE - 1))
+#else
+#define ROB_NEXT(cpu, i) (((i) + 1) % APEX_SPEC_ROB_SIZE)
+#endif
+
+#else /* !APEX_SPEC_HEADER */
+
+/* Largest machine a generic build can be configured to at run time */
+#define ROB_CAPACITY 256
+#define IQ_CAPACITY 64
+#define PHYS_REG_CAPACITY 128
+#define INTFU_CAPACITY 4
+#define MULFU_CAPACITY 4
+
+#define ROB_SIZE(cpu) ((cpu)->config.rob_size)
+#define IQ_SIZE(cpu) ((cpu)->config.iq_size)
+#define PHYS_REGS(cpu) ((cpu)->config.phys_regs)
+#define INTFU_COUNT(cpu) ((cpu)->config.intfu_count)
+#define MULFU_COUNT(cpu) ((cpu)->config.mulfu_count)
+#define INTFU_LATENCY(cpu) ((cpu)->config.intfu_latency)
+#define MUL_LATENCY(cpu) ((cpu)->config.mul_latency)
+#define MEM_LATENCY(cpu) ((cpu)->config.mem_latency)
+
+#define ROB_NEXT(cpu, i) (((i) + 1) % (cpu)->config.rob_size)
+
+#endif /* APEX_SPEC_HEADER */
+
+/* Parts of the machine an oracle makes ideal, for limit studies */
+enum
+{
+    ORACLE_BRANCH = 0x1, /* Fetch follows the committed path, branches never stall or flush */
+    ORACLE_MEMORY = 0x2, /* Loads and stores pass MEM1 and MEM2 in one cycle */
+    ORACLE_WINDOW = 0x4, /* ROB, issue queue and physical registers at the capacity of the build */
+    ORACLE_FU = 0x8,     /* Integer units and multipliers at the capacity of the build, MUL
+                          * gets its own issue port */
+    ORACLE_ALL = 0xf
+};
+
+#define ORACLE(cpu, which) ((cpu)->config.oracles & (which))
+
+/* Machine configuration of one simulation run */
+typedef struct APEX_Config
+{
+    const char *name;  /* Specialization name, "runtime" for a generic build */
+    int rob_size;      /* ROB entries */
+    int iq_size;       /* Issue queue entries */
+    int phys_regs;     /* Physical registers */
+    int intfu_count;   /* Integer units */
+    int mulfu_count;   /* Multiplier pipelines */
+    int intfu_latency; /* Cycles an instruction occupies an integer unit */
+    int mul_latency;   /* Cycles from MUL1 to result, at least 3 */
+    int mem_latency;   /* Cycles from MEM1 to result, at least 2 */
+    int oracles;       /* ORACLE_* parts of the machine made ideal */
+} APEX_Config;
+
+void APEX_config_default(APEX_Config *config);
+int APEX_config_check(const APEX_Config *config);
+void APEX_config_print(const APEX_Config *config);
+int APEX_config_parse_oracles(const char *list, int *oracles);
+void APEX_config_apply_oracles(APEX_Config *config);
+#endif
@@ -0,0 +1,242 @@
+/*
+ * apex_cpistack.c
+ * Contains the top-down CPI stack of a run
+ *
+ * At the end of every cycle the cycle is charged to exactly one category,
+ * the first of these which applies:
+ *
+ *   base             an instruction committed
+ *   bad speculation  a taken branch or jump squashed the issue queue or the
+ *                    ROB, or its flush is pending and decode is held
+ *   frontend         the ROB is empty, or fetch is stalled behind the BZ/BNZ
+ *                    dispatched last and decode has nothing
+ *   resource         decode held its instruction for lack of a physical
+ *                    register, an issue queue entry or a ROB entry
+ *   memory           the ROB head is a load or store in MEM1/MEM2
+ *   core             the ROB head waits for operands or a functional unit
+ *
+ * so the categories add up to the cycles of the run, and divided by the
+ * committed instructions to its CPI. Rows of a fixed number of cycles show
+ * how the stack changes over the run.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpistack.h"
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+static const char *names[CPI_KINDS] = {"Base", "Bad-spec", "Frontend", "Resource", "Memory", "Core"};
+
+APEX_CpiStack *
+APEX_cpistack_create(int interval)
+{
+    APEX_CpiStack *stack = calloc(1, sizeof(APEX_CpiStack));
+
+    if (!stack)
+    {
+        return NULL;
+    }
+    stack->interval = interval;
+    stack->capacity = 64;
+    stack->count = 1;
+    stack->rows = calloc(stack->capacity, sizeof(CPI_Interval));
+    if (!stack->rows)
+    {
+        free(stack);
+        return NULL;
+    }
+    return stack;
+}
+
+void
+APEX_cpistack_free(APEX_CpiStack *stack)
+{
+    if (stack)
+    {
+        free(stack->rows);
+        free(stack);
+    }
+}
+
+/* Called whenever a taken branch or jump discards younger work */
+void
+APEX_cpistack_squash(APEX_CpiStack *stack)
+{
+    stack->squashed = TRUE;
+}
+
+static int
+is_memory(int opcode)
+{
+    return opcode == OPCODE_LOAD || opcode == OPCODE_LDR || opcode == OPCODE_STORE || opcode == OPCODE_STR;
+}
+
+static int
+classify(const APEX_CpiStack *stack, const APEX_CPU *cpu)
+{
+    const ROB_ENTRY *head = &cpu->ROB[cpu->rob_head];
+    const ROB_ENTRY *youngest;
+
+    if (cpu->insn_completed != stack->insns)
+    {
+        return CPI_BASE;
+    }
+    if (stack->squashed || cpu->flush_pending)
+    {
+        return CPI_BAD_SPEC;
+    }
+    if (cpu->rob_head == cpu->rob_tail)
+    {
+        return CPI_FRONTEND;
+    }
+    youngest = &cpu->ROB[(cpu->rob_tail + ROB_SIZE(cpu) - 1) % ROB_SIZE(cpu)];
+    if (!cpu->decode.has_insn && !youngest->result_valid &&
+        (youngest->instruction_type == OPCODE_BZ || youngest->instruction_type == OPCODE_BNZ))
+    {
+        return CPI_FRONTEND;
+    }
+    /* Decode stalls on a pending flush were charged above */
+    if (cpu->decode.stalled)
+    {
+        return CPI_RESOURCE;
+    }
+    if (is_memory(head->instruction_type) && head->mready)
+    {
+        return CPI_MEMORY;
+    }
+    return CPI_CORE;
+}
+
+/*
+ * Called at the end of every cycle, before the clock advances
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_cpistack_cycle(APEX_CpiStack *stack, const APEX_CPU *cpu)
+{
+    CPI_Interval *row = &stack->rows[stack->count - 1];
+    int kind = classify(stack, cpu);
+
+    row->cycles[kind]++;
+    row->insns += cpu->insn_completed - stack->insns;
+    stack->total.cycles[kind]++;
+    stack->total.insns += cpu->insn_completed - stack->insns;
+    stack->insns = cpu->insn_completed;
+    stack->squashed = FALSE;
+
+    if ((cpu->clock + 1) % stack->interval == 0)
+    {
+        if (stack->count == stack->capacity)
+        {
+            CPI_Interval *rows = realloc(stack->rows, 2 * stack->capacity * sizeof(CPI_Interval));
+
+            if (!rows)
+            {
+                fprintf(stderr, "APEX_Error: Unable to allocate CPI stack\n");
+                return -1;
+            }
+            stack->rows = rows;
+            stack->capacity *= 2;
+        }
+        memset(&stack->rows[stack->count++], 0, sizeof(CPI_Interval));
+    }
+    return 0;
+}
+
+static long
+cycles_of(const CPI_Interval *row)
+{
+    long cycles = 0;
+
+    for (int i = 0; i < CPI_KINDS; i++)
+    {
+        cycles += row->cycles[i];
+    }
+    return cycles;
+}
+
+/*
+ * Writes the stack of the run and of every interval to filename, "-" for
+ * standard output
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_cpistack_write(const APEX_CpiStack *stack, const char *filename)
+{
+    FILE *fp = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    const CPI_Interval *total = &stack->total;
+    long cycles = cycles_of(total);
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open CPI stack %s\n", filename);
+        return -1;
+    }
+
+    fprintf(fp, "CPI stack: %ld cycles, %ld instructions committed", cycles, total->insns);
+    if (total->insns)
+    {
+        fprintf(fp, ", CPI %.3f", (double)cycles / total->insns);
+    }
+    fprintf(fp, "\n\n%-10s %9s %8s %8s\n", "Category", "Cycles", "Percent", "CPI");
+    for (int i = 0; i < CPI_KINDS; i++)
+    {
+        fprintf(fp, "%-10s %9ld %7.2f%% ", names[i], total->cycles[i],
+                cycles ? 100.0 * total->cycles[i] / cycles : 0.0);
+        if (total->insns)
+        {
+            fprintf(fp, "%8.3f\n", (double)total->cycles[i] / total->insns);
+        }
+        else
+        {
+            fprintf(fp, "%8s\n", "-");
+        }
+    }
+
+    /* Intervals without a commit have no CPI, their cycles still show */
+    fprintf(fp, "\nCycles of each category per %d cycle interval\n", stack->interval);
+    fprintf(fp, "%9s %7s %8s", "Cycle", "Insns", "CPI");
+    for (int i = 0; i < CPI_KINDS; i++)
+    {
+        fprintf(fp, " %8s", names[i]);
+    }
+    fprintf(fp, "\n");
+    for (int r = 0; r < stack->count; r++)
+    {
+        const CPI_Interval *row = &stack->rows[r];
+
+        if (!cycles_of(row))
+        {
+            continue;
+        }
+        fprintf(fp, "%9ld %7ld ", (long)r * stack->interval, row->insns);
+        if (row->insns)
+        {
+            fprintf(fp, "%8.3f", (double)cycles_of(row) / row->insns);
+        }
+        else
+        {
+            fprintf(fp, "%8s", "-");
+        }
+        for (int i = 0; i < CPI_KINDS; i++)
+        {
+            fprintf(fp, " %8ld", row->cycles[i]);
+        }
+        fprintf(fp, "\n");
+    }
+
+    if (fp != stdout && fclose(fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write CPI stack %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
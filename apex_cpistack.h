@@ -0,0 +1,53 @@
+/*
+ * apex_cpistack.h
+ * Contains declarations of the top-down CPI stack, which charges every cycle
+ * to one cause
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_CPISTACK_H_
+#define _APEX_CPISTACK_H_
+
+#include "apex_cpu.h"
+
+/* Default cycles of one row of the per-interval stack */
+#define CPISTACK_DEFAULT_INTERVAL 1000
+
+/* Categories a cycle is charged to, the first which applies wins */
+enum
+{
+    CPI_BASE,        /* At least one instruction committed */
+    CPI_BAD_SPEC,    /* Work behind a taken branch or jump discarded or waiting to be */
+    CPI_FRONTEND,    /* ROB empty, or fetch stalled behind an unresolved BZ/BNZ */
+    CPI_RESOURCE,    /* Decode held for lack of a physical register, IQ or ROB entry */
+    CPI_MEMORY,      /* ROB head is a load or store in the memory pipeline */
+    CPI_CORE,        /* ROB head waits for operands, an integer unit or a multiplier */
+    CPI_KINDS
+};
+
+/* Cycles of each category over some span of the run */
+typedef struct CPI_Interval
+{
+    long cycles[CPI_KINDS];
+    long insns;
+} CPI_Interval;
+
+typedef struct APEX_CpiStack
+{
+    int interval;              /* Cycles per row */
+    int insns;                 /* Instructions committed before the current cycle */
+    int squashed;              /* Work was discarded in the current cycle */
+    int count;                 /* Rows, the last one still being filled */
+    int capacity;
+    CPI_Interval *rows;
+    CPI_Interval total;
+} APEX_CpiStack;
+
+APEX_CpiStack *APEX_cpistack_create(int interval);
+void APEX_cpistack_free(APEX_CpiStack *stack);
+void APEX_cpistack_squash(APEX_CpiStack *stack);
+int APEX_cpistack_cycle(APEX_CpiStack *stack, const APEX_CPU *cpu);
+int APEX_cpistack_write(const APEX_CpiStack *stack, const char *filename);
+#endif
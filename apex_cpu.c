@@ -10,8 +10,21 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "apex_branchprof.h"
+#include "apex_checkpoint.h"
+#include "apex_cpistack.h"
 #include "apex_cpu.h"
+#include "apex_critpath.h"
+#include "apex_hostprof.h"
 #include "apex_macros.h"
+#include "apex_memimage.h"
+#include "apex_memprofile.h"
+#include "apex_observer.h"
+#include "apex_oracle.h"
+#include "apex_profile.h"
+#include "apex_runctl.h"
+#include "apex_telemetry.h"
+#include "apex_trace.h"
 int funct = 0; // 0 for simulate 1 for display and single step for 2
 int numOfCycles = 0;
 int ENABLE_DEBUG_MESSAGES = TRUE;
@@ -211,13 +224,13 @@ static void print_rob(APEX_CPU *cpu)
     printf("Details of R-ROB  State --\n");
 
     int a = cpu->rob_head;
-    while (a < cpu->rob_tail)
+    while (a != cpu->rob_tail)
     {
         ROB_ENTRY *rob_entry = &cpu->ROB[a];
 
         printf("%s,R%d __pc[%d] \n  ", rob_entry->opcode_str, rob_entry->des_rd, rob_entry->pc);
 
-        a++;
+        a = ROB_NEXT(cpu, a);
     }
     printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
 }
@@ -227,7 +240,7 @@ static void print_physical_register(APEX_CPU *cpu)
     printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
     printf("Details of Valid Physical register State --\n");
     printf(" P[#]  ==== [valid] ----- [value]\n  ");
-    for (int i = 0; i < 48; i++)
+    for (int i = 0; i < PHYS_REGS(cpu); i++)
     {
         // if (cpu->free_PR_list[i] == 1)
         {
@@ -236,6 +249,121 @@ static void print_physical_register(APEX_CPU *cpu)
         }
     }
 }
+
+/*
+ * Observer hooks, only called through OBSERVE once a callback watches the
+ * event, each fills in a view and hands it on
+ */
+static void
+observe_fetch(APEX_CPU *cpu, const CPU_Stage *stage)
+{
+    APEX_ObsView view;
+
+    APEX_observer_view(&view, OBS_FETCH, cpu);
+    view.pc = stage->pc;
+    view.opcode = stage->opcode;
+    APEX_observe(cpu, &view);
+}
+
+/* Tells of the instruction in ROB entry rob_index */
+static void
+observe_rob(APEX_CPU *cpu, int event, int rob_index)
+{
+    const ROB_ENTRY *rob_entry = &cpu->ROB[rob_index];
+    APEX_ObsView view;
+
+    APEX_observer_view(&view, event, cpu);
+    view.pc = rob_entry->pc;
+    view.opcode = rob_entry->instruction_type;
+    view.rob_index = rob_index;
+    /* Stores keep their address in des_phy_reg */
+    if (rob_entry->instruction_type != OPCODE_STORE && rob_entry->instruction_type != OPCODE_STR)
+    {
+        view.phys_reg = rob_entry->des_phy_reg;
+    }
+    if (rob_entry->result_valid)
+    {
+        view.value = rob_entry->result;
+    }
+    if (event == OBS_MEMORY)
+    {
+        view.address = rob_entry->mem_address;
+    }
+    APEX_observe(cpu, &view);
+}
+
+/*
+ * Tells of the issue queue entry taken by the instruction in ROB entry
+ * rob_index, or of its issue when decode sent it straight to MEM1
+ */
+static void
+observe_dispatch(APEX_CPU *cpu, int rob_index)
+{
+    const ROB_ENTRY *rob_entry = &cpu->ROB[rob_index];
+    APEX_ObsView view;
+
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        if (cpu->freeiq[i] == 1 && cpu->IssueQueue[i].rob_tail == rob_index)
+        {
+            if (OBSERVED(cpu, OBS_DISPATCH))
+            {
+                APEX_observer_view(&view, OBS_DISPATCH, cpu);
+                view.pc = cpu->IssueQueue[i].pc;
+                view.opcode = cpu->IssueQueue[i].opcode;
+                view.rob_index = rob_index;
+                view.phys_reg = cpu->IssueQueue[i].des_phy_reg;
+                view.iq_index = i;
+                APEX_observe(cpu, &view);
+            }
+            return;
+        }
+    }
+    if (OBSERVED(cpu, OBS_ISSUE) && cpu->memory1.has_insn && cpu->memory1.rob_entry == rob_entry)
+    {
+        APEX_observer_view(&view, OBS_ISSUE, cpu);
+        view.pc = rob_entry->pc;
+        view.opcode = rob_entry->instruction_type;
+        view.rob_index = rob_index;
+        if (rob_entry->instruction_type == OPCODE_LOAD || rob_entry->instruction_type == OPCODE_LDR)
+        {
+            view.phys_reg = rob_entry->des_phy_reg;
+        }
+        view.unit = OBS_UNIT_MEMORY;
+        view.lane = 0;
+        APEX_observe(cpu, &view);
+    }
+}
+
+static void
+observe_issue(APEX_CPU *cpu, const IQ_ENTRY *iq_entry, int unit, int lane)
+{
+    APEX_ObsView view;
+
+    APEX_observer_view(&view, OBS_ISSUE, cpu);
+    view.pc = iq_entry->pc;
+    view.opcode = iq_entry->opcode;
+    view.rob_index = iq_entry->rob_tail;
+    view.phys_reg = iq_entry->des_phy_reg;
+    view.unit = unit;
+    view.lane = lane;
+    APEX_observe(cpu, &view);
+}
+
+/* Tells of the branch or jump discarding squashed younger entries */
+static void
+observe_flush(APEX_CPU *cpu, int event, int pc, int opcode, int rob_index, int squashed)
+{
+    APEX_ObsView view;
+
+    APEX_observer_view(&view, event, cpu);
+    view.pc = pc;
+    view.opcode = opcode;
+    view.rob_index = rob_index;
+    view.squashed = squashed;
+    APEX_observe(cpu, &view);
+}
+
 static void
 APEX_fetch(APEX_CPU *cpu)
 {
@@ -253,12 +381,30 @@ APEX_fetch(APEX_CPU *cpu)
                 /* Skip this cycle*/
                 return;
             }
+            /* Nothing to fetch past the last instruction, pass a bubble
+             * while the pipeline drains until HALT commits */
+            if (get_code_memory_index_from_pc(cpu->pc) >= cpu->code_memory_size)
+            {
+                if (cpu->checkpoints)
+                {
+                    APEX_checkpoint_fetch(cpu->checkpoints, cpu->code_memory_size, cpu->clock);
+                }
+                if (!cpu->decode.stalled)
+                {
+                    cpu->decode.has_insn = FALSE;
+                }
+                return;
+            }
             /* Store current PC in fetch latch */
             cpu->fetch.pc = cpu->pc;
             /* Index into code memory using this pc and copy all instruction fields
          * into fetch latch  */
             current_ins = &cpu->code_memory[get_code_memory_index_from_pc(cpu->pc)];
-            strcpy(cpu->fetch.opcode_str, current_ins->opcode_str);
+            if (cpu->checkpoints)
+            {
+                APEX_checkpoint_fetch(cpu->checkpoints, get_code_memory_index_from_pc(cpu->pc), cpu->clock);
+            }
+            HOSTPROF_STRCPY(cpu->fetch.opcode_str, current_ins->opcode_str);
             cpu->fetch.opcode = current_ins->opcode;
             cpu->fetch.rd = current_ins->rd;
             cpu->fetch.rs1 = current_ins->rs1;
@@ -268,11 +414,25 @@ APEX_fetch(APEX_CPU *cpu)
 
             if (!cpu->decode.stalled)
             {
-                /* Update PC for next instruction */
-                cpu->pc += 4;
+                if (cpu->fetch_breaks && cpu->fetch_breaks[get_code_memory_index_from_pc(cpu->pc)])
+                {
+                    cpu->fetch_break_pc = cpu->pc;
+                }
+                /* Update PC for next instruction, the branch oracle knows
+                 * where the committed path goes */
+                if (cpu->oracle)
+                {
+                    cpu->pc = APEX_oracle_fetch(cpu->oracle, current_ins, cpu->pc);
+                }
+                else
+                {
+                    cpu->pc += 4;
+                }
 
                 /* Copy data from fetch latch to decode latch*/
+                HOSTPROF_EVENT(HP_LATCH_COPY);
                 cpu->decode = cpu->fetch;
+                OBSERVE(cpu, OBS_FETCH, observe_fetch(cpu, &cpu->decode));
             }
             else
             {
@@ -303,18 +463,73 @@ APEX_fetch(APEX_CPU *cpu)
  *
  * Note: You are free to edit this function according to your implementation
  */
+static int
+rob_full(const APEX_CPU *cpu)
+{
+    return ROB_NEXT(cpu, cpu->rob_tail) == cpu->rob_head;
+}
+
+int
+APEX_cpu_rob_full(const APEX_CPU *cpu)
+{
+    return rob_full(cpu);
+}
+
+int
+APEX_cpu_iq_full(const APEX_CPU *cpu)
+{
+    HOSTPROF_EVENT(HP_IQ_SCAN);
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        if (cpu->freeiq[i] != 1)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Committed value of architectural register reg */
+int
+APEX_cpu_arch_reg(const APEX_CPU *cpu, int reg)
+{
+    if (cpu->r_rename_table[reg] < 0)
+    {
+        return 0;
+    }
+    return cpu->phys_regs[cpu->r_rename_table[reg]];
+}
+
 static void
 APEX_decode(APEX_CPU *cpu)
 {
+    /* Retry an instruction held back by a resource stall last cycle, fetch
+     * was held behind it */
+    if (cpu->decode.stalled)
+    {
+        cpu->decode.stalled = FALSE;
+        cpu->fetch.stalled = 0;
+    }
+
     if (cpu->decode.has_insn)
     {
         int stagestalled = 0;
+        /* Redirected instructions may not enter the ROB before the branch
+         * commits, its flush clears the whole ROB */
+        if (cpu->flush_pending)
+        {
+            stagestalled = 1;
+        }
         /*create a iq entruy*/
         if (stagestalled == 0)
         {
             IQ_ENTRY *iq_entry = NULL;
 
-            if (cpu->decode.opcode == OPCODE_HALT)
+            if (cpu->decode.opcode == OPCODE_HALT && rob_full(cpu))
+            {
+                stagestalled = 1;
+            }
+            else if (cpu->decode.opcode == OPCODE_HALT)
             {
                 // halt should got to ROB, not IQ
                 //rob
@@ -328,15 +543,16 @@ APEX_decode(APEX_CPU *cpu)
                 rob_entry->result = 0;
                 rob_entry->mready = 0;
                 rob_entry->instruction_type = cpu->decode.opcode;
-                strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                 rob_entry->des_phy_reg = -1;
-                cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                 //rob end
             }
             else if (cpu->decode.opcode == OPCODE_BZ || cpu->decode.opcode == OPCODE_BNZ)
             {
                 int i = 0;
-                for (i = 0; i < 24; i++)
+                HOSTPROF_EVENT(HP_IQ_SCAN);
+                for (i = 0; i < IQ_SIZE(cpu); i++)
                 {
                     /*iq means iq entry occupied o means free 1 means occupied*/
                     if (cpu->freeiq[i] < 1)
@@ -344,14 +560,15 @@ APEX_decode(APEX_CPU *cpu)
                         break;
                     }
                 }
-                if (i == 24)
+                if (i == IQ_SIZE(cpu) || rob_full(cpu))
                 {
                     stagestalled = 1;
                 }
                 if (stagestalled == 0)
                 {
                     /*fill the iq entry*/
-                    for (int i = 0; i < 24; i++)
+                    HOSTPROF_EVENT(HP_IQ_SCAN);
+                    for (int i = 0; i < IQ_SIZE(cpu); i++)
                     {
                         if (cpu->freeiq[i] == 0)
                         {
@@ -361,7 +578,7 @@ APEX_decode(APEX_CPU *cpu)
                         }
                     }
                     iq_entry->opcode = cpu->decode.opcode;
-                    strcpy(iq_entry->opcode_str, cpu->decode.opcode_str);
+                    HOSTPROF_STRCPY(iq_entry->opcode_str, cpu->decode.opcode_str);
                     iq_entry->imm = cpu->decode.imm;
                     iq_entry->pc = cpu->decode.pc;
 
@@ -374,9 +591,9 @@ APEX_decode(APEX_CPU *cpu)
                     rob_entry->result = 0;
                     rob_entry->mready = 0;
                     rob_entry->instruction_type = cpu->decode.opcode;
-                    strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                    HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                     iq_entry->rob_tail = cpu->rob_tail; // rob index assigned
-                    cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                    cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                     //rob end
                     if (cpu->decode.opcode == OPCODE_BZ)
                     {
@@ -395,7 +612,10 @@ APEX_decode(APEX_CPU *cpu)
 
                     iq_entry->fu_type = 3;
                     cpu->decode.has_insn = FALSE;
-                    cpu->fetch.stalled = 1;
+                    if (!ORACLE(cpu, ORACLE_BRANCH))
+                    {
+                        cpu->fetch.stalled = 1;
+                    }
                 }
             }
             else
@@ -404,19 +624,37 @@ APEX_decode(APEX_CPU *cpu)
                 int rs1_physical = cpu->decode.rs1 > -1 ? cpu->rename_table[cpu->decode.rs1] : -1;
                 int rs2_physical = cpu->decode.rs2 > -1 ? cpu->rename_table[cpu->decode.rs2] : -1;
                 int rs3_physical = -1;
-                int first_free_phy_reg;
+                int first_free_phy_reg = -1;
                 if (cpu->decode.opcode == OPCODE_STR)
                     rs3_physical = cpu->decode.rs3 > -1 ? cpu->rename_table[cpu->decode.rs3] : -1;
 
-                if ((cpu->decode.opcode == OPCODE_ADD) || (cpu->decode.opcode == OPCODE_ADDL) || (cpu->decode.opcode == OPCODE_AND) ||
+                int i = 0;
+                HOSTPROF_EVENT(HP_IQ_SCAN);
+                for (i = 0; i < IQ_SIZE(cpu); i++)
+                {
+                    /*iq means iq entry occupied o means free 1 means occupied*/
+                    if (cpu->freeiq[i] < 1)
+                    {
+
+                        break;
+                    }
+                }
+                /* Check IQ and ROB space first so a stalled instruction does
+                 * not hold on to a physical register while it waits */
+                if (i == IQ_SIZE(cpu) || rob_full(cpu))
+                {
+                    stagestalled = 1;
+                }
+
+                if (stagestalled == 0 && ((cpu->decode.opcode == OPCODE_ADD) || (cpu->decode.opcode == OPCODE_ADDL) || (cpu->decode.opcode == OPCODE_AND) ||
                     (cpu->decode.opcode == OPCODE_MUL) ||
                     (cpu->decode.opcode == OPCODE_DIV) || (cpu->decode.opcode == OPCODE_OR) || (cpu->decode.opcode == OPCODE_JAL) ||
-                    (cpu->decode.opcode == OPCODE_SUB) || (cpu->decode.opcode == OPCODE_JUMP) || (cpu->decode.opcode == OPCODE_MOVC) ||
-                    (cpu->decode.opcode == OPCODE_SUBL) || (cpu->decode.opcode == OPCODE_LOAD) || (cpu->decode.opcode == OPCODE_LDR) || (cpu->decode.opcode == OPCODE_XOR))
+                    (cpu->decode.opcode == OPCODE_SUB) || (cpu->decode.opcode == OPCODE_MOVC) ||
+                    (cpu->decode.opcode == OPCODE_SUBL) || (cpu->decode.opcode == OPCODE_LOAD) || (cpu->decode.opcode == OPCODE_LDR) || (cpu->decode.opcode == OPCODE_XOR)))
                 {
                     first_free_phy_reg = -1;
 
-                    for (int i = 0; i < 48; i++)
+                    for (int i = 0; i < PHYS_REGS(cpu); i++)
                     {
                         if (cpu->free_PR_list[i] == 0)
                         {
@@ -441,27 +679,13 @@ APEX_decode(APEX_CPU *cpu)
                         stagestalled = 1;
                     }
                 }
-                int i = 0;
-                for (i = 0; i < 24; i++)
-                {
-                    /*iq means iq entry occupied o means free 1 means occupied*/
-                    if (cpu->freeiq[i] < 1)
-                    {
-
-                        break;
-                    }
-                }
-                if (i == 24)
-                {
-                    stagestalled = 1;
-                }
-
                 if (cpu->decode.opcode != OPCODE_LOAD && cpu->decode.opcode != OPCODE_LDR && cpu->decode.opcode != OPCODE_STORE && cpu->decode.opcode != OPCODE_STR)
                 {
                     if (stagestalled == 0)
                     {
                         /*fill the iq entry*/
-                        for (int i = 0; i < 24; i++)
+                        HOSTPROF_EVENT(HP_IQ_SCAN);
+                        for (int i = 0; i < IQ_SIZE(cpu); i++)
                         {
                             if (cpu->freeiq[i] == 0)
                             {
@@ -471,7 +695,7 @@ APEX_decode(APEX_CPU *cpu)
                             }
                         }
                         iq_entry->opcode = cpu->decode.opcode;
-                        strcpy(iq_entry->opcode_str, cpu->decode.opcode_str);
+                        HOSTPROF_STRCPY(iq_entry->opcode_str, cpu->decode.opcode_str);
                         iq_entry->src1 = rs1_physical;
                         iq_entry->src2 = rs2_physical;
                         iq_entry->imm = cpu->decode.imm;
@@ -501,10 +725,10 @@ APEX_decode(APEX_CPU *cpu)
                             rob_entry->result = 0;
                             rob_entry->mready = 0;
                             rob_entry->instruction_type = cpu->decode.opcode;
-                            strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                            HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                             rob_entry->des_phy_reg = first_free_phy_reg;
                             iq_entry->rob_tail = cpu->rob_tail; // rob index assigned
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                             //rob end
 
                             /*3 for ifu*/
@@ -524,10 +748,10 @@ APEX_decode(APEX_CPU *cpu)
                             rob_entry->result = 0;
                             rob_entry->mready = 0;
                             rob_entry->instruction_type = cpu->decode.opcode;
-                            strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                            HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                             rob_entry->des_phy_reg = -1;
                             iq_entry->rob_tail = cpu->rob_tail; // rob index assigned
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                             //rob end
 
                             /*3 for ifu*/
@@ -548,10 +772,10 @@ APEX_decode(APEX_CPU *cpu)
                             rob_entry->result = 0;
                             rob_entry->mready = 0;
                             rob_entry->instruction_type = cpu->decode.opcode;
-                            strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                            HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                             rob_entry->des_phy_reg = first_free_phy_reg;
                             iq_entry->rob_tail = cpu->rob_tail; // rob index assigned
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                             //rob end
                             iq_entry->fu_type = 4;
                             cpu->decode.has_insn = FALSE;
@@ -570,10 +794,10 @@ APEX_decode(APEX_CPU *cpu)
                             rob_entry->result = 0;
                             rob_entry->mready = 0;
                             rob_entry->instruction_type = cpu->decode.opcode;
-                            strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                            HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                             rob_entry->des_phy_reg = first_free_phy_reg;
                             iq_entry->rob_tail = cpu->rob_tail; // rob index assigned
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                             //rob end
 
                             // cpu->is_stalled = 1;
@@ -584,7 +808,7 @@ APEX_decode(APEX_CPU *cpu)
                         }
                     }
                 }
-                else
+                else if (stagestalled == 0)
                 {
                     switch (cpu->decode.opcode)
                     {
@@ -600,7 +824,7 @@ APEX_decode(APEX_CPU *cpu)
                         rob_entry->result_valid = 0;
                         rob_entry->result = 0;
                         rob_entry->instruction_type = cpu->decode.opcode;
-                        strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                        HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                         rob_entry->des_phy_reg = first_free_phy_reg;
 
                         if (cpu->phys_regs_valid[rs1_physical] == 1 && cpu->phys_regs_valid[rs2_physical] == 1 && cpu->memory1.has_insn == FALSE && (cpu->iqsize == 0))
@@ -608,7 +832,7 @@ APEX_decode(APEX_CPU *cpu)
                             rob_entry->mready = 1;
 
                             cpu->rob_current_instruction = cpu->rob_tail;
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                             cpu->memory1.rob_entry = rob_entry;
 
                             cpu->memory1.has_insn = TRUE;
@@ -623,10 +847,11 @@ APEX_decode(APEX_CPU *cpu)
                             rob_entry->mready = 0;
 
                             cpu->rob_current_instruction = cpu->rob_tail;
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
 
                             /*fill the iq entry*/
-                            for (int i = 0; i < 24; i++)
+                            HOSTPROF_EVENT(HP_IQ_SCAN);
+                            for (int i = 0; i < IQ_SIZE(cpu); i++)
                             {
                                 if (cpu->freeiq[i] == 0)
                                 {
@@ -636,7 +861,7 @@ APEX_decode(APEX_CPU *cpu)
                                 }
                             }
                             iq_entry->opcode = cpu->decode.opcode;
-                            strcpy(iq_entry->opcode_str, cpu->decode.opcode_str);
+                            HOSTPROF_STRCPY(iq_entry->opcode_str, cpu->decode.opcode_str);
                             iq_entry->src1 = rs1_physical;
                             iq_entry->src2 = rs2_physical;
                             iq_entry->pc = cpu->decode.pc;
@@ -662,14 +887,14 @@ APEX_decode(APEX_CPU *cpu)
                         rob_entry->result_valid = 0;
                         rob_entry->result = 0;
                         rob_entry->instruction_type = cpu->decode.opcode;
-                        strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                        HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                         rob_entry->des_phy_reg = first_free_phy_reg;
 
                         if (cpu->phys_regs_valid[rs1_physical] == 1 && cpu->memory1.has_insn == FALSE && (cpu->iqsize == 0))
                         {
                             rob_entry->mready = 1;
                             cpu->rob_current_instruction = cpu->rob_tail;
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                             cpu->memory1.rob_entry = rob_entry;
 
                             cpu->memory1.has_insn = TRUE;
@@ -685,10 +910,11 @@ APEX_decode(APEX_CPU *cpu)
                             rob_entry->mready = 0;
 
                             cpu->rob_current_instruction = cpu->rob_tail;
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
 
                             /*fill the iq entry*/
-                            for (int i = 0; i < 24; i++)
+                            HOSTPROF_EVENT(HP_IQ_SCAN);
+                            for (int i = 0; i < IQ_SIZE(cpu); i++)
                             {
                                 if (cpu->freeiq[i] == 0)
                                 {
@@ -698,7 +924,7 @@ APEX_decode(APEX_CPU *cpu)
                                 }
                             }
                             iq_entry->opcode = cpu->decode.opcode;
-                            strcpy(iq_entry->opcode_str, cpu->decode.opcode_str);
+                            HOSTPROF_STRCPY(iq_entry->opcode_str, cpu->decode.opcode_str);
                             iq_entry->src1 = rs1_physical;
                             iq_entry->src2 = rs2_physical;
                             iq_entry->pc = cpu->decode.pc;
@@ -725,13 +951,13 @@ APEX_decode(APEX_CPU *cpu)
                         rob_entry->result_valid = 0;
                         rob_entry->result = 0;
                         rob_entry->instruction_type = cpu->decode.opcode;
-                        strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                        HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                         rob_entry->des_phy_reg = first_free_phy_reg;
                         if (cpu->phys_regs_valid[rs1_physical] == 1 && cpu->phys_regs_valid[rs2_physical] == 1 && cpu->memory1.has_insn == FALSE)
                         {
                             rob_entry->mready = 1;
                             cpu->rob_current_instruction = cpu->rob_tail;
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                             cpu->memory1.rob_entry = rob_entry;
 
                             cpu->memory1.has_insn = TRUE;
@@ -743,10 +969,11 @@ APEX_decode(APEX_CPU *cpu)
                             rob_entry->mready = 0;
 
                             cpu->rob_current_instruction = cpu->rob_tail;
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
 
                             /*fill the iq entry*/
-                            for (int i = 0; i < 24; i++)
+                            HOSTPROF_EVENT(HP_IQ_SCAN);
+                            for (int i = 0; i < IQ_SIZE(cpu); i++)
                             {
                                 if (cpu->freeiq[i] == 0)
                                 {
@@ -756,7 +983,7 @@ APEX_decode(APEX_CPU *cpu)
                                 }
                             }
                             iq_entry->opcode = cpu->decode.opcode;
-                            strcpy(iq_entry->opcode_str, cpu->decode.opcode_str);
+                            HOSTPROF_STRCPY(iq_entry->opcode_str, cpu->decode.opcode_str);
                             iq_entry->src1 = rs1_physical;
                             iq_entry->src2 = rs2_physical;
                             iq_entry->imm = cpu->decode.imm;
@@ -780,13 +1007,13 @@ APEX_decode(APEX_CPU *cpu)
                         rob_entry->result_valid = 0;
                         rob_entry->result = 0;
                         rob_entry->instruction_type = cpu->decode.opcode;
-                        strcpy(rob_entry->opcode_str, cpu->decode.opcode_str);
+                        HOSTPROF_STRCPY(rob_entry->opcode_str, cpu->decode.opcode_str);
                         rob_entry->des_phy_reg = first_free_phy_reg;
                         rob_entry->mready = 1;
                         if (cpu->phys_regs_valid[rs1_physical] == 1 && cpu->phys_regs_valid[rs2_physical] == 1 && cpu->phys_regs_valid[rs3_physical] == 1 && cpu->memory1.has_insn == FALSE)
                         {
                             cpu->rob_current_instruction = cpu->rob_tail;
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
                             cpu->memory1.rob_entry = rob_entry;
                             cpu->memory1.has_insn = TRUE;
                         }
@@ -797,10 +1024,11 @@ APEX_decode(APEX_CPU *cpu)
                             rob_entry->mready = 0;
 
                             cpu->rob_current_instruction = cpu->rob_tail;
-                            cpu->rob_tail = (cpu->rob_tail + 1) % 64;
+                            cpu->rob_tail = ROB_NEXT(cpu, cpu->rob_tail);
 
                             /*fill the iq entry*/
-                            for (int i = 0; i < 24; i++)
+                            HOSTPROF_EVENT(HP_IQ_SCAN);
+                            for (int i = 0; i < IQ_SIZE(cpu); i++)
                             {
                                 if (cpu->freeiq[i] == 0)
                                 {
@@ -810,7 +1038,7 @@ APEX_decode(APEX_CPU *cpu)
                                 }
                             }
                             iq_entry->opcode = cpu->decode.opcode;
-                            strcpy(iq_entry->opcode_str, cpu->decode.opcode_str);
+                            HOSTPROF_STRCPY(iq_entry->opcode_str, cpu->decode.opcode_str);
                             iq_entry->src1 = rs1_physical;
                             iq_entry->src2 = rs2_physical;
                             iq_entry->src3 = rs3_physical;
@@ -827,6 +1055,11 @@ APEX_decode(APEX_CPU *cpu)
             }
         }
 
+        if (stagestalled)
+        {
+            cpu->decode.stalled = TRUE;
+        }
+
         if (ENABLE_DEBUG_MESSAGES)
         {
             print_stage_content("Instruction at decode____________Stage--->", &cpu->decode);
@@ -839,67 +1072,63 @@ APEX_decode(APEX_CPU *cpu)
     }
 }
 
-static void
-APEX_memory1(APEX_CPU *cpu)
+/*
+ * Decides a BZ/BNZ at one of the BRANCH_AT_* points, from the trace when
+ * replaying one, and notes the outcome in its ROB entry for recording
+ */
+static int
+branch_taken(APEX_CPU *cpu, ROB_ENTRY *rob_entry, int at)
 {
-    ROB_ENTRY *selectedrobentry = cpu->memory1.rob_entry;
-    if (cpu->memory1.has_insn && selectedrobentry->mready == 1)
-    {
-        switch (selectedrobentry->instruction_type)
-        {
-        case OPCODE_LDR:
-        {
-            // LDR dest ,SRC2, SRC3
-            //dest <- src2+src3
-            cpu->memory1.memory_address = cpu->phys_regs[selectedrobentry->src2] + cpu->phys_regs[selectedrobentry->src1];
-            // dest reg <- mem addr[memory_address]
-            cpu->fetch.stalled = 0;
-            cpu->fetch.has_insn = TRUE;
-
-            break;
-        }
-        case OPCODE_LOAD:
-        { // load r1,r2,#10
-            cpu->memory1.memory_address = cpu->phys_regs[selectedrobentry->src1] + selectedrobentry->imm;
-            cpu->fetch.stalled = 0;
-            cpu->fetch.has_insn = TRUE;
-            break;
-        }
-        case OPCODE_STR:
-        {
-            // rs1,rs2,r3
-            // mem addr[memory_address] <- src1
-            cpu->memory1.memory_address = cpu->phys_regs[selectedrobentry->src2] + cpu->phys_regs[selectedrobentry->src3];
-            break;
-        }
-        case OPCODE_STORE:
-        {
-            // mem addr[memory_address] <- src1
-            cpu->memory1.memory_address = cpu->phys_regs[selectedrobentry->src2] + selectedrobentry->imm;
-            break;
-        }
-        }
-        cpu->memory2 = cpu->memory1;
-        cpu->memory1.has_insn = FALSE;
+    const APEX_TraceRecord *rec = cpu->trace ? APEX_trace_record(cpu->trace, rob_entry) : NULL;
+    int taken;
 
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            printf("Instruction at memory1--->");
-            printf("\n");
-            printf("\n");
-        }
+    if (rec)
+    {
+        taken = rec->taken >> at & 1;
     }
-    else if (ENABLE_DEBUG_MESSAGES)
+    else if (rob_entry->instruction_type == OPCODE_BZ)
     {
-        printf("Instruction at memory1____________Stage---empty>");
-        printf("\n");
+        taken = cpu->zero_flag == TRUE;
+    }
+    else
+    {
+        taken = cpu->zero_flag == FALSE;
     }
+    rob_entry->branch_outcome = (rob_entry->branch_outcome & ~(1 << at)) | (taken << at);
+    return taken;
 }
+
+/* Target of a JUMP or JAL, from the trace when replaying one */
+static int
+jump_target(const APEX_CPU *cpu, const IQ_ENTRY *iq_entry)
+{
+    const APEX_TraceRecord *rec = cpu->trace ? APEX_trace_record(cpu->trace, &cpu->ROB[iq_entry->rob_tail]) : NULL;
+
+    return rec ? rec->target : cpu->phys_regs[iq_entry->src1] + iq_entry->imm;
+}
+
+/* Value an instruction produces when a live replay carries it, the units do not compute it again */
+static int
+traced_result(const APEX_CPU *cpu, const ROB_ENTRY *rob_entry, int *value)
+{
+    return cpu->trace && APEX_trace_result(cpu->trace, rob_entry, value);
+}
+
 static void
 APEX_memory2(APEX_CPU *cpu)
 {
     ROB_ENTRY *selectedrobentry = cpu->memory2.rob_entry;
-    if (cpu->memory2.has_insn && selectedrobentry->mready == 1)
+    if (cpu->memory2.has_insn && cpu->memory2.delay > 0)
+    {
+        cpu->memory2.delay--;
+        if (ENABLE_DEBUG_MESSAGES)
+        {
+            printf("Instruction at memory2--->");
+            printf("\n");
+            printf("\n");
+        }
+    }
+    else if (cpu->memory2.has_insn && selectedrobentry->mready == 1)
     {
 
         switch (selectedrobentry->instruction_type)
@@ -910,10 +1139,18 @@ APEX_memory2(APEX_CPU *cpu)
             // LDR dest ,SRC1, SRC2
             //dest <- src1+src2
             // dest reg <- mem addr[memory_address]
-            cpu->memory2.result_buffer = cpu->data_memory[cpu->memory2.memory_address];
+            /* A squashed load may compute any address */
+            if (!traced_result(cpu, selectedrobentry, &cpu->memory2.result_buffer))
+            {
+                cpu->memory2.result_buffer =
+                    (cpu->memory2.memory_address >= 0 && cpu->memory2.memory_address < DATA_MEMORY_SIZE)
+                        ? cpu->data_memory[cpu->memory2.memory_address]
+                        : 0;
+            }
             selectedrobentry->exception_codes = 0;
             selectedrobentry->result_valid = 1;
             selectedrobentry->result = cpu->memory2.result_buffer;
+            selectedrobentry->mem_address = cpu->memory2.memory_address;
             //end
 
             break;
@@ -924,13 +1161,17 @@ APEX_memory2(APEX_CPU *cpu)
         {
             // mem addr[memory_address] <- src1
             //  cpu->data_memory[cpu->memory2.memory_address] = cpu->phys_regs[selectedrobentry->src1];
-            cpu->memory2.result_buffer = cpu->phys_regs[selectedrobentry->src1];
+            if (!traced_result(cpu, selectedrobentry, &cpu->memory2.result_buffer))
+            {
+                cpu->memory2.result_buffer = cpu->phys_regs[selectedrobentry->src1];
+            }
             //start
             // ROB_ENTRY *rob_entry = &cpu->ROB[cpu->rob_tail];
             selectedrobentry->exception_codes = 0;
             selectedrobentry->result_valid = 1;
             selectedrobentry->result = cpu->memory2.result_buffer;
             selectedrobentry->des_phy_reg = cpu->memory2.memory_address;
+            selectedrobentry->mem_address = cpu->memory2.memory_address;
             //  cpu->data_memory[cpu->memory2.memory_address] = cpu->phys_regs[selectedrobentry->src1];
 
             //end
@@ -939,6 +1180,8 @@ APEX_memory2(APEX_CPU *cpu)
         }
 
         cpu->memory2.has_insn = FALSE;
+        OBSERVE(cpu, OBS_MEMORY, observe_rob(cpu, OBS_MEMORY, selectedrobentry - cpu->ROB));
+        OBSERVE(cpu, OBS_COMPLETE, observe_rob(cpu, OBS_COMPLETE, selectedrobentry - cpu->ROB));
         if (ENABLE_DEBUG_MESSAGES)
         {
             printf("Instruction at memory2--->");
@@ -952,93 +1195,216 @@ APEX_memory2(APEX_CPU *cpu)
         printf("\n");
     }
 }
-
-/*
- * issuequeue Stage of APEX Pipeline
- *
- * Note: You are free to edit this function according to your implementation
- */
 static void
-APEX_issuequeue(APEX_CPU *cpu)
+APEX_memory1(APEX_CPU *cpu)
 {
-    int issuequequeindex;
-    int intfuissued = -1;
-    int mulfuissued = -1;
-    int branchfuissued = -1;
-    int robissued = -1;
+    ROB_ENTRY *selectedrobentry = cpu->memory1.rob_entry;
+    /* MEM2 still holds the previous access when memory latency is above 2,
+     * unless that access was squashed by a flush */
+    int memory2_busy = cpu->memory2.has_insn && cpu->memory2.rob_entry->mready == 1;
 
-    IQ_ENTRY selectedintfuiqentry;
-    IQ_ENTRY selectedmulfuiqentry;
-    IQ_ENTRY selectedbranchfuiqentry;
-    IQ_ENTRY selectedrobqentry;
-    cpu->iqsize = 0;
-    for (int i = 0; i < 24; i++)
+    if (cpu->memory1.has_insn && selectedrobentry->mready == 1 && !memory2_busy)
     {
-
-        if (cpu->freeiq[i] == 1)
+        switch (selectedrobentry->instruction_type)
         {
-            cpu->iqsize = cpu->iqsize + 1;
-        }
-    }
-    for (int i = 0; i < 24; i++)
-    {
-        if (cpu->freeiq[i] != 1)
+        case OPCODE_LDR:
         {
-            continue;
-        }
-        //  printf("iq free %d %d\n", i, cpu->freeiq[i]);
-        issuequequeindex = i;
-        IQ_ENTRY iqe = cpu->IssueQueue[issuequequeindex];
+            // LDR dest ,SRC2, SRC3
+            //dest <- src2+src3
+            cpu->memory1.memory_address = cpu->phys_regs[selectedrobentry->src2] + cpu->phys_regs[selectedrobentry->src1];
+            // dest reg <- mem addr[memory_address]
+            cpu->fetch.stalled = 0;
+            cpu->fetch.has_insn = TRUE;
 
-        switch (iqe.opcode)
-        {
-        case OPCODE_ADD:
-        case OPCODE_SUB:
-        case OPCODE_AND:
-        case OPCODE_OR:
-        case OPCODE_XOR:
-        case OPCODE_CMP:
-        {
-            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 && intfuissued == -1)
-            {
-                selectedintfuiqentry = iqe;
-                intfuissued = issuequequeindex;
-            }
             break;
         }
-        case OPCODE_ADDL:
-        case OPCODE_SUBL:
-        {
-            if (cpu->phys_regs_valid[iqe.src1] == 1 && intfuissued == -1)
-            {
-                selectedintfuiqentry = iqe;
-                intfuissued = issuequequeindex;
-            }
+        case OPCODE_LOAD:
+        { // load r1,r2,#10
+            cpu->memory1.memory_address = cpu->phys_regs[selectedrobentry->src1] + selectedrobentry->imm;
+            cpu->fetch.stalled = 0;
+            cpu->fetch.has_insn = TRUE;
             break;
         }
-        case OPCODE_MOVC:
+        case OPCODE_STR:
         {
-            if (intfuissued == -1)
+            // rs1,rs2,r3
+            // mem addr[memory_address] <- src1
+            cpu->memory1.memory_address = cpu->phys_regs[selectedrobentry->src2] + cpu->phys_regs[selectedrobentry->src3];
+            break;
+        }
+        case OPCODE_STORE:
+        {
+            // mem addr[memory_address] <- src1
+            cpu->memory1.memory_address = cpu->phys_regs[selectedrobentry->src2] + selectedrobentry->imm;
+            break;
+        }
+        }
+        if (cpu->trace && APEX_trace_record(cpu->trace, selectedrobentry))
+        {
+            cpu->memory1.memory_address = APEX_trace_record(cpu->trace, selectedrobentry)->address;
+        }
+        if (cpu->memprofile)
+        {
+            APEX_memprofile_access(cpu->memprofile, selectedrobentry->pc, selectedrobentry->instruction_type,
+                                   cpu->memory1.memory_address, cpu->clock);
+        }
+        HOSTPROF_EVENT(HP_LATCH_COPY);
+        cpu->memory2 = cpu->memory1;
+        cpu->memory2.delay = MEM_LATENCY(cpu) - 2;
+        cpu->memory1.has_insn = FALSE;
+        /* The memory oracle finishes the access in the cycle it starts */
+        if (ORACLE(cpu, ORACLE_MEMORY))
+        {
+            cpu->memory2.delay = 0;
+            APEX_memory2(cpu);
+        }
+
+        if (ENABLE_DEBUG_MESSAGES)
+        {
+            printf("Instruction at memory1--->");
+            printf("\n");
+            printf("\n");
+        }
+    }
+    else if (ENABLE_DEBUG_MESSAGES)
+    {
+        printf("Instruction at memory1____________Stage---empty>");
+        printf("\n");
+    }
+}
+
+/*
+ * issuequeue Stage of APEX Pipeline
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+/*
+ * Checks that no other issue queue entry is older than iqe, a load waiting
+ * behind a younger dependent instruction would never issue otherwise
+ */
+static int
+oldest_in_iq(const APEX_CPU *cpu, const IQ_ENTRY *iqe)
+{
+    int age = (iqe->rob_tail - cpu->rob_head + ROB_SIZE(cpu)) % ROB_SIZE(cpu);
+
+    HOSTPROF_EVENT(HP_IQ_SCAN);
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        if (cpu->freeiq[i] == 1 &&
+            (cpu->IssueQueue[i].rob_tail - cpu->rob_head + ROB_SIZE(cpu)) % ROB_SIZE(cpu) < age)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void
+APEX_issuequeue(APEX_CPU *cpu)
+{
+    int issuequequeindex;
+    int intfuissued[INTFU_CAPACITY] = {0};
+    int mulfuissued[MULFU_CAPACITY] = {0};
+    int nintfuissued = 0;
+    int nmulfuissued = 0;
+    int intfufree = 0;
+    int mulfufree = 0;
+    int branchfuissued = -1;
+    int robissued = -1;
+
+    IQ_ENTRY selectedintfuiqentry[INTFU_CAPACITY];
+    IQ_ENTRY selectedmulfuiqentry[MULFU_CAPACITY];
+    IQ_ENTRY selectedbranchfuiqentry;
+    IQ_ENTRY selectedrobqentry;
+    cpu->iqsize = 0;
+    HOSTPROF_EVENT(HP_IQ_SCAN);
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+
+        if (cpu->freeiq[i] == 1)
+        {
+            cpu->iqsize = cpu->iqsize + 1;
+        }
+    }
+    /* Units still busy with a multi-cycle instruction cannot take a new one */
+    for (int lane = 0; lane < INTFU_COUNT(cpu); lane++)
+    {
+        if (!cpu->intfu[lane].has_insn)
+        {
+            intfufree++;
+        }
+    }
+    for (int lane = 0; lane < MULFU_COUNT(cpu); lane++)
+    {
+        if (!cpu->mul1[lane].has_insn)
+        {
+            mulfufree++;
+        }
+    }
+    HOSTPROF_EVENT(HP_IQ_SCAN);
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        if (cpu->freeiq[i] != 1)
+        {
+            continue;
+        }
+        //  printf("iq free %d %d\n", i, cpu->freeiq[i]);
+        issuequequeindex = i;
+        IQ_ENTRY iqe = cpu->IssueQueue[issuequequeindex];
+
+        switch (iqe.opcode)
+        {
+        case OPCODE_ADD:
+        case OPCODE_SUB:
+        case OPCODE_AND:
+        case OPCODE_OR:
+        case OPCODE_XOR:
+        case OPCODE_CMP:
+        {
+            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 && nintfuissued < intfufree)
             {
-                selectedintfuiqentry = iqe;
-                intfuissued = issuequequeindex;
+                selectedintfuiqentry[nintfuissued] = iqe;
+                intfuissued[nintfuissued++] = issuequequeindex;
+            }
+            break;
+        }
+        case OPCODE_ADDL:
+        case OPCODE_SUBL:
+        {
+            if (cpu->phys_regs_valid[iqe.src1] == 1 && nintfuissued < intfufree)
+            {
+                selectedintfuiqentry[nintfuissued] = iqe;
+                intfuissued[nintfuissued++] = issuequequeindex;
+            }
+            break;
+        }
+        case OPCODE_MOVC:
+        {
+            if (nintfuissued < intfufree)
+            {
+                selectedintfuiqentry[nintfuissued] = iqe;
+                intfuissued[nintfuissued++] = issuequequeindex;
             }
             break;
         }
         case OPCODE_MUL:
         {
-            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 && intfuissued == -1)
+            /* MUL shares the issue port of the integer units */
+            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 &&
+                (nintfuissued == 0 || ORACLE(cpu, ORACLE_FU)) && nmulfuissued < mulfufree)
 
             {
-                selectedmulfuiqentry = iqe;
-                mulfuissued = issuequequeindex;
+                selectedmulfuiqentry[nmulfuissued] = iqe;
+                mulfuissued[nmulfuissued++] = issuequequeindex;
             }
             break;
         }
         case OPCODE_JUMP:
         case OPCODE_JAL:
         {
-            if (cpu->phys_regs_valid[iqe.src1] == 1 && branchfuissued == -1)
+            /* JBU1 clears the whole issue queue, older entries must be gone */
+            if (branchfuissued == -1 &&
+                (ORACLE(cpu, ORACLE_BRANCH) || (cpu->phys_regs_valid[iqe.src1] == 1 && oldest_in_iq(cpu, &iqe))))
             {
                 selectedbranchfuiqentry = iqe;
                 branchfuissued = issuequequeindex;
@@ -1049,7 +1415,10 @@ APEX_issuequeue(APEX_CPU *cpu)
         case OPCODE_BZ:
         case OPCODE_BNZ:
         {
-            if (intfuissued == -1 && branchfuissued == -1 && (cpu->iqsize == 1 || cpu->iqsize == 0))
+            /* The zero flag is read in JBU1, the integer unit which sets it
+             * must have finished */
+            if (branchfuissued == -1 && (ORACLE(cpu, ORACLE_BRANCH) ||
+                                         (nintfuissued == 0 && intfufree == INTFU_COUNT(cpu) && (cpu->iqsize == 1 || cpu->iqsize == 0))))
             {
                 selectedbranchfuiqentry = iqe;
                 branchfuissued = issuequequeindex;
@@ -1058,16 +1427,16 @@ APEX_issuequeue(APEX_CPU *cpu)
         }
         case OPCODE_HALT:
         {
-            if (intfuissued == -1)
+            if (nintfuissued < intfufree)
             {
-                selectedintfuiqentry = iqe;
-                intfuissued = issuequequeindex;
+                selectedintfuiqentry[nintfuissued] = iqe;
+                intfuissued[nintfuissued++] = issuequequeindex;
                 break;
             }
         }
         case OPCODE_LDR:
         {
-            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 && robissued == -1 && (cpu->iqsize == 1 || cpu->iqsize == 0))
+            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 && robissued == -1 && !cpu->memory1.has_insn && (cpu->iqsize == 1 || cpu->iqsize == 0 || oldest_in_iq(cpu, &iqe)))
 
             {
                 selectedrobqentry = iqe;
@@ -1081,7 +1450,7 @@ APEX_issuequeue(APEX_CPU *cpu)
         }
         case OPCODE_LOAD:
         {
-            if (cpu->phys_regs_valid[iqe.src1] == 1 && robissued == -1 && (cpu->iqsize == 1 || cpu->iqsize == 0))
+            if (cpu->phys_regs_valid[iqe.src1] == 1 && robissued == -1 && !cpu->memory1.has_insn && (cpu->iqsize == 1 || cpu->iqsize == 0 || oldest_in_iq(cpu, &iqe)))
 
             {
                 selectedrobqentry = iqe;
@@ -1095,7 +1464,7 @@ APEX_issuequeue(APEX_CPU *cpu)
         }
         case OPCODE_STR:
         {
-            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 && cpu->phys_regs_valid[iqe.src3] == 1 && robissued == -1)
+            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 && cpu->phys_regs_valid[iqe.src3] == 1 && robissued == -1 && !cpu->memory1.has_insn)
 
             {
                 selectedrobqentry = iqe;
@@ -1107,7 +1476,7 @@ APEX_issuequeue(APEX_CPU *cpu)
         }
         case OPCODE_STORE:
         {
-            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 && robissued == -1)
+            if (cpu->phys_regs_valid[iqe.src1] == 1 && cpu->phys_regs_valid[iqe.src2] == 1 && robissued == -1 && !cpu->memory1.has_insn)
 
             {
                 selectedrobqentry = iqe;
@@ -1127,7 +1496,8 @@ APEX_issuequeue(APEX_CPU *cpu)
         printf("\n");
 
         IQ_ENTRY *iq_entry1;
-        for (int i = 0; i < 24; i++)
+        HOSTPROF_EVENT(HP_IQ_SCAN);
+        for (int i = 0; i < IQ_SIZE(cpu); i++)
         {
             if (cpu->freeiq[i] == 1)
             {
@@ -1140,25 +1510,40 @@ APEX_issuequeue(APEX_CPU *cpu)
         printf("\n");
     }
 
-    if (intfuissued > -1)
+    /* Hand the selected instructions to free lanes in lane order */
+    for (int lane = 0, k = 0; lane < INTFU_COUNT(cpu) && k < nintfuissued; lane++)
     {
-        IQ_ENTRY entry = selectedintfuiqentry;
+        if (cpu->intfu[lane].has_insn)
+        {
+            continue;
+        }
+        IQ_ENTRY entry = selectedintfuiqentry[k];
         entry.finishedstage = IQ;
-        cpu->intfu.iq_entry = entry;
-        cpu->intfu.stalled = 0;
-        cpu->freeiq[intfuissued] = 0;
-        cpu->intfu.has_insn = TRUE;
+        cpu->intfu[lane].iq_entry = entry;
+        cpu->intfu[lane].stalled = 0;
+        cpu->intfu[lane].delay = INTFU_LATENCY(cpu) - 1;
+        cpu->freeiq[intfuissued[k]] = 0;
+        cpu->intfu[lane].has_insn = TRUE;
         cpu->iqsize = cpu->iqsize - 1;
+        OBSERVE(cpu, OBS_ISSUE, observe_issue(cpu, &entry, OBS_UNIT_INT, lane));
+        k++;
     }
-    if (mulfuissued > -1)
+    for (int lane = 0, k = 0; lane < MULFU_COUNT(cpu) && k < nmulfuissued; lane++)
     {
-        IQ_ENTRY entry = selectedmulfuiqentry;
+        if (cpu->mul1[lane].has_insn)
+        {
+            continue;
+        }
+        IQ_ENTRY entry = selectedmulfuiqentry[k];
         entry.finishedstage = IQ;
-        cpu->mul1.iq_entry = entry;
-        cpu->mul1.stalled = 0;
-        cpu->mul1.has_insn = TRUE;
-        cpu->freeiq[mulfuissued] = 0;
+        cpu->mul1[lane].iq_entry = entry;
+        cpu->mul1[lane].stalled = 0;
+        cpu->mul1[lane].delay = MUL_LATENCY(cpu) - 3;
+        cpu->mul1[lane].has_insn = TRUE;
+        cpu->freeiq[mulfuissued[k]] = 0;
         cpu->iqsize = cpu->iqsize - 1;
+        OBSERVE(cpu, OBS_ISSUE, observe_issue(cpu, &entry, OBS_UNIT_MUL, lane));
+        k++;
     }
     if (branchfuissued > -1)
     {
@@ -1170,6 +1555,7 @@ APEX_issuequeue(APEX_CPU *cpu)
         cpu->jbu1.has_insn = TRUE;
         cpu->freeiq[branchfuissued] = 0;
         cpu->iqsize = cpu->iqsize - 1;
+        OBSERVE(cpu, OBS_ISSUE, observe_issue(cpu, &entry, OBS_UNIT_BRANCH, 0));
     }
     if (robissued > -1)
     {
@@ -1180,22 +1566,71 @@ APEX_issuequeue(APEX_CPU *cpu)
         selectedrobqentry.finishedstage = IQ;
         cpu->freeiq[robissued] = 0;
         cpu->iqsize = cpu->iqsize - 1;
+        OBSERVE(cpu, OBS_ISSUE, observe_issue(cpu, &cpu->IssueQueue[robissued], OBS_UNIT_MEMORY, 0));
+    }
+}
+
+/* Writes the result of the instruction in an integer unit to its ROB entry and frees the unit */
+static void
+intfu_complete(APEX_CPU *cpu, CPU_Stage *stage)
+{
+    const IQ_ENTRY *iq_entry = &stage->iq_entry;
+    ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry->rob_tail];
+
+    rob_entry->exception_codes = 0;
+    rob_entry->result_valid = 1;
+    rob_entry->result = stage->result_buffer;
+    rob_entry->des_phy_reg = iq_entry->des_phy_reg;
+    rob_entry->des_rd = iq_entry->des_rd;
+    stage->has_insn = FALSE;
+    OBSERVE(cpu, OBS_COMPLETE, observe_rob(cpu, OBS_COMPLETE, iq_entry->rob_tail));
+    if (ENABLE_DEBUG_MESSAGES)
+    {
+        printf("Instruction at intfu____________Stage--->");
+        printf("\n");
+
+        printf("%-15s: pc(%d) %s", "intfu ", iq_entry->pc, iq_entry->opcode_str);
+        printf("\n");
     }
 }
 
 static int
-APEX_intfu(APEX_CPU *cpu)
+intfu_lane(APEX_CPU *cpu, CPU_Stage *stage)
 {
-    IQ_ENTRY iq_entry = cpu->intfu.iq_entry;
+    IQ_ENTRY iq_entry = stage->iq_entry;
 
-    if (!cpu->intfu.stalled && cpu->intfu.has_insn)
+    if (!stage->stalled && stage->has_insn && stage->delay > 0)
+    {
+        /* Multi-cycle integer unit, result is produced in the last cycle */
+        stage->delay--;
+        if (ENABLE_DEBUG_MESSAGES)
+        {
+            printf("Instruction at intfu____________Stage--->");
+            printf("\n");
+
+            printf("%-15s: pc(%d) %s", "intfu ", iq_entry.pc, iq_entry.opcode_str);
+            printf("\n");
+        }
+    }
+    else if (!stage->stalled && stage->has_insn && iq_entry.opcode != OPCODE_HALT &&
+             traced_result(cpu, &cpu->ROB[iq_entry.rob_tail], &stage->result_buffer))
+    {
+        /* The functional model has the value, only the zero flag is left to set */
+        if (iq_entry.opcode == OPCODE_ADD || iq_entry.opcode == OPCODE_SUB || iq_entry.opcode == OPCODE_SUBL ||
+            iq_entry.opcode == OPCODE_CMP)
+        {
+            cpu->zero_flag = stage->result_buffer == 0 ? TRUE : FALSE;
+        }
+        intfu_complete(cpu, stage);
+    }
+    else if (!stage->stalled && stage->has_insn)
     {
         switch (iq_entry.opcode)
         {
         case OPCODE_ADD:
         {
-            cpu->intfu.result_buffer = cpu->phys_regs[iq_entry.src1] + cpu->phys_regs[iq_entry.src2];
-            if (cpu->intfu.result_buffer == 0)
+            stage->result_buffer = cpu->phys_regs[iq_entry.src1] + cpu->phys_regs[iq_entry.src2];
+            if (stage->result_buffer == 0)
             {
                 cpu->zero_flag = TRUE;
             }
@@ -1203,20 +1638,12 @@ APEX_intfu(APEX_CPU *cpu)
             {
                 cpu->zero_flag = FALSE;
             }
-            //start
-            ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            rob_entry->exception_codes = 0;
-            rob_entry->result_valid = 1;
-            rob_entry->result = cpu->intfu.result_buffer;
-            rob_entry->des_phy_reg = iq_entry.des_phy_reg;
-            rob_entry->des_rd = iq_entry.des_rd;
-            //end
             break;
         }
         case OPCODE_SUB:
         {
-            cpu->intfu.result_buffer = cpu->phys_regs[iq_entry.src1] - cpu->phys_regs[iq_entry.src2];
-            if (cpu->intfu.result_buffer == 0)
+            stage->result_buffer = cpu->phys_regs[iq_entry.src1] - cpu->phys_regs[iq_entry.src2];
+            if (stage->result_buffer == 0)
             {
                 cpu->zero_flag = TRUE;
             }
@@ -1224,37 +1651,19 @@ APEX_intfu(APEX_CPU *cpu)
             {
                 cpu->zero_flag = FALSE;
             }
-            //start
-            ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            rob_entry->exception_codes = 0;
-            rob_entry->result_valid = 1;
-            rob_entry->result = cpu->intfu.result_buffer;
-            rob_entry->des_phy_reg = iq_entry.des_phy_reg;
-            rob_entry->des_rd = iq_entry.des_rd;
-            //end
             break;
         }
         case OPCODE_ADDL:
         {
-            cpu->intfu.result_buffer = cpu->phys_regs[iq_entry.src1] + iq_entry.imm;
-
-            //start
-            ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            rob_entry->exception_codes = 0;
-            rob_entry->result_valid = 1;
-            rob_entry->result = cpu->intfu.result_buffer;
-            rob_entry->des_phy_reg = iq_entry.des_phy_reg;
-            rob_entry->des_rd = iq_entry.des_rd;
-            //end
-
+            stage->result_buffer = cpu->phys_regs[iq_entry.src1] + iq_entry.imm;
             break;
         }
 
         case OPCODE_SUBL:
         {
-            cpu->intfu.result_buffer = cpu->phys_regs[iq_entry.src1] - iq_entry.imm;
+            stage->result_buffer = cpu->phys_regs[iq_entry.src1] - iq_entry.imm;
 
-            if (cpu->intfu.result_buffer == 0)
+            if (stage->result_buffer == 0)
             {
                 cpu->zero_flag = TRUE;
             }
@@ -1262,62 +1671,27 @@ APEX_intfu(APEX_CPU *cpu)
             {
                 cpu->zero_flag = FALSE;
             }
-            //start
-            ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            rob_entry->exception_codes = 0;
-            rob_entry->result_valid = 1;
-            rob_entry->result = cpu->intfu.result_buffer;
-            rob_entry->des_phy_reg = iq_entry.des_phy_reg;
-            rob_entry->des_rd = iq_entry.des_rd;
-            //end
             break;
         }
         case OPCODE_AND:
         {
-            cpu->intfu.result_buffer = cpu->phys_regs[iq_entry.src1] & cpu->phys_regs[iq_entry.src2];
-
-            //start
-            ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            rob_entry->exception_codes = 0;
-            rob_entry->result_valid = 1;
-            rob_entry->result = cpu->intfu.result_buffer;
-            rob_entry->des_phy_reg = iq_entry.des_phy_reg;
-            rob_entry->des_rd = iq_entry.des_rd;
-            //end
+            stage->result_buffer = cpu->phys_regs[iq_entry.src1] & cpu->phys_regs[iq_entry.src2];
             break;
         }
         case OPCODE_OR:
         {
-            cpu->intfu.result_buffer = cpu->phys_regs[iq_entry.src1] | cpu->phys_regs[iq_entry.src2];
-
-            //start
-            ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            rob_entry->exception_codes = 0;
-            rob_entry->result_valid = 1;
-            rob_entry->result = cpu->intfu.result_buffer;
-            rob_entry->des_phy_reg = iq_entry.des_phy_reg;
-            rob_entry->des_rd = iq_entry.des_rd;
-            //end
+            stage->result_buffer = cpu->phys_regs[iq_entry.src1] | cpu->phys_regs[iq_entry.src2];
             break;
         }
         case OPCODE_XOR:
         {
-            cpu->intfu.result_buffer = cpu->phys_regs[iq_entry.src1] ^ cpu->phys_regs[iq_entry.src2];
-            //start
-            ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            rob_entry->exception_codes = 0;
-            rob_entry->result_valid = 1;
-            rob_entry->result = cpu->intfu.result_buffer;
-            rob_entry->des_phy_reg = iq_entry.des_phy_reg;
-            rob_entry->des_rd = iq_entry.des_rd;
-            //end
-
+            stage->result_buffer = cpu->phys_regs[iq_entry.src1] ^ cpu->phys_regs[iq_entry.src2];
             break;
         }
         case OPCODE_CMP:
         {
-            cpu->intfu.result_buffer = cpu->phys_regs[iq_entry.src1] - cpu->phys_regs[iq_entry.src2];
-            if (cpu->intfu.result_buffer == 0)
+            stage->result_buffer = cpu->phys_regs[iq_entry.src1] - cpu->phys_regs[iq_entry.src2];
+            if (stage->result_buffer == 0)
             {
                 cpu->zero_flag = TRUE;
             }
@@ -1325,29 +1699,12 @@ APEX_intfu(APEX_CPU *cpu)
             {
                 cpu->zero_flag = FALSE;
             }
-            //start
-            ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            rob_entry->exception_codes = 0;
-            rob_entry->result_valid = 1;
-            rob_entry->result = cpu->intfu.result_buffer;
-            rob_entry->des_phy_reg = iq_entry.des_phy_reg;
-            rob_entry->des_rd = iq_entry.des_rd;
-            //end
             break;
         }
         case OPCODE_MOVC:
         {
 
-            cpu->intfu.result_buffer = iq_entry.imm;
-
-            //start
-            ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            rob_entry->exception_codes = 0;
-            rob_entry->result_valid = 1;
-            rob_entry->result = cpu->intfu.result_buffer;
-            rob_entry->des_phy_reg = iq_entry.des_phy_reg;
-            rob_entry->des_rd = iq_entry.des_rd;
-            //end
+            stage->result_buffer = iq_entry.imm;
             break;
         }
         case OPCODE_HALT:
@@ -1358,16 +1715,7 @@ APEX_intfu(APEX_CPU *cpu)
             return TRUE;
         }
         }
-        iq_entry.finishedstage = INTFU;
-        cpu->intfu.has_insn = FALSE;
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            printf("Instruction at intfu____________Stage--->");
-            printf("\n");
-
-            printf("%-15s: pc(%d) %s", "intfu ", iq_entry.pc, iq_entry.opcode_str);
-            printf("\n");
-        }
+        intfu_complete(cpu, stage);
     }
     else if (ENABLE_DEBUG_MESSAGES)
     {
@@ -1377,20 +1725,35 @@ APEX_intfu(APEX_CPU *cpu)
     return 0;
 }
 
-int APEX_mul1(APEX_CPU *cpu)
+static int
+APEX_intfu(APEX_CPU *cpu)
 {
-    IQ_ENTRY iq_entry = cpu->mul1.iq_entry;
+    int halted = 0;
 
-    if (!cpu->mul1.stalled && iq_entry.finishedstage < MUL1 && cpu->mul1.has_insn)
+    for (int lane = 0; lane < INTFU_COUNT(cpu); lane++)
     {
-        if (iq_entry.opcode == OPCODE_MUL)
+        halted |= intfu_lane(cpu, &cpu->intfu[lane]);
+    }
+    return halted;
+}
+
+static void
+mul1_lane(APEX_CPU *cpu, int lane)
+{
+    CPU_Stage *stage = &cpu->mul1[lane];
+    IQ_ENTRY iq_entry = stage->iq_entry;
+
+    if (!stage->stalled && iq_entry.finishedstage < MUL1 && stage->has_insn && !cpu->mul2[lane].has_insn)
+    {
+        if (iq_entry.opcode == OPCODE_MUL && !traced_result(cpu, &cpu->ROB[iq_entry.rob_tail], &stage->result_buffer))
         {
-            cpu->mul1.result_buffer = cpu->phys_regs[iq_entry.src1] * cpu->phys_regs[iq_entry.src2];
+            stage->result_buffer = cpu->phys_regs[iq_entry.src1] * cpu->phys_regs[iq_entry.src2];
         }
         iq_entry.finishedstage = MUL1;
 
-        cpu->mul2 = cpu->mul1;
-        cpu->mul1.has_insn = FALSE;
+        HOSTPROF_EVENT(HP_LATCH_COPY);
+        cpu->mul2[lane] = *stage;
+        stage->has_insn = FALSE;
         if (ENABLE_DEBUG_MESSAGES)
         {
             printf("Instruction at mul1____________Stage--->");
@@ -1405,19 +1768,30 @@ int APEX_mul1(APEX_CPU *cpu)
         printf("Instruction at mul1____________Stage---empty>");
         printf("\n");
     }
+}
+
+int APEX_mul1(APEX_CPU *cpu)
+{
+    for (int lane = 0; lane < MULFU_COUNT(cpu); lane++)
+    {
+        mul1_lane(cpu, lane);
+    }
     return 0;
 }
 
-int APEX_mul2(APEX_CPU *cpu)
+static void
+mul2_lane(APEX_CPU *cpu, int lane)
 {
-    IQ_ENTRY iq_entry = cpu->mul2.iq_entry;
+    CPU_Stage *stage = &cpu->mul2[lane];
+    IQ_ENTRY iq_entry = stage->iq_entry;
 
-    if (!cpu->mul2.stalled && iq_entry.finishedstage < MUL2 && cpu->mul2.has_insn)
+    if (!stage->stalled && iq_entry.finishedstage < MUL2 && stage->has_insn && !cpu->mul3[lane].has_insn)
     {
         iq_entry.finishedstage = MUL2;
 
-        cpu->mul3 = cpu->mul2;
-        cpu->mul2.has_insn = FALSE;
+        HOSTPROF_EVENT(HP_LATCH_COPY);
+        cpu->mul3[lane] = *stage;
+        stage->has_insn = FALSE;
 
         if (ENABLE_DEBUG_MESSAGES)
         {
@@ -1433,27 +1807,50 @@ int APEX_mul2(APEX_CPU *cpu)
         printf("Instruction at mul2____________Stage---empty>");
         printf("\n");
     }
+}
+
+int APEX_mul2(APEX_CPU *cpu)
+{
+    for (int lane = 0; lane < MULFU_COUNT(cpu); lane++)
+    {
+        mul2_lane(cpu, lane);
+    }
     return 0;
 }
 
-int APEX_mul3(APEX_CPU *cpu)
+static void
+mul3_lane(APEX_CPU *cpu, int lane)
 {
+    CPU_Stage *stage = &cpu->mul3[lane];
+    IQ_ENTRY iq_entry = stage->iq_entry;
 
-    IQ_ENTRY iq_entry = cpu->mul3.iq_entry;
+    if (!stage->stalled && stage->has_insn && stage->delay > 0)
+    {
+        /* Multiplier latency above 3 is spent here, MUL1 and MUL2 back up */
+        stage->delay--;
+        if (ENABLE_DEBUG_MESSAGES)
+        {
+            printf("Instruction at mul3____________Stage--->");
+            printf("\n");
 
-    if (!cpu->mul3.stalled && iq_entry.finishedstage < MUL3 && cpu->mul3.has_insn)
+            printf("%-15s: pc(%d) ", "mul3", iq_entry.pc);
+            printf("\n");
+        }
+    }
+    else if (!stage->stalled && iq_entry.finishedstage < MUL3 && stage->has_insn)
     {
 
         //start
         ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
         rob_entry->exception_codes = 0;
         rob_entry->result_valid = 1;
-        rob_entry->result = cpu->mul3.result_buffer;
+        rob_entry->result = stage->result_buffer;
         rob_entry->des_phy_reg = iq_entry.des_phy_reg;
         rob_entry->des_rd = iq_entry.des_rd;
         //end
         iq_entry.finishedstage = MUL3;
-        cpu->mul3.has_insn = FALSE;
+        stage->has_insn = FALSE;
+        OBSERVE(cpu, OBS_COMPLETE, observe_rob(cpu, OBS_COMPLETE, iq_entry.rob_tail));
         if (ENABLE_DEBUG_MESSAGES)
         {
             printf("Instruction at mul3____________Stage--->");
@@ -1468,11 +1865,46 @@ int APEX_mul3(APEX_CPU *cpu)
         printf("Instruction at mul3____________Stage---empty>");
         printf("\n");
     }
+}
+
+int APEX_mul3(APEX_CPU *cpu)
+{
+    for (int lane = 0; lane < MULFU_COUNT(cpu); lane++)
+    {
+        mul3_lane(cpu, lane);
+    }
     return 0;
 }
+/* Discards every issue queue entry, all are younger than the taken branch or jump by */
+static void
+squash_iq(APEX_CPU *cpu, const IQ_ENTRY *by)
+{
+    int squashed = 0;
+
+    HOSTPROF_EVENT(HP_IQ_SCAN);
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        squashed += cpu->freeiq[i] == 1;
+        cpu->freeiq[i] = 0;
+    }
+    OBSERVE(cpu, OBS_SQUASH, observe_flush(cpu, OBS_SQUASH, by->pc, by->opcode, by->rob_tail, squashed));
+    if (cpu->cpistack)
+    {
+        APEX_cpistack_squash(cpu->cpistack);
+    }
+}
+
 int APEX_jbu1(APEX_CPU *cpu)
 {
-    if (cpu->jbu1.has_insn)
+    if (cpu->jbu1.has_insn && ORACLE(cpu, ORACLE_BRANCH))
+    {
+        /* Fetch already followed the committed path, nothing to redirect */
+        cpu->jbu1.rd = cpu->jbu1.iq_entry.pc + 4;
+        HOSTPROF_EVENT(HP_LATCH_COPY);
+        cpu->jbu2 = cpu->jbu1;
+        cpu->jbu1.has_insn = FALSE;
+    }
+    else if (cpu->jbu1.has_insn)
     {
         IQ_ENTRY iq_entry = cpu->jbu1.iq_entry;
         switch (iq_entry.opcode)
@@ -1480,57 +1912,46 @@ int APEX_jbu1(APEX_CPU *cpu)
         case OPCODE_JAL:
         {
             // cpu->jbu1.result_buffer = iq_entry.src1 + iq_entry.imm;
-            cpu->jbu1.result_buffer = cpu->phys_regs[iq_entry.src1] + iq_entry.imm;
+            cpu->jbu1.result_buffer = jump_target(cpu, &iq_entry);
             cpu->jbu1.rd = iq_entry.pc + 4;
             cpu->decode.has_insn = FALSE;
             cpu->fetch.has_insn = FALSE;
-            for (int i = 0; i < 24; i++)
-            {
-                cpu->freeiq[i] = 0;
-            }
+            squash_iq(cpu, &iq_entry);
             break;
         }
         case OPCODE_JUMP:
         {
-            cpu->jbu1.result_buffer = cpu->phys_regs[iq_entry.src1] + iq_entry.imm;
+            cpu->jbu1.result_buffer = jump_target(cpu, &iq_entry);
             cpu->decode.has_insn = FALSE;
             cpu->fetch.has_insn = FALSE;
-            for (int i = 0; i < 24; i++)
-            {
-                cpu->freeiq[i] = 0;
-            }
+            squash_iq(cpu, &iq_entry);
             break;
         }
         case OPCODE_BZ:
         {
-            if (cpu->zero_flag == TRUE)
+            if (branch_taken(cpu, &cpu->ROB[iq_entry.rob_tail], BRANCH_AT_JBU1))
             {
                 cpu->jbu1.result_buffer = iq_entry.pc + iq_entry.imm;
                 cpu->decode.has_insn = FALSE;
                 cpu->fetch.has_insn = FALSE;
-                for (int i = 0; i < 24; i++)
-                {
-                    cpu->freeiq[i] = 0;
-                }
+                squash_iq(cpu, &iq_entry);
             }
 
             break;
         }
         case OPCODE_BNZ:
         {
-            if (cpu->zero_flag == FALSE)
+            if (branch_taken(cpu, &cpu->ROB[iq_entry.rob_tail], BRANCH_AT_JBU1))
             {
                 cpu->jbu1.result_buffer = iq_entry.pc + iq_entry.imm;
                 cpu->decode.has_insn = FALSE;
                 cpu->fetch.has_insn = FALSE;
-                for (int i = 0; i < 24; i++)
-                {
-                    cpu->freeiq[i] = 0;
-                }
+                squash_iq(cpu, &iq_entry);
             }
             break;
         }
         }
+        HOSTPROF_EVENT(HP_LATCH_COPY);
         cpu->jbu2 = cpu->jbu1;
         cpu->jbu1.has_insn = FALSE;
 
@@ -1552,9 +1973,27 @@ int APEX_jbu1(APEX_CPU *cpu)
 }
 int APEX_jbu2(APEX_CPU *cpu)
 {
-    if (cpu->jbu2.has_insn)
+    if (cpu->jbu2.has_insn && ORACLE(cpu, ORACLE_BRANCH))
+    {
+        ROB_ENTRY *rob_entry = &cpu->ROB[cpu->jbu2.iq_entry.rob_tail];
+
+        rob_entry->exception_codes = 0;
+        rob_entry->result_valid = 1;
+        rob_entry->des_phy_reg = cpu->jbu2.iq_entry.des_phy_reg;
+        rob_entry->des_rd = cpu->jbu2.iq_entry.des_rd;
+        if (cpu->jbu2.iq_entry.opcode == OPCODE_JAL)
+        {
+            rob_entry->imm = cpu->jbu2.rd;
+        }
+        cpu->jbu2.has_insn = FALSE;
+        OBSERVE(cpu, OBS_COMPLETE, observe_rob(cpu, OBS_COMPLETE, cpu->jbu2.iq_entry.rob_tail));
+    }
+    else if (cpu->jbu2.has_insn)
     {
         IQ_ENTRY iq_entry = cpu->jbu2.iq_entry;
+        /* A younger branch on the wrong path does not own a pending flush */
+        int flush_pending = cpu->flush_pending;
+
         switch (iq_entry.opcode)
         {
         case OPCODE_BZ:
@@ -1567,19 +2006,17 @@ int APEX_jbu2(APEX_CPU *cpu)
             rob_entry->des_phy_reg = iq_entry.des_phy_reg;
             rob_entry->des_rd = iq_entry.des_rd;
             //end
-            if (cpu->zero_flag == TRUE)
+            if (branch_taken(cpu, rob_entry, BRANCH_AT_JBU2))
             { // DO IN ROB
                 //cpu->pc = cpu->jbu2.result_buffer;
                 //cpu->is_stalled = 0; // 1 means stalled
                 cpu->jbu2.result_buffer = iq_entry.pc + iq_entry.imm;
                 cpu->decode.has_insn = FALSE;
                 cpu->pc = cpu->jbu2.result_buffer;
+                cpu->flush_pending = TRUE;
 
                 cpu->fetch.has_insn = TRUE;
-                for (int i = 0; i < 24; i++)
-                {
-                    cpu->freeiq[i] = 0;
-                }
+                squash_iq(cpu, &iq_entry);
             }
             cpu->fetch.stalled = 0;
             break;
@@ -1594,7 +2031,7 @@ int APEX_jbu2(APEX_CPU *cpu)
             rob_entry->des_phy_reg = iq_entry.des_phy_reg;
             rob_entry->des_rd = iq_entry.des_rd;
             //end
-            if (cpu->zero_flag == FALSE)
+            if (branch_taken(cpu, rob_entry, BRANCH_AT_JBU2))
             { // DO IN ROB
                 //cpu->pc = cpu->jbu2.result_buffer;
                 //cpu->is_stalled = 0; // 1 means stalled
@@ -1602,11 +2039,9 @@ int APEX_jbu2(APEX_CPU *cpu)
                 cpu->decode.has_insn = FALSE;
                 cpu->fetch.stalled = 0;
                 cpu->pc = cpu->jbu2.result_buffer;
+                cpu->flush_pending = TRUE;
 
-                for (int i = 0; i < 24; i++)
-                {
-                    cpu->freeiq[i] = 0;
-                }
+                squash_iq(cpu, &iq_entry);
             }
 
             cpu->fetch.has_insn = TRUE;
@@ -1616,7 +2051,7 @@ int APEX_jbu2(APEX_CPU *cpu)
         {
             //start
             ROB_ENTRY *rob_entry = &cpu->ROB[iq_entry.rob_tail];
-            cpu->jbu2.result_buffer = cpu->phys_regs[iq_entry.src1] + iq_entry.imm;
+            cpu->jbu2.result_buffer = jump_target(cpu, &iq_entry);
 
             rob_entry->exception_codes = 0;
             rob_entry->result_valid = 1;
@@ -1628,12 +2063,10 @@ int APEX_jbu2(APEX_CPU *cpu)
 
             cpu->decode.has_insn = FALSE;
             cpu->pc = cpu->jbu2.result_buffer;
+            cpu->flush_pending = TRUE;
 
             cpu->fetch.has_insn = TRUE;
-            for (int i = 0; i < 24; i++)
-            {
-                cpu->freeiq[i] = 0;
-            }
+            squash_iq(cpu, &iq_entry);
             //end
 
             break;
@@ -1646,7 +2079,7 @@ int APEX_jbu2(APEX_CPU *cpu)
             rob_entry->exception_codes = 0;
             rob_entry->result_valid = 1;
 
-            cpu->jbu2.result_buffer = cpu->phys_regs[iq_entry.src1] + iq_entry.imm;
+            cpu->jbu2.result_buffer = jump_target(cpu, &iq_entry);
             rob_entry->result = cpu->jbu2.result_buffer;
             rob_entry->des_phy_reg = iq_entry.des_phy_reg;
             rob_entry->des_rd = iq_entry.des_rd;
@@ -1655,18 +2088,21 @@ int APEX_jbu2(APEX_CPU *cpu)
             //cpu->is_stalled = 0;
             //cpu->pc = cpu->jbu2.result_buffer;
             cpu->pc = cpu->jbu2.result_buffer;
+            cpu->flush_pending = TRUE;
 
             cpu->decode.has_insn = FALSE;
             cpu->fetch.has_insn = TRUE;
-            for (int i = 0; i < 24; i++)
-            {
-                cpu->freeiq[i] = 0;
-            }
+            squash_iq(cpu, &iq_entry);
 
             break;
         }
         }
         cpu->jbu2.has_insn = FALSE;
+        OBSERVE(cpu, OBS_COMPLETE, observe_rob(cpu, OBS_COMPLETE, iq_entry.rob_tail));
+        if (cpu->branchprof && cpu->flush_pending && !flush_pending)
+        {
+            APEX_branchprof_redirect(cpu->branchprof, iq_entry.pc);
+        }
 
         if (ENABLE_DEBUG_MESSAGES)
         {
@@ -1684,91 +2120,188 @@ int APEX_jbu2(APEX_CPU *cpu)
     }
     return 0;
 }
+/*
+ * Flushes the ROB behind a taken branch at commit, everything older has
+ * retired so the retirement RAT holds the correct mappings
+ */
+static void
+flush_at_commit(APEX_CPU *cpu)
+{
+    /* Everything behind the head, the branch or jump itself retires */
+    OBSERVE(cpu, OBS_FLUSH,
+            observe_flush(cpu, OBS_FLUSH, cpu->ROB[cpu->rob_head].pc, cpu->ROB[cpu->rob_head].instruction_type,
+                          cpu->rob_head, (cpu->rob_tail - cpu->rob_head + ROB_SIZE(cpu)) % ROB_SIZE(cpu) - 1));
+    cpu->rob_head = 0;
+    cpu->rob_tail = 0;
+    memset(cpu->ROB, 0, sizeof(cpu->ROB));
+    memcpy(cpu->rename_table, cpu->r_rename_table, sizeof(cpu->rename_table));
+    /* Registers renamed by the squashed instructions go back to the free list */
+    memset(cpu->free_PR_list, 0, sizeof(cpu->free_PR_list));
+    memset(cpu->phys_regs_valid, 0, sizeof(cpu->phys_regs_valid));
+    for (int r = 0; r < REG_FILE_SIZE; r++)
+    {
+        if (cpu->r_rename_table[r] >= 0)
+        {
+            cpu->free_PR_list[cpu->r_rename_table[r]] = 1;
+            cpu->phys_regs_valid[cpu->r_rename_table[r]] = 1;
+        }
+    }
+    cpu->flush_pending = FALSE;
+    if (cpu->cpistack)
+    {
+        APEX_cpistack_squash(cpu->cpistack);
+    }
+}
+
 int APEX_instruction_commitment(APEX_CPU *cpu)
 {
 
     ROB_ENTRY *rob_entry = &cpu->ROB[cpu->rob_head];
     ROB_ENTRY *selectedrobentry = rob_entry;
-    while (selectedrobentry->result_valid && cpu->rob_tail > cpu->rob_head)
+    while (selectedrobentry->result_valid && cpu->rob_head != cpu->rob_tail)
     {
+        /* A flush below clears the entry */
+        int pc = selectedrobentry->pc;
+        int rob_index = cpu->rob_head;
+        int flushed = FALSE;
+        int taken = FALSE;
+
+        /* Under the branch oracle nothing younger is ever off the path */
+        if ((selectedrobentry->instruction_type == OPCODE_BZ || selectedrobentry->instruction_type == OPCODE_BNZ) &&
+            !ORACLE(cpu, ORACLE_BRANCH))
+        {
+            taken = branch_taken(cpu, selectedrobentry, BRANCH_AT_COMMIT);
+        }
+        if (cpu->branchprof)
+        {
+            APEX_branchprof_commit(cpu->branchprof, selectedrobentry, taken);
+        }
+        if (cpu->trace)
+        {
+            APEX_trace_commit(cpu->trace, selectedrobentry);
+        }
+        OBSERVE(cpu, OBS_COMMIT, observe_rob(cpu, OBS_COMMIT, rob_index));
+
         if (selectedrobentry->result_valid && (selectedrobentry->instruction_type == OPCODE_STR || selectedrobentry->instruction_type == OPCODE_STORE))
         {
             cpu->data_memory[selectedrobentry->des_phy_reg] = selectedrobentry->result;
-            cpu->rob_head = (cpu->rob_head + 1) % 64;
+            if (selectedrobentry->des_phy_reg >= 0 && selectedrobentry->des_phy_reg < DATA_MEMORY_SIZE)
+            {
+                cpu->data_memory_dirty[selectedrobentry->des_phy_reg / DIRTY_BITS_PER_WORD] |=
+                    1UL << (selectedrobentry->des_phy_reg % DIRTY_BITS_PER_WORD);
+                cpu->data_memory_pages_written |= 1U << (selectedrobentry->des_phy_reg / DATA_MEMORY_PAGE_WORDS);
+            }
+            cpu->rob_head = ROB_NEXT(cpu, cpu->rob_head);
         }
         else if (selectedrobentry->result_valid && (selectedrobentry->instruction_type == OPCODE_ADD ||
                                                     selectedrobentry->instruction_type == OPCODE_SUBL || selectedrobentry->instruction_type == OPCODE_OR || selectedrobentry->instruction_type == OPCODE_XOR || selectedrobentry->instruction_type == OPCODE_AND || selectedrobentry->instruction_type == OPCODE_ADDL || selectedrobentry->instruction_type == OPCODE_SUB || selectedrobentry->instruction_type == OPCODE_MOVC || selectedrobentry->instruction_type == OPCODE_MUL))
         {
 
             instruction_retirement_intfu(cpu, selectedrobentry->result, selectedrobentry->des_rd, selectedrobentry->des_phy_reg);
-            cpu->rob_head = (cpu->rob_head + 1) % 64;
+            cpu->rob_head = ROB_NEXT(cpu, cpu->rob_head);
         }
         else if (selectedrobentry->instruction_type == OPCODE_LOAD || selectedrobentry->instruction_type == OPCODE_LDR)
         {
 
             instruction_retirement_intfu(cpu, selectedrobentry->result, selectedrobentry->des_rd, selectedrobentry->des_phy_reg);
-            cpu->rob_head = (cpu->rob_head + 1) % 64;
+            cpu->rob_head = ROB_NEXT(cpu, cpu->rob_head);
             cpu->fetch.stalled = 0;
             cpu->fetch.has_insn = TRUE;
         }
+        else if (ORACLE(cpu, ORACLE_BRANCH) && (selectedrobentry->instruction_type == OPCODE_BZ ||
+                                                selectedrobentry->instruction_type == OPCODE_BNZ))
+        {
+            cpu->rob_head = ROB_NEXT(cpu, cpu->rob_head);
+        }
         else if (selectedrobentry->result_valid && (selectedrobentry->instruction_type == OPCODE_BZ))
         {
-            if (cpu->zero_flag == TRUE)
+            if (taken)
             {
-                cpu->rob_head = 0;
-                cpu->rob_tail = 0;
-                memset(cpu->ROB, 0, sizeof(int) * 64);
+                flush_at_commit(cpu);
+                flushed = TRUE;
             }
             else
             {
-                cpu->rob_head = (cpu->rob_head + 1) % 64;
+                cpu->rob_head = ROB_NEXT(cpu, cpu->rob_head);
                 cpu->fetch.stalled = 0;
                 cpu->fetch.has_insn = TRUE;
+                cpu->flush_pending = FALSE;
             }
         }
         else if (selectedrobentry->result_valid && (selectedrobentry->instruction_type == OPCODE_BNZ))
         {
-            if (cpu->zero_flag == FALSE)
+            if (taken)
             {
-                cpu->rob_head = 0;
-                cpu->rob_tail = 0;
-                memset(cpu->ROB, 0, sizeof(int) * 64);
+                flush_at_commit(cpu);
+                flushed = TRUE;
             }
             else
             {
-                cpu->rob_head = (cpu->rob_head + 1) % 64;
+                cpu->rob_head = ROB_NEXT(cpu, cpu->rob_head);
                 cpu->fetch.stalled = 0;
                 cpu->fetch.has_insn = TRUE;
+                cpu->flush_pending = FALSE;
             }
         }
         else if (selectedrobentry->result_valid && selectedrobentry->instruction_type == OPCODE_JAL)
         {
             instruction_retirement_intfu(cpu, selectedrobentry->imm, selectedrobentry->des_rd, selectedrobentry->des_phy_reg);
-            cpu->rob_head = 0;
-            cpu->rob_tail = 0;
-            memset(cpu->ROB, 0, sizeof(int) * 64);
-            cpu->fetch.stalled = 0;
-            cpu->fetch.has_insn = TRUE;
+            if (ORACLE(cpu, ORACLE_BRANCH))
+            {
+                cpu->rob_head = ROB_NEXT(cpu, cpu->rob_head);
+            }
+            else
+            {
+                flush_at_commit(cpu);
+                flushed = TRUE;
+                cpu->fetch.stalled = 0;
+                cpu->fetch.has_insn = TRUE;
+            }
         }
         else if (selectedrobentry->result_valid && selectedrobentry->instruction_type == OPCODE_JUMP)
         {
-            cpu->rob_head = 0;
-            cpu->rob_tail = 0;
-            memset(cpu->ROB, 0, sizeof(int) * 64);
-            cpu->fetch.stalled = 0;
-            cpu->fetch.has_insn = TRUE;
-            break;
+            flushed = !ORACLE(cpu, ORACLE_BRANCH);
+            if (flushed)
+            {
+                flush_at_commit(cpu);
+                cpu->fetch.stalled = 0;
+                cpu->fetch.has_insn = TRUE;
+            }
+            else
+            {
+                cpu->rob_head = ROB_NEXT(cpu, cpu->rob_head);
+            }
         }
         else if (selectedrobentry->result_valid && selectedrobentry->instruction_type == OPCODE_CMP)
         {
-            cpu->rob_head = (cpu->rob_head + 1) % 64;
+            cpu->rob_head = ROB_NEXT(cpu, cpu->rob_head);
+        }
+
+        cpu->insn_completed++;
+        if (cpu->profile)
+        {
+            APEX_profile_commit(cpu->profile, pc, flushed);
+        }
+        if (cpu->critpath)
+        {
+            APEX_critpath_commit(cpu->critpath, cpu, rob_index, pc, flushed);
+        }
+        if (cpu->commit_breaks)
+        {
+            int index = get_code_memory_index_from_pc(pc);
+
+            if (index >= 0 && index < cpu->code_memory_size && cpu->commit_breaks[index])
+            {
+                cpu->commit_break_pc = pc;
+            }
         }
 
         if (ENABLE_DEBUG_MESSAGES)
         {
             printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
             printf("Details of ROB Retired Instructions –\n");
-            printf("%s----[%d]", selectedrobentry->opcode_str, selectedrobentry->pc);
+            /* A flush has cleared the entry, code memory still holds it */
+            printf("%s----[%d]", cpu->code_memory[get_code_memory_index_from_pc(pc)].opcode_str, pc);
             printf("\n");
             printf("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
         }
@@ -1782,56 +2315,122 @@ int APEX_instruction_commitment(APEX_CPU *cpu)
     //default
     return 0;
 }
+/*
+ * Puts cpu in its state before the first cycle, running code_memory on the
+ * machine of opts, which may be NULL for the default machine. Data memory is
+ * cleared, then preloaded from --mem-load. Analyses attached to cpu are
+ * dropped, the caller frees them first.
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_cpu_reset(APEX_CPU *cpu, APEX_Instruction *code_memory, int code_memory_size, const APEX_Options *opts)
+{
+    memset(cpu, 0, sizeof(APEX_CPU));
+
+    /* Initialize PC, Registers and all pipeline stages */
+    cpu->pc = 4000;
+    cpu->single_step = ENABLE_SINGLE_STEP;
+    if (opts)
+    {
+        cpu->config = opts->config;
+        APEX_config_apply_oracles(&cpu->config);
+    }
+    else
+    {
+        APEX_config_default(&cpu->config);
+    }
+    cpu->zero_flag = -1;
+    cpu->code_memory = code_memory;
+    cpu->code_memory_size = code_memory_size;
+
+    //invalid contents
+    memset(cpu->rename_table, -1, sizeof(int) * 16);
+    //invalid contents
+    memset(cpu->r_rename_table, -1, sizeof(int) * 16);
+
+    /* Preload data memory so the program starts with its input in place */
+    if (opts && opts->mem_load_file && APEX_memimage_load(cpu, opts->mem_load_file) < 0)
+    {
+        return -1;
+    }
+    /* The branch oracle starts from the same data memory */
+    if (ORACLE(cpu, ORACLE_BRANCH) && !(cpu->oracle = APEX_oracle_create(cpu)))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate branch oracle\n");
+        return -1;
+    }
+
+    /* To start fetch stage */
+    cpu->fetch.has_insn = TRUE;
+    return 0;
+}
+
+/*
+ * Starts a freshly reset cpu in the middle of its program, from the
+ * architectural state of a functional model about to execute pc. Every
+ * register is mapped to a committed physical register of its own, the
+ * configuration check leaves at least one more to rename with.
+ */
+void
+APEX_cpu_restore(APEX_CPU *cpu, const APEX_Oracle *state, int pc)
+{
+    for (int r = 0; r < REG_FILE_SIZE; r++)
+    {
+        cpu->phys_regs[r] = state->regs[r];
+        cpu->phys_regs_valid[r] = 1;
+        cpu->free_PR_list[r] = 1;
+        cpu->rename_table[r] = cpu->r_rename_table[r] = r;
+        cpu->rename_table_valid[r] = cpu->r_rename_table_valid[r] = 1;
+    }
+    memcpy(cpu->data_memory, state->data_memory, sizeof(cpu->data_memory));
+    cpu->zero_flag = state->zero_flag;
+    cpu->pc = pc;
+    /* The branch oracle goes on from the same point */
+    if (cpu->oracle)
+    {
+        memcpy(cpu->oracle, state, sizeof(APEX_Oracle));
+    }
+}
+
 /*
  * This function creates and initializes APEX cpu.
  *
  * Note: You are free to edit this function according to your implementation
  */
 APEX_CPU *
-APEX_cpu_init(const char *filename)
+APEX_cpu_init(const char *filename, const APEX_Options *opts)
 {
     int i;
+    int code_memory_size;
     APEX_CPU *cpu;
+    APEX_Instruction *code_memory;
 
     if (!filename)
     {
         return NULL;
     }
 
-    cpu = calloc(1, sizeof(APEX_CPU));
+    cpu = malloc(sizeof(APEX_CPU));
 
     if (!cpu)
     {
         return NULL;
     }
 
-    /* Initialize PC, Registers and all pipeline stages */
-    cpu->pc = 4000;
-    memset(cpu->regs, 0, sizeof(int) * REG_FILE_SIZE);
-    memset(cpu->data_memory, 0, sizeof(int) * DATA_MEMORY_SIZE);
-    cpu->single_step = ENABLE_SINGLE_STEP;
-    cpu->zero_flag = -1;
     /* Parse input file and create code memory */
-    cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
-
-    memset(cpu->phys_regs, 0, sizeof(int) * 48);
-    //invalid contents
-    memset(cpu->phys_regs_valid, 0, sizeof(int) * 48);
-
-    //invalid contents
-    memset(cpu->rename_table, -1, sizeof(int) * 16);
-
-    memset(cpu->rename_table_valid, 0, sizeof(int) * 16);
-    //invalid contents
-    memset(cpu->r_rename_table, -1, sizeof(int) * 16);
-
-    memset(cpu->r_rename_table_valid, 0, sizeof(int) * 16);
-
-    if (!cpu->code_memory)
+    code_memory = create_code_memory(filename, &code_memory_size);
+    if (!code_memory)
     {
         free(cpu);
         return NULL;
     }
+    if (APEX_cpu_reset(cpu, code_memory, code_memory_size, opts) < 0)
+    {
+        free(code_memory);
+        free(cpu);
+        return NULL;
+    }
 
     if (ENABLE_DEBUG_MESSAGES)
     {
@@ -1850,20 +2449,131 @@ APEX_cpu_init(const char *filename)
                    cpu->code_memory[i].rs2, cpu->code_memory[i].imm);
         }
     }
-
-    /* To start fetch stage */
-    cpu->fetch.has_insn = TRUE;
     return cpu;
 }
 
+/* Prints the parts of the CPU state selected by the APEX_PRINT_* flags */
+void
+APEX_cpu_print_state(APEX_CPU *cpu, int what)
+{
+    if (what & APEX_PRINT_ROB)
+    {
+        print_rob(cpu);
+    }
+    if (what & APEX_PRINT_RAT)
+    {
+        print_rename_table(cpu);
+        print_r_rename_table(cpu);
+        printf("\n");
+    }
+    if (what & APEX_PRINT_MEM)
+    {
+        printdatamemory(cpu);
+    }
+    if (what & APEX_PRINT_PRF)
+    {
+        print_physical_register(cpu);
+        printf("\n");
+    }
+}
+
+/*
+ * Simulates one clock cycle, stages run in reverse pipeline order
+ *
+ * Returns TRUE when HALT commits in this cycle
+ */
+int
+APEX_cpu_cycle(APEX_CPU *cpu)
+{
+    int halted = FALSE;
+    int rob_tail;
+    HOSTPROF_CYCLE_BEGIN();
+
+    if (ENABLE_DEBUG_MESSAGES)
+    {
+        printf("--------------------------------------------\n");
+        printf("Clock Cycle #: %d\n", cpu->clock + 1);
+        printf("--------------------------------------------\n");
+    }
+
+    HOSTPROF_STAGE(HP_COMMIT, halted = APEX_instruction_commitment(cpu));
+    if (cpu->profile)
+    {
+        APEX_profile_rob(cpu->profile, cpu);
+    }
+    HOSTPROF_STAGE(HP_MEMORY2, APEX_memory2(cpu));
+    HOSTPROF_STAGE(HP_MEMORY1, APEX_memory1(cpu));
+    HOSTPROF_STAGE(HP_JBU2, APEX_jbu2(cpu));
+    HOSTPROF_STAGE(HP_JBU1, APEX_jbu1(cpu));
+    HOSTPROF_STAGE(HP_MUL3, APEX_mul3(cpu));
+    HOSTPROF_STAGE(HP_MUL2, APEX_mul2(cpu));
+    HOSTPROF_STAGE(HP_MUL1, APEX_mul1(cpu));
+    HOSTPROF_STAGE(HP_INTFU, APEX_intfu(cpu));
+    HOSTPROF_STAGE(HP_ISSUE, APEX_issuequeue(cpu));
+    if (cpu->profile)
+    {
+        APEX_profile_issue(cpu->profile, cpu);
+    }
+    rob_tail = cpu->rob_tail;
+    HOSTPROF_STAGE(HP_DECODE, APEX_decode(cpu));
+    if (cpu->rob_tail != rob_tail)
+    {
+        if (cpu->trace)
+        {
+            APEX_trace_dispatch(cpu->trace, &cpu->ROB[rob_tail]);
+        }
+        OBSERVE(cpu, OBS_RENAME, observe_rob(cpu, OBS_RENAME, rob_tail));
+        if (OBSERVED(cpu, OBS_DISPATCH) || OBSERVED(cpu, OBS_ISSUE))
+        {
+            observe_dispatch(cpu, rob_tail);
+        }
+    }
+    HOSTPROF_STAGE(HP_FETCH, APEX_fetch(cpu));
+
+    if (cpu->critpath)
+    {
+        APEX_critpath_cycle(cpu->critpath, cpu);
+    }
+    if (cpu->cpistack && APEX_cpistack_cycle(cpu->cpistack, cpu) < 0)
+    {
+        cpu->hook_failed = TRUE;
+    }
+    if (cpu->branchprof)
+    {
+        APEX_branchprof_cycle(cpu->branchprof, cpu);
+    }
+
+    if (halted)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            cpu->rename_table[i] = cpu->r_rename_table[i];
+        }
+    }
+    cpu->clock++;
+    if (cpu->telemetry)
+    {
+        APEX_telemetry_cycle(cpu->telemetry, cpu);
+    }
+    if (cpu->checkpoints && APEX_checkpoint_cycle(cpu->checkpoints, cpu) < 0)
+    {
+        cpu->hook_failed = TRUE;
+    }
+    HOSTPROF_CYCLE_END();
+    return halted;
+}
+
 /*
  * APEX CPU simulation loop
  *
  * Note: You are free to edit this function according to your implementation
  */
-void APEX_cpu_run(APEX_CPU *cpu, const char *fun, const char *steps)
+/* Returns TRUE when the program ran to its HALT */
+int APEX_cpu_run(APEX_CPU *cpu, const char *fun, const char *steps)
 {
     char user_prompt_val;
+    int breaktrue = 0;
+    int user_quit = 0;
     //int funct=0; // 0 for simulate 1 for display and single step for 2
     if (strcmp(fun, "simulate") == 0)
     {
@@ -1883,38 +2593,8 @@ void APEX_cpu_run(APEX_CPU *cpu, const char *fun, const char *steps)
 
     while (TRUE)
     {
-        int breaktrue = 0;
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            printf("--------------------------------------------\n");
-            printf("Clock Cycle #: %d\n", cpu->clock + 1);
-            printf("--------------------------------------------\n");
-        }
-
-        if (APEX_instruction_commitment(cpu))
-        {
-            breaktrue = 1;
-        }
-        APEX_memory2(cpu);
-        APEX_memory1(cpu);
-        APEX_jbu2(cpu);
-        APEX_jbu1(cpu);
-        APEX_mul3(cpu);
-        APEX_mul2(cpu);
-        APEX_mul1(cpu);
-        APEX_intfu(cpu);
-        APEX_issuequeue(cpu);
-        APEX_decode(cpu);
-        APEX_fetch(cpu);
-
-        if (breaktrue)
-        {
+        breaktrue = APEX_cpu_cycle(cpu);
 
-            for (int i = 0; i < 16; i++)
-            {
-                cpu->rename_table[i] = cpu->r_rename_table[i];
-            }
-        }
         //  print_reg_file(cpu);
         if (funct != 0)
         {
@@ -1934,13 +2614,15 @@ void APEX_cpu_run(APEX_CPU *cpu, const char *fun, const char *steps)
 
             if ((user_prompt_val == 'Q') || (user_prompt_val == 'q'))
             {
-                printf("APEX_CPU: Simulation Stopped, cycles = %d instructions = %d\n", cpu->clock + 1, cpu->insn_completed);
+                printf("APEX_CPU: Simulation Stopped, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
+                user_quit = 1;
                 break;
             }
         }
 
-        cpu->clock++;
-        if (funct != 2 && numOfCycles == cpu->clock)
+        /* A run stopped by its run control ends as at its cycle limit */
+        if (funct != 2 && (numOfCycles == cpu->clock ||
+                           (!breaktrue && cpu->runctl && APEX_runctl_check(cpu->runctl, cpu) != RUN_ON)))
         {
             if (funct == 0)
             {
@@ -1980,6 +2662,14 @@ void APEX_cpu_run(APEX_CPU *cpu, const char *fun, const char *steps)
             break;
         }
     }
+
+    if (!user_quit)
+    {
+        printf("APEX_CPU: Simulation %s, cycles = %d instructions = %d\n",
+               breaktrue ? "Complete" : "Stopped", cpu->clock, cpu->insn_completed);
+    }
+    APEX_config_print(&cpu->config);
+    return breaktrue;
 }
 void instruction_retirement_intfu(APEX_CPU *cpu, int result_buffer, int des_rd, int des_phy_reg)
 {
@@ -2025,6 +2715,14 @@ void instruction_retirement_intfu(APEX_CPU *cpu, int result_buffer, int des_rd,
  */
 void APEX_cpu_stop(APEX_CPU *cpu)
 {
+    APEX_observers_free(cpu);
+    APEX_profile_free(cpu->profile);
+    APEX_critpath_free(cpu->critpath);
+    APEX_cpistack_free(cpu->cpistack);
+    APEX_memprofile_free(cpu->memprofile);
+    APEX_branchprof_free(cpu->branchprof);
+    APEX_telemetry_close(cpu->telemetry);
+    APEX_oracle_free(cpu->oracle);
     free(cpu->code_memory);
     free(cpu);
 }
@@ -9,7 +9,17 @@
 #ifndef _APEX_CPU_H_
 #define _APEX_CPU_H_
 
+#include <stddef.h>
+#include <stdio.h>
+
+#include "apex_config.h"
 #include "apex_macros.h"
+#include "apex_options.h"
+
+struct APEX_Profile;
+struct APEX_CritPath;
+struct APEX_Trace;
+
 enum
 {
 	F,
@@ -51,7 +61,9 @@ typedef struct ROB_ENTRY
     int src3;
     int imm;
     int mready;
-    
+    int mem_address; // effective address of loads and stores, set in MEM2
+    int branch_outcome; // BZ/BNZ taken at each BRANCH_AT_* point, one bit each
+    int trace_index; // trace record of the instruction when replaying, -1 if none
 } ROB_ENTRY;
 typedef struct IQ_ENTRY
 {
@@ -94,6 +106,7 @@ typedef struct CPU_Stage
     int memory_address;
     int has_insn;
     int stalled;
+    int delay; // Extra cycles the instruction still spends in this stage
     IQ_ENTRY iq_entry;
     ROB_ENTRY *rob_entry;
 } CPU_Stage;
@@ -113,21 +126,24 @@ typedef struct APEX_CPU
     int code_memory_size;          /* Number of instruction in the input file */
     APEX_Instruction *code_memory; /* Code Memory */
     int data_memory[DATA_MEMORY_SIZE]; /* Data Memory */
+    unsigned long data_memory_dirty[DATA_MEMORY_SIZE / DIRTY_BITS_PER_WORD]; /* Words written by committed stores */
+    unsigned int data_memory_pages_written; /* Pages stored to since the last snapshot, one bit each */
     int single_step;               /* Wait for user input after every cycle */
     int zero_flag;                 /* {TRUE, FALSE} Used by BZ and BNZ to branch */
+    int flush_pending;             /* Taken branch resolved, ROB flush waits for its commit */
     int fetch_from_next_cycle;
 
 
 	int is_stalled;
 
-    int phys_regs[48];
-	int phys_regs_valid[48];
+    int phys_regs[PHYS_REG_CAPACITY];
+	int phys_regs_valid[PHYS_REG_CAPACITY];
 
 
 	// Index represents the PR and values 1- represents free,0 - represents occupied.
-	int free_PR_list[48];
+	int free_PR_list[PHYS_REG_CAPACITY];
 
-    ROB_ENTRY ROB[64];
+    ROB_ENTRY ROB[ROB_CAPACITY];
   
     int rob_tail;
     int rob_head;
@@ -140,17 +156,17 @@ typedef struct APEX_CPU
 	//retired Rename table to contain info with Index represents the  Physical Register.
 	int r_rename_table[16];
     int r_rename_table_valid[16];
-    IQ_ENTRY IssueQueue[24];
+    IQ_ENTRY IssueQueue[IQ_CAPACITY];
   
-    int freeiq[24];
+    int freeiq[IQ_CAPACITY];
     /* Pipeline stages */
     CPU_Stage fetch;
     CPU_Stage decode;
     CPU_Stage issuequeue ;
-    CPU_Stage intfu ; 
-    CPU_Stage mul1 ;
-    CPU_Stage mul2 ;
-    CPU_Stage mul3 ;
+    CPU_Stage intfu[INTFU_CAPACITY]; // One latch per integer unit
+    CPU_Stage mul1[MULFU_CAPACITY];  // One MUL1 -> MUL3 pipeline per multiplier
+    CPU_Stage mul2[MULFU_CAPACITY];
+    CPU_Stage mul3[MULFU_CAPACITY];
     CPU_Stage jbu1 ;
     CPU_Stage jbu2 ; 
     
@@ -158,11 +174,68 @@ typedef struct APEX_CPU
     CPU_Stage memory2 ;
     IQ_ENTRY iq_entry;
     CPU_Stage instruction_commitment ;
+
+    APEX_Config config;            /* Machine configuration of this run */
+
+    /* Breakpoints on commit and fetch PCs, one flag per code memory index,
+     * NULL unless the debugger is attached (see apex_debug.c) */
+    const unsigned char *commit_breaks;
+    const unsigned char *fetch_breaks;
+    int commit_break_pc;           /* PC whose commit breakpoint fired, -1 if none */
+    int fetch_break_pc;            /* PC whose fetch breakpoint fired, -1 if none */
+
+    /* Per-PC hot-spot counters, NULL unless --profile is given (see apex_profile.c) */
+    struct APEX_Profile *profile;
+    /* Dependence graph timestamps, NULL unless --critical-path is given (see apex_critpath.c) */
+    struct APEX_CritPath *critpath;
+    /* Cycles charged to top-down categories, NULL unless --cpi-stack is given (see apex_cpistack.c) */
+    struct APEX_CpiStack *cpistack;
+    /* Strides, reuse distances and working set, NULL unless --mem-profile is given (see apex_memprofile.c) */
+    struct APEX_MemProfile *memprofile;
+    /* Outcomes, predictability and cost of branches, NULL unless --branch-profile is given
+     * (see apex_branchprof.c) */
+    struct APEX_BranchProf *branchprof;
+    /* Committed stream being recorded or driving the pipeline, NULL if none (see apex_trace.c) */
+    struct APEX_Trace *trace;
+    /* Live counters in shared memory, NULL unless --telemetry is given (see apex_telemetry.c) */
+    struct APEX_Telemetry *telemetry;
+    /* Functional model steering fetch, NULL unless --oracle=branch is given (see apex_oracle.c) */
+    struct APEX_Oracle *oracle;
+    /* Snapshots and fetch record kept for the next run, NULL unless --checkpoints is given
+     * (see apex_checkpoint.c) */
+    struct APEX_Checkpoints *checkpoints;
+    /* Callbacks on pipeline events, NULL if none (see apex_observer.c) */
+    struct APEX_Observers *observers;
+    unsigned observed;             /* OBS_MASK of the events some callback watches */
+    /* Watchdog, wall-clock budget and interrupts of the run, NULL if unwatched (see apex_runctl.c) */
+    struct APEX_RunCtl *runctl;
+    int hook_failed;               /* An analysis failed during a cycle, the run control stops the run */
 } APEX_CPU;
 
+/* Parts of the CPU state printed by APEX_cpu_print_state */
+enum
+{
+    APEX_PRINT_ROB = 0x1, /* Reorder buffer */
+    APEX_PRINT_RAT = 0x2, /* Rename and retirement rename tables */
+    APEX_PRINT_MEM = 0x4, /* Data memory words shown after a run */
+    APEX_PRINT_PRF = 0x8  /* Physical register file */
+};
+
+/* Per-cycle pipeline printing, off in simulate mode and in the debugger */
+extern int ENABLE_DEBUG_MESSAGES;
+
 APEX_Instruction *create_code_memory(const char *filename, int *size);
-APEX_CPU *APEX_cpu_init(const char *filename);
-void APEX_cpu_run(APEX_CPU *cpu,const char *fun,const char *steps);
+APEX_Instruction *read_code_memory(FILE *fp, int *size);
+char *APEX_format_instruction(const APEX_Instruction *ins, char *buf, size_t size);
+APEX_CPU *APEX_cpu_init(const char *filename, const APEX_Options *opts);
+int APEX_cpu_reset(APEX_CPU *cpu, APEX_Instruction *code_memory, int code_memory_size, const APEX_Options *opts);
+void APEX_cpu_restore(APEX_CPU *cpu, const struct APEX_Oracle *state, int pc);
+int APEX_cpu_run(APEX_CPU *cpu,const char *fun,const char *steps);
+int APEX_cpu_cycle(APEX_CPU *cpu);
+int APEX_cpu_rob_full(const APEX_CPU *cpu);
+int APEX_cpu_iq_full(const APEX_CPU *cpu);
+int APEX_cpu_arch_reg(const APEX_CPU *cpu, int reg);
+void APEX_cpu_print_state(APEX_CPU *cpu, int what);
 void APEX_cpu_stop(APEX_CPU *cpu);
 void instruction_retirement(APEX_CPU *cpu,IQ_ENTRY iq_entry);
 void instruction_retirement_intfu(APEX_CPU *cpu, int result_buffer, int des_rd, int des_phy_reg );
@@ -0,0 +1,404 @@
+/*
+ * apex_critpath.c
+ * Contains the dynamic critical path analysis of committed instructions
+ *
+ * Every committed instruction contributes four nodes to a dependence graph:
+ * dispatch (D), issue (E), completion (C) and commit (R), timestamped with
+ * the cycles the pipeline actually spent. Edges are
+ *
+ *   D(i-1) -> D(i)         in-order dispatch
+ *   R(i-W) -> D(i)         ROB capacity, W usable entries
+ *   C(b) or R(b) -> D(i)   fetch resumes after BZ/BNZ, redirects at commit
+ *   D(i) -> E(i)           issue queue selection
+ *   C(p) -> E(i)           register or zero flag produced by p
+ *   R(s) -> E(i)           load of the word committed by store s
+ *   E(i) -> C(i)           execution latency
+ *   C(i) -> R(i)           commit
+ *   R(i-1) -> R(i)         in-order commit
+ *
+ * The critical path follows the last arriving edge into every node. Instead
+ * of keeping the graph, each node carries the cycles of every edge kind on
+ * the path reaching it, so the analysis needs memory only for the nodes
+ * later instructions can still depend on.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_critpath.h"
+#include "apex_macros.h"
+
+static const struct
+{
+    const char *name;
+    const char *remedy;
+} kinds[CP_KINDS] = {
+    [CP_DISPATCH] = {"dispatch", "wider fetch and decode, larger --iq-size or --phys-regs"},
+    [CP_ROB_FULL] = {"rob-full", "larger --rob-size"},
+    [CP_BRANCH] = {"branch", "resolve or predict branches earlier"},
+    [CP_ISSUE] = {"issue", "more --intfu-count or --mulfu-count"},
+    [CP_DATA] = {"data", "shorter dependence chains in the program"},
+    [CP_MEMDEP] = {"memdep", "store to load forwarding"},
+    [CP_INTFU] = {"intfu", "lower --intfu-latency"},
+    [CP_MUL] = {"mul", "lower --mul-latency"},
+    [CP_MEMORY] = {"memory", "lower --mem-latency"},
+    [CP_RESOLVE] = {"resolve", "faster branch unit"},
+    [CP_COMMIT] = {"commit", "wider or earlier commit"},
+};
+
+/* Latest arriving edge into a node being built */
+typedef struct CP_Arrival
+{
+    const CP_Node *src;
+    int kind;
+} CP_Arrival;
+
+APEX_CritPath *
+APEX_critpath_create(void)
+{
+    APEX_CritPath *cp = calloc(1, sizeof(APEX_CritPath));
+
+    if (!cp)
+    {
+        return NULL;
+    }
+    cp->stores = calloc(DATA_MEMORY_SIZE, sizeof(CP_Node));
+    cp->stored = calloc(DATA_MEMORY_SIZE, 1);
+    if (!cp->stores || !cp->stored)
+    {
+        APEX_critpath_free(cp);
+        return NULL;
+    }
+    return cp;
+}
+
+void
+APEX_critpath_free(APEX_CritPath *cp)
+{
+    if (cp)
+    {
+        free(cp->stores);
+        free(cp->stored);
+        free(cp);
+    }
+}
+
+/*
+ * Called at the end of every cycle, timestamps the instructions which
+ * entered the ROB, left the issue queue or completed in it
+ */
+void
+APEX_critpath_cycle(APEX_CritPath *cp, const APEX_CPU *cpu)
+{
+    unsigned char queued[ROB_CAPACITY] = {0};
+
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        if (cpu->freeiq[i] == 1)
+        {
+            queued[cpu->IssueQueue[i].rob_tail] = 1;
+        }
+    }
+    for (int i = cpu->rob_head; i != cpu->rob_tail; i = ROB_NEXT(cpu, i))
+    {
+        CP_Slot *slot = &cp->slots[i];
+
+        if (!slot->live)
+        {
+            slot->live = TRUE;
+            slot->dispatch = cpu->clock;
+            slot->issue = -1;
+            slot->complete = -1;
+        }
+        if (slot->issue < 0 && !queued[i])
+        {
+            slot->issue = cpu->clock;
+        }
+        if (slot->complete < 0 && cpu->ROB[i].result_valid)
+        {
+            slot->complete = cpu->clock;
+        }
+    }
+}
+
+static void
+consider(CP_Arrival *arrival, long time, const CP_Node *src, int kind)
+{
+    /* An edge cannot arrive after its node, such a source did not constrain it */
+    if (src->time <= time && (!arrival->src || src->time > arrival->src->time))
+    {
+        arrival->src = src;
+        arrival->kind = kind;
+    }
+}
+
+static CP_Node
+settle(long time, const CP_Arrival *arrival, int start_kind)
+{
+    CP_Node node;
+
+    node.time = time;
+    if (!arrival->src)
+    {
+        memset(node.kinds, 0, sizeof(node.kinds));
+        node.kinds[start_kind] = time;
+        return node;
+    }
+    memcpy(node.kinds, arrival->src->kinds, sizeof(node.kinds));
+    node.kinds[arrival->kind] += time - arrival->src->time;
+    return node;
+}
+
+/* Architectural source registers of an instruction, returns their count */
+static int
+source_regs(const APEX_Instruction *ins, int regs[3])
+{
+    switch (ins->opcode)
+    {
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_MUL:
+    case OPCODE_DIV:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_LDR:
+    case OPCODE_CMP:
+    case OPCODE_STORE:
+        regs[0] = ins->rs1;
+        regs[1] = ins->rs2;
+        return 2;
+    case OPCODE_STR:
+        regs[0] = ins->rs1;
+        regs[1] = ins->rs2;
+        regs[2] = ins->rs3;
+        return 3;
+    case OPCODE_ADDL:
+    case OPCODE_SUBL:
+    case OPCODE_LOAD:
+    case OPCODE_JUMP:
+    case OPCODE_JAL:
+        regs[0] = ins->rs1;
+        return 1;
+    }
+    return 0;
+}
+
+static int
+writes_reg(int opcode)
+{
+    switch (opcode)
+    {
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_MUL:
+    case OPCODE_DIV:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_MOVC:
+    case OPCODE_LOAD:
+    case OPCODE_LDR:
+    case OPCODE_ADDL:
+    case OPCODE_SUBL:
+    case OPCODE_JAL:
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* Kind of the execution edge E -> C */
+static int
+execute_kind(int opcode)
+{
+    switch (opcode)
+    {
+    case OPCODE_MUL:
+        return CP_MUL;
+    case OPCODE_LOAD:
+    case OPCODE_LDR:
+    case OPCODE_STORE:
+    case OPCODE_STR:
+        return CP_MEMORY;
+    case OPCODE_BZ:
+    case OPCODE_BNZ:
+    case OPCODE_JUMP:
+    case OPCODE_JAL:
+        return CP_RESOLVE;
+    }
+    return CP_INTFU;
+}
+
+/*
+ * Called for every instruction leaving the ROB at rob_index, after the flush
+ * it caused if any
+ */
+void
+APEX_critpath_commit(APEX_CritPath *cp, const APEX_CPU *cpu, int rob_index, int pc, int flushed)
+{
+    const CP_Slot *slot = &cp->slots[rob_index];
+    const APEX_Instruction *ins;
+    int window = ROB_SIZE(cpu) - 1;
+    long now = cpu->clock;
+    long d_time = slot->live ? slot->dispatch : now;
+    long e_time = slot->live && slot->issue >= 0 ? slot->issue : d_time;
+    long c_time = slot->live && slot->complete >= 0 ? slot->complete : e_time;
+    CP_Arrival arrival;
+    CP_Node d, e, c, r;
+    int regs[3], nregs;
+
+    if (pc < 4000 || (pc - 4000) / 4 >= cpu->code_memory_size)
+    {
+        return;
+    }
+    ins = &cpu->code_memory[(pc - 4000) / 4];
+
+    memset(&arrival, 0, sizeof(arrival));
+    if (cp->after_control)
+    {
+        consider(&arrival, d_time, &cp->control, CP_BRANCH);
+    }
+    if (cp->committed >= window)
+    {
+        consider(&arrival, d_time, &cp->window[(cp->committed - window) % ROB_CAPACITY], CP_ROB_FULL);
+    }
+    if (cp->committed)
+    {
+        consider(&arrival, d_time, &cp->last_dispatch, CP_DISPATCH);
+    }
+    d = settle(d_time, &arrival, CP_DISPATCH);
+
+    memset(&arrival, 0, sizeof(arrival));
+    nregs = source_regs(ins, regs);
+    for (int i = 0; i < nregs; i++)
+    {
+        if (regs[i] >= 0 && regs[i] < REG_FILE_SIZE && cp->regs_written[regs[i]])
+        {
+            consider(&arrival, e_time, &cp->regs[regs[i]], CP_DATA);
+        }
+    }
+    if ((ins->opcode == OPCODE_BZ || ins->opcode == OPCODE_BNZ) && cp->flag_written)
+    {
+        consider(&arrival, e_time, &cp->flag, CP_DATA);
+    }
+    if ((ins->opcode == OPCODE_LOAD || ins->opcode == OPCODE_LDR) &&
+        cpu->ROB[rob_index].mem_address >= 0 && cpu->ROB[rob_index].mem_address < DATA_MEMORY_SIZE &&
+        cp->stored[cpu->ROB[rob_index].mem_address])
+    {
+        consider(&arrival, e_time, &cp->stores[cpu->ROB[rob_index].mem_address], CP_MEMDEP);
+    }
+    consider(&arrival, e_time, &d, CP_ISSUE);
+    e = settle(e_time, &arrival, CP_ISSUE);
+
+    memset(&arrival, 0, sizeof(arrival));
+    consider(&arrival, c_time, &e, execute_kind(ins->opcode));
+    c = settle(c_time, &arrival, CP_COMMIT);
+
+    memset(&arrival, 0, sizeof(arrival));
+    consider(&arrival, now, &c, CP_COMMIT);
+    if (cp->committed)
+    {
+        consider(&arrival, now, &cp->last_commit, CP_COMMIT);
+    }
+    r = settle(now, &arrival, CP_COMMIT);
+
+    /* Nodes later instructions can depend on */
+    cp->last_dispatch = d;
+    cp->last_commit = r;
+    cp->window[cp->committed % ROB_CAPACITY] = r;
+    cp->committed++;
+    if (writes_reg(ins->opcode) && ins->rd >= 0 && ins->rd < REG_FILE_SIZE)
+    {
+        cp->regs[ins->rd] = c;
+        cp->regs_written[ins->rd] = TRUE;
+    }
+    if (ins->opcode == OPCODE_ADD || ins->opcode == OPCODE_SUB || ins->opcode == OPCODE_SUBL ||
+        ins->opcode == OPCODE_CMP)
+    {
+        cp->flag = c;
+        cp->flag_written = TRUE;
+    }
+    if ((ins->opcode == OPCODE_STORE || ins->opcode == OPCODE_STR) && cpu->ROB[rob_index].mem_address >= 0 &&
+        cpu->ROB[rob_index].mem_address < DATA_MEMORY_SIZE)
+    {
+        cp->stores[cpu->ROB[rob_index].mem_address] = r;
+        cp->stored[cpu->ROB[rob_index].mem_address] = TRUE;
+    }
+    cp->after_control = ins->opcode == OPCODE_BZ || ins->opcode == OPCODE_BNZ || ins->opcode == OPCODE_JUMP ||
+                        ins->opcode == OPCODE_JAL;
+    cp->control = flushed ? r : c;
+
+    if (flushed)
+    {
+        for (int i = 0; i < ROB_CAPACITY; i++)
+        {
+            cp->slots[i].live = FALSE;
+        }
+    }
+    else
+    {
+        cp->slots[rob_index].live = FALSE;
+    }
+}
+
+/*
+ * Writes the critical path breakdown to filename, "-" for standard output
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_critpath_write(const APEX_CritPath *cp, const APEX_CPU *cpu, const char *filename)
+{
+    FILE *fp = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    const CP_Node *end = &cp->last_commit;
+    long length = cp->committed ? end->time + 1 : 0;
+    long cycles[CP_KINDS];
+    int order[CP_KINDS];
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open critical path report %s\n", filename);
+        return -1;
+    }
+
+    /* Largest contribution first, the cycle HALT commits in is part of the path */
+    for (int i = 0; i < CP_KINDS; i++)
+    {
+        int j = i;
+
+        cycles[i] = end->kinds[i] + (i == CP_COMMIT && cp->committed);
+        for (; j > 0 && cycles[order[j - 1]] < cycles[i]; j--)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    fprintf(fp, "Critical path: %ld cycles, %ld instructions committed, %d cycles simulated\n\n", length,
+            cp->committed, cpu->clock);
+    fprintf(fp, "%-10s %9s %8s  %s\n", "Edge", "Cycles", "Percent", "Shorten with");
+    for (int i = 0; i < CP_KINDS; i++)
+    {
+        if (cycles[order[i]])
+        {
+            fprintf(fp, "%-10s %9ld %7.2f%%  %s\n", kinds[order[i]].name, cycles[order[i]],
+                    length ? 100.0 * cycles[order[i]] / length : 0.0, kinds[order[i]].remedy);
+        }
+    }
+    if (cp->committed)
+    {
+        fprintf(fp, "\nLargest edge kind: %s, %s\n", kinds[order[0]].name, kinds[order[0]].remedy);
+    }
+
+    if (fp != stdout && fclose(fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write critical path report %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * apex_critpath.h
+ * Contains declarations of the dynamic critical path analysis
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_CRITPATH_H_
+#define _APEX_CRITPATH_H_
+
+#include "apex_cpu.h"
+
+/* Kinds of dependence graph edges */
+enum
+{
+    CP_DISPATCH, /* In-order fetch, decode and dispatch of the previous instruction */
+    CP_ROB_FULL, /* ROB entry freed by the commit of an older instruction */
+    CP_BRANCH,   /* Fetch redirected or resumed by a control instruction */
+    CP_ISSUE,    /* Dispatch to issue with operands ready: IQ selection, busy units */
+    CP_DATA,     /* Register or zero flag produced by an older instruction */
+    CP_MEMDEP,   /* Memory word written by an older store */
+    CP_INTFU,    /* Integer unit latency */
+    CP_MUL,      /* Multiplier latency */
+    CP_MEMORY,   /* Memory pipeline latency of loads and stores */
+    CP_RESOLVE,  /* Branch unit latency */
+    CP_COMMIT,   /* Completion to commit and in-order commit */
+    CP_KINDS
+};
+
+/* Cycles of each edge kind on the longest path reaching a node */
+typedef struct CP_Node
+{
+    long time;
+    long kinds[CP_KINDS];
+} CP_Node;
+
+/* Timestamps of the instruction in one ROB entry */
+typedef struct CP_Slot
+{
+    int live;
+    long dispatch;
+    long issue;
+    long complete;
+} CP_Slot;
+
+typedef struct APEX_CritPath
+{
+    CP_Slot slots[ROB_CAPACITY];
+    long committed;
+    CP_Node last_dispatch;
+    CP_Node last_commit;
+    CP_Node control;       /* Point the instruction after a control instruction waits for */
+    int after_control;     /* The previous instruction was BZ, BNZ, JUMP or JAL */
+    CP_Node regs[REG_FILE_SIZE];
+    int regs_written[REG_FILE_SIZE];
+    CP_Node flag;
+    int flag_written;
+    CP_Node *stores;       /* Commit of the last store per data memory address */
+    unsigned char *stored;
+    CP_Node window[ROB_CAPACITY]; /* Commits of the last ROB_CAPACITY instructions */
+} APEX_CritPath;
+
+APEX_CritPath *APEX_critpath_create(void);
+void APEX_critpath_free(APEX_CritPath *cp);
+void APEX_critpath_cycle(APEX_CritPath *cp, const APEX_CPU *cpu);
+void APEX_critpath_commit(APEX_CritPath *cp, const APEX_CPU *cpu, int rob_index, int pc, int flushed);
+int APEX_critpath_write(const APEX_CritPath *cp, const APEX_CPU *cpu, const char *filename);
+#endif
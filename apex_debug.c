@@ -0,0 +1,781 @@
+/*
+ * apex_debug.c
+ * Contains the APEX simulator debugger: breakpoints on commit PC, fetch PC
+ * and cycle, watchpoints on data memory and architectural registers, and
+ * stops when the ROB or the issue queue fills up
+ *
+ * Between stops the pipeline runs with all per-cycle printing disabled.
+ * Commit and fetch PC breakpoints are flagged by the pipeline itself through
+ * per-PC tables, everything else is checked once per cycle.
+ *
+ * Snapshots of the CPU are taken while running, "reverse-step" and "goto"
+ * restore the newest one before the target cycle and replay silently from
+ * there.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_debug.h"
+#include "apex_macros.h"
+
+#define DEBUG_MAX_ARGS 4
+
+static const char *stop_names[] = {
+    [STOP_COMMIT_PC] = "commit",
+    [STOP_FETCH_PC] = "fetch",
+    [STOP_CYCLE] = "cycle",
+    [STOP_MEM] = "mem",
+    [STOP_REG] = "reg",
+    [STOP_ROB_FULL] = "rob-full",
+    [STOP_IQ_FULL] = "iq-full",
+};
+
+static void
+print_help(void)
+{
+    printf("Commands:\n");
+    printf("  break commit|fetch <pc>   stop when the instruction at pc commits / leaves fetch\n");
+    printf("  break cycle <n>           stop at the end of cycle n\n");
+    printf("  break rob-full|iq-full    stop when the ROB / issue queue becomes full\n");
+    printf("  watch mem <addr>          stop when data memory word addr changes\n");
+    printf("  watch reg R<n>            stop when the committed value of Rn changes\n");
+    printf("  until <break arguments>   run to a one-shot breakpoint\n");
+    printf("  info                      list breakpoints and watchpoints\n");
+    printf("  delete [id]               delete one or all breakpoints\n");
+    printf("  run | continue            run until a stop fires or HALT commits\n");
+    printf("  step [n]                  run n cycles (default 1)\n");
+    printf("  reverse-step [n]          go back n cycles (default 1)\n");
+    printf("  goto [cycle] <n>          go to the end of cycle n, backwards or forwards\n");
+    printf("  print rob|rat|prf|iq|pipeline\n");
+    printf("  print mem <addr> [count]  print data memory words\n");
+    printf("  print reg [R<n>]          print committed architectural registers\n");
+    printf("  quit\n");
+}
+
+/* Current value of a watched location or condition */
+static int
+stop_value(const APEX_Debugger *dbg, const APEX_Stop *stop)
+{
+    switch (stop->kind)
+    {
+    case STOP_MEM:
+        return dbg->cpu->data_memory[stop->arg];
+    case STOP_REG:
+        return APEX_cpu_arch_reg(dbg->cpu, stop->arg);
+    case STOP_ROB_FULL:
+        return APEX_cpu_rob_full(dbg->cpu);
+    case STOP_IQ_FULL:
+        return APEX_cpu_iq_full(dbg->cpu);
+    }
+    return 0;
+}
+
+/* Rebuilds the per-PC tables the pipeline checks at commit and fetch */
+static void
+update_pc_tables(APEX_Debugger *dbg)
+{
+    int ncommit = 0, nfetch = 0;
+
+    memset(dbg->commit_breaks, 0, dbg->cpu->code_memory_size);
+    memset(dbg->fetch_breaks, 0, dbg->cpu->code_memory_size);
+    for (int i = 0; i < DEBUG_MAX_STOPS; i++)
+    {
+        const APEX_Stop *stop = &dbg->stops[i];
+
+        if (stop->id && stop->kind == STOP_COMMIT_PC)
+        {
+            dbg->commit_breaks[(stop->arg - 4000) / 4] = 1;
+            ncommit++;
+        }
+        else if (stop->id && stop->kind == STOP_FETCH_PC)
+        {
+            dbg->fetch_breaks[(stop->arg - 4000) / 4] = 1;
+            nfetch++;
+        }
+    }
+    /* Keep the pipeline off the tables while they are empty */
+    dbg->cpu->commit_breaks = ncommit ? dbg->commit_breaks : NULL;
+    dbg->cpu->fetch_breaks = nfetch ? dbg->fetch_breaks : NULL;
+}
+
+/*
+ * Parses a register name, "R5" or "5"
+ *
+ * Returns the register number, -1 when invalid
+ */
+static int
+parse_reg(const char *arg)
+{
+    char *end;
+    long reg;
+
+    if (arg[0] == 'R' || arg[0] == 'r')
+    {
+        arg++;
+    }
+    reg = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || reg < 0 || reg >= REG_FILE_SIZE)
+    {
+        return -1;
+    }
+    return (int)reg;
+}
+
+static int
+parse_number(const char *arg, long *out)
+{
+    char *end;
+
+    *out = strtol(arg, &end, 0);
+    return (*arg == '\0' || *end != '\0') ? -1 : 0;
+}
+
+/*
+ * Adds the stop described by "<kind> [arg]" in argv
+ *
+ * Returns the new stop, NULL on a bad description
+ */
+static APEX_Stop *
+add_stop(APEX_Debugger *dbg, int argc, char **argv, int watch, int temporary)
+{
+    APEX_Stop stop = {0};
+    APEX_Stop *slot = NULL;
+    long num = 0;
+    int kind;
+
+    if (argc < 1)
+    {
+        printf("Missing stop kind, see \"help\"\n");
+        return NULL;
+    }
+    for (kind = 0; kind <= STOP_IQ_FULL; kind++)
+    {
+        if (strcmp(argv[0], stop_names[kind]) == 0)
+        {
+            break;
+        }
+    }
+    if (kind > STOP_IQ_FULL || watch != (kind == STOP_MEM || kind == STOP_REG))
+    {
+        printf("Unknown %s kind \"%s\", see \"help\"\n", watch ? "watch" : "break", argv[0]);
+        return NULL;
+    }
+
+    if (kind != STOP_ROB_FULL && kind != STOP_IQ_FULL)
+    {
+        if (argc < 2)
+        {
+            printf("Missing argument for %s\n", stop_names[kind]);
+            return NULL;
+        }
+        if (kind == STOP_REG)
+        {
+            num = parse_reg(argv[1]);
+        }
+        else if (parse_number(argv[1], &num) < 0)
+        {
+            num = -1;
+        }
+    }
+
+    switch (kind)
+    {
+    case STOP_COMMIT_PC:
+    case STOP_FETCH_PC:
+        if (num < 4000 || num % 4 || (num - 4000) / 4 >= dbg->cpu->code_memory_size)
+        {
+            printf("No instruction at pc %s\n", argv[1]);
+            return NULL;
+        }
+        break;
+    case STOP_CYCLE:
+        if (num <= dbg->cpu->clock)
+        {
+            printf("Cycle %s is not ahead of cycle %d\n", argv[1], dbg->cpu->clock);
+            return NULL;
+        }
+        break;
+    case STOP_MEM:
+        if (num < 0 || num >= DATA_MEMORY_SIZE)
+        {
+            printf("Address %s is outside data memory\n", argv[1]);
+            return NULL;
+        }
+        break;
+    case STOP_REG:
+        if (num < 0)
+        {
+            printf("Invalid register %s\n", argv[1]);
+            return NULL;
+        }
+        break;
+    }
+
+    for (int i = 0; i < DEBUG_MAX_STOPS; i++)
+    {
+        if (!dbg->stops[i].id)
+        {
+            slot = &dbg->stops[i];
+            break;
+        }
+    }
+    if (!slot)
+    {
+        printf("Too many breakpoints, at most %d\n", DEBUG_MAX_STOPS);
+        return NULL;
+    }
+
+    stop.id = ++dbg->next_id;
+    stop.kind = kind;
+    stop.arg = (int)num;
+    stop.temporary = temporary;
+    stop.last = stop_value(dbg, &stop);
+    *slot = stop;
+    update_pc_tables(dbg);
+    return slot;
+}
+
+static void
+delete_stop(APEX_Debugger *dbg, APEX_Stop *stop)
+{
+    stop->id = 0;
+    update_pc_tables(dbg);
+}
+
+static void
+describe_stop(const APEX_Stop *stop)
+{
+    switch (stop->kind)
+    {
+    case STOP_COMMIT_PC:
+    case STOP_FETCH_PC:
+        printf("%s pc %d", stop_names[stop->kind], stop->arg);
+        break;
+    case STOP_CYCLE:
+        printf("cycle %d", stop->arg);
+        break;
+    case STOP_MEM:
+        printf("MEM[%d]", stop->arg);
+        break;
+    case STOP_REG:
+        printf("R%d", stop->arg);
+        break;
+    default:
+        printf("%s", stop_names[stop->kind]);
+        break;
+    }
+}
+
+static void
+print_status(const APEX_CPU *cpu)
+{
+    int rob = (cpu->rob_tail - cpu->rob_head + ROB_SIZE(cpu)) % ROB_SIZE(cpu);
+    int iq = 0;
+
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        iq += cpu->freeiq[i] == 1;
+    }
+    printf("Cycle %d: next fetch pc %d, committed %d, rob %d/%d, iq %d/%d\n", cpu->clock, cpu->pc,
+           cpu->insn_completed, rob, ROB_SIZE(cpu), iq, IQ_SIZE(cpu));
+}
+
+/*
+ * Reports every stop which fired in the cycle just simulated and refreshes
+ * the watched values
+ *
+ * Returns the number of stops which fired
+ */
+static int
+check_stops(APEX_Debugger *dbg)
+{
+    APEX_CPU *cpu = dbg->cpu;
+    int fired = 0;
+
+    for (int i = 0; i < DEBUG_MAX_STOPS; i++)
+    {
+        APEX_Stop *stop = &dbg->stops[i];
+        int hit = FALSE;
+        int value;
+
+        if (!stop->id)
+        {
+            continue;
+        }
+        switch (stop->kind)
+        {
+        case STOP_COMMIT_PC:
+            hit = cpu->commit_break_pc == stop->arg;
+            break;
+        case STOP_FETCH_PC:
+            hit = cpu->fetch_break_pc == stop->arg;
+            break;
+        case STOP_CYCLE:
+            hit = cpu->clock == stop->arg;
+            break;
+        default:
+            /* Watchpoints fire on a change, conditions when they become true */
+            value = stop_value(dbg, stop);
+            hit = value != stop->last && (stop->kind == STOP_MEM || stop->kind == STOP_REG || value);
+            if (hit && (stop->kind == STOP_MEM || stop->kind == STOP_REG))
+            {
+                printf("Watchpoint %d: ", stop->id);
+                describe_stop(stop);
+                printf(" changed %d -> %d\n", stop->last, value);
+            }
+            stop->last = value;
+            break;
+        }
+        if (!hit)
+        {
+            continue;
+        }
+        if (stop->kind != STOP_MEM && stop->kind != STOP_REG)
+        {
+            printf("Breakpoint %d: ", stop->id);
+            describe_stop(stop);
+            printf("\n");
+        }
+        fired++;
+        if (stop->temporary || stop->kind == STOP_CYCLE)
+        {
+            delete_stop(dbg, stop);
+        }
+    }
+    return fired;
+}
+
+/*
+ * Runs up to limit cycles, a negative limit runs until a stop fires or HALT
+ * commits
+ */
+static void
+run_cycles(APEX_Debugger *dbg, long limit)
+{
+    APEX_CPU *cpu = dbg->cpu;
+    int fired = 0;
+
+    if (dbg->halted)
+    {
+        printf("The program has halted\n");
+        return;
+    }
+    while (limit < 0 || limit-- > 0)
+    {
+        cpu->commit_break_pc = -1;
+        cpu->fetch_break_pc = -1;
+        if (APEX_cpu_cycle(cpu))
+        {
+            dbg->halted = TRUE;
+        }
+        APEX_snapshot_take(&dbg->snaps, cpu);
+        fired = check_stops(dbg);
+        if (dbg->halted || fired)
+        {
+            break;
+        }
+    }
+    print_status(cpu);
+    if (dbg->halted)
+    {
+        printf("APEX_CPU: Simulation Complete, cycles = %d instructions = %d\n", cpu->clock,
+               cpu->insn_completed);
+        APEX_config_print(&cpu->config);
+    }
+}
+
+/*
+ * Moves the CPU to the end of cycle target, or to HALT if it commits first
+ *
+ * Going back restores the newest snapshot before target, then cycles are
+ * replayed without checking stops. Watched values are refreshed afterwards so
+ * the jump itself does not fire watchpoints.
+ */
+static void
+travel_to(APEX_Debugger *dbg, long target)
+{
+    APEX_CPU *cpu = dbg->cpu;
+    int from = cpu->clock;
+    int start;
+
+    if (target < 0)
+    {
+        target = 0;
+    }
+    if (target < cpu->clock)
+    {
+        if ((start = APEX_snapshot_restore(&dbg->snaps, cpu, (int)target)) < 0)
+        {
+            printf("No snapshot before cycle %ld\n", target);
+            return;
+        }
+        dbg->halted = FALSE;
+        from = start;
+    }
+    else if (dbg->halted)
+    {
+        printf("The program has halted\n");
+        return;
+    }
+
+    while (cpu->clock < target && !dbg->halted)
+    {
+        if (APEX_cpu_cycle(cpu))
+        {
+            dbg->halted = TRUE;
+        }
+        APEX_snapshot_take(&dbg->snaps, cpu);
+    }
+    for (int i = 0; i < DEBUG_MAX_STOPS; i++)
+    {
+        dbg->stops[i].last = stop_value(dbg, &dbg->stops[i]);
+    }
+    cpu->commit_break_pc = -1;
+    cpu->fetch_break_pc = -1;
+
+    if (from != cpu->clock)
+    {
+        printf("Replayed %d cycles from cycle %d\n", cpu->clock - from, from);
+    }
+    print_status(cpu);
+    if (dbg->halted)
+    {
+        printf("APEX_CPU: Simulation Complete, cycles = %d instructions = %d\n", cpu->clock,
+               cpu->insn_completed);
+    }
+}
+
+static void
+print_stage(const char *name, int has_insn, int pc)
+{
+    if (has_insn)
+    {
+        printf("  %-8s pc %d\n", name, pc);
+    }
+    else
+    {
+        printf("  %-8s empty\n", name);
+    }
+}
+
+static void
+print_pipeline(const APEX_CPU *cpu)
+{
+    char name[16];
+
+    print_stage("decode", cpu->decode.has_insn, cpu->decode.pc);
+    for (int lane = 0; lane < INTFU_COUNT(cpu); lane++)
+    {
+        snprintf(name, sizeof(name), "intfu%d", lane);
+        print_stage(name, cpu->intfu[lane].has_insn, cpu->intfu[lane].iq_entry.pc);
+    }
+    for (int lane = 0; lane < MULFU_COUNT(cpu); lane++)
+    {
+        snprintf(name, sizeof(name), "mul1.%d", lane);
+        print_stage(name, cpu->mul1[lane].has_insn, cpu->mul1[lane].iq_entry.pc);
+        snprintf(name, sizeof(name), "mul2.%d", lane);
+        print_stage(name, cpu->mul2[lane].has_insn, cpu->mul2[lane].iq_entry.pc);
+        snprintf(name, sizeof(name), "mul3.%d", lane);
+        print_stage(name, cpu->mul3[lane].has_insn, cpu->mul3[lane].iq_entry.pc);
+    }
+    print_stage("jbu1", cpu->jbu1.has_insn, cpu->jbu1.iq_entry.pc);
+    print_stage("jbu2", cpu->jbu2.has_insn, cpu->jbu2.iq_entry.pc);
+    print_stage("memory1", cpu->memory1.has_insn, cpu->memory1.has_insn ? cpu->memory1.rob_entry->pc : 0);
+    print_stage("memory2", cpu->memory2.has_insn, cpu->memory2.has_insn ? cpu->memory2.rob_entry->pc : 0);
+}
+
+static void
+print_iq(const APEX_CPU *cpu)
+{
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        const IQ_ENTRY *iqe = &cpu->IssueQueue[i];
+
+        if (cpu->freeiq[i] == 1)
+        {
+            printf("  IQ[%d] pc %d P%d <- P%d P%d\n", i, iqe->pc, iqe->des_phy_reg, iqe->src1, iqe->src2);
+        }
+    }
+}
+
+static void
+print_command(APEX_Debugger *dbg, int argc, char **argv)
+{
+    APEX_CPU *cpu = dbg->cpu;
+    long addr, count = 1;
+    int reg;
+
+    if (argc < 1)
+    {
+        print_status(cpu);
+    }
+    else if (strcmp(argv[0], "rob") == 0)
+    {
+        APEX_cpu_print_state(cpu, APEX_PRINT_ROB);
+    }
+    else if (strcmp(argv[0], "rat") == 0)
+    {
+        APEX_cpu_print_state(cpu, APEX_PRINT_RAT);
+    }
+    else if (strcmp(argv[0], "prf") == 0)
+    {
+        APEX_cpu_print_state(cpu, APEX_PRINT_PRF);
+    }
+    else if (strcmp(argv[0], "iq") == 0)
+    {
+        print_iq(cpu);
+    }
+    else if (strcmp(argv[0], "pipeline") == 0)
+    {
+        print_pipeline(cpu);
+    }
+    else if (strcmp(argv[0], "mem") == 0)
+    {
+        if (argc < 2 || parse_number(argv[1], &addr) < 0 || (argc > 2 && parse_number(argv[2], &count) < 0) ||
+            addr < 0 || count < 1 || addr + count > DATA_MEMORY_SIZE)
+        {
+            printf("Usage: print mem <addr> [count], within [0, %d)\n", DATA_MEMORY_SIZE);
+            return;
+        }
+        for (long i = addr; i < addr + count; i++)
+        {
+            printf("  MEM[%ld] = %d\n", i, cpu->data_memory[i]);
+        }
+    }
+    else if (strcmp(argv[0], "reg") == 0)
+    {
+        if (argc > 1)
+        {
+            if ((reg = parse_reg(argv[1])) < 0)
+            {
+                printf("Invalid register %s\n", argv[1]);
+                return;
+            }
+            printf("  R%d = %d\n", reg, APEX_cpu_arch_reg(cpu, reg));
+            return;
+        }
+        for (reg = 0; reg < REG_FILE_SIZE; reg++)
+        {
+            printf("  R%-2d = %-10d%s", reg, APEX_cpu_arch_reg(cpu, reg), reg % 4 == 3 ? "\n" : "");
+        }
+    }
+    else
+    {
+        printf("Unknown print target \"%s\", see \"help\"\n", argv[0]);
+    }
+}
+
+static void
+info_command(const APEX_Debugger *dbg)
+{
+    int any = FALSE;
+
+    for (int i = 0; i < DEBUG_MAX_STOPS; i++)
+    {
+        const APEX_Stop *stop = &dbg->stops[i];
+
+        if (stop->id)
+        {
+            printf("  %-3d %-10s ", stop->id,
+                   (stop->kind == STOP_MEM || stop->kind == STOP_REG) ? "watch" : "break");
+            describe_stop(stop);
+            printf("%s\n", stop->temporary ? " (once)" : "");
+            any = TRUE;
+        }
+    }
+    if (!any)
+    {
+        printf("No breakpoints or watchpoints\n");
+    }
+    printf("Snapshots: %d, every %d cycles, %zu bytes\n", dbg->snaps.count, dbg->snaps.interval,
+           dbg->snaps.bytes);
+}
+
+/*
+ * Executes one command line
+ *
+ * Returns FALSE on quit, TRUE otherwise
+ */
+static int
+execute(APEX_Debugger *dbg, char *line)
+{
+    char *argv[DEBUG_MAX_ARGS];
+    int argc = 0;
+    char *tok;
+    APEX_Stop *stop;
+    long num;
+
+    for (tok = strtok(line, " \t\r\n"); tok && argc < DEBUG_MAX_ARGS; tok = strtok(NULL, " \t\r\n"))
+    {
+        argv[argc++] = tok;
+    }
+    if (argc == 0 || argv[0][0] == '#')
+    {
+        return TRUE;
+    }
+
+    if (strcmp(argv[0], "quit") == 0 || strcmp(argv[0], "q") == 0)
+    {
+        return FALSE;
+    }
+    else if (strcmp(argv[0], "help") == 0)
+    {
+        print_help();
+    }
+    else if (strcmp(argv[0], "break") == 0 || strcmp(argv[0], "b") == 0 || strcmp(argv[0], "watch") == 0)
+    {
+        if ((stop = add_stop(dbg, argc - 1, argv + 1, argv[0][0] == 'w', FALSE)))
+        {
+            printf("%s %d: ", stop->kind == STOP_MEM || stop->kind == STOP_REG ? "Watchpoint" : "Breakpoint",
+                   stop->id);
+            describe_stop(stop);
+            printf("\n");
+        }
+    }
+    else if (strcmp(argv[0], "until") == 0)
+    {
+        int watch = argc > 1 && (strcmp(argv[1], "mem") == 0 || strcmp(argv[1], "reg") == 0);
+
+        if (add_stop(dbg, argc - 1, argv + 1, watch, TRUE))
+        {
+            run_cycles(dbg, -1);
+        }
+    }
+    else if (strcmp(argv[0], "delete") == 0)
+    {
+        if (argc < 2)
+        {
+            for (int i = 0; i < DEBUG_MAX_STOPS; i++)
+            {
+                dbg->stops[i].id = 0;
+            }
+            update_pc_tables(dbg);
+            return TRUE;
+        }
+        if (parse_number(argv[1], &num) == 0)
+        {
+            for (int i = 0; i < DEBUG_MAX_STOPS; i++)
+            {
+                if (dbg->stops[i].id && dbg->stops[i].id == num)
+                {
+                    delete_stop(dbg, &dbg->stops[i]);
+                    return TRUE;
+                }
+            }
+        }
+        printf("No breakpoint %s\n", argv[1]);
+    }
+    else if (strcmp(argv[0], "info") == 0)
+    {
+        info_command(dbg);
+    }
+    else if (strcmp(argv[0], "run") == 0 || strcmp(argv[0], "continue") == 0 || strcmp(argv[0], "c") == 0)
+    {
+        run_cycles(dbg, -1);
+    }
+    else if (strcmp(argv[0], "step") == 0 || strcmp(argv[0], "s") == 0)
+    {
+        num = 1;
+        if (argc > 1 && (parse_number(argv[1], &num) < 0 || num < 1))
+        {
+            printf("Usage: step [cycles]\n");
+            return TRUE;
+        }
+        run_cycles(dbg, num);
+    }
+    else if (strcmp(argv[0], "reverse-step") == 0 || strcmp(argv[0], "rs") == 0)
+    {
+        num = 1;
+        if (argc > 1 && (parse_number(argv[1], &num) < 0 || num < 1))
+        {
+            printf("Usage: reverse-step [cycles]\n");
+            return TRUE;
+        }
+        travel_to(dbg, dbg->cpu->clock - num);
+    }
+    else if (strcmp(argv[0], "goto") == 0)
+    {
+        int arg = argc > 2 && strcmp(argv[1], "cycle") == 0 ? 2 : 1;
+
+        if (argc <= arg || parse_number(argv[arg], &num) < 0 || num < 0)
+        {
+            printf("Usage: goto [cycle] <n>\n");
+            return TRUE;
+        }
+        travel_to(dbg, num);
+    }
+    else if (strcmp(argv[0], "print") == 0 || strcmp(argv[0], "p") == 0)
+    {
+        print_command(dbg, argc - 1, argv + 1);
+    }
+    else
+    {
+        printf("Unknown command \"%s\", see \"help\"\n", argv[0]);
+    }
+    return TRUE;
+}
+
+/*
+ * Reads debugger commands from in until "quit" or end of input
+ *
+ * A prompt is shown only when in is a terminal, so command files can be
+ * piped in
+ */
+void
+APEX_debug_run(APEX_CPU *cpu, FILE *in, int snapshot_interval)
+{
+    APEX_Debugger dbg;
+    char line[256];
+    int prompt = isatty(fileno(in));
+
+    memset(&dbg, 0, sizeof(dbg));
+    dbg.cpu = cpu;
+    dbg.commit_breaks = calloc(cpu->code_memory_size + 1, 1);
+    dbg.fetch_breaks = calloc(cpu->code_memory_size + 1, 1);
+    if (!dbg.commit_breaks || !dbg.fetch_breaks)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate debugger tables\n");
+        free(dbg.commit_breaks);
+        free(dbg.fetch_breaks);
+        return;
+    }
+    if (APEX_snapshots_init(&dbg.snaps, snapshot_interval) < 0 || APEX_snapshot_take(&dbg.snaps, cpu) < 0)
+    {
+        APEX_snapshots_free(&dbg.snaps);
+        free(dbg.commit_breaks);
+        free(dbg.fetch_breaks);
+        return;
+    }
+
+    /* Nothing is printed between stops */
+    ENABLE_DEBUG_MESSAGES = FALSE;
+    if (prompt)
+    {
+        printf("Type \"help\" for the list of commands\n");
+    }
+    while (TRUE)
+    {
+        if (prompt)
+        {
+            printf("(apex) ");
+            fflush(stdout);
+        }
+        if (!fgets(line, sizeof(line), in) || !execute(&dbg, line))
+        {
+            break;
+        }
+    }
+
+    cpu->commit_breaks = NULL;
+    cpu->fetch_breaks = NULL;
+    APEX_snapshots_free(&dbg.snaps);
+    free(dbg.commit_breaks);
+    free(dbg.fetch_breaks);
+}
@@ -0,0 +1,54 @@
+/*
+ * apex_debug.h
+ * Contains the command interface of the APEX simulator debugger
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_DEBUG_H_
+#define _APEX_DEBUG_H_
+
+#include <stdio.h>
+
+#include "apex_cpu.h"
+#include "apex_snapshot.h"
+
+/* Most breakpoints and watchpoints alive at the same time */
+#define DEBUG_MAX_STOPS 64
+
+/* Kinds of stop conditions */
+enum
+{
+    STOP_COMMIT_PC, /* Instruction at PC commits */
+    STOP_FETCH_PC,  /* Instruction at PC leaves fetch */
+    STOP_CYCLE,     /* Clock reaches a cycle */
+    STOP_MEM,       /* Data memory word changes */
+    STOP_REG,       /* Committed architectural register changes */
+    STOP_ROB_FULL,  /* ROB becomes full */
+    STOP_IQ_FULL    /* Issue queue becomes full */
+};
+
+/* One breakpoint or watchpoint */
+typedef struct APEX_Stop
+{
+    int id;        /* Number shown by "info", 0 for a free slot */
+    int kind;      /* One of STOP_* */
+    int arg;       /* PC, cycle, memory address or register */
+    int last;      /* Watched value or condition seen after the last cycle */
+    int temporary; /* Deleted once it fires, set by "until" */
+} APEX_Stop;
+
+typedef struct APEX_Debugger
+{
+    APEX_CPU *cpu;
+    APEX_Stop stops[DEBUG_MAX_STOPS];
+    int next_id;
+    int halted;                   /* HALT has committed */
+    unsigned char *commit_breaks; /* Per code memory index, shared with cpu */
+    unsigned char *fetch_breaks;
+    APEX_Snapshots snaps;         /* Periodic CPU state for reverse execution */
+} APEX_Debugger;
+
+void APEX_debug_run(APEX_CPU *cpu, FILE *in, int snapshot_interval);
+#endif
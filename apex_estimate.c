@@ -0,0 +1,688 @@
+/*
+ * apex_estimate.c
+ * Contains the analytical performance estimator and its validation
+ *
+ * One functional pass over a program collects its workload, which a
+ * prediction for any machine then only weighs. Fetch stops behind every
+ * load until it issues and behind every branch and jump until it resolves,
+ * and none of them issues before everything older has, so these stalls cut
+ * the run into segments timed one after the other:
+ *
+ *   - decode dispatches one instruction of a segment per cycle
+ *   - the stall ending it waits on the longest chain of results and busy
+ *     units within it, an integer result being ready intfu-latency + 1
+ *     cycles after its producer issued, a product mul-latency + 1 and a
+ *     load mem-latency + 1, an integer unit busy for its latency, MUL1 for
+ *     mul-latency - 2 cycles and MEM1 for max(2, mem-latency - 1) behind a
+ *     load and mem-latency - 1 behind a store
+ *   - fetch goes on a fixed penalty after the stalling instruction issues
+ *   - results are only read once committed, in order, so a value is ready
+ *     no earlier than every older result: a long latency instruction at the
+ *     head of the ROB holds up everything younger which reads a register
+ *   - a taken branch or a jump has its target fetched in JBU2, a cycle
+ *     early, but decoded only once it commits, behind all older results
+ *
+ * The profile records each stall as the steps of the chain it waits on and
+ * how many instructions before it the chain begins, so a machine with other
+ * latencies only prices the same steps differently. Between the stalls the
+ * longest chain within windows of 2 to 256 instructions, against the window
+ * the ROB, the IQ and the free physical registers allow, and the load on
+ * each unit bound the run from below. The estimate command checks the
+ * predictions against the detailed model on every kernel and configuration
+ * it is given.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "apex_config.h"
+#include "apex_cpu.h"
+#include "apex_estimate.h"
+#include "apex_explore.h"
+#include "apex_macros.h"
+#include "apex_oracle.h"
+#include "apex_schedule.h"
+
+/* Longest dependence chain of the current window of one size */
+typedef struct Chains
+{
+    int size;                                /* Instructions per window */
+    int filled;                              /* Instructions in the current window */
+    int depth[SCHEDULE_FLAG + 1];            /* Chain ending in each register and the flag */
+    int path[SCHEDULE_FLAG + 1][EST_LOAD + 1];
+    int best;
+    int best_path[EST_LOAD + 1];
+    long windows;
+    double sum[EST_LOAD + 1];
+} Chains;
+
+/* Dependence chain a value or a unit waits on, timed from the last fetch stall */
+typedef struct Link
+{
+    double ready;              /* Cycle it is ready at the default latencies, 0 if it already is */
+    int head;                  /* Position of the instruction heading it, the first after the stall is 0 */
+    int chain[STEPS];
+} Link;
+
+/* Instructions since the last fetch stall */
+typedef struct Segment
+{
+    double cost[STEPS];            /* Of each step on the default machine */
+    int pos;
+    Link value[SCHEDULE_FLAG + 1]; /* Of each register and the flag */
+    Link unit[EST_LOAD + 1];       /* Of the integer units, the multipliers and MEM1 going idle */
+    Link issue;                    /* Latest an instruction of the segment may issue, stalls wait for it */
+    Link commit;                   /* Commit of the youngest instruction, no result is read before */
+} Segment;
+
+static int
+classify(int opcode)
+{
+    switch (opcode)
+    {
+    case OPCODE_MUL:
+    {
+        return EST_MUL;
+    }
+    case OPCODE_LOAD:
+    case OPCODE_LDR:
+    {
+        return EST_LOAD;
+    }
+    case OPCODE_STORE:
+    case OPCODE_STR:
+    {
+        return EST_STORE;
+    }
+    case OPCODE_BZ:
+    case OPCODE_BNZ:
+    {
+        return EST_BRANCH;
+    }
+    case OPCODE_JUMP:
+    case OPCODE_JAL:
+    {
+        return EST_JUMP;
+    }
+    case OPCODE_HALT:
+    case OPCODE_NOP:
+    {
+        return EST_OTHER;
+    }
+    }
+    return EST_INT;
+}
+
+static int
+penalty(int cls)
+{
+    return cls == EST_LOAD ? ESTIMATE_LOAD_PENALTY : cls == EST_BRANCH ? ESTIMATE_BRANCH_PENALTY : ESTIMATE_JUMP_PENALTY;
+}
+
+/* Cycles each step of a chain takes on the machine of config */
+static void
+step_costs(const APEX_Config *config, double *cost)
+{
+    cost[STEP_INT] = config->intfu_latency + 1;
+    cost[STEP_MUL] = config->mul_latency + 1;
+    cost[STEP_LOAD] = config->mem_latency + 1;
+    cost[STEP_INT_UNIT] = (double)config->intfu_latency / config->intfu_count;
+    cost[STEP_MUL_UNIT] = (double)(config->mul_latency > 3 ? config->mul_latency - 2 : 1) / config->mulfu_count;
+    cost[STEP_LOAD_UNIT] = config->mem_latency > 3 ? config->mem_latency - 1 : 2;
+    cost[STEP_STORE_UNIT] = config->mem_latency - 1;
+}
+
+/* Extends the chains of window c by ins of class cls */
+static void
+chain_step(Chains *c, const APEX_Instruction *ins, int cls)
+{
+    unsigned reads, writes;
+    int from = -1, depth = 0;
+
+    APEX_schedule_resources(ins, &reads, &writes);
+    for (int r = 0; r <= SCHEDULE_FLAG; r++)
+    {
+        if ((reads & (1U << r)) && c->depth[r] > depth)
+        {
+            depth = c->depth[r];
+            from = r;
+        }
+    }
+    for (int r = 0; r <= SCHEDULE_FLAG; r++)
+    {
+        if (!(writes & (1U << r)))
+        {
+            continue;
+        }
+        if (from >= 0)
+        {
+            memcpy(c->path[r], c->path[from], sizeof(c->path[r]));
+        }
+        else
+        {
+            memset(c->path[r], 0, sizeof(c->path[r]));
+        }
+        c->depth[r] = depth;
+        if (cls <= EST_LOAD)
+        {
+            c->path[r][cls]++;
+            c->depth[r]++;
+        }
+        if (c->depth[r] > c->best)
+        {
+            c->best = c->depth[r];
+            memcpy(c->best_path, c->path[r], sizeof(c->best_path));
+        }
+    }
+    if (++c->filled == c->size)
+    {
+        for (int k = 0; k <= EST_LOAD; k++)
+        {
+            c->sum[k] += c->best_path[k];
+        }
+        c->windows++;
+        memset(c->depth, 0, sizeof(c->depth));
+        c->best = c->filled = 0;
+    }
+}
+
+/*
+ * Counts a fetch stall of class cls behind chain wait at position pos, a
+ * taken one also behind the commit of everything older, chain drain
+ */
+static void
+add_stall(APEX_Workload *wl, int cls, const Link *wait, const Link *drain, int pos, int taken)
+{
+    EstimateStall key = {cls, 0, {0}, taken, 0, {0}, 1};
+    int i;
+
+    if (wait->ready > pos)
+    {
+        key.distance = pos - wait->head;
+        memcpy(key.chain, wait->chain, sizeof(key.chain));
+    }
+    if (taken && drain->ready > pos)
+    {
+        key.drain_distance = pos - drain->head;
+        memcpy(key.drain, drain->chain, sizeof(key.drain));
+    }
+    for (i = 0; i < wl->stalls; i++)
+    {
+        EstimateStall *s = &wl->stall[i];
+
+        if (s->cls == key.cls && s->distance == key.distance && !memcmp(s->chain, key.chain, sizeof(key.chain)) &&
+            s->taken == key.taken && s->drain_distance == key.drain_distance &&
+            !memcmp(s->drain, key.drain, sizeof(key.drain)))
+        {
+            s->count++;
+            return;
+        }
+    }
+    if (i < ESTIMATE_MAX_STALLS)
+    {
+        wl->stall[wl->stalls++] = key;
+        return;
+    }
+    wl->unlisted[cls]++;
+    wl->unlisted_taken += taken;
+}
+
+/* Link l extended by a step of kind step */
+static Link
+extend(const Segment *seg, Link l, int step)
+{
+    l.chain[step]++;
+    l.ready += seg->cost[step];
+    return l;
+}
+
+/*
+ * Times ins of class cls in segment seg, counting the fetch stall it ends
+ * the segment with, if any, taken when it is a branch which branched or a
+ * jump
+ */
+static void
+segment_step(Segment *seg, APEX_Workload *wl, const APEX_Instruction *ins, int cls, int taken)
+{
+    static const int unit_step[EST_STORE + 1] = {STEP_INT_UNIT, STEP_MUL_UNIT, STEP_LOAD_UNIT, STEP_STORE_UNIT};
+    int stall = cls == EST_LOAD || cls == EST_BRANCH || cls == EST_JUMP;
+    int unit = cls == EST_STORE ? EST_LOAD : cls;
+    unsigned reads, writes;
+    Link issue = {0.0, 0, {0}}, done;
+
+    /* It issues once its sources and a unit are ready, a stalling instruction
+     * once everything older has issued too, a branch once the integer units
+     * are idle */
+    APEX_schedule_resources(ins, &reads, &writes);
+    for (int r = 0; r <= SCHEDULE_FLAG; r++)
+    {
+        if ((reads & (1U << r)) && seg->value[r].ready > issue.ready)
+        {
+            issue = seg->value[r];
+        }
+    }
+    if (unit == EST_LOAD && seg->unit[unit].ready > issue.ready)
+    {
+        issue = seg->unit[unit];
+    }
+    if (stall && seg->issue.ready > issue.ready)
+    {
+        issue = seg->issue;
+    }
+    if (cls == EST_BRANCH && seg->unit[EST_INT].ready > issue.ready)
+    {
+        issue = seg->unit[EST_INT];
+    }
+    if (issue.ready <= seg->pos)
+    {
+        memset(&issue, 0, sizeof(issue));
+        issue.ready = issue.head = seg->pos;
+    }
+    if (issue.ready > seg->issue.ready)
+    {
+        seg->issue = issue;
+    }
+    if (cls <= EST_STORE)
+    {
+        seg->unit[unit] = extend(seg, seg->unit[unit].ready > issue.ready ? seg->unit[unit] : issue, unit_step[cls]);
+    }
+
+    /* A store leaves MEM2 as late as a load. Registers are written at
+     * commit, which goes in order, the flag as soon as it is computed */
+    done = cls <= EST_LOAD ? extend(seg, issue, cls) : cls == EST_STORE ? extend(seg, issue, STEP_LOAD) : issue;
+    if (done.ready > seg->commit.ready)
+    {
+        seg->commit = done;
+    }
+    for (int r = 0; r <= SCHEDULE_FLAG; r++)
+    {
+        if (writes & (1U << r))
+        {
+            seg->value[r] = r == SCHEDULE_FLAG ? done : seg->commit;
+        }
+    }
+    if (!stall)
+    {
+        seg->pos++;
+        return;
+    }
+
+    /* Fetch goes on a penalty after the stalling instruction issues, or
+     * decode once it commits when taken, the segment after it is timed
+     * from there. The stall prices the chain it waited on, only the rest of
+     * each chain goes on into the next segment. */
+    add_stall(wl, cls, &issue, &seg->commit, seg->pos, taken);
+    {
+        double resume = issue.ready + penalty(cls) - (taken ? ESTIMATE_TAKEN_SAVING : 0);
+        Link waited = issue;
+        Link *links[SCHEDULE_FLAG + 1 + EST_LOAD + 2];
+        int n = 0;
+
+        if (taken && seg->commit.ready > resume)
+        {
+            resume = seg->commit.ready;
+            waited = seg->commit;
+        }
+        for (int r = 0; r <= SCHEDULE_FLAG; r++)
+        {
+            links[n++] = &seg->value[r];
+        }
+        for (int k = 0; k <= EST_LOAD; k++)
+        {
+            links[n++] = &seg->unit[k];
+        }
+        links[n++] = &seg->commit;
+        for (int i = 0; i < n; i++)
+        {
+            double left = 0.0;
+
+            if (links[i]->ready <= resume)
+            {
+                memset(links[i], 0, sizeof(Link));
+                continue;
+            }
+            for (int k = 0; k < STEPS; k++)
+            {
+                links[i]->chain[k] -= waited.chain[k] < links[i]->chain[k] ? waited.chain[k] : links[i]->chain[k];
+                left += links[i]->chain[k] * seg->cost[k];
+            }
+            links[i]->ready -= resume;
+            links[i]->head = (int)(links[i]->ready - left);
+        }
+        memset(&seg->issue, 0, sizeof(Link));
+        seg->pos = 0;
+    }
+}
+
+/*
+ * Runs code functionally for at most limit instructions, from the data
+ * memory of cpu, and collects its workload into wl
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_estimate_profile(const APEX_CPU *cpu, const APEX_Instruction *code, int size, long limit, APEX_Workload *wl)
+{
+    APEX_Oracle *state = APEX_oracle_create(cpu);
+    Chains *chains = calloc(ESTIMATE_WINDOWS, sizeof(Chains));
+    Segment *seg = calloc(1, sizeof(Segment));
+    APEX_Config reference;
+    int pc = 4000;
+
+    memset(wl, 0, sizeof(APEX_Workload));
+    if (!state || !chains || !seg)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate workload profile\n");
+        APEX_oracle_free(state);
+        free(chains);
+        free(seg);
+        return -1;
+    }
+    for (int w = 0; w < ESTIMATE_WINDOWS; w++)
+    {
+        chains[w].size = 2 << w;
+    }
+    APEX_config_default(&reference);
+    step_costs(&reference, seg->cost);
+
+    while (wl->insns < limit && pc >= 4000 && pc % 4 == 0 && (pc - 4000) / 4 < size)
+    {
+        const APEX_Instruction *ins = &code[(pc - 4000) / 4];
+        int cls = classify(ins->opcode);
+        int next = ins->opcode == OPCODE_HALT ? pc : APEX_oracle_fetch(state, ins, pc);
+        int taken = cls == EST_JUMP || (cls == EST_BRANCH && next != pc + 4);
+
+        for (int w = 0; w < ESTIMATE_WINDOWS; w++)
+        {
+            chain_step(&chains[w], ins, cls);
+        }
+        segment_step(seg, wl, ins, cls, taken);
+        wl->count[cls]++;
+        wl->insns++;
+        if (ins->opcode == OPCODE_HALT)
+        {
+            break;
+        }
+        wl->taken += cls == EST_BRANCH && taken;
+        pc = next;
+    }
+
+    for (int w = 0; w < ESTIMATE_WINDOWS; w++)
+    {
+        Chains *c = &chains[w];
+        double length = c->size;
+
+        /* A run shorter than the window is one window of its length */
+        if (c->windows == 0 && c->filled)
+        {
+            for (int k = 0; k <= EST_LOAD; k++)
+            {
+                c->sum[k] = c->best_path[k];
+            }
+            c->windows = 1;
+            length = c->filled;
+        }
+        for (int k = 0; k <= EST_LOAD && c->windows; k++)
+        {
+            wl->chain[w][k] = c->sum[k] / c->windows;
+        }
+        wl->window[w] = length;
+    }
+    APEX_oracle_free(state);
+    free(chains);
+    free(seg);
+    return 0;
+}
+
+/* Predicted CPI of the workload on the machine of config */
+double
+APEX_estimate_cpi(const APEX_Workload *wl, const APEX_Config *config)
+{
+    double latency[EST_LOAD + 1] = {config->intfu_latency + 1, config->mul_latency + 1, config->mem_latency + 1};
+    double per_insn[ESTIMATE_WINDOWS], cost[STEPS];
+    double cycles, bound, pos;
+    int window = config->rob_size, w;
+
+    if (wl->insns == 0)
+    {
+        return 0.0;
+    }
+    window = config->iq_size < window ? config->iq_size : window;
+    window = config->phys_regs - REG_FILE_SIZE < window ? config->phys_regs - REG_FILE_SIZE : window;
+    window = window < 1 ? 1 : window;
+
+    /* Cycles per instruction the longest chain allows, between the measured
+     * window sizes by the logarithm of the size */
+    for (w = 0; w < ESTIMATE_WINDOWS; w++)
+    {
+        per_insn[w] = 0.0;
+        for (int k = 0; k <= EST_LOAD; k++)
+        {
+            per_insn[w] += wl->chain[w][k] * latency[k];
+        }
+        per_insn[w] /= wl->window[w] ? wl->window[w] : 1.0;
+    }
+    pos = log2(window) - 1.0;
+    pos = pos < 0.0 ? 0.0 : pos > ESTIMATE_WINDOWS - 1 ? ESTIMATE_WINDOWS - 1 : pos;
+    w = (int)pos;
+    cycles = wl->insns * (w + 1 < ESTIMATE_WINDOWS ? per_insn[w] + (pos - w) * (per_insn[w + 1] - per_insn[w])
+                                                   : per_insn[w]);
+
+    /* Dispatch goes on in order but for the fetch stalls */
+    step_costs(config, cost);
+    bound = (double)wl->insns;
+    for (int i = 0; i < wl->stalls; i++)
+    {
+        const EstimateStall *st = &wl->stall[i];
+        double wait = -st->distance, drain = -st->drain_distance;
+
+        for (int k = 0; k < STEPS; k++)
+        {
+            wait += st->chain[k] * cost[k];
+            drain += st->drain[k] * cost[k];
+        }
+        wait = (wait > 0.0 ? wait : 0.0) + penalty(st->cls);
+
+        /* A taken branch or a jump commits behind everything older */
+        if (st->taken)
+        {
+            wait -= ESTIMATE_TAKEN_SAVING;
+            wait = drain > wait ? drain : wait;
+        }
+        bound += st->count * wait;
+    }
+    bound += wl->unlisted[EST_LOAD] * (double)ESTIMATE_LOAD_PENALTY +
+             wl->unlisted[EST_BRANCH] * (double)ESTIMATE_BRANCH_PENALTY +
+             wl->unlisted[EST_JUMP] * (double)ESTIMATE_JUMP_PENALTY -
+             wl->unlisted_taken * (double)ESTIMATE_TAKEN_SAVING;
+    cycles = bound > cycles ? bound : cycles;
+
+    /* The units bound it from below too */
+    bound = (double)wl->count[EST_INT] * config->intfu_latency / config->intfu_count;
+    cycles = bound > cycles ? bound : cycles;
+    bound = (double)wl->count[EST_MUL] * (config->mul_latency > 3 ? config->mul_latency - 2 : 1) / config->mulfu_count;
+    cycles = bound > cycles ? bound : cycles;
+    bound = (double)wl->count[EST_LOAD] * (config->mem_latency > 3 ? config->mem_latency - 1 : 2) +
+            (double)wl->count[EST_STORE] * (config->mem_latency - 1);
+    cycles = bound > cycles ? bound : cycles;
+    cycles += ESTIMATE_PIPELINE_DEPTH;
+    return cycles / wl->insns;
+}
+
+static double
+seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Simulates kernel on config in detail for the instructions of wl
+ *
+ * Returns the CPI, 0 if the pipeline got stuck, -1 on failure
+ */
+static double
+detailed_cpi(APEX_CPU *sim, const ExploreKernel *kernel, const APEX_Options *opts, const APEX_Config *config,
+             const APEX_Workload *wl)
+{
+    APEX_Options run = *opts;
+    int halted = FALSE;
+
+    run.config = *config;
+    if (APEX_cpu_reset(sim, kernel->code, kernel->size, &run) < 0)
+    {
+        return -1.0;
+    }
+    while (sim->insn_completed < wl->insns && sim->clock < wl->insns * ESTIMATE_MAX_CPI && !halted)
+    {
+        halted = APEX_cpu_cycle(sim);
+    }
+    APEX_oracle_free(sim->oracle);
+    sim->oracle = NULL;
+    if (!halted && sim->insn_completed < wl->insns)
+    {
+        return 0.0;
+    }
+    return sim->insn_completed ? (double)sim->clock / sim->insn_completed : -1.0;
+}
+
+/*
+ * Profiles the program of cpu and the --kernels programs for at most steps
+ * instructions each, then predicts their CPI on the configured machine, or
+ * on every machine of --space, and compares with the detailed model
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_estimate_run(APEX_CPU *cpu, const APEX_Options *opts, const char *program, const char *steps)
+{
+    ExploreParam params[EXPLORE_MAX_PARAMS];
+    ExploreKernel kernels[EXPLORE_MAX_KERNELS];
+    ExploreCandidate *cands = NULL;
+    APEX_CPU *sim = malloc(sizeof(APEX_CPU));
+    APEX_Workload wl;
+    double estimate_time = 0.0, detailed_time = 0.0, profile_time = 0.0;
+    double abs_error = 0.0, bias = 0.0, worst = 0.0;
+    long limit = atol(steps);
+    int nparams, nkernels, ncands = 1, runs = 0, stuck = 0;
+    int ret = -1;
+
+    if (!sim)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate CPU\n");
+        return -1;
+    }
+    if (limit <= 0)
+    {
+        fprintf(stderr, "APEX_Error: Invalid instruction count %s\n", steps);
+        free(sim);
+        return -1;
+    }
+    if (opts->config.oracles)
+    {
+        fprintf(stderr, "APEX_Error: The estimator models the real machine, --oracle cannot be combined with it\n");
+        free(sim);
+        return -1;
+    }
+    if ((nkernels = APEX_explore_read_kernels(cpu, program, opts->kernel_file, kernels)) < 0)
+    {
+        APEX_explore_free_kernels(kernels, -nkernels - 1);
+        free(sim);
+        return -1;
+    }
+    if (opts->space_file)
+    {
+        if ((nparams = APEX_explore_space(opts, params)) < 0 ||
+            (ncands = APEX_explore_enumerate(params, nparams, &opts->config, &cands)) < 0)
+        {
+            goto out;
+        }
+    }
+    else if ((cands = calloc(1, sizeof(ExploreCandidate))))
+    {
+        cands[0].config = opts->config;
+    }
+    if (!cands)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate configurations\n");
+        goto out;
+    }
+
+    ENABLE_DEBUG_MESSAGES = FALSE;
+    printf("%-24s %-32s %9s %9s %8s\n", "Kernel", "Configuration", "Estimate", "Detailed", "Error");
+    for (int k = 0; k < nkernels; k++)
+    {
+        double start = seconds();
+
+        if (APEX_estimate_profile(cpu, kernels[k].code, kernels[k].size, limit, &wl) < 0)
+        {
+            goto out;
+        }
+        profile_time += seconds() - start;
+        printf("APEX_Estimate: %s, %ld instructions, %.1f%% memory, %.1f%% BZ/BNZ of which %.1f%% taken, %d kinds of stall\n",
+               kernels[k].name, wl.insns, 100.0 * (wl.count[EST_LOAD] + wl.count[EST_STORE]) / wl.insns,
+               100.0 * wl.count[EST_BRANCH] / wl.insns,
+               wl.count[EST_BRANCH] ? 100.0 * wl.taken / wl.count[EST_BRANCH] : 0.0, wl.stalls);
+        for (int c = 0; c < ncands; c++)
+        {
+            const APEX_Config *config = &cands[c].config;
+            char label[64];
+            double estimate, detailed, error;
+
+            start = seconds();
+            estimate = APEX_estimate_cpi(&wl, config);
+            estimate_time += seconds() - start;
+            start = seconds();
+            detailed = detailed_cpi(sim, &kernels[k], opts, config, &wl);
+            detailed_time += seconds() - start;
+            if (detailed < 0.0)
+            {
+                fprintf(stderr, "APEX_Error: Detailed run of %s failed\n", kernels[k].name);
+                goto out;
+            }
+            snprintf(label, sizeof(label), "rob=%d iq=%d prf=%d int=%dx%d mul=%dx%d mem=%d", config->rob_size,
+                     config->iq_size, config->phys_regs, config->intfu_count, config->intfu_latency,
+                     config->mulfu_count, config->mul_latency, config->mem_latency);
+
+            /* A pipeline which stopped retiring says nothing of the estimate */
+            if (detailed == 0.0)
+            {
+                printf("%-24s %-32s %9.3f %9s %8s\n", kernels[k].name, label, estimate, "stuck", "-");
+                stuck++;
+                continue;
+            }
+            error = 100.0 * (estimate - detailed) / detailed;
+            abs_error += fabs(error);
+            bias += error;
+            worst = fabs(error) > fabs(worst) ? error : worst;
+            runs++;
+            printf("%-24s %-32s %9.3f %9.3f %+7.1f%%\n", kernels[k].name, label, estimate, detailed, error);
+        }
+    }
+    if (runs)
+    {
+        printf("APEX_Estimate: %d predictions, mean absolute error %.1f%%, bias %+.1f%%, worst %+.1f%%\n", runs,
+               abs_error / runs, bias / runs, worst);
+    }
+    if (stuck)
+    {
+        printf("APEX_Estimate: %d detailed runs stopped retiring within %d cycles per instruction and are left out\n",
+               stuck, ESTIMATE_MAX_CPI);
+    }
+    printf("APEX_Estimate: %.2f us per prediction after %.1f ms of profiling, %.2f ms per detailed run\n",
+           1e6 * estimate_time / (runs + stuck), 1e3 * profile_time, 1e3 * detailed_time / (runs + stuck));
+    ret = 0;
+out:
+    free(cands);
+    free(sim);
+    APEX_explore_free_kernels(kernels, nkernels);
+    return ret;
+}
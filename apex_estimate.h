@@ -0,0 +1,107 @@
+/*
+ * apex_estimate.h
+ * Contains declarations of the analytical performance estimator, which
+ * predicts the CPI of a program on a machine configuration from one
+ * functional pass instead of a cycle by cycle simulation
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_ESTIMATE_H_
+#define _APEX_ESTIMATE_H_
+
+#include "apex_config.h"
+#include "apex_cpu.h"
+#include "apex_options.h"
+
+/* Dependence chains are measured in windows of 2, 4, ... 256 instructions */
+#define ESTIMATE_WINDOWS 8
+
+/* Distinct fetch stalls told apart, the rest only counted */
+#define ESTIMATE_MAX_STALLS 256
+
+/* Cycles fetch waits on a BZ/BNZ once its flag is ready: issue, JBU1 and JBU2 */
+#define ESTIMATE_BRANCH_PENALTY 3
+
+/* Cycles fetch waits on a JUMP or JAL once its register is ready */
+#define ESTIMATE_JUMP_PENALTY 3
+
+/* Cycles a taken branch or a jump saves over the penalty, the target is
+ * fetched in JBU2 and decoded once the branch commits */
+#define ESTIMATE_TAKEN_SAVING 1
+
+/* Cycles fetch waits on a LOAD or LDR once it may issue */
+#define ESTIMATE_LOAD_PENALTY 1
+
+/* Cycles from the fetch of the first instruction to the commit of the last */
+#define ESTIMATE_PIPELINE_DEPTH 4
+
+/* Cycles per instruction after which the detailed run of a kernel gives up */
+#define ESTIMATE_MAX_CPI 64
+
+/* Instruction classes of the workload, by the unit they occupy */
+enum
+{
+    EST_INT,     /* Integer unit: arithmetic, logic, MOVC and CMP */
+    EST_MUL,     /* Multiplier */
+    EST_LOAD,    /* Memory pipeline, with a result */
+    EST_STORE,   /* Memory pipeline, without */
+    EST_BRANCH,  /* BZ and BNZ */
+    EST_JUMP,    /* JUMP and JAL */
+    EST_OTHER,   /* HALT and NOP */
+    EST_CLASSES
+};
+
+/* Steps of a dependence chain: a result of each class, or a unit to take */
+enum
+{
+    STEP_INT,          /* Integer result, intfu-latency + 1 after issue */
+    STEP_MUL,          /* Product, mul-latency + 1 */
+    STEP_LOAD,         /* Loaded value, mem-latency + 1 */
+    STEP_INT_UNIT,     /* An integer unit busy for its latency */
+    STEP_MUL_UNIT,     /* MUL1 taken until the product moves on */
+    STEP_LOAD_UNIT,    /* MEM1 taken by a load */
+    STEP_STORE_UNIT,   /* MEM1 taken by a store */
+    STEPS
+};
+
+/*
+ * Instructions fetch stops behind, a load until it may issue and a branch or
+ * jump until it resolves, alike in what they wait for: the dependence chain
+ * which holds them up, from the instruction heading it onwards. A taken
+ * branch or a jump also holds decode until it commits, behind the chain the
+ * oldest unfinished instruction of the ROB waits on.
+ */
+typedef struct EstimateStall
+{
+    int cls;                   /* EST_LOAD, EST_BRANCH or EST_JUMP */
+    int distance;              /* Instructions from the head of the chain to the stalling one */
+    int chain[STEPS];          /* Steps of each kind of the chain */
+    int taken;                 /* Decode waits for the commit of the stalling instruction */
+    int drain_distance;        /* As distance, of the chain older instructions commit behind */
+    int drain[STEPS];
+    long count;
+} EstimateStall;
+
+/* Everything the estimator needs to know of a program, independent of the machine */
+typedef struct APEX_Workload
+{
+    long insns;
+    long count[EST_CLASSES];
+    long taken;                /* BZ/BNZ which branched */
+    int stalls;
+    EstimateStall stall[ESTIMATE_MAX_STALLS];
+    long unlisted[EST_CLASSES]; /* Stalls beyond the table, by class, costing only their penalty */
+    long unlisted_taken;       /* Of them, taken branches and jumps */
+    /* Mean number of integer, multiply and load instructions on the longest
+     * dependence chain of a window of each size, and the mean window length */
+    double chain[ESTIMATE_WINDOWS][EST_LOAD + 1];
+    double window[ESTIMATE_WINDOWS];
+} APEX_Workload;
+
+int APEX_estimate_profile(const APEX_CPU *cpu, const APEX_Instruction *code, int size, long limit,
+                          APEX_Workload *wl);
+double APEX_estimate_cpi(const APEX_Workload *wl, const APEX_Config *config);
+int APEX_estimate_run(APEX_CPU *cpu, const APEX_Options *opts, const char *program, const char *steps);
+#endif
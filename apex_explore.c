@@ -0,0 +1,529 @@
+/*
+ * apex_explore.c
+ * Contains the design-space search over machine configurations
+ *
+ * Every combination of the values of the search space is a candidate. The
+ * search runs in rounds of successive halving: each round simulates every
+ * remaining candidate on every kernel for a budget of cycles, scores it by
+ * the geometric mean of its IPC over the kernels, and keeps one candidate
+ * in eta for the next round, whose budget is eta times longer. The last
+ * round runs the full budget. Candidates are kept by Pareto front of IPC
+ * against area first and by IPC within a front, and the whole front of a
+ * round always goes on, so the search narrows towards the trade-off curve
+ * rather than towards the single fastest machine. The front of the last
+ * round is reported.
+ *
+ * A short budget scores a candidate on the start of each kernel, which is
+ * what the early rounds trade for their speed.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apex_config.h"
+#include "apex_cpu.h"
+#include "apex_explore.h"
+#include "apex_macros.h"
+#include "apex_oracle.h"
+
+/* Runs of one round shared by the worker threads, candidate by kernel */
+typedef struct ExploreJobs
+{
+    APEX_Options opts;
+    const ExploreKernel *kernels;
+    int nkernels;
+    const ExploreCandidate *cands;
+    int jobs;
+    long budget;          /* Cycles of each run */
+    double *ipc;          /* IPC of each run */
+    long cycles;          /* Cycles simulated by all runs */
+    int next;             /* First run no worker has taken */
+    int failed;
+    pthread_mutex_t lock;
+} ExploreJobs;
+
+/* Searched when no --space is given */
+static const ExploreParam default_space[] = {
+    {"rob-size", 4, {16, 32, 64, 128}},
+    {"iq-size", 4, {8, 16, 24, 32}},
+    {"phys-regs", 4, {24, 32, 48, 64}},
+    {"intfu-count", 3, {1, 2, 3}},
+    {"mulfu-count", 2, {1, 2}},
+};
+
+/*
+ * Reads the search space, one option name and its values per line, each
+ * value checked against base
+ *
+ * Returns the number of parameters, -1 on failure
+ */
+int
+APEX_explore_read_space(const char *filename, const APEX_Config *base, ExploreParam *params)
+{
+    FILE *fp = fopen(filename, "r");
+    char line[512];
+    int n = 0, lineno = 0;
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open search space %s\n", filename);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        ExploreParam *p = &params[n];
+        APEX_Config config = *base;
+        char *tok = strtok(line, " \t\r\n");
+        int *field;
+
+        lineno++;
+        if (!tok || tok[0] == '#')
+        {
+            continue;
+        }
+        if (n == EXPLORE_MAX_PARAMS || strlen(tok) >= sizeof(p->name) ||
+            !(field = APEX_options_config_field(&config, tok)))
+        {
+            fprintf(stderr, "APEX_Error: Unknown or too many parameters on line %d of %s\n", lineno, filename);
+            fclose(fp);
+            return -1;
+        }
+        strcpy(p->name, tok);
+        for (p->count = 0; (tok = strtok(NULL, " \t\r\n")); p->count++)
+        {
+            char *end;
+
+            *field = (int)strtol(tok, &end, 10);
+            if (p->count == EXPLORE_MAX_VALUES || *end != '\0' || APEX_config_check(&config) < 0)
+            {
+                fprintf(stderr, "APEX_Error: Invalid value %s on line %d of %s\n", tok, lineno, filename);
+                fclose(fp);
+                return -1;
+            }
+            p->values[p->count] = *field;
+        }
+        if (p->count == 0)
+        {
+            fprintf(stderr, "APEX_Error: No value on line %d of %s\n", lineno, filename);
+            fclose(fp);
+            return -1;
+        }
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+/*
+ * Takes the search space from --space, or the default one without it
+ *
+ * Returns the number of parameters, -1 on failure
+ */
+int
+APEX_explore_space(const APEX_Options *opts, ExploreParam *params)
+{
+    if (opts->space_file)
+    {
+        return APEX_explore_read_space(opts->space_file, &opts->config, params);
+    }
+    memcpy(params, default_space, sizeof(default_space));
+    return sizeof(default_space) / sizeof(default_space[0]);
+}
+
+/*
+ * Loads the program of cpu and the programs listed in filename, one per
+ * line, as the kernel set
+ *
+ * Returns the number of kernels, -1 - the number loaded on failure
+ */
+int
+APEX_explore_read_kernels(const APEX_CPU *cpu, const char *program, const char *filename, ExploreKernel *kernels)
+{
+    FILE *fp;
+    char line[4096];
+    int n = 1;
+
+    kernels[0].name = program;
+    kernels[0].code = cpu->code_memory;
+    kernels[0].size = cpu->code_memory_size;
+    if (!filename)
+    {
+        return n;
+    }
+    if (!(fp = fopen(filename, "r")))
+    {
+        fprintf(stderr, "APEX_Error: Unable to open kernel list %s\n", filename);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+        {
+            continue;
+        }
+        if (n == EXPLORE_MAX_KERNELS)
+        {
+            fprintf(stderr, "APEX_Error: More than %d kernels in %s\n", EXPLORE_MAX_KERNELS, filename);
+            fclose(fp);
+            return -n - 1;
+        }
+        if (!(kernels[n].name = strdup(line)) || !(kernels[n].code = create_code_memory(line, &kernels[n].size)))
+        {
+            fprintf(stderr, "APEX_Error: Unable to load kernel %s\n", line);
+            free((char *)kernels[n].name);
+            fclose(fp);
+            return -n - 1;
+        }
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+void
+APEX_explore_free_kernels(ExploreKernel *kernels, int n)
+{
+    /* The first kernel belongs to the CPU */
+    for (int i = 1; i < n; i++)
+    {
+        free((char *)kernels[i].name);
+        free(kernels[i].code);
+    }
+}
+
+/* Entries of the out-of-order structures plus the functional units */
+int
+APEX_explore_area(const APEX_Config *config)
+{
+    return config->rob_size + config->iq_size + config->phys_regs +
+           (config->intfu_count + config->mulfu_count) * EXPLORE_UNIT_AREA;
+}
+
+/*
+ * Makes a candidate of every combination of the values of params, the rest
+ * of the configuration taken from base
+ *
+ * Returns the number of candidates, -1 when there are too many
+ */
+int
+APEX_explore_enumerate(const ExploreParam *params, int nparams, const APEX_Config *base, ExploreCandidate **cands)
+{
+    int digit[EXPLORE_MAX_PARAMS] = {0};
+    long total = 1;
+
+    for (int i = 0; i < nparams; i++)
+    {
+        total *= params[i].count;
+        if (total > EXPLORE_MAX_CONFIGS)
+        {
+            fprintf(stderr, "APEX_Error: Search space holds more than %d configurations\n", EXPLORE_MAX_CONFIGS);
+            return -1;
+        }
+    }
+    if (!(*cands = calloc(total, sizeof(ExploreCandidate))))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate candidates\n");
+        return -1;
+    }
+    for (long c = 0; c < total; c++)
+    {
+        ExploreCandidate *cand = &(*cands)[c];
+
+        cand->config = *base;
+        for (int i = 0; i < nparams; i++)
+        {
+            *APEX_options_config_field(&cand->config, params[i].name) = params[i].values[digit[i]];
+        }
+        cand->area = APEX_explore_area(&cand->config);
+        /* Next combination, the last parameter changing fastest */
+        for (int i = nparams - 1; i >= 0 && ++digit[i] == params[i].count; i--)
+        {
+            digit[i] = 0;
+        }
+    }
+    return (int)total;
+}
+
+/* Simulates one candidate on one kernel for the budget of the round */
+static void
+run_job(APEX_CPU *sim, ExploreJobs *jobs, int job)
+{
+    const ExploreKernel *kernel = &jobs->kernels[job % jobs->nkernels];
+    APEX_Options opts = jobs->opts;
+
+    opts.config = jobs->cands[job / jobs->nkernels].config;
+    if (APEX_cpu_reset(sim, kernel->code, kernel->size, &opts) < 0)
+    {
+        pthread_mutex_lock(&jobs->lock);
+        jobs->failed = TRUE;
+        pthread_mutex_unlock(&jobs->lock);
+        return;
+    }
+    while (sim->clock < jobs->budget && !APEX_cpu_cycle(sim))
+    {
+    }
+    jobs->ipc[job] = sim->clock ? (double)sim->insn_completed / sim->clock : 0.0;
+    APEX_oracle_free(sim->oracle);
+    sim->oracle = NULL;
+    pthread_mutex_lock(&jobs->lock);
+    jobs->cycles += sim->clock;
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+/* Takes runs off jobs until none is left, each worker has a CPU of its own */
+static void *
+explore_worker(void *arg)
+{
+    ExploreJobs *jobs = arg;
+    APEX_CPU *sim = malloc(sizeof(APEX_CPU));
+
+    for (;;)
+    {
+        int job;
+
+        pthread_mutex_lock(&jobs->lock);
+        job = jobs->next++;
+        pthread_mutex_unlock(&jobs->lock);
+        if (job >= jobs->jobs)
+        {
+            break;
+        }
+        if (!sim)
+        {
+            pthread_mutex_lock(&jobs->lock);
+            jobs->failed = TRUE;
+            pthread_mutex_unlock(&jobs->lock);
+            continue;
+        }
+        run_job(sim, jobs, job);
+    }
+    free(sim);
+    return NULL;
+}
+
+/*
+ * Runs every run of jobs on up to threads worker threads
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int
+run_round(ExploreJobs *jobs, int threads)
+{
+    pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+    int started;
+
+    jobs->next = 0;
+    for (started = 0; workers && started < threads && started < jobs->jobs; started++)
+    {
+        if (pthread_create(&workers[started], NULL, explore_worker, jobs) != 0)
+        {
+            break;
+        }
+    }
+    /* Whatever threads started share the work */
+    if (started == 0)
+    {
+        explore_worker(jobs);
+    }
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    free(workers);
+    return jobs->failed ? -1 : 0;
+}
+
+static int
+by_area(const void *a, const void *b)
+{
+    const ExploreCandidate *x = a, *y = b;
+
+    if (x->area != y->area)
+    {
+        return x->area - y->area;
+    }
+    return (x->ipc < y->ipc) - (x->ipc > y->ipc);
+}
+
+static int
+by_rank(const void *a, const void *b)
+{
+    const ExploreCandidate *x = a, *y = b;
+
+    if (x->rank != y->rank)
+    {
+        return x->rank - y->rank;
+    }
+    return (x->ipc < y->ipc) - (x->ipc > y->ipc);
+}
+
+/*
+ * Sorts the n candidates into Pareto fronts of IPC against area, best
+ * front and highest IPC first
+ *
+ * Returns the size of the first front
+ */
+static int
+rank_fronts(ExploreCandidate *cands, int n, double *best)
+{
+    int fronts = 0, first = 0;
+
+    /* By growing area, a candidate is dominated within a front exactly when
+     * an earlier member reached at least its IPC; best[] falls from front to
+     * front, so the first front it fits in is found by bisection */
+    qsort(cands, n, sizeof(ExploreCandidate), by_area);
+    for (int i = 0; i < n; i++)
+    {
+        int lo = 0, hi = fronts;
+
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+
+            if (best[mid] < cands[i].ipc)
+            {
+                hi = mid;
+            }
+            else
+            {
+                lo = mid + 1;
+            }
+        }
+        cands[i].rank = lo;
+        best[lo] = cands[i].ipc;
+        fronts += lo == fronts;
+        first += lo == 0;
+    }
+    qsort(cands, n, sizeof(ExploreCandidate), by_rank);
+    return first;
+}
+
+/*
+ * Searches the --space configurations on the program of cpu and the
+ * --kernels programs, with a budget of cycles per run in the last round
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_explore_run(APEX_CPU *cpu, const APEX_Options *opts, const char *program, const char *cycles)
+{
+    ExploreParam params[EXPLORE_MAX_PARAMS];
+    ExploreKernel kernels[EXPLORE_MAX_KERNELS];
+    ExploreCandidate *cands = NULL;
+    ExploreJobs jobs;
+    double *best = NULL;
+    long budget = atol(cycles), runs = 0;
+    int nparams, nkernels, ncands, alive, rounds, first = 0;
+    int eta = opts->explore_eta;
+    int threads = opts->threads ? opts->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int ret = -1;
+
+    memset(&jobs, 0, sizeof(jobs));
+    if ((nparams = APEX_explore_space(opts, params)) < 0)
+    {
+        return -1;
+    }
+    if ((nkernels = APEX_explore_read_kernels(cpu, program, opts->kernel_file, kernels)) < 0)
+    {
+        APEX_explore_free_kernels(kernels, -nkernels - 1);
+        return -1;
+    }
+    if (budget < EXPLORE_MIN_CYCLES)
+    {
+        fprintf(stderr, "APEX_Error: explore needs a budget of at least %d cycles\n", EXPLORE_MIN_CYCLES);
+        goto out;
+    }
+    if ((ncands = APEX_explore_enumerate(params, nparams, &opts->config, &cands)) < 0)
+    {
+        goto out;
+    }
+    jobs.ipc = malloc(sizeof(double) * ncands * nkernels);
+    best = malloc(sizeof(double) * ncands);
+    if (!jobs.ipc || !best)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate search\n");
+        goto out;
+    }
+
+    /* Enough rounds to halve down to one candidate, as long as the first
+     * budget stays long enough to say anything */
+    rounds = 1;
+    for (long n = ncands; n > 1; n = (n + eta - 1) / eta)
+    {
+        rounds++;
+    }
+    while (rounds > 1 && budget / (long)pow(eta, rounds - 1) < EXPLORE_MIN_CYCLES)
+    {
+        rounds--;
+    }
+    printf("APEX_Explore: %d configurations, %d kernels, %d rounds keeping 1 in %d\n", ncands, nkernels, rounds, eta);
+
+    jobs.opts = *opts;
+    jobs.kernels = kernels;
+    jobs.nkernels = nkernels;
+    jobs.cands = cands;
+    pthread_mutex_init(&jobs.lock, NULL);
+    ENABLE_DEBUG_MESSAGES = FALSE;
+    alive = ncands;
+    for (int r = 0; r < rounds; r++)
+    {
+        jobs.budget = budget / (long)pow(eta, rounds - 1 - r);
+        jobs.jobs = alive * nkernels;
+        printf("APEX_Explore: round %d: %d configurations, %ld cycles per kernel\n", r + 1, alive, jobs.budget);
+        fflush(stdout);
+        if (run_round(&jobs, threads < 1 ? 1 : threads) < 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to simulate candidates\n");
+            pthread_mutex_destroy(&jobs.lock);
+            goto out;
+        }
+        runs += jobs.jobs;
+        for (int c = 0; c < alive; c++)
+        {
+            double logs = 0.0;
+
+            for (int k = 0; k < nkernels; k++)
+            {
+                logs += log(jobs.ipc[c * nkernels + k] > 0.0 ? jobs.ipc[c * nkernels + k] : 1e-9);
+            }
+            cands[c].ipc = exp(logs / nkernels);
+        }
+        first = rank_fronts(cands, alive, best);
+        if (r < rounds - 1)
+        {
+            int keep = (alive + eta - 1) / eta;
+
+            alive = keep > first ? keep : first;
+        }
+    }
+    pthread_mutex_destroy(&jobs.lock);
+
+    printf("APEX_Explore: %ld runs, %ld cycles simulated; the full grid takes %ld runs of up to %ld cycles\n", runs,
+           jobs.cycles, (long)ncands * nkernels, budget);
+    printf("APEX_Explore: Pareto front of IPC against area, %d configurations\n", first);
+    printf("%6s %7s %5s %4s %4s %7s %7s %4s\n", "Area", "IPC", "ROB", "IQ", "PRF", "IntFU", "MulFU", "Mem");
+    /* Within the front IPC falls as area falls */
+    for (int c = first - 1; c >= 0; c--)
+    {
+        const APEX_Config *config = &cands[c].config;
+
+        printf("%6d %7.3f %5d %4d %4d %5dx%d %5dx%d %4d\n", cands[c].area, cands[c].ipc, config->rob_size,
+               config->iq_size, config->phys_regs, config->intfu_count, config->intfu_latency, config->mulfu_count,
+               config->mul_latency, config->mem_latency);
+    }
+    ret = 0;
+out:
+    free(best);
+    free(jobs.ipc);
+    free(cands);
+    APEX_explore_free_kernels(kernels, nkernels);
+    return ret;
+}
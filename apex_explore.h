@@ -0,0 +1,64 @@
+/*
+ * apex_explore.h
+ * Contains declarations of the design-space search, which looks for the
+ * machine configurations trading IPC against area best over a set of
+ * kernels with successive halving
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_EXPLORE_H_
+#define _APEX_EXPLORE_H_
+
+#include "apex_cpu.h"
+#include "apex_options.h"
+
+/* Default share of the candidates of a round kept for the next is 1 / eta */
+#define EXPLORE_DEFAULT_ETA 3
+
+/* The first round runs at least this many cycles per kernel */
+#define EXPLORE_MIN_CYCLES 200
+
+/* Area of one integer unit or multiplier, in ROB, IQ or register entries */
+#define EXPLORE_UNIT_AREA 16
+
+/* Bounds of the search space */
+#define EXPLORE_MAX_PARAMS 8
+#define EXPLORE_MAX_VALUES 16
+#define EXPLORE_MAX_CONFIGS 100000
+#define EXPLORE_MAX_KERNELS 64
+
+/* One swept configuration option and the values it takes */
+typedef struct ExploreParam
+{
+    char name[32];     /* Option name without the leading dashes, as rob-size */
+    int count;
+    int values[EXPLORE_MAX_VALUES];
+} ExploreParam;
+
+/* A program of the kernel set */
+typedef struct ExploreKernel
+{
+    const char *name;
+    APEX_Instruction *code;
+    int size;
+} ExploreKernel;
+
+/* A configuration and its score in the last round it ran */
+typedef struct ExploreCandidate
+{
+    APEX_Config config;
+    int area;          /* Entries of the ROB, IQ and register file, plus the units */
+    double ipc;        /* Geometric mean over the kernels */
+    int rank;          /* Pareto front it fell in, 0 for the best */
+} ExploreCandidate;
+
+int APEX_explore_read_space(const char *filename, const APEX_Config *base, ExploreParam *params);
+int APEX_explore_space(const APEX_Options *opts, ExploreParam *params);
+int APEX_explore_read_kernels(const APEX_CPU *cpu, const char *program, const char *filename, ExploreKernel *kernels);
+void APEX_explore_free_kernels(ExploreKernel *kernels, int n);
+int APEX_explore_area(const APEX_Config *config);
+int APEX_explore_enumerate(const ExploreParam *params, int nparams, const APEX_Config *base, ExploreCandidate **cands);
+int APEX_explore_run(APEX_CPU *cpu, const APEX_Options *opts, const char *program, const char *cycles);
+#endif
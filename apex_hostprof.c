@@ -0,0 +1,89 @@
+/*
+ * apex_hostprof.c
+ * Contains the report of the host side self-profiling
+ *
+ * Stage calls are timed in time stamp counter ticks, read right before and
+ * after each call. The counter is converted into nanoseconds by comparing
+ * it against the monotonic clock over the whole profiled run, so the report
+ * needs no fixed counter frequency. The report lists where the host time of
+ * one simulated cycle goes, stage by stage, and how often the costly
+ * operations of the pipeline model happen per cycle.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifdef APEX_HOSTPROF
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "apex_hostprof.h"
+
+/* Shorter runs are stretched to this, or the counter frequency comes out wrong */
+#define HOSTPROF_MIN_CALIBRATION_NS 10000000
+
+APEX_HostProf APEX_hostprof;
+
+static const char *stage_names[HP_STAGES] = {"commit", "memory2", "memory1", "jbu2", "jbu1", "mul3",
+                                             "mul2", "mul1", "intfu", "issue", "decode", "fetch"};
+static const char *event_names[HP_EVENTS] = {"iq-scan", "strcpy", "latch-copy"};
+
+void
+APEX_hostprof_start(void)
+{
+    memset(&APEX_hostprof, 0, sizeof(APEX_hostprof));
+    clock_gettime(CLOCK_MONOTONIC, &APEX_hostprof.start);
+    APEX_hostprof.start_ticks = hostprof_ticks();
+}
+
+static uint64_t
+elapsed_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - APEX_hostprof.start.tv_sec) * 1000000000u + now.tv_nsec -
+           APEX_hostprof.start.tv_nsec;
+}
+
+/* Writes the host time per simulated cycle of every stage and the event counts to fp */
+void
+APEX_hostprof_report(FILE *fp)
+{
+    const APEX_HostProf *hp = &APEX_hostprof;
+    uint64_t ns, stages = 0;
+    double ns_per_tick, cycles = hp->cycles ? (double)hp->cycles : 1.0;
+
+    while ((ns = elapsed_ns()) < HOSTPROF_MIN_CALIBRATION_NS)
+    {
+    }
+    ns_per_tick = (double)ns / (hostprof_ticks() - hp->start_ticks);
+
+    fprintf(fp, "APEX_HostProfile: %llu cycles simulated, %.1f ns per cycle, counter at %.3f GHz\n",
+            (unsigned long long)hp->cycles, hp->cycle_ticks * ns_per_tick / cycles, 1.0 / ns_per_tick);
+    fprintf(fp, "%-10s %12s %10s %10s %8s\n", "Stage", "Calls", "ns/call", "ns/cycle", "Percent");
+    for (int i = 0; i < HP_STAGES; i++)
+    {
+        stages += hp->ticks[i];
+        fprintf(fp, "%-10s %12llu %10.1f %10.1f %7.2f%%\n", stage_names[i], (unsigned long long)hp->calls[i],
+                hp->calls[i] ? hp->ticks[i] * ns_per_tick / hp->calls[i] : 0.0, hp->ticks[i] * ns_per_tick / cycles,
+                hp->cycle_ticks ? 100.0 * hp->ticks[i] / hp->cycle_ticks : 0.0);
+    }
+    /* Analysis hooks, timer reads and the rest of APEX_cpu_cycle */
+    if (hp->cycle_ticks > stages)
+    {
+        fprintf(fp, "%-10s %12s %10s %10.1f %7.2f%%\n", "other", "-", "-",
+                (hp->cycle_ticks - stages) * ns_per_tick / cycles, 100.0 * (hp->cycle_ticks - stages) / hp->cycle_ticks);
+    }
+    fprintf(fp, "%-10s %12s %10s\n", "Event", "Count", "Per cycle");
+    for (int i = 0; i < HP_EVENTS; i++)
+    {
+        fprintf(fp, "%-10s %12llu %10.2f\n", event_names[i], (unsigned long long)hp->events[i],
+                hp->events[i] / cycles);
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * apex_hostprof.h
+ * Contains the host side self-profiling of the simulator, which times every
+ * pipeline stage call with the time stamp counter
+ *
+ * Only a build with -DAPEX_HOSTPROF (make HOSTPROF=1) profiles, otherwise
+ * every macro below expands to its bare statement or to nothing.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_HOSTPROF_H_
+#define _APEX_HOSTPROF_H_
+
+#ifdef APEX_HOSTPROF
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Timed parts of one simulated cycle, in the order they run */
+enum
+{
+    HP_COMMIT,
+    HP_MEMORY2,
+    HP_MEMORY1,
+    HP_JBU2,
+    HP_JBU1,
+    HP_MUL3,
+    HP_MUL2,
+    HP_MUL1,
+    HP_INTFU,
+    HP_ISSUE,
+    HP_DECODE,
+    HP_FETCH,
+    HP_STAGES
+};
+
+/* Counted host events */
+enum
+{
+    HP_IQ_SCAN,    /* Loops over every issue queue entry */
+    HP_STRCPY,     /* Opcode strings copied between latches, IQ and ROB */
+    HP_LATCH_COPY, /* Whole pipeline latches copied */
+    HP_EVENTS
+};
+
+typedef struct APEX_HostProf
+{
+    uint64_t ticks[HP_STAGES];
+    uint64_t calls[HP_STAGES];
+    uint64_t cycle_ticks;      /* Whole APEX_cpu_cycle calls, analyses included */
+    uint64_t cycles;
+    uint64_t events[HP_EVENTS];
+    uint64_t start_ticks;      /* Counter and clock when profiling began, to */
+    struct timespec start;     /* convert ticks into nanoseconds */
+} APEX_HostProf;
+
+extern APEX_HostProf APEX_hostprof;
+
+static inline uint64_t
+hostprof_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+void APEX_hostprof_start(void);
+void APEX_hostprof_report(FILE *fp);
+
+#define HOSTPROF_START() APEX_hostprof_start()
+#define HOSTPROF_CYCLE_BEGIN() uint64_t hostprof_cycle = hostprof_ticks()
+#define HOSTPROF_CYCLE_END() \
+    (APEX_hostprof.cycle_ticks += hostprof_ticks() - hostprof_cycle, APEX_hostprof.cycles++)
+#define HOSTPROF_REPORT(fp) APEX_hostprof_report(fp)
+#define HOSTPROF_EVENT(event) (APEX_hostprof.events[event]++)
+#define HOSTPROF_STAGE(stage, call)                                    \
+    do                                                                 \
+    {                                                                  \
+        uint64_t hostprof_begin = hostprof_ticks();                    \
+        call;                                                          \
+        APEX_hostprof.ticks[stage] += hostprof_ticks() - hostprof_begin; \
+        APEX_hostprof.calls[stage]++;                                  \
+    } while (0)
+
+#else
+
+#define HOSTPROF_START() ((void)0)
+#define HOSTPROF_CYCLE_BEGIN()
+#define HOSTPROF_CYCLE_END() ((void)0)
+#define HOSTPROF_REPORT(fp) ((void)0)
+#define HOSTPROF_EVENT(event) ((void)0)
+#define HOSTPROF_STAGE(stage, call) call
+
+#endif
+
+#define HOSTPROF_STRCPY(dst, src) (HOSTPROF_EVENT(HP_STRCPY), strcpy(dst, src))
+
+#endif
@@ -15,6 +15,13 @@
 /* Integers */
 #define DATA_MEMORY_SIZE 4096
 
+/* Data memory words tracked by one word of the dirty bitmap */
+#define DIRTY_BITS_PER_WORD (8 * sizeof(unsigned long))
+
+/* Data memory is snapshotted in pages of this many words */
+#define DATA_MEMORY_PAGE_WORDS 256
+#define DATA_MEMORY_PAGES (DATA_MEMORY_SIZE / DATA_MEMORY_PAGE_WORDS)
+
 /* Size of integer register file */
 #define REG_FILE_SIZE 16
 
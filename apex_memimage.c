@@ -0,0 +1,210 @@
+/*
+ * apex_memimage.c
+ * Contains functions to preload data memory from an image file and to
+ * dump it back once the simulation is over
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_memimage.h"
+#include "apex_options.h"
+
+static int
+load_raw_image(APEX_CPU *cpu, const unsigned char *image, size_t size)
+{
+    if (size % sizeof(int32_t) || size > sizeof(int32_t) * DATA_MEMORY_SIZE)
+    {
+        fprintf(stderr, "APEX_Error: Raw memory image must be a multiple of 4 bytes and at most %d words\n",
+                DATA_MEMORY_SIZE);
+        return -1;
+    }
+    memcpy(cpu->data_memory, image, size);
+    return 0;
+}
+
+static int
+load_sparse_image(APEX_CPU *cpu, const unsigned char *image, size_t size)
+{
+    size_t offset = MEMIMAGE_SPARSE_MAGIC_LEN;
+
+    while (offset < size)
+    {
+        uint32_t record[2];
+
+        if (size - offset < sizeof(record))
+        {
+            fprintf(stderr, "APEX_Error: Truncated record header in sparse memory image\n");
+            return -1;
+        }
+        memcpy(record, image + offset, sizeof(record));
+        offset += sizeof(record);
+
+        if (record[0] > DATA_MEMORY_SIZE || record[1] > DATA_MEMORY_SIZE - record[0])
+        {
+            fprintf(stderr, "APEX_Error: Sparse memory record MEM[%u] x %u is out of range\n",
+                    record[0], record[1]);
+            return -1;
+        }
+        if (size - offset < record[1] * sizeof(int32_t))
+        {
+            fprintf(stderr, "APEX_Error: Truncated data in sparse memory image\n");
+            return -1;
+        }
+        memcpy(&cpu->data_memory[record[0]], image + offset, record[1] * sizeof(int32_t));
+        offset += record[1] * sizeof(int32_t);
+    }
+    return 0;
+}
+
+/*
+ * Maps the image file and copies it into data memory
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_memimage_load(APEX_CPU *cpu, const char *filename)
+{
+    struct stat st;
+    unsigned char *image;
+    int fd, ret;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open memory image %s\n", filename);
+        return -1;
+    }
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+    {
+        fprintf(stderr, "APEX_Error: Unable to map memory image %s\n", filename);
+        return -1;
+    }
+
+    if ((size_t)st.st_size >= MEMIMAGE_SPARSE_MAGIC_LEN &&
+        memcmp(image, MEMIMAGE_SPARSE_MAGIC, MEMIMAGE_SPARSE_MAGIC_LEN) == 0)
+    {
+        ret = load_sparse_image(cpu, image, st.st_size);
+    }
+    else
+    {
+        ret = load_raw_image(cpu, image, st.st_size);
+    }
+
+    munmap(image, st.st_size);
+    return ret;
+}
+
+static int
+is_dirty(const APEX_CPU *cpu, int addr)
+{
+    return (cpu->data_memory_dirty[addr / DIRTY_BITS_PER_WORD] >> (addr % DIRTY_BITS_PER_WORD)) & 1;
+}
+
+/*
+ * Finds the next run of dirty words at or after *start
+ *
+ * Returns the run length, 0 when there are no more dirty words
+ */
+static int
+next_dirty_range(const APEX_CPU *cpu, int *start)
+{
+    int addr = *start;
+    int end;
+
+    while (addr < DATA_MEMORY_SIZE && !is_dirty(cpu, addr))
+    {
+        addr++;
+    }
+    end = addr;
+    while (end < DATA_MEMORY_SIZE && is_dirty(cpu, end))
+    {
+        end++;
+    }
+    *start = addr;
+    return end - addr;
+}
+
+/*
+ * Writes data memory to filename in one of the MEM_DUMP_* formats
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_memimage_dump(const APEX_CPU *cpu, const char *filename, int format)
+{
+    FILE *fp;
+    int addr, len;
+
+    fp = fopen(filename, format == MEM_DUMP_RANGES ? "w" : "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create memory dump %s\n", filename);
+        return -1;
+    }
+
+    switch (format)
+    {
+    case MEM_DUMP_RAW:
+    {
+        fwrite(cpu->data_memory, sizeof(int32_t), DATA_MEMORY_SIZE, fp);
+        break;
+    }
+    case MEM_DUMP_SPARSE:
+    {
+        fwrite(MEMIMAGE_SPARSE_MAGIC, 1, MEMIMAGE_SPARSE_MAGIC_LEN, fp);
+        for (addr = 0; (len = next_dirty_range(cpu, &addr)) > 0; addr += len)
+        {
+            uint32_t record[2] = {addr, len};
+
+            fwrite(record, sizeof(uint32_t), 2, fp);
+            fwrite(&cpu->data_memory[addr], sizeof(int32_t), len, fp);
+        }
+        break;
+    }
+    case MEM_DUMP_RANGES:
+    {
+        for (addr = 0; (len = next_dirty_range(cpu, &addr)) > 0; addr += len)
+        {
+            fprintf(fp, "MEM[%d-%d]:", addr, addr + len - 1);
+            for (int i = 0; i < len; i++)
+            {
+                fprintf(fp, " %d", cpu->data_memory[addr + i]);
+            }
+            fprintf(fp, "\n");
+        }
+        break;
+    }
+    }
+
+    if (fclose(fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write memory dump %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+/*
+ * apex_memimage.h
+ * Contains declarations to preload and dump APEX data memory images
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_MEMIMAGE_H_
+#define _APEX_MEMIMAGE_H_
+
+#include "apex_cpu.h"
+
+/*
+ * Image formats:
+ *
+ * raw    - flat array of 32-bit words, word i is loaded into MEM[i]
+ * sparse - MEMIMAGE_SPARSE_MAGIC followed by records of
+ *          { uint32 base, uint32 count, int32 words[count] }
+ *
+ * All fields are in host byte order.
+ */
+#define MEMIMAGE_SPARSE_MAGIC "APEXMEM1"
+#define MEMIMAGE_SPARSE_MAGIC_LEN 8
+
+int APEX_memimage_load(APEX_CPU *cpu, const char *filename);
+int APEX_memimage_dump(const APEX_CPU *cpu, const char *filename, int format);
+#endif
@@ -0,0 +1,422 @@
+/*
+ * apex_memprofile.c
+ * Contains the memory access profile of a run
+ *
+ * Every address a load or store computes in MEM1 is recorded, including the
+ * accesses of instructions a flush later discards, since they too went to
+ * memory. Addresses are grouped into blocks of a power of two words so the
+ * profile can be read for a cache line size.
+ *
+ *   strides      each static load or store keeps the few strides it saw most
+ *                often; the dominant one and its share of the accesses tell a
+ *                regular walk from a scattered one
+ *   reuse        the distinct blocks touched between two accesses of a block,
+ *                kept in a Fenwick tree over access times with a mark on the
+ *                last access of every block, so each access costs O(log n)
+ *   working set  the distinct blocks touched in each interval of cycles
+ *
+ * An access at reuse distance d hits in a fully associative LRU cache of
+ * more than d blocks, so the cumulative reuse histogram is the hit ratio of
+ * such a cache against its size.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_macros.h"
+#include "apex_memprofile.h"
+
+APEX_MemProfile *
+APEX_memprofile_create(int code_memory_size, int block, int interval)
+{
+    APEX_MemProfile *prof = calloc(1, sizeof(APEX_MemProfile));
+    int blocks = DATA_MEMORY_SIZE / block;
+
+    if (!prof)
+    {
+        return NULL;
+    }
+    prof->size = code_memory_size;
+    prof->block = block;
+    prof->interval = interval;
+    prof->capacity = 64;
+    prof->count = 1;
+    prof->pcs = calloc(code_memory_size ? code_memory_size : 1, sizeof(MemProfPc));
+    prof->tree = calloc(MEMPROF_WINDOW + 1, sizeof(int));
+    prof->owner = calloc(MEMPROF_WINDOW + 1, sizeof(int));
+    prof->last = calloc(blocks, sizeof(int));
+    prof->stamp = calloc(blocks, sizeof(int));
+    prof->rows = calloc(prof->capacity, sizeof(MemProfInterval));
+    if (!prof->pcs || !prof->tree || !prof->owner || !prof->last || !prof->stamp || !prof->rows)
+    {
+        APEX_memprofile_free(prof);
+        return NULL;
+    }
+    return prof;
+}
+
+void
+APEX_memprofile_free(APEX_MemProfile *prof)
+{
+    if (prof)
+    {
+        if (prof->pcs)
+        {
+            for (int i = 0; i < prof->size; i++)
+            {
+                free(prof->pcs[i].touched);
+            }
+        }
+        free(prof->pcs);
+        free(prof->tree);
+        free(prof->owner);
+        free(prof->last);
+        free(prof->stamp);
+        free(prof->rows);
+        free(prof);
+    }
+}
+
+static void
+tree_add(int *tree, int time, int delta)
+{
+    for (; time <= MEMPROF_WINDOW; time += time & -time)
+    {
+        tree[time] += delta;
+    }
+}
+
+/* Marks at times 1 to time */
+static int
+tree_prefix(const int *tree, int time)
+{
+    int sum = 0;
+
+    for (; time > 0; time -= time & -time)
+    {
+        sum += tree[time];
+    }
+    return sum;
+}
+
+/*
+ * Renumbers the marked times 1, 2, ... in order once the window is used
+ * up, the distances between them stay the same
+ */
+static void
+compact(APEX_MemProfile *prof)
+{
+    int next = 0;
+
+    for (int t = 1; t <= prof->now; t++)
+    {
+        if (prof->owner[t])
+        {
+            next++;
+            prof->owner[next] = prof->owner[t];
+            prof->last[prof->owner[t] - 1] = next;
+        }
+    }
+    memset(&prof->owner[next + 1], 0, (MEMPROF_WINDOW - next) * sizeof(int));
+    memset(prof->tree, 0, (MEMPROF_WINDOW + 1) * sizeof(int));
+    for (int t = 1; t <= MEMPROF_WINDOW; t++)
+    {
+        int up = t + (t & -t);
+
+        prof->tree[t] += t <= next;
+        if (up <= MEMPROF_WINDOW)
+        {
+            prof->tree[up] += prof->tree[t];
+        }
+    }
+    prof->now = next;
+}
+
+/* Bucket of reuse distance d: 0, 1, 2-3, 4-7 ... */
+static int
+bucket_of(int d)
+{
+    int bucket = 0;
+
+    while (d)
+    {
+        bucket++;
+        d >>= 1;
+    }
+    return bucket < MEMPROF_BUCKETS ? bucket : MEMPROF_BUCKETS - 1;
+}
+
+/* Counts stride among the candidates of entry, replacing the least seen */
+static void
+count_stride(MemProfPc *entry, int stride)
+{
+    int least = 0;
+
+    for (int i = 0; i < MEMPROF_STRIDES; i++)
+    {
+        if (entry->stride_count[i] && entry->strides[i] == stride)
+        {
+            entry->stride_count[i]++;
+            return;
+        }
+        if (entry->stride_count[i] < entry->stride_count[least])
+        {
+            least = i;
+        }
+    }
+    entry->strides[least] = stride;
+    entry->stride_count[least]++;
+}
+
+/* Counts the access of the static instruction at pc */
+static int
+access_pc(APEX_MemProfile *prof, int pc, int address, int block)
+{
+    int index = (pc - 4000) / 4;
+    MemProfPc *entry;
+
+    if (pc < 4000 || index >= prof->size)
+    {
+        return 0;
+    }
+    entry = &prof->pcs[index];
+    if (!entry->touched)
+    {
+        entry->touched = calloc((DATA_MEMORY_SIZE / prof->block + 7) / 8, 1);
+        if (!entry->touched)
+        {
+            fprintf(stderr, "APEX_Error: Unable to grow memory profile\n");
+            return -1;
+        }
+    }
+    if (entry->accesses)
+    {
+        int stride = address - entry->last_address;
+
+        count_stride(entry, stride);
+        entry->repeats += entry->accesses > 1 && stride == entry->last_stride;
+        entry->last_stride = stride;
+    }
+    if (!(entry->touched[block / 8] & (1 << (block % 8))))
+    {
+        entry->touched[block / 8] |= 1 << (block % 8);
+        entry->footprint++;
+    }
+    entry->accesses++;
+    entry->last_address = address;
+    return 0;
+}
+
+/*
+ * Called for every load or store leaving MEM1 with the address it computed
+ *
+ * Returns -1 if the profile cannot grow, the access is then left out
+ */
+int
+APEX_memprofile_access(APEX_MemProfile *prof, int pc, int opcode, int address, int clock)
+{
+    int row = clock / prof->interval;
+    int block, first;
+    MemProfInterval *rows;
+
+    if (address < 0 || address >= DATA_MEMORY_SIZE)
+    {
+        prof->outside++;
+        return 0;
+    }
+    if (row >= prof->capacity)
+    {
+        int capacity = prof->capacity;
+
+        while (row >= capacity)
+        {
+            capacity *= 2;
+        }
+        rows = realloc(prof->rows, capacity * sizeof(MemProfInterval));
+        if (!rows)
+        {
+            fprintf(stderr, "APEX_Error: Unable to grow memory profile\n");
+            return -1;
+        }
+        memset(&rows[prof->capacity], 0, (capacity - prof->capacity) * sizeof(MemProfInterval));
+        prof->rows = rows;
+        prof->capacity = capacity;
+    }
+    if (row >= prof->count)
+    {
+        prof->count = row + 1;
+    }
+
+    block = address / prof->block;
+    if (access_pc(prof, pc, address, block) < 0)
+    {
+        return -1;
+    }
+
+    first = !prof->last[block];
+    if (first)
+    {
+        prof->cold++;
+        prof->live++;
+    }
+    else
+    {
+        prof->reuse[bucket_of(prof->live - tree_prefix(prof->tree, prof->last[block]))]++;
+        tree_add(prof->tree, prof->last[block], -1);
+        prof->owner[prof->last[block]] = 0;
+    }
+    if (prof->now == MEMPROF_WINDOW)
+    {
+        compact(prof);
+    }
+    prof->now++;
+    tree_add(prof->tree, prof->now, 1);
+    prof->owner[prof->now] = block + 1;
+    prof->last[block] = prof->now;
+
+    if (opcode == OPCODE_LOAD || opcode == OPCODE_LDR)
+    {
+        prof->rows[row].loads++;
+    }
+    else
+    {
+        prof->rows[row].stores++;
+    }
+    if (prof->stamp[block] != row + 1)
+    {
+        prof->stamp[block] = row + 1;
+        prof->rows[row].blocks++;
+    }
+    prof->rows[row].new_blocks += first;
+    return 0;
+}
+
+/* Most seen stride of entry, its count in *count */
+static int
+dominant_stride(const MemProfPc *entry, long *count)
+{
+    int best = 0;
+
+    for (int i = 1; i < MEMPROF_STRIDES; i++)
+    {
+        if (entry->stride_count[i] > entry->stride_count[best])
+        {
+            best = i;
+        }
+    }
+    *count = entry->stride_count[best];
+    return entry->strides[best];
+}
+
+int
+APEX_memprofile_write(const APEX_MemProfile *prof, const APEX_CPU *cpu, const char *filename)
+{
+    FILE *fp = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    long loads = 0, stores = 0, accesses, reused = 0, hits = 0;
+    char text[64];
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open memory profile %s\n", filename);
+        return -1;
+    }
+
+    for (int r = 0; r < prof->count; r++)
+    {
+        loads += prof->rows[r].loads;
+        stores += prof->rows[r].stores;
+    }
+    accesses = loads + stores;
+    fprintf(fp, "Memory profile: %ld accesses (%ld loads, %ld stores), footprint %d blocks of %d words", accesses,
+            loads, stores, prof->live, prof->block);
+    if (prof->outside)
+    {
+        fprintf(fp, ", %ld outside data memory left out", prof->outside);
+    }
+    fprintf(fp, "\nRegular: share of strides equal to the dominant one, Repeat: to the one before\n\n");
+
+    fprintf(fp, "%9s %8s %8s %8s %9s  %-5s %s\n", "Accesses", "Stride", "Regular", "Repeat", "Footprint", "PC",
+            "Instruction");
+    for (int i = 0; i < prof->size; i++)
+    {
+        const MemProfPc *entry = &prof->pcs[i];
+        long count;
+        int stride;
+
+        if (!entry->accesses)
+        {
+            continue;
+        }
+        stride = dominant_stride(entry, &count);
+        fprintf(fp, "%9ld ", entry->accesses);
+        if (entry->accesses > 1)
+        {
+            fprintf(fp, "%8d %7.2f%% ", stride, 100.0 * count / (entry->accesses - 1));
+        }
+        else
+        {
+            fprintf(fp, "%8s %8s ", "-", "-");
+        }
+        if (entry->accesses > 2)
+        {
+            fprintf(fp, "%7.2f%% ", 100.0 * entry->repeats / (entry->accesses - 2));
+        }
+        else
+        {
+            fprintf(fp, "%8s ", "-");
+        }
+        fprintf(fp, "%9d  %-5d %s\n", entry->footprint, 4000 + 4 * i,
+                APEX_format_instruction(&cpu->code_memory[i], text, sizeof(text)));
+    }
+
+    /* Hit ratio of a fully associative LRU cache of one block more than the
+     * upper bound of the distance */
+    fprintf(fp, "\nReuse distance in distinct blocks, Hit: LRU hit ratio with distance + 1 blocks\n");
+    fprintf(fp, "%11s %9s %8s %8s\n", "Distance", "Accesses", "Percent", "Hit");
+    for (int b = 0; b < MEMPROF_BUCKETS; b++)
+    {
+        reused += prof->reuse[b];
+    }
+    for (int b = 0; b < MEMPROF_BUCKETS && hits < reused; b++)
+    {
+        char range[24];
+
+        if (b < 2)
+        {
+            snprintf(range, sizeof(range), "%d", b);
+        }
+        else
+        {
+            snprintf(range, sizeof(range), "%d-%d", 1 << (b - 1), (1 << b) - 1);
+        }
+        hits += prof->reuse[b];
+        fprintf(fp, "%11s %9ld %7.2f%% %7.2f%%\n", range, prof->reuse[b],
+                accesses ? 100.0 * prof->reuse[b] / accesses : 0.0, accesses ? 100.0 * hits / accesses : 0.0);
+    }
+    fprintf(fp, "%11s %9ld %7.2f%%\n", "cold", prof->cold, accesses ? 100.0 * prof->cold / accesses : 0.0);
+
+    fprintf(fp, "\nWorking set per %d cycle interval\n", prof->interval);
+    fprintf(fp, "%9s %8s %8s %8s %8s\n", "Cycle", "Loads", "Stores", "Blocks", "New");
+    for (int r = 0; r < prof->count; r++)
+    {
+        const MemProfInterval *row = &prof->rows[r];
+
+        if (!row->loads && !row->stores)
+        {
+            continue;
+        }
+        fprintf(fp, "%9ld %8ld %8ld %8d %8d\n", (long)r * prof->interval, row->loads, row->stores, row->blocks,
+                row->new_blocks);
+    }
+
+    if (fp != stdout && fclose(fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write memory profile %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * apex_memprofile.h
+ * Contains declarations of the memory access profile, which describes how
+ * the loads and stores of a program touch data memory: the strides of each
+ * static instruction, the reuse distances and the working set over time
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_MEMPROFILE_H_
+#define _APEX_MEMPROFILE_H_
+
+#include "apex_cpu.h"
+
+/* Default cycles of one row of the working set */
+#define MEMPROF_DEFAULT_INTERVAL 1000
+
+/* Strides told apart per static instruction, the least seen is replaced */
+#define MEMPROF_STRIDES 4
+
+/* Timestamps of the reuse distance tree before it is compacted, well above
+ * the number of blocks it can hold at once */
+#define MEMPROF_WINDOW (1 << 16)
+
+/* Reuse distance buckets: 0, 1, 2-3, 4-7 ... up to the blocks of data memory */
+#define MEMPROF_BUCKETS 13
+
+/* Accesses of one static load or store */
+typedef struct MemProfPc
+{
+    long accesses;
+    int last_address;
+    int strides[MEMPROF_STRIDES];       /* Candidate strides and how often each was seen */
+    long stride_count[MEMPROF_STRIDES];
+    long repeats;                       /* Strides equal to the one before */
+    int last_stride;
+    unsigned char *touched;             /* One bit per block, NULL until the first access */
+    int footprint;                      /* Blocks touched */
+} MemProfPc;
+
+/* Accesses of one span of the run */
+typedef struct MemProfInterval
+{
+    long loads;
+    long stores;
+    int blocks;                         /* Distinct blocks touched, the working set */
+    int new_blocks;                     /* Blocks never touched before */
+} MemProfInterval;
+
+typedef struct APEX_MemProfile
+{
+    int size;                           /* Static instructions, one per code memory index */
+    int block;                          /* Addresses per block, a power of two */
+    int interval;                       /* Cycles per row */
+    MemProfPc *pcs;
+    long outside;                       /* Accesses beyond data memory, not profiled */
+
+    /* Reuse distances: a Fenwick tree over access times marks the last
+     * access of every block, the distinct blocks since the previous access
+     * of a block are the marks after it */
+    int now;                            /* Time of the last access */
+    int live;                           /* Marks in the tree, blocks accessed so far */
+    int *tree;                          /* MEMPROF_WINDOW + 1 counters */
+    int *owner;                         /* Block + 1 last accessed at each time, 0 if none */
+    int *last;                          /* Time of the last access of each block, 0 if none */
+    long cold;                          /* First accesses of a block */
+    long reuse[MEMPROF_BUCKETS];
+
+    int count;                          /* Rows, the last one still being filled */
+    int capacity;
+    MemProfInterval *rows;
+    int *stamp;                         /* Row + 1 which last touched each block */
+} APEX_MemProfile;
+
+APEX_MemProfile *APEX_memprofile_create(int code_memory_size, int block, int interval);
+void APEX_memprofile_free(APEX_MemProfile *prof);
+int APEX_memprofile_access(APEX_MemProfile *prof, int pc, int opcode, int address, int clock);
+int APEX_memprofile_write(const APEX_MemProfile *prof, const APEX_CPU *cpu, const char *filename);
+#endif
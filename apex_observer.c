@@ -0,0 +1,203 @@
+/*
+ * apex_observer.c
+ * Contains the registry of observers and the loader of observer plugins
+ *
+ * A plugin is a shared object defining
+ *
+ *     int APEX_observer_init(APEX_CPU *cpu);
+ *
+ * which registers its callbacks with APEX_observer_add and returns 0, or -1
+ * to stop the run. An optional void APEX_observer_fini(APEX_CPU *cpu) is
+ * called once the run is over, with the final state of the CPU.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_observer.h"
+
+typedef int (*PluginInit)(APEX_CPU *cpu);
+typedef void (*PluginFini)(APEX_CPU *cpu);
+
+static void
+update_mask(APEX_CPU *cpu)
+{
+    cpu->observed = 0;
+    for (int i = 0; i < cpu->observers->count; i++)
+    {
+        cpu->observed |= cpu->observers->events[i];
+    }
+}
+
+/*
+ * Calls fn(arg, view, cpu) on every event of the events mask (OBS_MASK of
+ * each, or OBS_ALL) from the next one on
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_observer_add(APEX_CPU *cpu, unsigned events, APEX_ObserverFn fn, void *arg)
+{
+    if (!fn || !(events & OBS_ALL))
+    {
+        fprintf(stderr, "APEX_Error: An observer needs a callback and an event\n");
+        return -1;
+    }
+    if (!cpu->observers && !(cpu->observers = calloc(1, sizeof(APEX_Observers))))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate observers\n");
+        return -1;
+    }
+    if (cpu->observers->count == OBSERVER_MAX)
+    {
+        fprintf(stderr, "APEX_Error: More than %d observers\n", OBSERVER_MAX);
+        return -1;
+    }
+    cpu->observers->events[cpu->observers->count] = events & OBS_ALL;
+    cpu->observers->fn[cpu->observers->count] = fn;
+    cpu->observers->arg[cpu->observers->count] = arg;
+    cpu->observers->count++;
+    update_mask(cpu);
+    return 0;
+}
+
+/* Drops the callbacks registered as fn with arg */
+void
+APEX_observer_remove(APEX_CPU *cpu, APEX_ObserverFn fn, void *arg)
+{
+    APEX_Observers *obs = cpu->observers;
+    int kept = 0;
+
+    if (!obs)
+    {
+        return;
+    }
+    for (int i = 0; i < obs->count; i++)
+    {
+        if (obs->fn[i] != fn || obs->arg[i] != arg)
+        {
+            obs->events[kept] = obs->events[i];
+            obs->fn[kept] = obs->fn[i];
+            obs->arg[kept] = obs->arg[i];
+            kept++;
+        }
+    }
+    obs->count = kept;
+    update_mask(cpu);
+}
+
+/* View of event in the current cycle, every other field -1 */
+void
+APEX_observer_view(APEX_ObsView *view, int event, const APEX_CPU *cpu)
+{
+    view->event = event;
+    view->cycle = cpu->clock;
+    view->pc = -1;
+    view->opcode = -1;
+    view->rob_index = -1;
+    view->phys_reg = -1;
+    view->iq_index = -1;
+    view->unit = -1;
+    view->lane = -1;
+    view->address = -1;
+    view->value = -1;
+    view->squashed = -1;
+}
+
+/* Hands view to every callback watching its event, in registration order */
+void
+APEX_observe(const APEX_CPU *cpu, const APEX_ObsView *view)
+{
+    const APEX_Observers *obs = cpu->observers;
+
+    for (int i = 0; i < obs->count; i++)
+    {
+        if (obs->events[i] & OBS_MASK(view->event))
+        {
+            obs->fn[i](obs->arg[i], view, cpu);
+        }
+    }
+}
+
+/*
+ * Loads the observer plugin at path and lets it register on cpu, it stays
+ * loaded until APEX_observers_free
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_observer_load(APEX_CPU *cpu, const char *path)
+{
+    void *handle;
+    PluginInit init;
+    int registered;
+
+    if (!cpu->observers && !(cpu->observers = calloc(1, sizeof(APEX_Observers))))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate observers\n");
+        return -1;
+    }
+    if (cpu->observers->nplugins == OBSERVER_MAX)
+    {
+        fprintf(stderr, "APEX_Error: More than %d observer plugins\n", OBSERVER_MAX);
+        return -1;
+    }
+    if (!(handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)))
+    {
+        fprintf(stderr, "APEX_Error: Unable to load observer %s: %s\n", path, dlerror());
+        return -1;
+    }
+    *(void **)&init = dlsym(handle, "APEX_observer_init");
+    if (!init)
+    {
+        fprintf(stderr, "APEX_Error: Observer %s defines no APEX_observer_init\n", path);
+        dlclose(handle);
+        return -1;
+    }
+    registered = cpu->observers->count;
+    if (init(cpu) < 0)
+    {
+        /* Callbacks it registered before failing live in the plugin, and it never gets its fini */
+        fprintf(stderr, "APEX_Error: Observer %s failed to start\n", path);
+        cpu->observers->count = registered;
+        update_mask(cpu);
+        dlclose(handle);
+        return -1;
+    }
+    cpu->observers->plugins[cpu->observers->nplugins++] = handle;
+    return 0;
+}
+
+/* Lets the plugins of cpu finish, then unloads them and drops every callback */
+void
+APEX_observers_free(APEX_CPU *cpu)
+{
+    APEX_Observers *obs = cpu->observers;
+    PluginFini fini;
+
+    if (!obs)
+    {
+        return;
+    }
+    for (int i = 0; i < obs->nplugins; i++)
+    {
+        *(void **)&fini = dlsym(obs->plugins[i], "APEX_observer_fini");
+        if (fini)
+        {
+            fini(cpu);
+        }
+    }
+    /* The callbacks may live in the plugins */
+    cpu->observed = 0;
+    obs->count = 0;
+    for (int i = 0; i < obs->nplugins; i++)
+    {
+        dlclose(obs->plugins[i]);
+    }
+    free(obs);
+    cpu->observers = NULL;
+}
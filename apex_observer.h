@@ -0,0 +1,101 @@
+/*
+ * apex_observer.h
+ * Contains declarations of the observer hooks, which let code outside the
+ * pipeline watch instructions go through it without patching apex_cpu.c
+ *
+ * A hook in a stage costs one test of cpu->observed while nothing watches
+ * its event, a build with -DAPEX_NO_OBSERVERS (make OBSERVERS=0) drops the
+ * hooks altogether.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_OBSERVER_H_
+#define _APEX_OBSERVER_H_
+
+#include "apex_cpu.h"
+
+/* Callbacks registered on one CPU */
+#define OBSERVER_MAX 16
+
+/* Events an observer may watch, in pipeline order */
+enum
+{
+    OBS_FETCH,    /* Fetched and handed to decode */
+    OBS_RENAME,   /* Given its ROB entry and destination physical register */
+    OBS_DISPATCH, /* Entered the issue queue, HALT and ready loads and stores skip it */
+    OBS_ISSUE,    /* Sent to a unit, from the issue queue or from decode */
+    OBS_COMPLETE, /* Result written into its ROB entry */
+    OBS_MEMORY,   /* Load or store at MEM2, the store writes memory at commit */
+    OBS_COMMIT,   /* Retired */
+    OBS_SQUASH,   /* Issue queue emptied behind a branch or jump in JBU1 or JBU2 */
+    OBS_FLUSH,    /* ROB emptied behind a branch or jump at its commit */
+    OBS_EVENTS
+};
+
+#define OBS_MASK(event) (1u << (event))
+#define OBS_ALL ((1u << OBS_EVENTS) - 1)
+
+/* Units an instruction issues to */
+enum
+{
+    OBS_UNIT_INT,
+    OBS_UNIT_MUL,
+    OBS_UNIT_BRANCH,
+    OBS_UNIT_MEMORY
+};
+
+/* What an observer is told of one event, fields which do not apply are -1 */
+typedef struct APEX_ObsView
+{
+    int event;      /* OBS_* */
+    int cycle;      /* Cycles elapsed before the one the event happens in */
+    int pc;
+    int opcode;
+    int rob_index;  /* ROB entry of the instruction */
+    int phys_reg;   /* Destination physical register */
+    int iq_index;   /* Issue queue entry, on dispatch */
+    int unit;       /* OBS_UNIT_* and lane, on issue */
+    int lane;
+    int address;    /* Data address, on memory */
+    int value;      /* Result on complete and commit, data loaded or stored on memory */
+    int squashed;   /* Entries discarded, on squash and flush */
+} APEX_ObsView;
+
+/* Called with the arg given on registration, cpu must not be changed */
+typedef void (*APEX_ObserverFn)(void *arg, const APEX_ObsView *view, const APEX_CPU *cpu);
+
+typedef struct APEX_Observers
+{
+    int count;
+    unsigned events[OBSERVER_MAX]; /* OBS_MASK of the events each callback watches */
+    APEX_ObserverFn fn[OBSERVER_MAX];
+    void *arg[OBSERVER_MAX];
+    void *plugins[OBSERVER_MAX];   /* Shared objects loaded by --observer */
+    int nplugins;
+} APEX_Observers;
+
+#ifdef APEX_NO_OBSERVERS
+#define OBSERVED(cpu, event) 0
+#else
+#define OBSERVED(cpu, event) ((cpu)->observed & OBS_MASK(event))
+#endif
+
+/* Runs call when an observer watches event, as the statement of a stage */
+#define OBSERVE(cpu, event, call)  \
+    do                             \
+    {                              \
+        if (OBSERVED(cpu, event))  \
+        {                          \
+            call;                  \
+        }                          \
+    } while (0)
+
+int APEX_observer_add(APEX_CPU *cpu, unsigned events, APEX_ObserverFn fn, void *arg);
+void APEX_observer_remove(APEX_CPU *cpu, APEX_ObserverFn fn, void *arg);
+void APEX_observer_view(APEX_ObsView *view, int event, const APEX_CPU *cpu);
+void APEX_observe(const APEX_CPU *cpu, const APEX_ObsView *view);
+int APEX_observer_load(APEX_CPU *cpu, const char *path);
+void APEX_observers_free(APEX_CPU *cpu);
+#endif
@@ -0,0 +1,446 @@
+/*
+ * apex_options.c
+ * Contains functions to parse command line options of the APEX simulator
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cache.h"
+#include "apex_cpistack.h"
+#include "apex_explore.h"
+#include "apex_memprofile.h"
+#include "apex_options.h"
+#include "apex_ring.h"
+#include "apex_runctl.h"
+#include "apex_simpoint.h"
+#include "apex_snapshot.h"
+#include "apex_telemetry.h"
+
+/*
+ * Returns the value part of "--name=value" if arg is the option name,
+ * NULL otherwise
+ */
+static const char *
+option_value(const char *arg, const char *name)
+{
+    size_t len = strlen(name);
+
+    if (strncmp(arg, name, len) == 0 && arg[len] == '=')
+    {
+        return arg + len + 1;
+    }
+    return NULL;
+}
+
+/* Integer options which set a field of the machine configuration */
+static const struct
+{
+    const char *name;
+    size_t offset;
+} config_options[] = {
+    {"--rob-size", offsetof(APEX_Config, rob_size)},
+    {"--iq-size", offsetof(APEX_Config, iq_size)},
+    {"--phys-regs", offsetof(APEX_Config, phys_regs)},
+    {"--intfu-count", offsetof(APEX_Config, intfu_count)},
+    {"--mulfu-count", offsetof(APEX_Config, mulfu_count)},
+    {"--intfu-latency", offsetof(APEX_Config, intfu_latency)},
+    {"--mul-latency", offsetof(APEX_Config, mul_latency)},
+    {"--mem-latency", offsetof(APEX_Config, mem_latency)},
+};
+
+/*
+ * Parses a decimal integer, the whole string has to be consumed
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int
+parse_int(const char *val, int *out)
+{
+    char *end;
+    long num = strtol(val, &end, 10);
+
+    if (*val == '\0' || *end != '\0' || num < -2147483647L || num > 2147483647L)
+    {
+        return -1;
+    }
+    *out = (int)num;
+    return 0;
+}
+
+/*
+ * Returns the field of config set by the option "--name", NULL when name is
+ * not a machine configuration option
+ */
+int *
+APEX_options_config_field(APEX_Config *config, const char *name)
+{
+    for (size_t i = 0; i < sizeof(config_options) / sizeof(config_options[0]); i++)
+    {
+        if (strcmp(config_options[i].name + 2, name) == 0)
+        {
+            return (int *)((char *)config + config_options[i].offset);
+        }
+    }
+    return NULL;
+}
+
+void
+APEX_options_init(APEX_Options *opts)
+{
+    memset(opts, 0, sizeof(APEX_Options));
+    opts->mem_dump_format = MEM_DUMP_RAW;
+    opts->snapshot_interval = SNAPSHOT_DEFAULT_INTERVAL;
+    opts->cache_size = CACHE_DEFAULT_SIZE;
+    opts->cpistack_interval = CPISTACK_DEFAULT_INTERVAL;
+    opts->memprofile_interval = MEMPROF_DEFAULT_INTERVAL;
+    opts->memprofile_block = 1;
+    opts->simpoint_interval = SIMPOINT_DEFAULT_INTERVAL;
+    opts->simpoint_max_k = SIMPOINT_DEFAULT_MAX_K;
+    opts->sample_warmup = SIMPOINT_DEFAULT_WARMUP;
+    opts->explore_eta = EXPLORE_DEFAULT_ETA;
+    opts->watchdog = RUNCTL_DEFAULT_WATCHDOG;
+    APEX_config_default(&opts->config);
+}
+
+/*
+ * Parses a single "--name=value" argument into opts
+ *
+ * Returns 0 on success, -1 for an unknown option or a bad value
+ */
+int
+APEX_options_parse(APEX_Options *opts, const char *arg)
+{
+    const char *val;
+
+    for (size_t i = 0; i < sizeof(config_options) / sizeof(config_options[0]); i++)
+    {
+        if ((val = option_value(arg, config_options[i].name)))
+        {
+            return parse_int(val, (int *)((char *)&opts->config + config_options[i].offset));
+        }
+    }
+    if ((val = option_value(arg, "--mem-load")))
+    {
+        opts->mem_load_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--mem-dump")))
+    {
+        opts->mem_dump_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--profile")))
+    {
+        opts->profile_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--critical-path")))
+    {
+        opts->critpath_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--cpi-stack")))
+    {
+        opts->cpistack_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--cpi-interval")))
+    {
+        return parse_int(val, &opts->cpistack_interval);
+    }
+    if ((val = option_value(arg, "--mem-profile")))
+    {
+        opts->memprofile_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--mem-profile-interval")))
+    {
+        return parse_int(val, &opts->memprofile_interval);
+    }
+    if ((val = option_value(arg, "--mem-profile-block")))
+    {
+        return parse_int(val, &opts->memprofile_block);
+    }
+    if ((val = option_value(arg, "--branch-profile")))
+    {
+        opts->branchprof_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--trace-record")) || (val = option_value(arg, "--trace-replay")))
+    {
+        if (opts->trace_file)
+        {
+            fprintf(stderr, "APEX_Error: Only one trace can be recorded or replayed\n");
+            return -1;
+        }
+        opts->trace_file = val;
+        opts->trace_replay = strncmp(arg, "--trace-replay", 14) == 0;
+        return 0;
+    }
+    if ((val = option_value(arg, "--decoupled")))
+    {
+        return parse_int(val, &opts->decoupled);
+    }
+    if ((val = option_value(arg, "--telemetry")))
+    {
+        opts->telemetry_name = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--observer")))
+    {
+        opts->observer_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--server")))
+    {
+        opts->server_endpoint = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--batch-inputs")))
+    {
+        opts->batch_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--cache")))
+    {
+        opts->cache_dir = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--cache-size")))
+    {
+        return parse_int(val, &opts->cache_size);
+    }
+    if ((val = option_value(arg, "--checkpoints")))
+    {
+        opts->checkpoint_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--simpoints")))
+    {
+        opts->simpoint_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--simpoint-interval")))
+    {
+        return parse_int(val, &opts->simpoint_interval);
+    }
+    if ((val = option_value(arg, "--simpoint-max-k")))
+    {
+        return parse_int(val, &opts->simpoint_max_k);
+    }
+    if ((val = option_value(arg, "--sample-warmup")))
+    {
+        return parse_int(val, &opts->sample_warmup);
+    }
+    if ((val = option_value(arg, "--threads")))
+    {
+        return parse_int(val, &opts->threads);
+    }
+    if ((val = option_value(arg, "--kernels")))
+    {
+        opts->kernel_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--space")))
+    {
+        opts->space_file = val;
+        return 0;
+    }
+    if ((val = option_value(arg, "--eta")))
+    {
+        return parse_int(val, &opts->explore_eta);
+    }
+    if ((val = option_value(arg, "--watchdog")))
+    {
+        return parse_int(val, &opts->watchdog);
+    }
+    if ((val = option_value(arg, "--time-limit")))
+    {
+        return parse_int(val, &opts->time_limit);
+    }
+    if ((val = option_value(arg, "--oracle")))
+    {
+        return APEX_config_parse_oracles(val, &opts->config.oracles);
+    }
+    if ((val = option_value(arg, "--snapshot-interval")))
+    {
+        return parse_int(val, &opts->snapshot_interval);
+    }
+    if ((val = option_value(arg, "--mem-dump-format")))
+    {
+        if (strcmp(val, "raw") == 0)
+        {
+            opts->mem_dump_format = MEM_DUMP_RAW;
+        }
+        else if (strcmp(val, "sparse") == 0)
+        {
+            opts->mem_dump_format = MEM_DUMP_SPARSE;
+        }
+        else if (strcmp(val, "ranges") == 0)
+        {
+            opts->mem_dump_format = MEM_DUMP_RANGES;
+        }
+        else
+        {
+            return -1;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * Checks option values which can only be validated together
+ *
+ * Returns 0 when valid, -1 otherwise
+ */
+int
+APEX_options_check(const APEX_Options *opts)
+{
+    if (opts->snapshot_interval < 1)
+    {
+        fprintf(stderr, "APEX_Error: --snapshot-interval must be at least 1\n");
+        return -1;
+    }
+    if (opts->cpistack_interval < 1)
+    {
+        fprintf(stderr, "APEX_Error: --cpi-interval must be at least 1\n");
+        return -1;
+    }
+    if (opts->memprofile_interval < 1)
+    {
+        fprintf(stderr, "APEX_Error: --mem-profile-interval must be at least 1\n");
+        return -1;
+    }
+    if (opts->memprofile_block < 1 || opts->memprofile_block > DATA_MEMORY_SIZE ||
+        (opts->memprofile_block & (opts->memprofile_block - 1)))
+    {
+        fprintf(stderr, "APEX_Error: --mem-profile-block must be a power of two up to %d\n", DATA_MEMORY_SIZE);
+        return -1;
+    }
+    if (opts->simpoint_interval < 1 || opts->simpoint_max_k < 1)
+    {
+        fprintf(stderr, "APEX_Error: --simpoint-interval and --simpoint-max-k must be at least 1\n");
+        return -1;
+    }
+    if (opts->sample_warmup < 0 || opts->threads < 0)
+    {
+        fprintf(stderr, "APEX_Error: --sample-warmup and --threads cannot be negative\n");
+        return -1;
+    }
+    if (opts->watchdog < 0 || opts->time_limit < 0)
+    {
+        fprintf(stderr, "APEX_Error: --watchdog and --time-limit cannot be negative\n");
+        return -1;
+    }
+    if (opts->explore_eta < 2)
+    {
+        fprintf(stderr, "APEX_Error: --eta must be at least 2\n");
+        return -1;
+    }
+    if (opts->cache_size < 1)
+    {
+        fprintf(stderr, "APEX_Error: --cache-size must be at least 1\n");
+        return -1;
+    }
+    if (opts->decoupled && (opts->decoupled < RING_MIN_SIZE || opts->decoupled > RING_MAX_SIZE ||
+                            (opts->decoupled & (opts->decoupled - 1))))
+    {
+        fprintf(stderr, "APEX_Error: --decoupled must be a power of two from %d to %d\n", RING_MIN_SIZE,
+                RING_MAX_SIZE);
+        return -1;
+    }
+    /* A live replay is a trace of its own */
+    if (opts->decoupled && opts->trace_file)
+    {
+        fprintf(stderr, "APEX_Error: --decoupled and traces cannot be combined\n");
+        return -1;
+    }
+    /* Fetch never waits for a branch the oracle already knows */
+    if (opts->branchprof_file && (opts->config.oracles & ORACLE_BRANCH))
+    {
+        fprintf(stderr, "APEX_Error: --branch-profile and --oracle=branch cannot be combined\n");
+        return -1;
+    }
+    /* Both would decide where fetch goes */
+    if ((opts->decoupled || (opts->trace_file && opts->trace_replay)) && (opts->config.oracles & ORACLE_BRANCH))
+    {
+        fprintf(stderr, "APEX_Error: %s and --oracle=branch cannot be combined\n",
+                opts->decoupled ? "--decoupled" : "--trace-replay");
+        return -1;
+    }
+    return APEX_config_check(&opts->config);
+}
+
+/*
+ * Tells whether opts attach anything watching the pipeline cycle by cycle:
+ * profiles, the critical path, the CPI stack, traces, the decoupled
+ * functional model, telemetry or observers
+ */
+int
+APEX_options_any_analysis(const APEX_Options *opts)
+{
+    return opts->profile_file || opts->critpath_file || opts->cpistack_file || opts->trace_file ||
+           opts->decoupled || opts->telemetry_name || opts->observer_file || opts->memprofile_file ||
+           opts->branchprof_file;
+}
+
+void
+APEX_options_usage(void)
+{
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --mem-load=<file>         preload data memory from a raw or sparse image\n");
+    fprintf(stderr, "  --mem-dump=<file>         write data memory after the run\n");
+    fprintf(stderr, "  --mem-dump-format=<fmt>   raw (default), sparse or ranges\n");
+    fprintf(stderr, "  --profile=<file>          write a per-PC hot-spot profile, - for stdout\n");
+    fprintf(stderr, "  --critical-path=<file>    write the critical path breakdown, - for stdout\n");
+    fprintf(stderr, "  --cpi-stack=<file>        write the top-down CPI stack, - for stdout\n");
+    fprintf(stderr, "  --cpi-interval=<n>        cycles per row of the CPI stack (default %d)\n",
+            CPISTACK_DEFAULT_INTERVAL);
+    fprintf(stderr, "  --mem-profile=<file>      write strides, reuse distances and working set, - for stdout\n");
+    fprintf(stderr, "  --mem-profile-interval=<n> cycles per row of the working set (default %d)\n",
+            MEMPROF_DEFAULT_INTERVAL);
+    fprintf(stderr, "  --mem-profile-block=<n>   words per block of the memory profile, a power of two (default 1)\n");
+    fprintf(stderr, "  --branch-profile=<file>   write per-branch outcomes, predictability and cost, - for stdout\n");
+    fprintf(stderr, "  --trace-record=<file>     record the committed instruction stream\n");
+    fprintf(stderr, "  --trace-replay=<file>     take branch outcomes, jump targets and addresses from a trace\n");
+    fprintf(stderr, "  --decoupled=<n>           run the functional model on a thread of its own, n instructions ahead\n");
+    fprintf(stderr, "  --telemetry=<label>       publish live counters in " TELEMETRY_DIR " for apex_top\n");
+    fprintf(stderr, "  --observer=<lib.so>       load a plugin watching pipeline events\n");
+    fprintf(stderr, "  --server=<socket>         run jobs read from a Unix socket, - for stdin\n");
+    fprintf(stderr, "  --batch-inputs=<file>     data memory images run in lockstep by batch, one per line\n");
+    fprintf(stderr, "  --cache=<dir>             reuse results of identical simulate runs stored in dir\n");
+    fprintf(stderr, "  --cache-size=<mb>         disk space the cache may take (default %d)\n", CACHE_DEFAULT_SIZE);
+    fprintf(stderr, "  --checkpoints=<file>      resume an edited program where it last ran the same\n");
+    fprintf(stderr, "  --simpoints=<file>        intervals written by simpoint and simulated by sample\n");
+    fprintf(stderr, "  --simpoint-interval=<n>   instructions per simpoint interval (default %d)\n",
+            SIMPOINT_DEFAULT_INTERVAL);
+    fprintf(stderr, "  --simpoint-max-k=<n>      most clusters simpoint tries (default %d)\n", SIMPOINT_DEFAULT_MAX_K);
+    fprintf(stderr, "  --sample-warmup=<n>       instructions simulated before each sampled interval (default %d)\n",
+            SIMPOINT_DEFAULT_WARMUP);
+    fprintf(stderr, "  --threads=<n>             worker threads of sample and explore, 0 for one per core (default)\n");
+    fprintf(stderr, "  --kernels=<file>          programs explore runs besides the input, one per line\n");
+    fprintf(stderr, "  --space=<file>            option name and values per line searched by explore\n");
+    fprintf(stderr, "  --eta=<n>                 explore keeps 1 in n candidates each round (default %d)\n",
+            EXPLORE_DEFAULT_ETA);
+    fprintf(stderr, "  --watchdog=<n>            stop a run after n cycles without a commit, 0 never (default %d)\n",
+            RUNCTL_DEFAULT_WATCHDOG);
+    fprintf(stderr, "  --time-limit=<seconds>    stop a run after this wall-clock time (default none)\n");
+    fprintf(stderr, "  --oracle=<list>           perfect branch, memory, window, fu, comma separated, or all\n");
+    fprintf(stderr, "  --snapshot-interval=<n>   debugger and checkpoint cycles between snapshots (default %d)\n",
+            SNAPSHOT_DEFAULT_INTERVAL);
+    fprintf(stderr, "  --rob-size=<n>            ROB entries (default %d)\n", DEFAULT_ROB_SIZE);
+    fprintf(stderr, "  --iq-size=<n>             issue queue entries (default %d)\n", DEFAULT_IQ_SIZE);
+    fprintf(stderr, "  --phys-regs=<n>           physical registers (default %d)\n", DEFAULT_PHYS_REGS);
+    fprintf(stderr, "  --intfu-count=<n>         integer units (default %d)\n", DEFAULT_INTFU_COUNT);
+    fprintf(stderr, "  --mulfu-count=<n>         multiplier pipelines (default %d)\n", DEFAULT_MULFU_COUNT);
+    fprintf(stderr, "  --intfu-latency=<n>       integer unit latency (default %d)\n", DEFAULT_INTFU_LATENCY);
+    fprintf(stderr, "  --mul-latency=<n>         multiplier latency (default %d)\n", DEFAULT_MUL_LATENCY);
+    fprintf(stderr, "  --mem-latency=<n>         memory latency (default %d)\n", DEFAULT_MEM_LATENCY);
+}
@@ -0,0 +1,66 @@
+/*
+ * apex_options.h
+ * Contains command line options of the APEX simulator
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_OPTIONS_H_
+#define _APEX_OPTIONS_H_
+
+#include "apex_config.h"
+
+/* Formats accepted by --mem-dump-format */
+enum
+{
+    MEM_DUMP_RAW,    /* Whole data memory as a flat binary image */
+    MEM_DUMP_SPARSE, /* Dirty ranges as a binary sparse image */
+    MEM_DUMP_RANGES  /* Dirty ranges as a text listing */
+};
+
+/* Options given as --name=value after the positional arguments */
+typedef struct APEX_Options
+{
+    const char *mem_load_file; /* Data memory image loaded before the run */
+    const char *mem_dump_file; /* Data memory image written after the run */
+    int mem_dump_format;       /* One of MEM_DUMP_* */
+    int snapshot_interval;     /* Debugger or checkpoint cycles between two snapshots */
+    const char *profile_file;  /* Annotated per-PC profile written after the run */
+    const char *critpath_file; /* Critical path breakdown written after the run */
+    const char *cpistack_file; /* Top-down CPI stack written after the run */
+    int cpistack_interval;     /* Cycles per row of the CPI stack */
+    const char *memprofile_file; /* Memory access profile written after the run */
+    int memprofile_interval;   /* Cycles per row of the working set */
+    int memprofile_block;      /* Words per block of the memory profile */
+    const char *branchprof_file; /* Per-branch outcomes, predictability and cost written after the run */
+    const char *trace_file;    /* Committed instruction trace recorded or replayed */
+    int trace_replay;          /* trace_file drives the pipeline instead of being recorded */
+    int decoupled;             /* Records a functional model thread runs ahead of the pipeline, 0 for none */
+    const char *telemetry_name; /* Label of the live counters published in shared memory */
+    const char *observer_file; /* Shared object registering callbacks on pipeline events */
+    const char *server_endpoint; /* Jobs are read from it, - for standard input */
+    const char *batch_file;    /* Data memory images run by the batch command, one per line */
+    const char *cache_dir;     /* Results of earlier runs are looked up and stored there */
+    int cache_size;            /* Bound of the disk space of cache_dir, in MB */
+    const char *checkpoint_file; /* Snapshots of the previous run resumed from and rewritten */
+    const char *simpoint_file; /* Intervals written by simpoint and simulated by sample */
+    int simpoint_interval;     /* Instructions per profiled interval */
+    int simpoint_max_k;        /* Most clusters simpoint tries */
+    int sample_warmup;         /* Instructions simulated before each sampled interval */
+    int threads;               /* Worker threads, 0 for one per online core */
+    const char *kernel_file;   /* Programs explore scores candidates on besides the input, one per line */
+    const char *space_file;    /* Configuration values explore searches */
+    int explore_eta;           /* explore keeps one candidate in explore_eta each round */
+    int watchdog;              /* Cycles without a commit before a run is stopped, 0 for never */
+    int time_limit;            /* Wall-clock seconds of a run, 0 for no limit */
+    APEX_Config config;        /* Machine configuration */
+} APEX_Options;
+
+void APEX_options_init(APEX_Options *opts);
+int APEX_options_parse(APEX_Options *opts, const char *arg);
+int APEX_options_check(const APEX_Options *opts);
+int APEX_options_any_analysis(const APEX_Options *opts);
+void APEX_options_usage(void);
+int *APEX_options_config_field(APEX_Config *config, const char *name);
+#endif
@@ -0,0 +1,181 @@
+/*
+ * apex_oracle.c
+ * Contains the functional model behind the branch oracle
+ *
+ * With a perfect branch unit fetch never leaves the committed path, so the
+ * instructions fetched are exactly the ones which commit, in order. Executing
+ * each one functionally as it is fetched therefore tells fetch where the next
+ * one is, before the pipeline has computed any operand. The semantics are
+ * those of the pipeline at commit: ADD, SUB, SUBL and CMP set the zero flag,
+ * which starts out neither set nor clear.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_oracle.h"
+
+/* Starts from the initial state of cpu, with its preloaded data memory */
+APEX_Oracle *
+APEX_oracle_create(const APEX_CPU *cpu)
+{
+    APEX_Oracle *oracle = calloc(1, sizeof(APEX_Oracle));
+
+    if (!oracle)
+    {
+        return NULL;
+    }
+    oracle->zero_flag = -1;
+    memcpy(oracle->data_memory, cpu->data_memory, sizeof(oracle->data_memory));
+    return oracle;
+}
+
+void
+APEX_oracle_free(APEX_Oracle *oracle)
+{
+    free(oracle);
+}
+
+static int
+read_memory(const APEX_Oracle *oracle, int address)
+{
+    return (address >= 0 && address < DATA_MEMORY_SIZE) ? oracle->data_memory[address] : 0;
+}
+
+static void
+write_memory(APEX_Oracle *oracle, int address, int value)
+{
+    if (address >= 0 && address < DATA_MEMORY_SIZE)
+    {
+        oracle->data_memory[address] = value;
+    }
+}
+
+/* Effective address of a load or store about to execute, 0 for anything else */
+int
+APEX_oracle_address(const APEX_Oracle *oracle, const APEX_Instruction *ins)
+{
+    const int *regs = oracle->regs;
+
+    switch (ins->opcode)
+    {
+    case OPCODE_LOAD:
+    {
+        return regs[ins->rs1] + ins->imm;
+    }
+    case OPCODE_LDR:
+    {
+        return regs[ins->rs1] + regs[ins->rs2];
+    }
+    case OPCODE_STORE:
+    {
+        return regs[ins->rs2] + ins->imm;
+    }
+    case OPCODE_STR:
+    {
+        return regs[ins->rs2] + regs[ins->rs3];
+    }
+    }
+    return 0;
+}
+
+/*
+ * Executes ins, fetched at pc
+ *
+ * Returns the pc of the next instruction on the committed path
+ */
+int
+APEX_oracle_fetch(APEX_Oracle *oracle, const APEX_Instruction *ins, int pc)
+{
+    int *regs = oracle->regs;
+    int value;
+
+    switch (ins->opcode)
+    {
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_CMP:
+    {
+        value = ins->opcode == OPCODE_ADD ? regs[ins->rs1] + regs[ins->rs2] : regs[ins->rs1] - regs[ins->rs2];
+        if (ins->opcode != OPCODE_CMP)
+        {
+            regs[ins->rd] = value;
+        }
+        oracle->zero_flag = value == 0;
+        break;
+    }
+    case OPCODE_SUBL:
+    {
+        regs[ins->rd] = regs[ins->rs1] - ins->imm;
+        oracle->zero_flag = regs[ins->rd] == 0;
+        break;
+    }
+    case OPCODE_ADDL:
+    {
+        regs[ins->rd] = regs[ins->rs1] + ins->imm;
+        break;
+    }
+    case OPCODE_MUL:
+    {
+        regs[ins->rd] = regs[ins->rs1] * regs[ins->rs2];
+        break;
+    }
+    case OPCODE_AND:
+    {
+        regs[ins->rd] = regs[ins->rs1] & regs[ins->rs2];
+        break;
+    }
+    case OPCODE_OR:
+    {
+        regs[ins->rd] = regs[ins->rs1] | regs[ins->rs2];
+        break;
+    }
+    case OPCODE_XOR:
+    {
+        regs[ins->rd] = regs[ins->rs1] ^ regs[ins->rs2];
+        break;
+    }
+    case OPCODE_MOVC:
+    {
+        regs[ins->rd] = ins->imm;
+        break;
+    }
+    case OPCODE_LOAD:
+    case OPCODE_LDR:
+    {
+        regs[ins->rd] = read_memory(oracle, APEX_oracle_address(oracle, ins));
+        break;
+    }
+    case OPCODE_STORE:
+    case OPCODE_STR:
+    {
+        write_memory(oracle, APEX_oracle_address(oracle, ins), regs[ins->rs1]);
+        break;
+    }
+    case OPCODE_BZ:
+    {
+        return oracle->zero_flag == TRUE ? pc + ins->imm : pc + 4;
+    }
+    case OPCODE_BNZ:
+    {
+        return oracle->zero_flag == FALSE ? pc + ins->imm : pc + 4;
+    }
+    case OPCODE_JUMP:
+    {
+        return regs[ins->rs1] + ins->imm;
+    }
+    case OPCODE_JAL:
+    {
+        int target = regs[ins->rs1] + ins->imm;
+
+        regs[ins->rd] = pc + 4;
+        return target;
+    }
+    }
+    return pc + 4;
+}
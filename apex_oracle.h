@@ -0,0 +1,28 @@
+/*
+ * apex_oracle.h
+ * Contains declarations of the functional model the branch oracle steers
+ * fetch with
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_ORACLE_H_
+#define _APEX_ORACLE_H_
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Architectural state of the program as far as it has been fetched */
+typedef struct APEX_Oracle
+{
+    int regs[REG_FILE_SIZE];
+    int zero_flag;
+    int data_memory[DATA_MEMORY_SIZE];
+} APEX_Oracle;
+
+APEX_Oracle *APEX_oracle_create(const APEX_CPU *cpu);
+void APEX_oracle_free(APEX_Oracle *oracle);
+int APEX_oracle_address(const APEX_Oracle *oracle, const APEX_Instruction *ins);
+int APEX_oracle_fetch(APEX_Oracle *oracle, const APEX_Instruction *ins, int pc);
+#endif
@@ -0,0 +1,217 @@
+/*
+ * apex_profile.c
+ * Contains the per-PC hot-spot profiler of simulated code
+ *
+ * Every static instruction gets a set of counters. Commit counts executions
+ * and the flushes an instruction causes, the issue queue is sampled right
+ * after issue selection and the ROB right after commit, so each waiting
+ * cycle is charged to the instruction which spent it. The result is written
+ * as a disassembly of code memory annotated with the counters, ordered like
+ * the program, with the share of cycles each instruction held the ROB head.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_profile.h"
+
+APEX_Profile *
+APEX_profile_create(int code_memory_size)
+{
+    APEX_Profile *prof = calloc(1, sizeof(APEX_Profile));
+
+    if (!prof)
+    {
+        return NULL;
+    }
+    prof->size = code_memory_size;
+    prof->pcs = calloc(code_memory_size + 1, sizeof(APEX_ProfileEntry));
+    if (!prof->pcs)
+    {
+        free(prof);
+        return NULL;
+    }
+    return prof;
+}
+
+void
+APEX_profile_free(APEX_Profile *prof)
+{
+    if (prof)
+    {
+        free(prof->pcs);
+        free(prof);
+    }
+}
+
+/* Counters of the instruction at pc, NULL outside code memory */
+static APEX_ProfileEntry *
+entry_of(const APEX_Profile *prof, int pc)
+{
+    int index = (pc - 4000) / 4;
+
+    if (pc < 4000 || index >= prof->size)
+    {
+        return NULL;
+    }
+    return &prof->pcs[index];
+}
+
+/* Called for every instruction leaving the ROB */
+void
+APEX_profile_commit(APEX_Profile *prof, int pc, int flushed)
+{
+    APEX_ProfileEntry *entry = entry_of(prof, pc);
+
+    if (entry)
+    {
+        entry->executed++;
+        entry->flushes += flushed;
+    }
+}
+
+static int
+reg_ready(const APEX_CPU *cpu, int phys)
+{
+    return phys < 0 || cpu->phys_regs_valid[phys] == 1;
+}
+
+/* Whether every physical source register of an issue queue entry is valid */
+static int
+operands_ready(const APEX_CPU *cpu, const IQ_ENTRY *iqe)
+{
+    switch (iqe->opcode)
+    {
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_CMP:
+    case OPCODE_MUL:
+    case OPCODE_LDR:
+    case OPCODE_STORE:
+        return reg_ready(cpu, iqe->src1) && reg_ready(cpu, iqe->src2);
+    case OPCODE_STR:
+        return reg_ready(cpu, iqe->src1) && reg_ready(cpu, iqe->src2) && reg_ready(cpu, iqe->src3);
+    case OPCODE_ADDL:
+    case OPCODE_SUBL:
+    case OPCODE_LOAD:
+    case OPCODE_JUMP:
+    case OPCODE_JAL:
+        return reg_ready(cpu, iqe->src1);
+    }
+    return TRUE;
+}
+
+/*
+ * Called after issue selection, every entry still in the issue queue was
+ * there during selection and did not issue
+ */
+void
+APEX_profile_issue(APEX_Profile *prof, const APEX_CPU *cpu)
+{
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        APEX_ProfileEntry *entry;
+
+        if (cpu->freeiq[i] != 1 || !(entry = entry_of(prof, cpu->IssueQueue[i].pc)))
+        {
+            continue;
+        }
+        if (operands_ready(cpu, &cpu->IssueQueue[i]))
+        {
+            entry->fu_wait++;
+        }
+        else
+        {
+            entry->operand_wait++;
+        }
+    }
+}
+
+/*
+ * Called after commit, the head entry is the one commit stopped at and every
+ * completed entry behind it waits for it
+ */
+void
+APEX_profile_rob(APEX_Profile *prof, const APEX_CPU *cpu)
+{
+    APEX_ProfileEntry *entry;
+
+    prof->cycles++;
+    if (cpu->rob_head == cpu->rob_tail)
+    {
+        return;
+    }
+    if ((entry = entry_of(prof, cpu->ROB[cpu->rob_head].pc)))
+    {
+        entry->head++;
+    }
+    for (int i = ROB_NEXT(cpu, cpu->rob_head); i != cpu->rob_tail; i = ROB_NEXT(cpu, i))
+    {
+        if (cpu->ROB[i].result_valid && (entry = entry_of(prof, cpu->ROB[i].pc)))
+        {
+            entry->rob_wait++;
+        }
+    }
+}
+
+/*
+ * Writes the annotated disassembly to filename, "-" for standard output
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_profile_write(const APEX_Profile *prof, const APEX_CPU *cpu, const char *filename)
+{
+    FILE *fp = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    APEX_ProfileEntry total = {0};
+    char text[64];
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open profile %s\n", filename);
+        return -1;
+    }
+
+    for (int i = 0; i < prof->size; i++)
+    {
+        total.executed += prof->pcs[i].executed;
+        total.operand_wait += prof->pcs[i].operand_wait;
+        total.fu_wait += prof->pcs[i].fu_wait;
+        total.rob_wait += prof->pcs[i].rob_wait;
+        total.head += prof->pcs[i].head;
+        total.flushes += prof->pcs[i].flushes;
+    }
+
+    fprintf(fp, "Profile: %ld cycles, %ld instructions committed\n", prof->cycles, total.executed);
+    fprintf(fp, "Percent: share of cycles the instruction blocked commit at the ROB head\n\n");
+    fprintf(fp, "%7s %9s %9s %9s %9s %9s %7s  %-5s %s\n", "Percent", "Executed", "Operand", "FU-wait",
+            "ROB-wait", "Head", "Flushes", "PC", "Instruction");
+    for (int i = 0; i < prof->size; i++)
+    {
+        const APEX_ProfileEntry *entry = &prof->pcs[i];
+
+        fprintf(fp, "%6.2f%% %9ld %9ld %9ld %9ld %9ld %7ld  %-5d %s\n",
+                prof->cycles ? 100.0 * entry->head / prof->cycles : 0.0, entry->executed,
+                entry->operand_wait, entry->fu_wait, entry->rob_wait, entry->head, entry->flushes,
+                4000 + 4 * i, APEX_format_instruction(&cpu->code_memory[i], text, sizeof(text)));
+    }
+    fprintf(fp, "%6.2f%% %9ld %9ld %9ld %9ld %9ld %7ld  total\n",
+            prof->cycles ? 100.0 * total.head / prof->cycles : 0.0, total.executed, total.operand_wait,
+            total.fu_wait, total.rob_wait, total.head, total.flushes);
+
+    if (fp != stdout && fclose(fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write profile %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * apex_profile.h
+ * Contains declarations of the per-PC hot-spot profiler of simulated code
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_PROFILE_H_
+#define _APEX_PROFILE_H_
+
+#include "apex_cpu.h"
+
+/* Counters of one static instruction */
+typedef struct APEX_ProfileEntry
+{
+    long executed;     /* Dynamic instances committed */
+    long operand_wait; /* Cycles in the issue queue with a source not ready */
+    long fu_wait;      /* Cycles in the issue queue ready but not selected */
+    long rob_wait;     /* Cycles completed in the ROB behind an older instruction */
+    long head;         /* Cycles at the ROB head blocking commit */
+    long flushes;      /* Pipeline flushes caused at commit */
+} APEX_ProfileEntry;
+
+typedef struct APEX_Profile
+{
+    int size;                /* Entries, one per code memory index */
+    long cycles;             /* Cycles profiled */
+    APEX_ProfileEntry *pcs;
+} APEX_Profile;
+
+APEX_Profile *APEX_profile_create(int code_memory_size);
+void APEX_profile_free(APEX_Profile *prof);
+void APEX_profile_commit(APEX_Profile *prof, int pc, int flushed);
+void APEX_profile_issue(APEX_Profile *prof, const APEX_CPU *cpu);
+void APEX_profile_rob(APEX_Profile *prof, const APEX_CPU *cpu);
+int APEX_profile_write(const APEX_Profile *prof, const APEX_CPU *cpu, const char *filename);
+#endif
@@ -0,0 +1,143 @@
+/*
+ * apex_ring.c
+ * Contains the lock-free ring between the functional and timing threads
+ *
+ * head and tail only grow, each written by one side and read by the other:
+ * the producer fills a slot and then publishes head with release order, the
+ * consumer reads head with acquire order before the slot, and the same the
+ * other way round for tail. Each side keeps the last value it saw of the
+ * other index and reads the shared one again only when that value says the
+ * ring is full or empty, so a run of pushes or pops touches no line the
+ * other side writes.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_macros.h"
+#include "apex_ring.h"
+
+#define LOAD(field) __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define STORE(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+
+/* Ring of size records, a power of two */
+APEX_Ring *
+APEX_ring_create(unsigned long size)
+{
+    APEX_Ring *ring = NULL;
+
+    if (posix_memalign((void **)&ring, RING_LINE, sizeof(APEX_Ring)) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate ring\n");
+        return NULL;
+    }
+    memset(ring, 0, sizeof(APEX_Ring));
+    ring->size = size;
+    if (posix_memalign((void **)&ring->slots, RING_LINE, size * sizeof(APEX_TraceRecord)) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate ring\n");
+        free(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+void
+APEX_ring_free(APEX_Ring *ring)
+{
+    if (ring)
+    {
+        free(ring->slots);
+    }
+    free(ring);
+}
+
+/* Lets the other side run after spins fruitless polls */
+static void
+backoff(int *spins)
+{
+    if (++*spins >= RING_SPINS)
+    {
+        sched_yield();
+        *spins = 0;
+    }
+}
+
+/*
+ * Appends rec, waiting while the ring is full
+ *
+ * Returns 0 on success, -1 once the consumer stopped
+ */
+int
+APEX_ring_push(APEX_Ring *ring, const APEX_TraceRecord *rec)
+{
+    unsigned long head = ring->head;
+    int spins = 0;
+
+    while (head - ring->tail_seen == ring->size)
+    {
+        if (LOAD(ring->stopped))
+        {
+            return -1;
+        }
+        ring->tail_seen = LOAD(ring->tail);
+        if (head - ring->tail_seen == ring->size)
+        {
+            backoff(&spins);
+        }
+    }
+    ring->slots[head & (ring->size - 1)] = *rec;
+    STORE(ring->head, head + 1);
+    return 0;
+}
+
+/* Ends the records, the consumer drains what is left */
+void
+APEX_ring_close(APEX_Ring *ring)
+{
+    STORE(ring->closed, TRUE);
+}
+
+/*
+ * Takes the oldest record into rec, waiting while the ring is empty
+ *
+ * Returns 0 on success, -1 once the producer closed the ring and it is empty
+ */
+int
+APEX_ring_pop(APEX_Ring *ring, APEX_TraceRecord *rec)
+{
+    unsigned long tail = ring->tail;
+    int spins = 0;
+
+    while (tail == ring->head_seen)
+    {
+        /* closed is read before head, a record pushed before closing is seen */
+        int closed = LOAD(ring->closed);
+
+        ring->head_seen = LOAD(ring->head);
+        if (tail != ring->head_seen)
+        {
+            break;
+        }
+        if (closed)
+        {
+            return -1;
+        }
+        backoff(&spins);
+    }
+    *rec = ring->slots[tail & (ring->size - 1)];
+    STORE(ring->tail, tail + 1);
+    return 0;
+}
+
+/* Takes no more records, a producer waiting on a full ring gives up */
+void
+APEX_ring_stop(APEX_Ring *ring)
+{
+    STORE(ring->stopped, TRUE);
+}
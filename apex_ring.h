@@ -0,0 +1,47 @@
+/*
+ * apex_ring.h
+ * Contains declarations of the single producer, single consumer ring which
+ * hands trace records from the functional model thread to the timing model
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_RING_H_
+#define _APEX_RING_H_
+
+#include "apex_trace.h"
+
+/* Bounds of the records the functional model may run ahead of the timing model */
+#define RING_MIN_SIZE 2
+#define RING_MAX_SIZE (1 << 20)
+
+/* Polls of a full or empty ring before the waiting side yields its core */
+#define RING_SPINS 256
+
+/* Bytes of a cache line, each side writes its own */
+#define RING_LINE 64
+
+typedef struct APEX_Ring
+{
+    unsigned long size;        /* Slots, a power of two */
+    APEX_TraceRecord *slots;
+
+    /* Written by the producer */
+    unsigned long head __attribute__((aligned(RING_LINE))); /* Records pushed */
+    int closed;                                              /* Nothing more will be pushed */
+    unsigned long tail_seen;                                 /* Its last look at tail */
+
+    /* Written by the consumer */
+    unsigned long tail __attribute__((aligned(RING_LINE))); /* Records popped */
+    int stopped;                                             /* Nothing more will be popped */
+    unsigned long head_seen;                                 /* Its last look at head */
+} APEX_Ring;
+
+APEX_Ring *APEX_ring_create(unsigned long size);
+void APEX_ring_free(APEX_Ring *ring);
+int APEX_ring_push(APEX_Ring *ring, const APEX_TraceRecord *rec);
+void APEX_ring_close(APEX_Ring *ring);
+int APEX_ring_pop(APEX_Ring *ring, APEX_TraceRecord *rec);
+void APEX_ring_stop(APEX_Ring *ring);
+#endif
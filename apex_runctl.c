@@ -0,0 +1,284 @@
+/*
+ * apex_runctl.c
+ * Contains the watchdog, the wall-clock budget and the interrupt handling
+ * of a run
+ *
+ * The signal handler only sets a flag, the run looks at it between two
+ * cycles and stops the way it does at its cycle limit: the state is printed
+ * and the analyses are written as usual.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "apex_macros.h"
+#include "apex_runctl.h"
+
+/* Last SIGINT or SIGTERM caught, 0 if none */
+static volatile sig_atomic_t caught_signal;
+
+static double
+monotonic_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Starts watching the run of cpu with the limits of opts */
+void
+APEX_runctl_start(APEX_RunCtl *rc, const APEX_Options *opts, const APEX_CPU *cpu)
+{
+    memset(rc, 0, sizeof(APEX_RunCtl));
+    rc->watchdog = opts->watchdog;
+    rc->time_limit = opts->time_limit;
+    if (rc->time_limit)
+    {
+        rc->deadline = monotonic_seconds() + rc->time_limit;
+    }
+    rc->progress_clock = cpu->clock;
+    rc->progress_insns = cpu->insn_completed;
+    rc->next_check = cpu->clock + RUNCTL_CHECK_INTERVAL;
+}
+
+static void
+catch_signal(int sig)
+{
+    caught_signal = sig;
+}
+
+/*
+ * Turns SIGINT and SIGTERM into a request to stop the run, a second one
+ * kills the process as usual
+ */
+void
+APEX_runctl_catch_signals(void)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = catch_signal;
+    sa.sa_flags = SA_RESETHAND | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+}
+
+/*
+ * Looks at the run after a cycle
+ *
+ * Returns RUN_ON while it may go on, else why it must stop
+ */
+int
+APEX_runctl_check(APEX_RunCtl *rc, const APEX_CPU *cpu)
+{
+    if (cpu->hook_failed)
+    {
+        return rc->stopped = RUN_FAILED;
+    }
+    if (cpu->insn_completed != rc->progress_insns)
+    {
+        rc->progress_insns = cpu->insn_completed;
+        rc->progress_clock = cpu->clock;
+    }
+    else if (rc->watchdog && cpu->clock - rc->progress_clock >= rc->watchdog)
+    {
+        return rc->stopped = RUN_STUCK;
+    }
+    if (cpu->clock >= rc->next_check)
+    {
+        rc->next_check = cpu->clock + RUNCTL_CHECK_INTERVAL;
+        if (caught_signal)
+        {
+            return rc->stopped = RUN_INTERRUPTED;
+        }
+        if (rc->time_limit && monotonic_seconds() >= rc->deadline)
+        {
+            return rc->stopped = RUN_TIMEOUT;
+        }
+    }
+    return RUN_ON;
+}
+
+/* Status word of a run stopped for stopped, as in the server replies */
+const char *
+APEX_runctl_status(int stopped)
+{
+    switch (stopped)
+    {
+    case RUN_STUCK:
+    {
+        return "stuck";
+    }
+    case RUN_TIMEOUT:
+    {
+        return "timeout";
+    }
+    case RUN_INTERRUPTED:
+    {
+        return "interrupted";
+    }
+    case RUN_FAILED:
+    {
+        return "failed";
+    }
+    }
+    return "running";
+}
+
+/* Prints the physical register src of an issue queue entry and whether it is ready */
+static void
+print_source(FILE *fp, const APEX_CPU *cpu, int src)
+{
+    fprintf(fp, " P%d%s", src, cpu->phys_regs_valid[src] ? "" : "(waiting)");
+}
+
+/* Physical registers an issue queue entry waits for, by opcode */
+static int
+source_count(int opcode)
+{
+    switch (opcode)
+    {
+    case OPCODE_STR:
+    {
+        return 3;
+    }
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_CMP:
+    case OPCODE_MUL:
+    case OPCODE_LDR:
+    case OPCODE_STORE:
+    {
+        return 2;
+    }
+    case OPCODE_ADDL:
+    case OPCODE_SUBL:
+    case OPCODE_LOAD:
+    case OPCODE_JUMP:
+    case OPCODE_JAL:
+    {
+        return 1;
+    }
+    }
+    return 0;
+}
+
+static void
+print_unit(FILE *fp, const char *name, const CPU_Stage *stage, int from_rob)
+{
+    if (stage->has_insn)
+    {
+        fprintf(fp, " %s:pc(%d)", name, from_rob ? stage->rob_entry->pc : stage->iq_entry.pc);
+    }
+}
+
+/*
+ * Prints why the run stopped and where the machine stands: the ROB head,
+ * the occupancy and free lists, the issue queue with the readiness of each
+ * source and the busy units
+ */
+void
+APEX_runctl_report(FILE *fp, const APEX_RunCtl *rc, const APEX_CPU *cpu)
+{
+    const ROB_ENTRY *head = &cpu->ROB[cpu->rob_head];
+    int rob = (cpu->rob_tail - cpu->rob_head + ROB_SIZE(cpu)) % ROB_SIZE(cpu);
+    int iq = 0, free_regs = 0;
+    char name[16];
+
+    switch (rc->stopped)
+    {
+    case RUN_STUCK:
+    {
+        fprintf(fp, "APEX_Error: Nothing committed for %d cycles since cycle %d\n", rc->watchdog,
+                rc->progress_clock);
+        break;
+    }
+    case RUN_TIMEOUT:
+    {
+        fprintf(fp, "APEX_Error: Wall-clock budget of %d seconds spent at cycle %d\n", rc->time_limit, cpu->clock);
+        break;
+    }
+    case RUN_INTERRUPTED:
+    {
+        fprintf(fp, "APEX_Error: Interrupted by signal %d at cycle %d\n", (int)caught_signal, cpu->clock);
+        break;
+    }
+    case RUN_FAILED:
+    {
+        fprintf(fp, "APEX_Error: Analysis of the run failed at cycle %d\n", cpu->clock);
+        break;
+    }
+    }
+
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        iq += cpu->freeiq[i] == 1;
+    }
+    for (int i = 0; i < PHYS_REGS(cpu); i++)
+    {
+        free_regs += cpu->free_PR_list[i] == 0;
+    }
+    fprintf(fp, "  ROB %d/%d, IQ %d/%d, free physical registers %d/%d\n", rob, ROB_SIZE(cpu), iq, IQ_SIZE(cpu),
+            free_regs, PHYS_REGS(cpu));
+    if (rob)
+    {
+        fprintf(fp, "  ROB head [%d] pc(%d) %s: result %s%s\n", cpu->rob_head, head->pc, head->opcode_str,
+                head->result_valid ? "valid" : "pending", head->mready ? ", memory access issued" : "");
+    }
+    for (int i = 0; i < IQ_SIZE(cpu); i++)
+    {
+        const IQ_ENTRY *iqe = &cpu->IssueQueue[i];
+        int n = source_count(iqe->opcode);
+
+        if (cpu->freeiq[i] != 1)
+        {
+            continue;
+        }
+        fprintf(fp, "  IQ[%d] pc(%d) %s:", i, iqe->pc, iqe->opcode_str);
+        if (n > 0)
+        {
+            print_source(fp, cpu, iqe->src1);
+        }
+        if (n > 1)
+        {
+            print_source(fp, cpu, iqe->src2);
+        }
+        if (n > 2)
+        {
+            print_source(fp, cpu, iqe->src3);
+        }
+        fprintf(fp, "\n");
+    }
+    fprintf(fp, "  Fetch%s%s, decode%s%s%s, units busy:", cpu->fetch.has_insn ? "" : " idle",
+            cpu->fetch.stalled ? " stalled" : "", cpu->decode.has_insn ? "" : " idle",
+            cpu->decode.stalled ? " stalled" : "", cpu->flush_pending ? ", flush pending" : "");
+    for (int lane = 0; lane < INTFU_COUNT(cpu); lane++)
+    {
+        snprintf(name, sizeof(name), "INTFU%d", lane);
+        print_unit(fp, name, &cpu->intfu[lane], FALSE);
+    }
+    for (int lane = 0; lane < MULFU_COUNT(cpu); lane++)
+    {
+        snprintf(name, sizeof(name), "MUL1.%d", lane);
+        print_unit(fp, name, &cpu->mul1[lane], FALSE);
+        snprintf(name, sizeof(name), "MUL2.%d", lane);
+        print_unit(fp, name, &cpu->mul2[lane], FALSE);
+        snprintf(name, sizeof(name), "MUL3.%d", lane);
+        print_unit(fp, name, &cpu->mul3[lane], FALSE);
+    }
+    print_unit(fp, "JBU1", &cpu->jbu1, FALSE);
+    print_unit(fp, "JBU2", &cpu->jbu2, FALSE);
+    print_unit(fp, "MEM1", &cpu->memory1, TRUE);
+    print_unit(fp, "MEM2", &cpu->memory2, TRUE);
+    fprintf(fp, "\n");
+}
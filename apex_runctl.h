@@ -0,0 +1,52 @@
+/*
+ * apex_runctl.h
+ * Contains declarations of the run control, which stops a run that no
+ * longer commits, outlives its wall-clock budget or is interrupted, so
+ * that the stats gathered so far are still written
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_RUNCTL_H_
+#define _APEX_RUNCTL_H_
+
+#include <stdio.h>
+
+#include "apex_cpu.h"
+#include "apex_options.h"
+
+/* Cycles without a commit before a run is taken for stuck, no instruction
+ * of the model waits anywhere near as long */
+#define RUNCTL_DEFAULT_WATCHDOG 100000
+
+/* Cycles between two looks at the wall clock and at caught signals */
+#define RUNCTL_CHECK_INTERVAL 4096
+
+/* Why a run was stopped */
+enum
+{
+    RUN_ON,          /* It was not */
+    RUN_STUCK,       /* Nothing committed for the watchdog cycles */
+    RUN_TIMEOUT,     /* The wall-clock budget is spent */
+    RUN_INTERRUPTED, /* SIGINT or SIGTERM */
+    RUN_FAILED       /* An analysis attached to the CPU failed */
+};
+
+typedef struct APEX_RunCtl
+{
+    int watchdog;         /* Cycles without a commit allowed, 0 for no watchdog */
+    int time_limit;       /* Wall-clock seconds of the run, 0 for no budget */
+    double deadline;      /* Monotonic clock time the budget ends at */
+    int progress_clock;   /* Cycle of the last commit seen */
+    int progress_insns;   /* Commits seen */
+    int next_check;       /* Cycle of the next look at the clock and signals */
+    int stopped;          /* RUN_* */
+} APEX_RunCtl;
+
+void APEX_runctl_start(APEX_RunCtl *rc, const APEX_Options *opts, const APEX_CPU *cpu);
+void APEX_runctl_catch_signals(void);
+int APEX_runctl_check(APEX_RunCtl *rc, const APEX_CPU *cpu);
+const char *APEX_runctl_status(int stopped);
+void APEX_runctl_report(FILE *fp, const APEX_RunCtl *rc, const APEX_CPU *cpu);
+#endif
@@ -0,0 +1,447 @@
+/*
+ * apex_schedule.c
+ * Contains the static list scheduler of APEX programs
+ *
+ * The program is cut into basic blocks at branch targets and after every
+ * BZ, BNZ, JUMP, JAL and HALT. Within a block an instruction depends on an
+ * older one when they share a register (read after write, write after read
+ * or write after write), the zero flag, or data memory with at least one
+ * store among the two; memory is not disambiguated. The zero flag is written
+ * by ADD, SUB, SUBL and CMP and read by BZ and BNZ, as in the pipeline. The
+ * instruction ending a block depends on every other one, so it stays last.
+ *
+ * Each block is then list scheduled one instruction per cycle: of the
+ * instructions whose operands are available, the one with the longest
+ * latency weighted path to the end of the block goes first, ties keep
+ * program order. Latencies are those of the configured machine.
+ *
+ * Register indirect jumps are assumed to land on a MOVC constant plus the
+ * offset of some JUMP or JAL, or after a JAL, those addresses start blocks.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_options.h"
+#include "apex_schedule.h"
+
+#define BIT(r) (1U << (r))
+
+/*
+ * Registers and zero flag ins reads into *reads and writes into *writes, one
+ * bit each, the flag at SCHEDULE_FLAG
+ */
+void
+APEX_schedule_resources(const APEX_Instruction *ins, unsigned *reads, unsigned *writes)
+{
+    *reads = 0;
+    *writes = 0;
+    switch (ins->opcode)
+    {
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    {
+        *reads = BIT(ins->rs1) | BIT(ins->rs2);
+        *writes = BIT(ins->rd) | BIT(SCHEDULE_FLAG);
+        break;
+    }
+    case OPCODE_CMP:
+    {
+        *reads = BIT(ins->rs1) | BIT(ins->rs2);
+        *writes = BIT(SCHEDULE_FLAG);
+        break;
+    }
+    case OPCODE_SUBL:
+    {
+        *reads = BIT(ins->rs1);
+        *writes = BIT(ins->rd) | BIT(SCHEDULE_FLAG);
+        break;
+    }
+    case OPCODE_MUL:
+    case OPCODE_DIV:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_LDR:
+    {
+        *reads = BIT(ins->rs1) | BIT(ins->rs2);
+        *writes = BIT(ins->rd);
+        break;
+    }
+    case OPCODE_ADDL:
+    case OPCODE_LOAD:
+    case OPCODE_JAL:
+    {
+        *reads = BIT(ins->rs1);
+        *writes = BIT(ins->rd);
+        break;
+    }
+    case OPCODE_MOVC:
+    {
+        *writes = BIT(ins->rd);
+        break;
+    }
+    case OPCODE_STORE:
+    {
+        *reads = BIT(ins->rs1) | BIT(ins->rs2);
+        break;
+    }
+    case OPCODE_STR:
+    {
+        *reads = BIT(ins->rs1) | BIT(ins->rs2) | BIT(ins->rs3);
+        break;
+    }
+    case OPCODE_BZ:
+    case OPCODE_BNZ:
+    {
+        *reads = BIT(SCHEDULE_FLAG);
+        break;
+    }
+    case OPCODE_JUMP:
+    {
+        *reads = BIT(ins->rs1);
+        break;
+    }
+    }
+}
+
+static int
+ends_block(const APEX_Instruction *ins)
+{
+    return ins->opcode == OPCODE_BZ || ins->opcode == OPCODE_BNZ || ins->opcode == OPCODE_JUMP ||
+           ins->opcode == OPCODE_JAL || ins->opcode == OPCODE_HALT;
+}
+
+static int
+is_load(const APEX_Instruction *ins)
+{
+    return ins->opcode == OPCODE_LOAD || ins->opcode == OPCODE_LDR;
+}
+
+static int
+is_store(const APEX_Instruction *ins)
+{
+    return ins->opcode == OPCODE_STORE || ins->opcode == OPCODE_STR;
+}
+
+/* Cycles from issue of ins until a dependent instruction can use its result */
+static int
+latency(const APEX_CPU *cpu, const APEX_Instruction *ins)
+{
+    if (ins->opcode == OPCODE_MUL)
+    {
+        return MUL_LATENCY(cpu);
+    }
+    if (is_load(ins) || is_store(ins))
+    {
+        return INTFU_LATENCY(cpu) + MEM_LATENCY(cpu);
+    }
+    return INTFU_LATENCY(cpu);
+}
+
+/* Code memory index of the BZ/BNZ at index, -1 outside the program */
+static int
+branch_target(const APEX_Instruction *code, int size, int index)
+{
+    int target = index + code[index].imm / 4;
+
+    return (code[index].imm % 4 == 0 && target >= 0 && target < size) ? target : -1;
+}
+
+/*
+ * Marks in leader every instruction which starts a basic block, JUMP and JAL
+ * targets as far as a MOVC constant gives them away
+ */
+void
+APEX_schedule_leaders(const APEX_Instruction *code, int size, char *leader)
+{
+    memset(leader, 0, size);
+    leader[0] = TRUE;
+    for (int i = 0; i < size; i++)
+    {
+        if (ends_block(&code[i]) && i + 1 < size)
+        {
+            leader[i + 1] = TRUE;
+        }
+        if ((code[i].opcode == OPCODE_BZ || code[i].opcode == OPCODE_BNZ) && branch_target(code, size, i) >= 0)
+        {
+            leader[branch_target(code, size, i)] = TRUE;
+        }
+        if (code[i].opcode != OPCODE_JUMP && code[i].opcode != OPCODE_JAL)
+        {
+            continue;
+        }
+        for (int j = 0; j < size; j++)
+        {
+            int target = (code[j].imm + code[i].imm - 4000) / 4;
+
+            if (code[j].opcode == OPCODE_MOVC && (code[j].imm + code[i].imm) % 4 == 0 && target >= 0 && target < size)
+            {
+                leader[target] = TRUE;
+            }
+        }
+    }
+}
+
+/*
+ * Builds the dependence graph of the n instructions of the block starting at
+ * code, edge[i * n + j] is the latency from i to j, -1 without dependence
+ */
+static void
+build_graph(const APEX_CPU *cpu, const APEX_Instruction *code, int n, ScheduleNode *nodes, int *edge)
+{
+    for (int j = 0; j < n; j++)
+    {
+        unsigned rj, wj;
+
+        APEX_schedule_resources(&code[j], &rj, &wj);
+        nodes[j].latency = latency(cpu, &code[j]);
+        nodes[j].npreds = 0;
+        nodes[j].earliest = 0;
+        nodes[j].scheduled = FALSE;
+        for (int i = 0; i < j; i++)
+        {
+            unsigned ri, wi;
+            int lat = -1;
+
+            APEX_schedule_resources(&code[i], &ri, &wi);
+            if (wi & rj)
+            {
+                lat = nodes[i].latency;
+            }
+            else if ((ri & wj) || (wi & wj) || (is_store(&code[i]) && (is_load(&code[j]) || is_store(&code[j]))) ||
+                     (is_load(&code[i]) && is_store(&code[j])) || (j == n - 1 && ends_block(&code[j])))
+            {
+                lat = 0;
+            }
+            edge[i * n + j] = lat;
+            nodes[j].npreds += lat >= 0;
+        }
+        for (int i = j; i < n; i++)
+        {
+            edge[i * n + j] = -1;
+        }
+    }
+
+    /* Successors are younger, heights are final walking backwards */
+    for (int i = n - 1; i >= 0; i--)
+    {
+        nodes[i].height = nodes[i].latency;
+        for (int j = i + 1; j < n; j++)
+        {
+            if (edge[i * n + j] >= 0 && nodes[i].latency + nodes[j].height > nodes[i].height)
+            {
+                nodes[i].height = nodes[i].latency + nodes[j].height;
+            }
+        }
+    }
+}
+
+/* List schedules the block of n nodes into order, as indices into the block */
+static void
+schedule_block(ScheduleNode *nodes, const int *edge, int n, int *order)
+{
+    int cycle = 0;
+
+    for (int placed = 0; placed < n; cycle++)
+    {
+        int best = -1;
+
+        for (int i = 0; i < n; i++)
+        {
+            if (!nodes[i].scheduled && nodes[i].npreds == 0 && nodes[i].earliest <= cycle &&
+                (best < 0 || nodes[i].height > nodes[best].height))
+            {
+                best = i;
+            }
+        }
+        if (best < 0)
+        {
+            continue;
+        }
+        nodes[best].scheduled = TRUE;
+        order[placed++] = best;
+        for (int j = 0; j < n; j++)
+        {
+            if (edge[best * n + j] >= 0)
+            {
+                nodes[j].npreds--;
+                if (cycle + edge[best * n + j] > nodes[j].earliest)
+                {
+                    nodes[j].earliest = cycle + edge[best * n + j];
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Reorders the instructions of every basic block of code for the machine of
+ * cpu and fixes up the BZ/BNZ offsets, the number of blocks goes to *blocks
+ *
+ * Returns the number of instructions which moved, -1 on failure
+ */
+int
+APEX_schedule_program(const APEX_CPU *cpu, APEX_Instruction *code, int size, int *blocks)
+{
+    APEX_Instruction *old = malloc(sizeof(APEX_Instruction) * size);
+    ScheduleNode *nodes = malloc(sizeof(ScheduleNode) * size);
+    int *order = malloc(sizeof(int) * size);
+    int *newpos = malloc(sizeof(int) * size);
+    char *leader = malloc(size);
+    int *edge = NULL;
+    int moved = 0;
+
+    *blocks = 0;
+    if (!old || !nodes || !order || !newpos || !leader)
+    {
+        moved = -1;
+        goto out;
+    }
+    memcpy(old, code, sizeof(APEX_Instruction) * size);
+    APEX_schedule_leaders(old, size, leader);
+
+    for (int start = 0, end; start < size; start = end)
+    {
+        int n;
+
+        for (end = start + 1; end < size && !leader[end]; end++)
+        {
+        }
+        n = end - start;
+        free(edge);
+        if (!(edge = malloc(sizeof(int) * n * n)))
+        {
+            moved = -1;
+            goto out;
+        }
+        build_graph(cpu, &old[start], n, nodes, edge);
+        schedule_block(nodes, edge, n, order);
+        for (int k = 0; k < n; k++)
+        {
+            newpos[start + order[k]] = start + k;
+            code[start + k] = old[start + order[k]];
+            moved += order[k] != k;
+        }
+        (*blocks)++;
+    }
+
+    /* A target starts a block, which begins at the same index as before
+     * whatever instruction now comes first in it */
+    for (int i = 0; i < size; i++)
+    {
+        int target;
+
+        if ((old[i].opcode == OPCODE_BZ || old[i].opcode == OPCODE_BNZ) && (target = branch_target(old, size, i)) >= 0)
+        {
+            code[newpos[i]].imm = (target - newpos[i]) * 4;
+        }
+    }
+
+out:
+    free(edge);
+    free(leader);
+    free(newpos);
+    free(order);
+    free(nodes);
+    free(old);
+    return moved;
+}
+
+/*
+ * Writes code in the syntax of the input file
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_schedule_write(const APEX_Instruction *code, int size, const char *filename)
+{
+    FILE *fp = fopen(filename, "w");
+    char buf[160];
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open %s\n", filename);
+        return -1;
+    }
+    for (int i = 0; i < size; i++)
+    {
+        fprintf(fp, "%s\n", APEX_format_instruction(&code[i], buf, sizeof(buf)));
+    }
+    if (fclose(fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/* Runs cpu until HALT commits or SCHEDULE_MAX_CYCLES, returns TRUE on HALT */
+static int
+run_to_halt(APEX_CPU *cpu)
+{
+    while (cpu->clock < SCHEDULE_MAX_CYCLES)
+    {
+        if (APEX_cpu_cycle(cpu))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * Schedules the program of cpu into output, then simulates the program as
+ * given on cpu and as scheduled on a second CPU and compares the two runs
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_schedule_run(APEX_CPU *cpu, const APEX_Options *opts, const char *output)
+{
+    APEX_CPU *after = calloc(1, sizeof(APEX_CPU));
+    APEX_Instruction *code = malloc(sizeof(APEX_Instruction) * cpu->code_memory_size);
+    int blocks, moved, halted_before, halted_after;
+
+    if (!after || !code)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate scheduled program\n");
+        free(after);
+        free(code);
+        return -1;
+    }
+    memcpy(code, cpu->code_memory, sizeof(APEX_Instruction) * cpu->code_memory_size);
+    moved = APEX_schedule_program(cpu, code, cpu->code_memory_size, &blocks);
+    /* The second CPU owns the scheduled code from here on */
+    if (moved < 0 || APEX_cpu_reset(after, code, cpu->code_memory_size, opts) < 0 ||
+        APEX_schedule_write(code, cpu->code_memory_size, output) < 0)
+    {
+        if (moved < 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to allocate scheduler\n");
+        }
+        after->code_memory = code;
+        APEX_cpu_stop(after);
+        return -1;
+    }
+    printf("APEX_Schedule: %s written, %d of %d instructions moved in %d basic blocks\n", output, moved,
+           cpu->code_memory_size, blocks);
+
+    ENABLE_DEBUG_MESSAGES = FALSE;
+    halted_before = run_to_halt(cpu);
+    halted_after = run_to_halt(after);
+    printf("APEX_Schedule: before: %s, cycles = %d instructions = %d\n", halted_before ? "Complete" : "Stopped",
+           cpu->clock, cpu->insn_completed);
+    printf("APEX_Schedule: after:  %s, cycles = %d instructions = %d\n", halted_after ? "Complete" : "Stopped",
+           after->clock, after->insn_completed);
+    printf("APEX_Schedule: cycles %+d (%+.1f%%)\n", after->clock - cpu->clock,
+           cpu->clock ? 100.0 * (after->clock - cpu->clock) / cpu->clock : 0.0);
+    APEX_cpu_stop(after);
+    return 0;
+}
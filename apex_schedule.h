@@ -0,0 +1,38 @@
+/*
+ * apex_schedule.h
+ * Contains declarations of the static list scheduler, which reorders the
+ * instructions of each basic block of a program for the configured machine
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_SCHEDULE_H_
+#define _APEX_SCHEDULE_H_
+
+#include "apex_cpu.h"
+#include "apex_options.h"
+
+/* Cycles a run of the schedule command may take before it is stopped */
+#define SCHEDULE_MAX_CYCLES 10000000
+
+/* Zero flag as a dependence graph resource, next to the 16 registers */
+#define SCHEDULE_FLAG REG_FILE_SIZE
+
+/* A node of the dependence graph of one basic block */
+typedef struct ScheduleNode
+{
+    int index;       /* Position in code memory before scheduling */
+    int latency;     /* Cycles until a consumer can use the result */
+    int height;      /* Longest latency path from here to the end of the block */
+    int npreds;      /* Predecessors not scheduled yet */
+    int earliest;    /* First cycle all operands are available */
+    int scheduled;
+} ScheduleNode;
+
+void APEX_schedule_resources(const APEX_Instruction *ins, unsigned *reads, unsigned *writes);
+void APEX_schedule_leaders(const APEX_Instruction *code, int size, char *leader);
+int APEX_schedule_program(const APEX_CPU *cpu, APEX_Instruction *code, int size, int *blocks);
+int APEX_schedule_write(const APEX_Instruction *code, int size, const char *filename);
+int APEX_schedule_run(APEX_CPU *cpu, const APEX_Options *opts, const char *output);
+#endif
@@ -0,0 +1,407 @@
+/*
+ * apex_server.c
+ * Contains the simulation server: one process runs job after job read from
+ * standard input or a Unix domain socket and answers each with one JSON line
+ *
+ * A job is a line in the syntax of the command line, without the mode:
+ *
+ *     <input_file> [cycles] [--name=value ...]
+ *
+ * and runs like "simulate". Programs are parsed once and kept, keyed by the
+ * file contents, so an edited file is parsed again. The CPU is
+ * allocated once and reset for every job. The line "quit" stops the server.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "apex_cache.h"
+#include "apex_cpu.h"
+#include "apex_memimage.h"
+#include "apex_options.h"
+#include "apex_oracle.h"
+#include "apex_runctl.h"
+#include "apex_server.h"
+
+static uint64_t
+content_hash(const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    return hash ? hash : 1;
+}
+
+/* Writes s as a JSON string */
+static void
+json_string(FILE *out, const char *s)
+{
+    putc('"', out);
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fprintf(out, "\\%c", *s);
+        }
+        else if ((unsigned char)*s < 0x20)
+        {
+            fprintf(out, "\\u%04x", *s);
+        }
+        else
+        {
+            putc(*s, out);
+        }
+    }
+    putc('"', out);
+}
+
+static void
+job_error(FILE *out, long job, const char *error)
+{
+    fprintf(out, "{\"job\":%ld,\"status\":\"error\",\"error\":", job);
+    json_string(out, error);
+    fprintf(out, "}\n");
+}
+
+/*
+ * Finds the parsed program in filename, parsing it on a cache miss. The
+ * contents are read once, the program is parsed from the same bytes it is
+ * keyed by.
+ *
+ * Returns the program, NULL with error set when it cannot be read or parsed
+ */
+static ServerProgram *
+lookup_program(APEX_Server *srv, const char *filename, const char **error)
+{
+    FILE *fp = fopen(filename, "r");
+    ServerProgram *prog, *victim = &srv->cache[0];
+    size_t size;
+    uint64_t hash;
+    int too_long, failed;
+
+    *error = "unable to read input file";
+    if (!fp)
+    {
+        return NULL;
+    }
+    size = fread(srv->file, 1, SERVER_PROGRAM_MAX, fp);
+    /* A full buffer may hold the whole file, a further byte makes it too long */
+    too_long = !feof(fp) && getc(fp) != EOF;
+    failed = ferror(fp);
+    fclose(fp);
+    if (failed)
+    {
+        return NULL;
+    }
+    if (too_long)
+    {
+        *error = "input file too long";
+        return NULL;
+    }
+    hash = content_hash(srv->file, size);
+
+    for (int i = 0; i < SERVER_CACHE_SIZE; i++)
+    {
+        prog = &srv->cache[i];
+        if (prog->hash == hash && prog->size == size && memcmp(prog->contents, srv->file, size) == 0)
+        {
+            prog->last_used = srv->jobs;
+            srv->hits++;
+            return prog;
+        }
+        if (prog->last_used < victim->last_used)
+        {
+            victim = prog;
+        }
+    }
+
+    free(victim->code_memory);
+    free(victim->contents);
+    memset(victim, 0, sizeof(ServerProgram));
+    if (size == 0 || !(fp = fmemopen(srv->file, size, "r")))
+    {
+        return NULL;
+    }
+    victim->code_memory = read_code_memory(fp, &victim->code_memory_size);
+    fclose(fp);
+    if (!victim->code_memory || !(victim->contents = malloc(size)))
+    {
+        free(victim->code_memory);
+        victim->code_memory = NULL;
+        return NULL;
+    }
+    memcpy(victim->contents, srv->file, size);
+    victim->hash = hash;
+    victim->size = size;
+    victim->last_used = srv->jobs;
+    return victim;
+}
+
+/* Runs the job in line and writes its result line to out */
+static void
+run_job(APEX_Server *srv, char *line, FILE *out)
+{
+    APEX_CPU *cpu = srv->cpu;
+    APEX_Options opts;
+    ServerProgram *prog;
+    const char *program = NULL;
+    long cycles = 0;
+    long job = ++srv->jobs;
+    int halted = FALSE, cached = FALSE;
+    int clock, insns;
+    APEX_CacheKey key;
+    APEX_CacheEntry entry;
+    APEX_RunCtl runctl;
+    const char *error;
+    char *end;
+
+    APEX_options_init(&opts);
+    for (char *tok = strtok(line, " \t"); tok; tok = strtok(NULL, " \t"))
+    {
+        if (strncmp(tok, "--", 2) == 0)
+        {
+            if (APEX_options_parse(&opts, tok) < 0)
+            {
+                job_error(out, job, "invalid option");
+                return;
+            }
+        }
+        else if (!program)
+        {
+            program = tok;
+        }
+        else
+        {
+            cycles = strtol(tok, &end, 10);
+            if (*end != '\0' || cycles < 0)
+            {
+                job_error(out, job, "invalid cycle count");
+                return;
+            }
+        }
+    }
+    if (!program)
+    {
+        job_error(out, job, "no input file");
+        return;
+    }
+    if (APEX_options_any_analysis(&opts) || opts.batch_file || opts.server_endpoint || opts.checkpoint_file ||
+        opts.simpoint_file || opts.kernel_file || opts.space_file)
+    {
+        job_error(out, job, "option not available in server jobs");
+        return;
+    }
+    if (APEX_options_check(&opts) < 0)
+    {
+        job_error(out, job, "invalid configuration");
+        return;
+    }
+    if (!(prog = lookup_program(srv, program, &error)))
+    {
+        job_error(out, job, error);
+        return;
+    }
+    /* The reset forgets the oracle of the previous job */
+    APEX_oracle_free(cpu->oracle);
+    if (APEX_cpu_reset(cpu, prog->code_memory, prog->code_memory_size, &opts) < 0)
+    {
+        job_error(out, job, "unable to load data memory");
+        return;
+    }
+
+    /* A memory dump needs the run itself */
+    if (opts.cache_dir && !opts.mem_dump_file)
+    {
+        APEX_cache_key(cpu, (int)cycles, &key);
+        cached = APEX_cache_lookup(opts.cache_dir, &key, &entry);
+    }
+    APEX_runctl_start(&runctl, &opts, cpu);
+    if (cached)
+    {
+        halted = entry.halted;
+        clock = entry.cycles;
+        insns = entry.insns;
+    }
+    else
+    {
+        while (!halted && (!cycles || cpu->clock < cycles) && APEX_runctl_check(&runctl, cpu) == RUN_ON)
+        {
+            halted = APEX_cpu_cycle(cpu);
+        }
+        clock = cpu->clock;
+        insns = cpu->insn_completed;
+        if (opts.cache_dir && !opts.mem_dump_file && !runctl.stopped)
+        {
+            APEX_cache_store(opts.cache_dir, &key, halted, clock, insns, opts.cache_size);
+        }
+    }
+    if (opts.mem_dump_file && APEX_memimage_dump(cpu, opts.mem_dump_file, opts.mem_dump_format) < 0)
+    {
+        job_error(out, job, "unable to write memory dump");
+        return;
+    }
+
+    fprintf(out, "{\"job\":%ld,\"program\":", job);
+    json_string(out, program);
+    fprintf(out, ",\"status\":\"%s\",\"cached\":%s,\"cycles\":%d,\"instructions\":%d,\"ipc\":%.4f,",
+            halted ? "complete" : runctl.stopped ? APEX_runctl_status(runctl.stopped) : "stopped",
+            cached ? "true" : "false", clock, insns,
+            clock ? (double)insns / clock : 0.0);
+    fprintf(out, "\"config\":{\"name\":");
+    json_string(out, cpu->config.name);
+    fprintf(out, ",\"rob\":%d,\"iq\":%d,\"prf\":%d,\"intfu\":%d,\"intfu_latency\":%d,\"mul\":%d,"
+                 "\"mul_latency\":%d,\"mem_latency\":%d}}\n",
+            cpu->config.rob_size, cpu->config.iq_size, cpu->config.phys_regs, cpu->config.intfu_count,
+            cpu->config.intfu_latency, cpu->config.mulfu_count, cpu->config.mul_latency,
+            cpu->config.mem_latency);
+}
+
+/*
+ * Runs the jobs read from in until its end
+ *
+ * Returns TRUE when a client asked the server to quit
+ */
+static int
+serve_stream(APEX_Server *srv, FILE *in, FILE *out)
+{
+    char line[SERVER_LINE_MAX];
+
+    while (fgets(line, sizeof(line), in))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+        {
+            continue;
+        }
+        if (strcmp(line, "quit") == 0)
+        {
+            return TRUE;
+        }
+        run_job(srv, line, out);
+        fflush(out);
+    }
+    return FALSE;
+}
+
+/* Accepts one client at a time on a Unix domain socket at path */
+static int
+serve_socket(APEX_Server *srv, const char *path)
+{
+    struct sockaddr_un addr;
+    int fd, quit = FALSE;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "APEX_Error: Socket path %s is too long\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to listen on %s\n", path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    while (!quit)
+    {
+        int client = accept(fd, NULL, NULL);
+        FILE *in, *out;
+
+        if (client < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        in = fdopen(client, "r");
+        out = fdopen(dup(client), "w");
+        if (in && out)
+        {
+            quit = serve_stream(srv, in, out);
+        }
+        if (in)
+        {
+            fclose(in);
+        }
+        if (out)
+        {
+            fclose(out);
+        }
+    }
+    close(fd);
+    unlink(path);
+    return quit ? 0 : -1;
+}
+
+/*
+ * Serves jobs from standard input when endpoint is "-", from a Unix domain
+ * socket at endpoint otherwise
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_server_run(const char *endpoint)
+{
+    APEX_Server *srv = calloc(1, sizeof(APEX_Server));
+    int ret;
+
+    if (!srv || !(srv->cpu = calloc(1, sizeof(APEX_CPU))) || !(srv->file = malloc(SERVER_PROGRAM_MAX)))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate server\n");
+        if (srv)
+        {
+            free(srv->cpu);
+        }
+        free(srv);
+        return -1;
+    }
+    ENABLE_DEBUG_MESSAGES = FALSE;
+    /* A client leaving early must not take the server down */
+    signal(SIGPIPE, SIG_IGN);
+
+    if (strcmp(endpoint, "-") == 0)
+    {
+        serve_stream(srv, stdin, stdout);
+        ret = 0;
+    }
+    else
+    {
+        ret = serve_socket(srv, endpoint);
+    }
+
+    fprintf(stderr, "APEX_Server: %ld jobs, %ld programs served from cache\n", srv->jobs, srv->hits);
+    for (int i = 0; i < SERVER_CACHE_SIZE; i++)
+    {
+        free(srv->cache[i].code_memory);
+        free(srv->cache[i].contents);
+    }
+    /* The cache owns the code memory */
+    srv->cpu->code_memory = NULL;
+    APEX_cpu_stop(srv->cpu);
+    free(srv->file);
+    free(srv);
+    return ret;
+}
@@ -0,0 +1,46 @@
+/*
+ * apex_server.h
+ * Contains declarations of the simulation server, which runs many jobs in
+ * one process
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_SERVER_H_
+#define _APEX_SERVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "apex_cpu.h"
+
+/* Parsed programs kept between jobs */
+#define SERVER_CACHE_SIZE 64
+
+/* Longest job line and longest program file accepted */
+#define SERVER_LINE_MAX 4096
+#define SERVER_PROGRAM_MAX (1 << 20)
+
+/* A parsed program, identified by the contents of its file */
+typedef struct ServerProgram
+{
+    uint64_t hash;                 /* FNV-1a of the file, 0 for a free slot */
+    size_t size;
+    char *contents;                /* The file, compared on a hash match */
+    APEX_Instruction *code_memory;
+    int code_memory_size;
+    long last_used;                /* Job which used it last, the oldest is replaced */
+} ServerProgram;
+
+typedef struct APEX_Server
+{
+    APEX_CPU *cpu;                 /* Reset for every job */
+    ServerProgram cache[SERVER_CACHE_SIZE];
+    char *file;                    /* Contents of the program of the current job */
+    long jobs;
+    long hits;                     /* Jobs whose program was already parsed */
+} APEX_Server;
+
+int APEX_server_run(const char *endpoint);
+#endif
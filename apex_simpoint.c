@@ -0,0 +1,925 @@
+/*
+ * apex_simpoint.c
+ * Contains the basic block vector profile and the sampled run
+ *
+ * The simpoint command runs the program on the functional model and cuts
+ * the run into intervals of a fixed number of instructions. Each interval
+ * is summarised by its basic block vector, the instructions it executed in
+ * every basic block, scaled to add up to one. The vectors are projected on
+ * a few random dimensions and clustered with k-means, the number of
+ * clusters being the smallest whose BIC score comes close to the best one.
+ * The interval nearest to the center of a cluster represents it, weighted
+ * by the share of the run the cluster covers, and the next nearest one is
+ * kept as a spare.
+ *
+ * The sample command first runs the program functionally once, keeping the
+ * architectural state a warm-up period before the start of every listed
+ * interval. Worker threads then simulate the intervals in detail, each on a
+ * CPU of its own: the warm-up fills the pipeline from empty and only the
+ * cycles of the interval itself are counted. Their CPI is weighed into the
+ * CPI of the whole run. The spread between the representative and the spare
+ * of each cluster gives the error estimate; clusters of a single interval
+ * are taken as exact.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_oracle.h"
+#include "apex_schedule.h"
+#include "apex_simpoint.h"
+
+/* Basic block vectors of the profiled run, projected */
+typedef struct Profile
+{
+    long insns;
+    int halted;
+    int count;        /* Intervals */
+    int capacity;
+    int blocks;       /* Basic blocks executed */
+    double *vectors;  /* count x SIMPOINT_DIMS */
+    long *lengths;    /* Instructions of each interval */
+} Profile;
+
+/* Start and result of the detailed run of one interval */
+typedef struct Sample
+{
+    APEX_Oracle state; /* Architectural state where the warm-up starts */
+    int pc;
+    long warm;         /* Instructions simulated before the interval */
+    long cycles;       /* Cycles and instructions of the interval itself */
+    long insns;
+    int failed;
+} Sample;
+
+/* Samples shared by the worker threads of a sampled run */
+typedef struct SampleJobs
+{
+    const APEX_CPU *cpu;
+    APEX_Options opts;
+    const APEX_SimPoints *sp;
+    Sample *samples;
+    int next;              /* First sample no worker has taken */
+    pthread_mutex_t lock;
+} SampleJobs;
+
+/* xorshift64*, the same on every host */
+static double
+random_unit(unsigned long long *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (double)((*state * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+/* Code memory index of pc, -1 outside the program */
+static int
+code_index(const APEX_CPU *cpu, int pc)
+{
+    int index = (pc - 4000) / 4;
+
+    return (pc >= 4000 && pc % 4 == 0 && index < cpu->code_memory_size) ? index : -1;
+}
+
+static int
+ends_block(const APEX_Instruction *ins)
+{
+    return ins->opcode == OPCODE_BZ || ins->opcode == OPCODE_BNZ || ins->opcode == OPCODE_JUMP ||
+           ins->opcode == OPCODE_JAL;
+}
+
+/* Appends the interval counted in counts, projected with matrix */
+static int
+close_interval(Profile *prof, long *counts, const double *matrix, int size, long length)
+{
+    double *v;
+
+    if (prof->count == prof->capacity)
+    {
+        int capacity = prof->capacity ? 2 * prof->capacity : 64;
+        double *vectors = realloc(prof->vectors, sizeof(double) * SIMPOINT_DIMS * capacity);
+        long *lengths = vectors ? realloc(prof->lengths, sizeof(long) * capacity) : NULL;
+
+        if (vectors)
+        {
+            prof->vectors = vectors;
+        }
+        if (!lengths)
+        {
+            return -1;
+        }
+        prof->lengths = lengths;
+        prof->capacity = capacity;
+    }
+    v = &prof->vectors[prof->count * SIMPOINT_DIMS];
+    memset(v, 0, sizeof(double) * SIMPOINT_DIMS);
+    for (int i = 0; i < size; i++)
+    {
+        if (counts[i])
+        {
+            for (int d = 0; d < SIMPOINT_DIMS; d++)
+            {
+                v[d] += (double)counts[i] / length * matrix[i * SIMPOINT_DIMS + d];
+            }
+        }
+    }
+    memset(counts, 0, sizeof(long) * size);
+    prof->lengths[prof->count++] = length;
+    return 0;
+}
+
+/*
+ * Runs the program functionally for at most limit instructions, recording
+ * the basic block vector of every interval instructions
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int
+profile_run(const APEX_CPU *cpu, long limit, int interval, Profile *prof)
+{
+    int size = cpu->code_memory_size;
+    char *leader = malloc(size);
+    char *seen = calloc(size, 1);
+    long *counts = calloc(size, sizeof(long));
+    double *matrix = malloc(sizeof(double) * SIMPOINT_DIMS * size);
+    APEX_Oracle *state = APEX_oracle_create(cpu);
+    unsigned long long seed = SIMPOINT_SEED;
+    long length = 0;
+    int pc = 4000, block = 0, after_control = FALSE, index;
+    int ret = -1;
+
+    if (!leader || !seen || !counts || !matrix || !state)
+    {
+        goto out;
+    }
+    APEX_schedule_leaders(cpu->code_memory, size, leader);
+    for (int i = 0; i < SIMPOINT_DIMS * size; i++)
+    {
+        matrix[i] = 2.0 * random_unit(&seed) - 1.0;
+    }
+
+    while (prof->insns < limit && (index = code_index(cpu, pc)) >= 0)
+    {
+        const APEX_Instruction *ins = &cpu->code_memory[index];
+
+        /* Jump targets the static leaders missed start a block all the same */
+        if (leader[index] || after_control)
+        {
+            leader[index] = TRUE;
+            block = index;
+        }
+        if (!seen[block])
+        {
+            seen[block] = TRUE;
+            prof->blocks++;
+        }
+        counts[block]++;
+        prof->insns++;
+        length++;
+        if (ins->opcode == OPCODE_HALT)
+        {
+            prof->halted = TRUE;
+            break;
+        }
+        after_control = ends_block(ins);
+        pc = APEX_oracle_fetch(state, ins, pc);
+        if (length == interval)
+        {
+            if (close_interval(prof, counts, matrix, size, length) < 0)
+            {
+                goto out;
+            }
+            length = 0;
+        }
+    }
+    if (length && close_interval(prof, counts, matrix, size, length) < 0)
+    {
+        goto out;
+    }
+    ret = 0;
+out:
+    if (ret < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate basic block vectors\n");
+    }
+    free(leader);
+    free(seen);
+    free(counts);
+    free(matrix);
+    APEX_oracle_free(state);
+    return ret;
+}
+
+static double
+distance(const double *a, const double *b)
+{
+    double sum = 0.0;
+
+    for (int d = 0; d < SIMPOINT_DIMS; d++)
+    {
+        sum += (a[d] - b[d]) * (a[d] - b[d]);
+    }
+    return sum;
+}
+
+/* Centers of the k clusters of assign, an empty cluster keeps its center */
+static void
+update_centers(const Profile *prof, int k, const int *assign, double *centers)
+{
+    int *members = calloc(k, sizeof(int));
+    double *sums = calloc(k * SIMPOINT_DIMS, sizeof(double));
+
+    if (!members || !sums)
+    {
+        free(members);
+        free(sums);
+        return;
+    }
+    for (int i = 0; i < prof->count; i++)
+    {
+        members[assign[i]]++;
+        for (int d = 0; d < SIMPOINT_DIMS; d++)
+        {
+            sums[assign[i] * SIMPOINT_DIMS + d] += prof->vectors[i * SIMPOINT_DIMS + d];
+        }
+    }
+    for (int c = 0; c < k; c++)
+    {
+        for (int d = 0; members[c] && d < SIMPOINT_DIMS; d++)
+        {
+            centers[c * SIMPOINT_DIMS + d] = sums[c * SIMPOINT_DIMS + d] / members[c];
+        }
+    }
+    free(members);
+    free(sums);
+}
+
+/*
+ * Clusters the intervals into k clusters, best of SIMPOINT_KMEANS_RUNS runs
+ * from random intervals as centers, leaving the clusters in assign
+ *
+ * Returns the sum of squared distances to the centers, -1 on failure
+ */
+static double
+kmeans(const Profile *prof, int k, int *assign, unsigned long long *seed)
+{
+    int n = prof->count;
+    int *order = malloc(sizeof(int) * n);
+    int *run = malloc(sizeof(int) * n);
+    double *centers = malloc(sizeof(double) * SIMPOINT_DIMS * k);
+    double best = -1.0;
+
+    if (!order || !run || !centers)
+    {
+        goto out;
+    }
+    for (int r = 0; r < SIMPOINT_KMEANS_RUNS; r++)
+    {
+        double sse = 0.0;
+        int changed = TRUE;
+
+        /* k distinct intervals, by a partial shuffle */
+        for (int i = 0; i < n; i++)
+        {
+            order[i] = i;
+        }
+        for (int c = 0; c < k; c++)
+        {
+            int j = c + (int)(random_unit(seed) * (n - c));
+            int tmp = order[c];
+
+            order[c] = order[j];
+            order[j] = tmp;
+            memcpy(&centers[c * SIMPOINT_DIMS], &prof->vectors[order[c] * SIMPOINT_DIMS],
+                   sizeof(double) * SIMPOINT_DIMS);
+        }
+        memset(run, -1, sizeof(int) * n);
+        for (int it = 0; it < SIMPOINT_KMEANS_ITERATIONS && changed; it++)
+        {
+            changed = FALSE;
+            for (int i = 0; i < n; i++)
+            {
+                int nearest = 0;
+                double dist = DBL_MAX;
+
+                for (int c = 0; c < k; c++)
+                {
+                    double dc = distance(&prof->vectors[i * SIMPOINT_DIMS], &centers[c * SIMPOINT_DIMS]);
+
+                    if (dc < dist)
+                    {
+                        dist = dc;
+                        nearest = c;
+                    }
+                }
+                if (run[i] != nearest)
+                {
+                    run[i] = nearest;
+                    changed = TRUE;
+                }
+            }
+            update_centers(prof, k, run, centers);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            sse += distance(&prof->vectors[i * SIMPOINT_DIMS], &centers[run[i] * SIMPOINT_DIMS]);
+        }
+        if (best < 0.0 || sse < best)
+        {
+            best = sse;
+            memcpy(assign, run, sizeof(int) * n);
+        }
+    }
+out:
+    free(order);
+    free(run);
+    free(centers);
+    return best;
+}
+
+/* Bayesian information criterion of a clustering into spherical Gaussians */
+static double
+bic(const Profile *prof, int k, const int *assign, double sse)
+{
+    int n = prof->count;
+    double variance = n > k ? sse / ((double)(n - k) * SIMPOINT_DIMS) : 0.0;
+    double likelihood = 0.0;
+    int *members = calloc(k, sizeof(int));
+
+    if (!members)
+    {
+        return -DBL_MAX;
+    }
+    /* Identical intervals fit any k exactly */
+    if (variance < 1e-12)
+    {
+        variance = 1e-12;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        members[assign[i]]++;
+    }
+    for (int c = 0; c < k; c++)
+    {
+        if (members[c])
+        {
+            likelihood += members[c] * log((double)members[c] / n);
+        }
+    }
+    free(members);
+    likelihood -= n * SIMPOINT_DIMS / 2.0 * log(2.0 * M_PI * variance) + SIMPOINT_DIMS * (n - k) / 2.0;
+    return likelihood - ((k - 1) + k * SIMPOINT_DIMS + 1) / 2.0 * log((double)n);
+}
+
+/*
+ * Clusters the intervals for every k up to max_k and keeps the smallest k
+ * whose BIC reaches SIMPOINT_BIC_THRESHOLD of the range of the scores
+ *
+ * Returns the chosen k with its clusters in assign, -1 on failure
+ */
+static int
+choose_clusters(const Profile *prof, int max_k, int *assign)
+{
+    int n = prof->count;
+    int ks = max_k < n ? max_k : n;
+    int *all = malloc(sizeof(int) * n * ks);
+    double *scores = malloc(sizeof(double) * ks);
+    unsigned long long seed = SIMPOINT_SEED;
+    double lo = DBL_MAX, hi = -DBL_MAX;
+    int k = -1;
+
+    if (!all || !scores)
+    {
+        goto out;
+    }
+    for (int i = 0; i < ks; i++)
+    {
+        double sse = kmeans(prof, i + 1, &all[i * n], &seed);
+
+        if (sse < 0.0)
+        {
+            goto out;
+        }
+        scores[i] = bic(prof, i + 1, &all[i * n], sse);
+        lo = scores[i] < lo ? scores[i] : lo;
+        hi = scores[i] > hi ? scores[i] : hi;
+    }
+    for (int i = 0; i < ks; i++)
+    {
+        if (scores[i] >= lo + SIMPOINT_BIC_THRESHOLD * (hi - lo))
+        {
+            k = i + 1;
+            memcpy(assign, &all[i * n], sizeof(int) * n);
+            break;
+        }
+    }
+out:
+    free(all);
+    free(scores);
+    return k;
+}
+
+static int
+by_start(const void *a, const void *b)
+{
+    const SimPoint *x = a, *y = b;
+
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/*
+ * Picks the interval nearest to the center of each of the k clusters and
+ * the next nearest as its spare, in order of their start
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int
+pick_points(const Profile *prof, int interval, int k, const int *assign, APEX_SimPoints *sp)
+{
+    double *centers = calloc(k * SIMPOINT_DIMS, sizeof(double));
+    int best[2];
+    double dist[2];
+
+    sp->insns = prof->insns;
+    sp->count = 0;
+    sp->points = malloc(sizeof(SimPoint) * 2 * k);
+    if (!centers || !sp->points)
+    {
+        free(centers);
+        return -1;
+    }
+    update_centers(prof, k, assign, centers);
+    for (int c = 0; c < k; c++)
+    {
+        long insns = 0;
+
+        best[0] = best[1] = -1;
+        dist[0] = dist[1] = DBL_MAX;
+        for (int i = 0; i < prof->count; i++)
+        {
+            double d;
+
+            if (assign[i] != c)
+            {
+                continue;
+            }
+            insns += prof->lengths[i];
+            d = distance(&prof->vectors[i * SIMPOINT_DIMS], &centers[c * SIMPOINT_DIMS]);
+            if (d < dist[0])
+            {
+                best[1] = best[0];
+                dist[1] = dist[0];
+                best[0] = i;
+                dist[0] = d;
+            }
+            else if (d < dist[1])
+            {
+                best[1] = i;
+                dist[1] = d;
+            }
+        }
+        for (int j = 0; j < 2 && best[j] >= 0; j++)
+        {
+            SimPoint *p = &sp->points[sp->count++];
+
+            p->start = (long)best[j] * interval;
+            p->length = prof->lengths[best[j]];
+            p->weight = j == 0 ? (double)insns / prof->insns : 0.0;
+            p->cluster = c;
+        }
+    }
+    qsort(sp->points, sp->count, sizeof(SimPoint), by_start);
+    free(centers);
+    return 0;
+}
+
+/*
+ * Profiles the program of cpu for at most steps instructions and writes the
+ * representative intervals to the --simpoints file
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_simpoint_run(APEX_CPU *cpu, const APEX_Options *opts, const char *steps)
+{
+    Profile prof;
+    APEX_SimPoints sp = {0, 0, NULL};
+    int *assign = NULL;
+    int k = -1;
+    int ret = -1;
+
+    memset(&prof, 0, sizeof(prof));
+    if (profile_run(cpu, atol(steps), opts->simpoint_interval, &prof) < 0)
+    {
+        return -1;
+    }
+    if (prof.count == 0)
+    {
+        fprintf(stderr, "APEX_Error: No instruction executed, nothing to profile\n");
+        goto out;
+    }
+    assign = malloc(sizeof(int) * prof.count);
+    if (!assign || (k = choose_clusters(&prof, opts->simpoint_max_k, assign)) < 0 ||
+        pick_points(&prof, opts->simpoint_interval, k, assign, &sp) < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate clusters\n");
+        goto out;
+    }
+    if (APEX_simpoints_write(&sp, opts->simpoint_file) < 0)
+    {
+        goto out;
+    }
+    printf("APEX_SimPoint: %s, instructions = %ld in %d intervals of %d, %d basic blocks executed\n",
+           prof.halted ? "Complete" : "Stopped", prof.insns, prof.count, opts->simpoint_interval, prof.blocks);
+    printf("APEX_SimPoint: %d clusters, %d intervals written to %s\n", k, sp.count, opts->simpoint_file);
+    ret = 0;
+out:
+    free(assign);
+    free(sp.points);
+    free(prof.vectors);
+    free(prof.lengths);
+    return ret;
+}
+
+/*
+ * Writes the intervals of sp to filename, "-" for standard output
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_simpoints_write(const APEX_SimPoints *sp, const char *filename)
+{
+    FILE *fp = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open simpoints %s\n", filename);
+        return -1;
+    }
+    fprintf(fp, "# APEX simpoints: start length weight cluster, weight 0 marks a spare\n");
+    fprintf(fp, "# instructions %ld\n", sp->insns);
+    for (int i = 0; i < sp->count; i++)
+    {
+        const SimPoint *p = &sp->points[i];
+
+        fprintf(fp, "%ld %ld %.6f %d\n", p->start, p->length, p->weight, p->cluster);
+    }
+    if (fp != stdout && fclose(fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write simpoints %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Reads intervals written by APEX_simpoints_write, or listed by hand as
+ * start, length and weight, each line its own cluster when none is given
+ *
+ * Returns the intervals sorted by start, NULL on failure
+ */
+APEX_SimPoints *
+APEX_simpoints_read(const char *filename)
+{
+    APEX_SimPoints *sp = calloc(1, sizeof(APEX_SimPoints));
+    FILE *fp = fopen(filename, "r");
+    char line[256];
+    int capacity = 0, lineno = 0;
+
+    if (!sp || !fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open simpoints %s\n", filename);
+        goto fail;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        SimPoint p;
+        int fields;
+
+        lineno++;
+        if (line[0] == '#')
+        {
+            sscanf(line, "# instructions %ld", &sp->insns);
+            continue;
+        }
+        if (strspn(line, " \t\r\n") == strlen(line))
+        {
+            continue;
+        }
+        fields = sscanf(line, "%ld %ld %lf %d", &p.start, &p.length, &p.weight, &p.cluster);
+        if (fields < 3 || p.start < 0 || p.length < 1 || p.weight < 0.0)
+        {
+            fprintf(stderr, "APEX_Error: Invalid interval on line %d of %s\n", lineno, filename);
+            goto fail;
+        }
+        if (fields == 3)
+        {
+            p.cluster = -1 - sp->count;
+        }
+        if (sp->count == capacity)
+        {
+            SimPoint *points = realloc(sp->points, sizeof(SimPoint) * (capacity ? 2 * capacity : 16));
+
+            if (!points)
+            {
+                fprintf(stderr, "APEX_Error: Unable to allocate simpoints\n");
+                goto fail;
+            }
+            sp->points = points;
+            capacity = capacity ? 2 * capacity : 16;
+        }
+        sp->points[sp->count++] = p;
+    }
+    if (sp->count == 0)
+    {
+        fprintf(stderr, "APEX_Error: No interval in %s\n", filename);
+        goto fail;
+    }
+    fclose(fp);
+    qsort(sp->points, sp->count, sizeof(SimPoint), by_start);
+    return sp;
+fail:
+    if (fp)
+    {
+        fclose(fp);
+    }
+    APEX_simpoints_free(sp);
+    return NULL;
+}
+
+void
+APEX_simpoints_free(APEX_SimPoints *sp)
+{
+    if (sp)
+    {
+        free(sp->points);
+        free(sp);
+    }
+}
+
+/*
+ * Executes the program functionally from *pc until *executed reaches
+ * target instructions
+ *
+ * Returns FALSE when the program halts or leaves code memory first
+ */
+static int
+fast_forward(const APEX_CPU *cpu, APEX_Oracle *state, int *pc, long *executed, long target)
+{
+    int index;
+
+    while (*executed < target)
+    {
+        if ((index = code_index(cpu, *pc)) < 0 || cpu->code_memory[index].opcode == OPCODE_HALT)
+        {
+            return FALSE;
+        }
+        *pc = APEX_oracle_fetch(state, &cpu->code_memory[index], *pc);
+        (*executed)++;
+    }
+    return TRUE;
+}
+
+/*
+ * Simulates sample in detail on sim: its warm-up instructions first, then
+ * length instructions whose cycles are measured
+ */
+static void
+simulate_interval(APEX_CPU *sim, const SampleJobs *jobs, Sample *sample, long length)
+{
+    long limit = (sample->warm + length) * SIMPOINT_MAX_CPI;
+    int clock = 0, insns = 0, halted = FALSE;
+
+    if (APEX_cpu_reset(sim, jobs->cpu->code_memory, jobs->cpu->code_memory_size, &jobs->opts) < 0)
+    {
+        sample->failed = TRUE;
+        return;
+    }
+    APEX_cpu_restore(sim, &sample->state, sample->pc);
+    while (!halted && sim->insn_completed < sample->warm && sim->clock < limit)
+    {
+        halted = APEX_cpu_cycle(sim);
+    }
+    clock = sim->clock;
+    insns = sim->insn_completed;
+    while (!halted && sim->insn_completed < sample->warm + length && sim->clock < limit)
+    {
+        halted = APEX_cpu_cycle(sim);
+    }
+    sample->cycles = sim->clock - clock;
+    sample->insns = sim->insn_completed - insns;
+    APEX_oracle_free(sim->oracle);
+    sim->oracle = NULL;
+}
+
+/* Takes samples off jobs until none is left, each worker has a CPU of its own */
+static void *
+sample_worker(void *arg)
+{
+    SampleJobs *jobs = arg;
+    APEX_CPU *sim = malloc(sizeof(APEX_CPU));
+
+    for (;;)
+    {
+        int i;
+
+        pthread_mutex_lock(&jobs->lock);
+        i = jobs->next++;
+        pthread_mutex_unlock(&jobs->lock);
+        if (i >= jobs->sp->count)
+        {
+            break;
+        }
+        if (!sim)
+        {
+            jobs->samples[i].failed = TRUE;
+            continue;
+        }
+        simulate_interval(sim, jobs, &jobs->samples[i], jobs->sp->points[i].length);
+    }
+    free(sim);
+    return NULL;
+}
+
+/*
+ * Runs the program functionally once, keeping the state warmup instructions
+ * before the start of each interval of sp in samples
+ *
+ * Returns 0 on success, -1 when the program ends before an interval
+ */
+static int
+take_starts(const APEX_CPU *cpu, const APEX_SimPoints *sp, long warmup, Sample *samples)
+{
+    APEX_Oracle *state = APEX_oracle_create(cpu);
+    long executed = 0;
+    int pc = 4000;
+
+    if (!state)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate functional model\n");
+        return -1;
+    }
+    /* Intervals are sorted by start, so are their warm-up starts */
+    for (int i = 0; i < sp->count; i++)
+    {
+        long start = sp->points[i].start > warmup ? sp->points[i].start - warmup : 0;
+
+        if (!fast_forward(cpu, state, &pc, &executed, start))
+        {
+            fprintf(stderr, "APEX_Error: Program ends after %ld instructions, before the interval at %ld\n", executed,
+                    sp->points[i].start);
+            APEX_oracle_free(state);
+            return -1;
+        }
+        memcpy(&samples[i].state, state, sizeof(APEX_Oracle));
+        samples[i].pc = pc;
+        samples[i].warm = sp->points[i].start - start;
+    }
+    APEX_oracle_free(state);
+    return 0;
+}
+
+/*
+ * Simulates each interval of the --simpoints file in detail, on as many
+ * threads as --threads allows, and extrapolates the CPI of the whole run
+ * from their weights
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_simpoint_sample(APEX_CPU *cpu, const APEX_Options *opts)
+{
+    APEX_SimPoints *sp = APEX_simpoints_read(opts->simpoint_file);
+    SampleJobs jobs;
+    pthread_t *workers = NULL;
+    double *cpi = NULL;
+    double estimate = 0.0, weights = 0.0, variance = 0.0;
+    long simulated = 0;
+    int threads = opts->threads ? opts->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int started = 0;
+    int ret = -1;
+
+    memset(&jobs, 0, sizeof(jobs));
+    if (!sp)
+    {
+        return -1;
+    }
+    threads = threads < 1 ? 1 : threads > sp->count ? sp->count : threads;
+    jobs.samples = calloc(sp->count, sizeof(Sample));
+    workers = malloc(sizeof(pthread_t) * threads);
+    cpi = malloc(sizeof(double) * sp->count);
+    if (!jobs.samples || !workers || !cpi)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate sampled run\n");
+        goto out;
+    }
+    if (take_starts(cpu, sp, opts->sample_warmup, jobs.samples) < 0)
+    {
+        goto out;
+    }
+
+    /* Data memory comes from the functional model */
+    jobs.cpu = cpu;
+    jobs.opts = *opts;
+    jobs.opts.mem_load_file = NULL;
+    jobs.sp = sp;
+    pthread_mutex_init(&jobs.lock, NULL);
+    ENABLE_DEBUG_MESSAGES = FALSE;
+    for (started = 0; started < threads; started++)
+    {
+        if (pthread_create(&workers[started], NULL, sample_worker, &jobs) != 0)
+        {
+            break;
+        }
+    }
+    /* Whatever threads started share the work */
+    if (started == 0)
+    {
+        sample_worker(&jobs);
+    }
+    for (int t = 0; t < started; t++)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    pthread_mutex_destroy(&jobs.lock);
+
+    for (int i = 0; i < sp->count; i++)
+    {
+        const SimPoint *p = &sp->points[i];
+        const Sample *s = &jobs.samples[i];
+
+        if (s->failed || s->insns == 0)
+        {
+            fprintf(stderr, "APEX_Error: Interval at %ld %s\n", p->start,
+                    s->failed ? "could not be simulated" : "committed no instruction");
+            goto out;
+        }
+        cpi[i] = (double)s->cycles / s->insns;
+        simulated += s->warm + s->insns;
+        printf("APEX_Sample: interval at %ld, weight %.4f, warm-up %ld, cycles = %ld instructions = %ld CPI = %.3f\n",
+               p->start, p->weight, s->warm, s->cycles, s->insns, cpi[i]);
+    }
+
+    /* Each cluster adds the sample variance of its intervals, scaled by its weight */
+    for (int i = 0; i < sp->count; i++)
+    {
+        const SimPoint *p = &sp->points[i];
+        double mean = 0.0, spread = 0.0;
+        int members = 0;
+
+        if (p->weight == 0.0)
+        {
+            continue;
+        }
+        estimate += p->weight * cpi[i];
+        weights += p->weight;
+        for (int j = 0; j < sp->count; j++)
+        {
+            if (sp->points[j].cluster == p->cluster)
+            {
+                mean += cpi[j];
+                members++;
+            }
+        }
+        mean /= members;
+        for (int j = 0; members > 1 && j < sp->count; j++)
+        {
+            if (sp->points[j].cluster == p->cluster)
+            {
+                spread += (cpi[j] - mean) * (cpi[j] - mean) / (members - 1);
+            }
+        }
+        variance += p->weight * p->weight * spread;
+    }
+    if (weights == 0.0)
+    {
+        fprintf(stderr, "APEX_Error: Every interval of %s has weight 0\n", opts->simpoint_file);
+        goto out;
+    }
+    estimate /= weights;
+    variance /= weights * weights;
+    printf("APEX_Sample: CPI = %.3f +- %.3f (%.1f%%), %ld instructions simulated in %d intervals on %d threads\n",
+           estimate, sqrt(variance), 100.0 * sqrt(variance) / estimate, simulated, sp->count, started ? started : 1);
+    if (sp->insns)
+    {
+        printf("APEX_Sample: estimated cycles = %.0f for %ld instructions\n", estimate * sp->insns, sp->insns);
+    }
+    ret = 0;
+out:
+    free(cpi);
+    free(workers);
+    free(jobs.samples);
+    APEX_simpoints_free(sp);
+    return ret;
+}
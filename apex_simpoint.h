@@ -0,0 +1,64 @@
+/*
+ * apex_simpoint.h
+ * Contains declarations of the basic block vector profile, which picks the
+ * intervals of a long run that stand for the whole of it, and of the sampled
+ * run simulating only those intervals
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_SIMPOINT_H_
+#define _APEX_SIMPOINT_H_
+
+#include "apex_cpu.h"
+#include "apex_options.h"
+
+/* Default instructions of one profiled interval */
+#define SIMPOINT_DEFAULT_INTERVAL 10000
+
+/* Default upper bound of the number of clusters tried */
+#define SIMPOINT_DEFAULT_MAX_K 10
+
+/* Dimensions basic block vectors are projected down to before clustering */
+#define SIMPOINT_DIMS 15
+
+/* k-means runs from different random centers for each k, the best is kept */
+#define SIMPOINT_KMEANS_RUNS 5
+#define SIMPOINT_KMEANS_ITERATIONS 100
+
+/* Fixed, so the same program and options always pick the same intervals */
+#define SIMPOINT_SEED 493575226ULL
+
+/* Smallest k whose BIC reaches this share of the range of all BIC scores */
+#define SIMPOINT_BIC_THRESHOLD 0.9
+
+/* Default instructions simulated before each interval to fill the pipeline */
+#define SIMPOINT_DEFAULT_WARMUP 1000
+
+/* Cycles per instruction after which the detailed run of an interval gives up */
+#define SIMPOINT_MAX_CPI 1000
+
+/* One interval of the profiled run */
+typedef struct SimPoint
+{
+    long start;    /* Instructions executed before it */
+    long length;   /* Instructions in it */
+    double weight; /* Share of the run its cluster stands for, 0 for a spare */
+    int cluster;
+} SimPoint;
+
+/* Intervals written by the simpoint command and read by the sample command */
+typedef struct APEX_SimPoints
+{
+    long insns;    /* Instructions of the whole profiled run */
+    int count;
+    SimPoint *points;
+} APEX_SimPoints;
+
+APEX_SimPoints *APEX_simpoints_read(const char *filename);
+void APEX_simpoints_free(APEX_SimPoints *sp);
+int APEX_simpoints_write(const APEX_SimPoints *sp, const char *filename);
+int APEX_simpoint_run(APEX_CPU *cpu, const APEX_Options *opts, const char *steps);
+int APEX_simpoint_sample(APEX_CPU *cpu, const APEX_Options *opts);
+#endif
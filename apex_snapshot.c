@@ -0,0 +1,422 @@
+/*
+ * apex_snapshot.c
+ * Contains periodic snapshots of the APEX CPU
+ *
+ * A snapshot is taken every interval cycles. Every SNAPSHOT_KEYFRAME_EVERY-th
+ * one is a keyframe holding the whole APEX_CPU, the others hold the
+ * SNAPSHOT_CHUNK sized pieces of the CPU state which changed since the
+ * previous snapshot and the data memory pages stored to since then. Going
+ * back to any cycle restores the newest snapshot at or before it and replays
+ * the remaining cycles, at most one interval of re-simulation.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_snapshot.h"
+
+/* Data memory is kept apart from the rest of the CPU state */
+#define MEMORY_BEGIN offsetof(APEX_CPU, data_memory)
+#define MEMORY_END (MEMORY_BEGIN + sizeof(((APEX_CPU *)0)->data_memory))
+
+/* Bytes of one chunk record of a delta */
+#define CHUNK_RECORD (sizeof(uint32_t) + SNAPSHOT_CHUNK)
+
+int
+APEX_snapshots_init(APEX_Snapshots *snaps, int interval)
+{
+    memset(snaps, 0, sizeof(APEX_Snapshots));
+    snaps->interval = interval;
+    snaps->last = malloc(sizeof(APEX_CPU));
+    if (!snaps->last)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate snapshot state\n");
+        return -1;
+    }
+    return 0;
+}
+
+void
+APEX_snapshots_free(APEX_Snapshots *snaps)
+{
+    for (int i = 0; i < snaps->count; i++)
+    {
+        free(snaps->list[i].core);
+        free(snaps->list[i].memory);
+    }
+    free(snaps->list);
+    free(snaps->last);
+    memset(snaps, 0, sizeof(APEX_Snapshots));
+}
+
+/* Length of the chunk at offset, chunks never cross data memory */
+static size_t
+chunk_length(size_t offset)
+{
+    size_t end = offset < MEMORY_BEGIN ? MEMORY_BEGIN : sizeof(APEX_CPU);
+
+    return end - offset < SNAPSHOT_CHUNK ? end - offset : SNAPSHOT_CHUNK;
+}
+
+/* Offset of the chunk following the one at offset */
+static size_t
+next_chunk(size_t offset)
+{
+    offset += chunk_length(offset);
+    return offset == MEMORY_BEGIN ? MEMORY_END : offset;
+}
+
+/*
+ * Records the CPU state changed since the newest snapshot into snap
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int
+take_delta(APEX_Snapshots *snaps, APEX_Snapshot *snap, const APEX_CPU *cpu)
+{
+    const unsigned char *now = (const unsigned char *)cpu;
+    size_t offset, n = 0;
+    int words = 0;
+
+    for (offset = 0; offset < sizeof(APEX_CPU); offset = next_chunk(offset))
+    {
+        n += memcmp(now + offset, snaps->last + offset, chunk_length(offset)) != 0;
+    }
+    snap->core = malloc(n * CHUNK_RECORD + 1);
+    snap->pages = cpu->data_memory_pages_written;
+    for (int page = 0; page < DATA_MEMORY_PAGES; page++)
+    {
+        words += (snap->pages >> page & 1) * DATA_MEMORY_PAGE_WORDS;
+    }
+    snap->memory = malloc(words * sizeof(int) + 1);
+    if (!snap->core || !snap->memory)
+    {
+        return -1;
+    }
+
+    for (offset = 0; offset < sizeof(APEX_CPU); offset = next_chunk(offset))
+    {
+        size_t len = chunk_length(offset);
+
+        if (memcmp(now + offset, snaps->last + offset, len) != 0)
+        {
+            unsigned char *record = snap->core + snap->nchunks++ * CHUNK_RECORD;
+            uint32_t at = offset;
+
+            memcpy(record, &at, sizeof(at));
+            memcpy(record + sizeof(at), now + offset, len);
+        }
+    }
+    words = 0;
+    for (int page = 0; page < DATA_MEMORY_PAGES; page++)
+    {
+        if (snap->pages >> page & 1)
+        {
+            memcpy(&snap->memory[words], &cpu->data_memory[page * DATA_MEMORY_PAGE_WORDS],
+                   DATA_MEMORY_PAGE_WORDS * sizeof(int));
+            words += DATA_MEMORY_PAGE_WORDS;
+        }
+    }
+    snaps->bytes += snap->nchunks * CHUNK_RECORD + words * sizeof(int);
+    return 0;
+}
+
+/*
+ * Takes a snapshot when the CPU clock is at a snapshot point which has not
+ * been recorded yet, replays through recorded cycles are skipped
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_snapshot_take(APEX_Snapshots *snaps, APEX_CPU *cpu)
+{
+    APEX_Snapshot *snap;
+
+    if (cpu->clock % snaps->interval ||
+        (snaps->count && cpu->clock <= snaps->list[snaps->count - 1].cycle))
+    {
+        return 0;
+    }
+    if (snaps->count == snaps->capacity)
+    {
+        int capacity = snaps->capacity ? 2 * snaps->capacity : 64;
+        APEX_Snapshot *list = realloc(snaps->list, capacity * sizeof(APEX_Snapshot));
+
+        if (!list)
+        {
+            fprintf(stderr, "APEX_Error: Unable to allocate snapshot\n");
+            return -1;
+        }
+        snaps->list = list;
+        snaps->capacity = capacity;
+    }
+
+    snap = &snaps->list[snaps->count];
+    memset(snap, 0, sizeof(APEX_Snapshot));
+    snap->cycle = cpu->clock;
+    if (snaps->count % SNAPSHOT_KEYFRAME_EVERY == 0)
+    {
+        snap->core = malloc(sizeof(APEX_CPU));
+        if (snap->core)
+        {
+            memcpy(snap->core, cpu, sizeof(APEX_CPU));
+            snaps->bytes += sizeof(APEX_CPU);
+        }
+    }
+    else if (take_delta(snaps, snap, cpu) < 0)
+    {
+        free(snap->core);
+        free(snap->memory);
+        snap->core = NULL;
+    }
+    if (!snap->core)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate snapshot\n");
+        return -1;
+    }
+
+    memcpy(snaps->last, cpu, sizeof(APEX_CPU));
+    cpu->data_memory_pages_written = 0;
+    snaps->count++;
+    return 0;
+}
+
+static void
+apply_delta(APEX_CPU *cpu, const APEX_Snapshot *snap)
+{
+    unsigned char *now = (unsigned char *)cpu;
+    int words = 0;
+
+    for (int i = 0; i < snap->nchunks; i++)
+    {
+        const unsigned char *record = snap->core + i * CHUNK_RECORD;
+        uint32_t at;
+
+        memcpy(&at, record, sizeof(at));
+        memcpy(now + at, record + sizeof(at), chunk_length(at));
+    }
+    for (int page = 0; page < DATA_MEMORY_PAGES; page++)
+    {
+        if (snap->pages >> page & 1)
+        {
+            memcpy(&cpu->data_memory[page * DATA_MEMORY_PAGE_WORDS], &snap->memory[words],
+                   DATA_MEMORY_PAGE_WORDS * sizeof(int));
+            words += DATA_MEMORY_PAGE_WORDS;
+        }
+    }
+}
+
+/* Members of the CPU which belong to this process rather than to the simulated machine */
+typedef struct HostHooks
+{
+    const unsigned char *commit_breaks;
+    const unsigned char *fetch_breaks;
+    struct APEX_Profile *profile;
+    struct APEX_CritPath *critpath;
+    struct APEX_CpiStack *cpistack;
+    struct APEX_MemProfile *memprofile;
+    struct APEX_BranchProf *branchprof;
+    struct APEX_Trace *trace;
+    struct APEX_Telemetry *telemetry;
+    struct APEX_Oracle *oracle;
+    struct APEX_Checkpoints *checkpoints;
+    struct APEX_Observers *observers;
+    unsigned observed;
+    struct APEX_RunCtl *runctl;
+} HostHooks;
+
+static void
+save_hooks(HostHooks *hooks, const APEX_CPU *cpu)
+{
+    hooks->commit_breaks = cpu->commit_breaks;
+    hooks->fetch_breaks = cpu->fetch_breaks;
+    hooks->profile = cpu->profile;
+    hooks->critpath = cpu->critpath;
+    hooks->cpistack = cpu->cpistack;
+    hooks->memprofile = cpu->memprofile;
+    hooks->branchprof = cpu->branchprof;
+    hooks->trace = cpu->trace;
+    hooks->telemetry = cpu->telemetry;
+    hooks->oracle = cpu->oracle;
+    hooks->checkpoints = cpu->checkpoints;
+    hooks->observers = cpu->observers;
+    hooks->observed = cpu->observed;
+    hooks->runctl = cpu->runctl;
+}
+
+static void
+restore_hooks(APEX_CPU *cpu, const HostHooks *hooks)
+{
+    cpu->commit_breaks = hooks->commit_breaks;
+    cpu->fetch_breaks = hooks->fetch_breaks;
+    cpu->profile = hooks->profile;
+    cpu->critpath = hooks->critpath;
+    cpu->cpistack = hooks->cpistack;
+    cpu->memprofile = hooks->memprofile;
+    cpu->branchprof = hooks->branchprof;
+    cpu->trace = hooks->trace;
+    cpu->telemetry = hooks->telemetry;
+    cpu->oracle = hooks->oracle;
+    cpu->checkpoints = hooks->checkpoints;
+    cpu->observers = hooks->observers;
+    cpu->observed = hooks->observed;
+    cpu->runctl = hooks->runctl;
+}
+
+/*
+ * Restores the newest snapshot taken at or before cycle
+ *
+ * The breakpoints, analyses, trace, telemetry, oracle, checkpoints,
+ * observers and run control attached to cpu stay attached, only the
+ * machine is rolled back: what they gathered or published since the
+ * snapshot is not undone. main.c refuses those combinations in debug mode
+ * for that reason, and a checkpoint resume happens before any of them but
+ * the checkpoints is attached.
+ *
+ * Returns the cycle of the restored snapshot, -1 when there is none
+ */
+int
+APEX_snapshot_restore(const APEX_Snapshots *snaps, APEX_CPU *cpu, int cycle)
+{
+    HostHooks hooks;
+    int lo = 0, hi = snaps->count - 1, found = -1;
+    int key;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+
+        if (snaps->list[mid].cycle <= cycle)
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    if (found < 0)
+    {
+        return -1;
+    }
+
+    key = found - found % SNAPSHOT_KEYFRAME_EVERY;
+    save_hooks(&hooks, cpu);
+    memcpy(cpu, snaps->list[key].core, sizeof(APEX_CPU));
+    for (int i = key + 1; i <= found; i++)
+    {
+        apply_delta(cpu, &snaps->list[i]);
+    }
+
+    restore_hooks(cpu, &hooks);
+    cpu->data_memory_pages_written = 0;
+    return snaps->list[found].cycle;
+}
+
+/* Bytes of the CPU state and data memory words stored by snap */
+static size_t
+core_bytes(const APEX_Snapshot *snap, int index)
+{
+    return index % SNAPSHOT_KEYFRAME_EVERY == 0 ? sizeof(APEX_CPU) : snap->nchunks * CHUNK_RECORD;
+}
+
+static size_t
+memory_words(const APEX_Snapshot *snap)
+{
+    return (size_t)__builtin_popcount(snap->pages) * DATA_MEMORY_PAGE_WORDS;
+}
+
+/*
+ * Writes all snapshots to fp, pointers inside the CPU state are written as
+ * they are and must be set again after a restore in another process
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_snapshots_write(const APEX_Snapshots *snaps, FILE *fp)
+{
+    if (fwrite(&snaps->count, sizeof(int), 1, fp) != 1)
+    {
+        return -1;
+    }
+    for (int i = 0; i < snaps->count; i++)
+    {
+        const APEX_Snapshot *snap = &snaps->list[i];
+
+        if (fwrite(&snap->cycle, sizeof(int), 1, fp) != 1 || fwrite(&snap->nchunks, sizeof(int), 1, fp) != 1 ||
+            fwrite(&snap->pages, sizeof(unsigned int), 1, fp) != 1 ||
+            fwrite(snap->core, 1, core_bytes(snap, i), fp) != core_bytes(snap, i) ||
+            fwrite(snap->memory, sizeof(int), memory_words(snap), fp) != memory_words(snap))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Reads snapshots written by APEX_snapshots_write into snaps, initialized
+ * and empty
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_snapshots_read(APEX_Snapshots *snaps, FILE *fp)
+{
+    int count;
+
+    if (fread(&count, sizeof(int), 1, fp) != 1 || count < 0 ||
+        !(snaps->list = calloc(count + 1, sizeof(APEX_Snapshot))))
+    {
+        return -1;
+    }
+    snaps->capacity = count + 1;
+    for (int i = 0; i < count; i++)
+    {
+        APEX_Snapshot *snap = &snaps->list[i];
+
+        if (fread(&snap->cycle, sizeof(int), 1, fp) != 1 || fread(&snap->nchunks, sizeof(int), 1, fp) != 1 ||
+            fread(&snap->pages, sizeof(unsigned int), 1, fp) != 1 || snap->nchunks < 0 ||
+            (size_t)snap->nchunks > sizeof(APEX_CPU) / SNAPSHOT_CHUNK + 2)
+        {
+            return -1;
+        }
+        snap->core = malloc(core_bytes(snap, i) + 1);
+        snap->memory = malloc(memory_words(snap) * sizeof(int) + 1);
+        snaps->count++;
+        if (!snap->core || !snap->memory || fread(snap->core, 1, core_bytes(snap, i), fp) != core_bytes(snap, i) ||
+            fread(snap->memory, sizeof(int), memory_words(snap), fp) != memory_words(snap))
+        {
+            return -1;
+        }
+        snaps->bytes += core_bytes(snap, i) + memory_words(snap) * sizeof(int);
+    }
+    return 0;
+}
+
+/*
+ * Drops the snapshots taken after cycle, cpu holds the state of the newest
+ * one left, which further snapshots are taken against
+ */
+void
+APEX_snapshots_truncate(APEX_Snapshots *snaps, int cycle, const APEX_CPU *cpu)
+{
+    while (snaps->count && snaps->list[snaps->count - 1].cycle > cycle)
+    {
+        APEX_Snapshot *snap = &snaps->list[--snaps->count];
+
+        snaps->bytes -= core_bytes(snap, snaps->count) + memory_words(snap) * sizeof(int);
+        free(snap->core);
+        free(snap->memory);
+    }
+    memcpy(snaps->last, cpu, sizeof(APEX_CPU));
+}
@@ -0,0 +1,54 @@
+/*
+ * apex_snapshot.h
+ * Contains declarations of periodic APEX CPU snapshots used to travel
+ * backwards in simulated time
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_SNAPSHOT_H_
+#define _APEX_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "apex_cpu.h"
+
+/* Default cycles between two snapshots */
+#define SNAPSHOT_DEFAULT_INTERVAL 1000
+
+/* Every this many snapshots one holds the full CPU state */
+#define SNAPSHOT_KEYFRAME_EVERY 16
+
+/* Granule of the CPU state deltas, in bytes */
+#define SNAPSHOT_CHUNK 64
+
+/* CPU state of one cycle */
+typedef struct APEX_Snapshot
+{
+    int cycle;
+    int nchunks;           /* Changed chunks stored in core, 0 for a keyframe */
+    unsigned char *core;   /* Keyframe: copy of APEX_CPU, else {uint32 offset, chunk} records */
+    unsigned int pages;    /* Data memory pages stored in memory, all for a keyframe */
+    int *memory;           /* The stored pages in ascending order */
+} APEX_Snapshot;
+
+typedef struct APEX_Snapshots
+{
+    int interval;          /* Cycles between snapshots */
+    int count;
+    int capacity;
+    APEX_Snapshot *list;   /* Ascending by cycle */
+    unsigned char *last;   /* CPU state at the newest snapshot, deltas are taken against it */
+    size_t bytes;          /* Memory held by all snapshots */
+} APEX_Snapshots;
+
+int APEX_snapshots_init(APEX_Snapshots *snaps, int interval);
+void APEX_snapshots_free(APEX_Snapshots *snaps);
+int APEX_snapshot_take(APEX_Snapshots *snaps, APEX_CPU *cpu);
+int APEX_snapshot_restore(const APEX_Snapshots *snaps, APEX_CPU *cpu, int cycle);
+int APEX_snapshots_write(const APEX_Snapshots *snaps, FILE *fp);
+int APEX_snapshots_read(APEX_Snapshots *snaps, FILE *fp);
+void APEX_snapshots_truncate(APEX_Snapshots *snaps, int cycle, const APEX_CPU *cpu);
+#endif
@@ -0,0 +1,115 @@
+/*
+ * apex_telemetry.c
+ * Contains the publishing of live simulation counters in shared memory
+ *
+ * The counters live in a small file under TELEMETRY_DIR mapped shared, so a
+ * reader sees them without any system call or signal on the simulator side.
+ * Each cycle ends with a handful of relaxed atomic stores into that mapping.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_telemetry.h"
+
+#define PUBLISH(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+
+/*
+ * Creates and maps the counters file of this process, labelled name
+ *
+ * Returns the telemetry, NULL on failure
+ */
+APEX_Telemetry *
+APEX_telemetry_open(const char *name, const char *program, const APEX_CPU *cpu)
+{
+    APEX_Telemetry *tm = calloc(1, sizeof(APEX_Telemetry));
+    APEX_TelemetryPage *page;
+    int fd;
+
+    if (!tm)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate telemetry\n");
+        return NULL;
+    }
+    snprintf(tm->path, sizeof(tm->path), "%s/%s%d", TELEMETRY_DIR, TELEMETRY_PREFIX, (int)getpid());
+    fd = open(tm->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(APEX_TelemetryPage)) < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create telemetry file %s\n", tm->path);
+        if (fd >= 0)
+        {
+            close(fd);
+            unlink(tm->path);
+        }
+        free(tm);
+        return NULL;
+    }
+    page = mmap(NULL, sizeof(APEX_TelemetryPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED)
+    {
+        fprintf(stderr, "APEX_Error: Unable to map telemetry file %s\n", tm->path);
+        unlink(tm->path);
+        free(tm);
+        return NULL;
+    }
+
+    page->pid = getpid();
+    page->state = TELEMETRY_RUNNING;
+    page->started = time(NULL);
+    snprintf(page->name, sizeof(page->name), "%s", name);
+    snprintf(page->program, sizeof(page->program), "%s", program);
+    snprintf(page->config, sizeof(page->config), "%s: rob=%d iq=%d prf=%d intfu=%dx%d mul=%dx%d mem=%d",
+             cpu->config.name, cpu->config.rob_size, cpu->config.iq_size, cpu->config.phys_regs,
+             cpu->config.intfu_count, cpu->config.intfu_latency, cpu->config.mulfu_count,
+             cpu->config.mul_latency, cpu->config.mem_latency);
+    /* The magic goes last, a reader skips a page still being filled in */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(page->magic, TELEMETRY_MAGIC, TELEMETRY_MAGIC_LEN);
+    tm->page = page;
+    return tm;
+}
+
+/* Publishes the counters at the end of a cycle */
+void
+APEX_telemetry_cycle(APEX_Telemetry *tm, const APEX_CPU *cpu)
+{
+    APEX_TelemetryPage *page = tm->page;
+    int rob_used = (cpu->rob_tail - cpu->rob_head + ROB_SIZE(cpu)) % ROB_SIZE(cpu);
+    /* Counted by issue selection this cycle */
+    int iq_used = cpu->iqsize;
+
+    PUBLISH(page->cycle, cpu->clock);
+    PUBLISH(page->insns, cpu->insn_completed);
+    PUBLISH(page->rob_used, rob_used);
+    PUBLISH(page->iq_used, iq_used);
+    PUBLISH(page->rob_occupancy, page->rob_occupancy + rob_used);
+    PUBLISH(page->iq_occupancy, page->iq_occupancy + iq_used);
+    PUBLISH(page->rob_full, page->rob_full + (rob_used == ROB_SIZE(cpu) - 1));
+    PUBLISH(page->iq_full, page->iq_full + (iq_used == IQ_SIZE(cpu)));
+    PUBLISH(page->decode_stalls, page->decode_stalls + (cpu->decode.stalled != 0));
+    PUBLISH(page->fetch_stalls, page->fetch_stalls + (cpu->fetch.stalled != 0));
+}
+
+/* Marks the simulation done and removes its counters file */
+void
+APEX_telemetry_close(APEX_Telemetry *tm)
+{
+    if (!tm)
+    {
+        return;
+    }
+    PUBLISH(tm->page->state, TELEMETRY_DONE);
+    munmap(tm->page, sizeof(APEX_TelemetryPage));
+    unlink(tm->path);
+    free(tm);
+}
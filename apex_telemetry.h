@@ -0,0 +1,68 @@
+/*
+ * apex_telemetry.h
+ * Contains the layout of the shared memory counters a running simulation
+ * publishes, and the declarations to publish them
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_TELEMETRY_H_
+#define _APEX_TELEMETRY_H_
+
+#include <stdint.h>
+
+#include "apex_cpu.h"
+
+/*
+ * Every simulation run with --telemetry maps TELEMETRY_DIR/TELEMETRY_PREFIX<pid>
+ * and stores its counters there with relaxed atomic stores, once per cycle.
+ * Readers (see apex_top.c) map the same file read only and load the counters
+ * the same way, a sample may mix two adjacent cycles. The file is removed
+ * when the simulation ends.
+ */
+#define TELEMETRY_DIR "/dev/shm"
+#define TELEMETRY_PREFIX "apex_sim."
+#define TELEMETRY_MAGIC "APEXTLM1"
+#define TELEMETRY_MAGIC_LEN 8
+
+/* States of a published simulation */
+enum
+{
+    TELEMETRY_RUNNING,
+    TELEMETRY_DONE
+};
+
+typedef struct APEX_TelemetryPage
+{
+    char magic[TELEMETRY_MAGIC_LEN];
+    uint32_t pid;
+    uint32_t state;
+    int64_t started;       /* Unix time the simulation started */
+    char name[64];         /* Label given to --telemetry */
+    char program[128];     /* Input file */
+    char config[96];       /* Machine configuration */
+
+    /* Written once per cycle */
+    uint64_t cycle;
+    uint64_t insns;        /* Committed instructions */
+    uint64_t rob_used;     /* ROB entries in use this cycle */
+    uint64_t iq_used;      /* Issue queue entries in use at issue this cycle */
+    uint64_t rob_occupancy; /* Sums over all cycles of rob_used and iq_used */
+    uint64_t iq_occupancy;
+    uint64_t rob_full;     /* Cycles ending with the ROB full */
+    uint64_t iq_full;      /* Cycles ending with the issue queue full */
+    uint64_t decode_stalls; /* Cycles decode held an instruction back */
+    uint64_t fetch_stalls; /* Cycles fetch was stopped */
+} APEX_TelemetryPage;
+
+typedef struct APEX_Telemetry
+{
+    APEX_TelemetryPage *page;
+    char path[256];
+} APEX_Telemetry;
+
+APEX_Telemetry *APEX_telemetry_open(const char *name, const char *program, const APEX_CPU *cpu);
+void APEX_telemetry_cycle(APEX_Telemetry *tm, const APEX_CPU *cpu);
+void APEX_telemetry_close(APEX_Telemetry *tm);
+#endif
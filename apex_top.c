@@ -0,0 +1,215 @@
+/*
+ * apex_top.c
+ * Shows the progress of every simulation on the host that publishes live
+ * counters (apex_sim --telemetry=<label>)
+ *
+ * Each refresh maps the counters files found in TELEMETRY_DIR, samples them
+ * twice, one interval apart, and prints totals and rates over the interval.
+ * Nothing is sent to the simulations, they never notice being watched.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "apex_telemetry.h"
+
+#define TOP_MAX_JOBS 1024
+
+#define SAMPLE(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+/* Counters of one job at one point in time */
+typedef struct Sample
+{
+    uint64_t cycle;
+    uint64_t insns;
+    uint64_t rob_occupancy;
+    uint64_t iq_occupancy;
+    uint64_t rob_full;
+    uint64_t iq_full;
+    uint64_t decode_stalls;
+    uint64_t fetch_stalls;
+} Sample;
+
+typedef struct Job
+{
+    const APEX_TelemetryPage *page;
+    Sample first;
+    Sample last;
+} Job;
+
+static void
+take_sample(const APEX_TelemetryPage *page, Sample *s)
+{
+    s->cycle = SAMPLE(page->cycle);
+    s->insns = SAMPLE(page->insns);
+    s->rob_occupancy = SAMPLE(page->rob_occupancy);
+    s->iq_occupancy = SAMPLE(page->iq_occupancy);
+    s->rob_full = SAMPLE(page->rob_full);
+    s->iq_full = SAMPLE(page->iq_full);
+    s->decode_stalls = SAMPLE(page->decode_stalls);
+    s->fetch_stalls = SAMPLE(page->fetch_stalls);
+}
+
+/* Maps the counters file at path, NULL for anything but a live simulation */
+static const APEX_TelemetryPage *
+map_page(const char *path)
+{
+    const APEX_TelemetryPage *page;
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(APEX_TelemetryPage))
+    {
+        close(fd);
+        return NULL;
+    }
+    page = mmap(NULL, sizeof(APEX_TelemetryPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED)
+    {
+        return NULL;
+    }
+    /* Skip pages still being filled in and those left by a killed simulation */
+    if (memcmp(page->magic, TELEMETRY_MAGIC, TELEMETRY_MAGIC_LEN) != 0 ||
+        (kill(page->pid, 0) < 0 && errno == ESRCH))
+    {
+        munmap((void *)page, sizeof(APEX_TelemetryPage));
+        return NULL;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return page;
+}
+
+/* Maps every published simulation, returns how many */
+static int
+find_jobs(Job *jobs)
+{
+    DIR *dir = opendir(TELEMETRY_DIR);
+    struct dirent *de;
+    char path[512];
+    int njobs = 0;
+
+    if (!dir)
+    {
+        return 0;
+    }
+    while ((de = readdir(dir)) && njobs < TOP_MAX_JOBS)
+    {
+        if (strncmp(de->d_name, TELEMETRY_PREFIX, strlen(TELEMETRY_PREFIX)) != 0)
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", TELEMETRY_DIR, de->d_name);
+        if ((jobs[njobs].page = map_page(path)))
+        {
+            take_sample(jobs[njobs].page, &jobs[njobs].first);
+            njobs++;
+        }
+    }
+    closedir(dir);
+    return njobs;
+}
+
+static double
+ratio(uint64_t num, uint64_t den)
+{
+    return den ? (double)num / den : 0.0;
+}
+
+static void
+print_jobs(Job *jobs, int njobs, double interval)
+{
+    uint64_t total_cycles = 0, total_insns = 0;
+    time_t now = time(NULL);
+
+    printf("%7s %-16s %12s %12s %5s %9s %9s %5s %5s %6s %6s %6s %6s %7s\n", "PID", "LABEL", "CYCLES",
+           "INSNS", "IPC", "KCYC/S", "KINSN/S", "ROB", "IQ", "ROBF%", "IQF%", "DECS%", "FETS%", "ELAPSED");
+    for (int i = 0; i < njobs; i++)
+    {
+        const Sample *a = &jobs[i].first, *b = &jobs[i].last;
+        uint64_t cycles = b->cycle - a->cycle;
+        long elapsed = (long)(now - jobs[i].page->started);
+
+        printf("%7u %-16.16s %12llu %12llu %5.2f %9.1f %9.1f %5.1f %5.1f %6.1f %6.1f %6.1f %6.1f %4ld:%02ld\n",
+               jobs[i].page->pid, jobs[i].page->name, (unsigned long long)b->cycle, (unsigned long long)b->insns,
+               ratio(b->insns, b->cycle), cycles / interval / 1000.0, (b->insns - a->insns) / interval / 1000.0,
+               ratio(b->rob_occupancy - a->rob_occupancy, cycles), ratio(b->iq_occupancy - a->iq_occupancy, cycles),
+               100.0 * ratio(b->rob_full - a->rob_full, cycles), 100.0 * ratio(b->iq_full - a->iq_full, cycles),
+               100.0 * ratio(b->decode_stalls - a->decode_stalls, cycles),
+               100.0 * ratio(b->fetch_stalls - a->fetch_stalls, cycles), elapsed / 60, elapsed % 60);
+        total_cycles += cycles;
+        total_insns += b->insns - a->insns;
+    }
+    printf("%d simulations, %.1f kcycles/s, %.1f kinsns/s\n", njobs, total_cycles / interval / 1000.0,
+           total_insns / interval / 1000.0);
+}
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr, "APEX_Help: Usage %s [--interval=<seconds>] [--count=<n>]\n", prog);
+    fprintf(stderr, "  Shows simulations started with --telemetry, every interval (default 1s),\n");
+    fprintf(stderr, "  count times (default until interrupted)\n");
+}
+
+int
+main(int argc, char const *argv[])
+{
+    static Job jobs[TOP_MAX_JOBS];
+    double interval = 1.0;
+    long count = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--interval=", 11) == 0 && (interval = atof(argv[i] + 11)) > 0)
+        {
+            continue;
+        }
+        if (strncmp(argv[i], "--count=", 8) == 0 && (count = atol(argv[i] + 8)) > 0)
+        {
+            continue;
+        }
+        usage(argv[0]);
+        exit(1);
+    }
+
+    for (long n = 0; !count || n < count; n++)
+    {
+        struct timespec ts = {(time_t)interval, (long)((interval - (time_t)interval) * 1e9)};
+        int njobs = find_jobs(jobs);
+
+        nanosleep(&ts, NULL);
+        for (int i = 0; i < njobs; i++)
+        {
+            take_sample(jobs[i].page, &jobs[i].last);
+        }
+        /* Clear the screen between refreshes of an interactive terminal */
+        if (isatty(STDOUT_FILENO))
+        {
+            printf("\033[H\033[2J");
+        }
+        print_jobs(jobs, njobs, interval);
+        fflush(stdout);
+        for (int i = 0; i < njobs; i++)
+        {
+            munmap((void *)jobs[i].page, sizeof(APEX_TelemetryPage));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,479 @@
+/*
+ * apex_trace.c
+ * Contains recording of the committed instruction stream and trace driven
+ * timing
+ *
+ * Recording writes one record per committed instruction: its pc, the
+ * effective address of loads and stores, the target of JUMP and JAL and the
+ * BZ/BNZ outcome at each point the pipeline decides it. Straight-line code
+ * collapses into run bytes and everything else is delta coded.
+ *
+ * Replaying attaches records to dispatched instructions in program order.
+ * An instruction whose pc is not the next record is on a path which will be
+ * flushed and gets none. Branch outcomes, jump targets and memory addresses
+ * of instructions with a record come from the trace instead of the register
+ * file, so every machine configuration follows the recorded path.
+ *
+ * A live replay takes the same records from a thread running the functional
+ * model ahead of the pipeline, through a lock-free ring, so the timing model
+ * runs on one core and the semantics which steer it on another. Its records
+ * also carry the value each instruction produces, which the execution units
+ * and memory take instead of computing it again.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+#include "apex_oracle.h"
+#include "apex_ring.h"
+#include "apex_trace.h"
+
+/* FNV-1a hash of the decoded program, a trace only replays on its program */
+static uint32_t
+program_hash(const APEX_CPU *cpu)
+{
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < cpu->code_memory_size; i++)
+    {
+        const APEX_Instruction *ins = &cpu->code_memory[i];
+        int fields[6] = {ins->opcode, ins->rd, ins->rs1, ins->rs2, ins->rs3, ins->imm};
+
+        for (int j = 0; j < 6; j++)
+        {
+            hash = (hash ^ (uint32_t)fields[j]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static void
+put_varint(FILE *fp, int value)
+{
+    uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+
+    while (zz >= 0x80)
+    {
+        putc((zz & 0x7f) | 0x80, fp);
+        zz >>= 7;
+    }
+    putc(zz, fp);
+}
+
+/* Returns 0 on success, -1 at a truncated value */
+static int
+get_varint(FILE *fp, int *value)
+{
+    uint32_t zz = 0;
+    int shift = 0;
+    int c;
+
+    do
+    {
+        if ((c = getc(fp)) == EOF || shift > 28)
+        {
+            return -1;
+        }
+        zz |= (uint32_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    *value = (int)(zz >> 1) ^ -(int)(zz & 1);
+    return 0;
+}
+
+static void
+flush_run(APEX_Trace *trace)
+{
+    if (trace->run)
+    {
+        putc(TRACE_RUN | trace->run, trace->fp);
+        trace->run = 0;
+    }
+}
+
+/*
+ * Opens filename to record, or to replay when replay is set
+ *
+ * Returns the trace, NULL on failure
+ */
+APEX_Trace *
+APEX_trace_open(const char *filename, const APEX_CPU *cpu, int replay)
+{
+    APEX_Trace *trace = calloc(1, sizeof(APEX_Trace));
+    char magic[TRACE_MAGIC_LEN];
+    uint32_t header[2] = {cpu->code_memory_size, program_hash(cpu)};
+    uint32_t stored[2];
+
+    if (!trace)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate trace\n");
+        return NULL;
+    }
+    trace->filename = filename;
+    trace->replay = replay;
+    trace->last_pc = 4000 - 4;
+    trace->fp = fopen(filename, replay ? "rb" : "wb");
+    if (!trace->fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open trace %s\n", filename);
+        free(trace);
+        return NULL;
+    }
+
+    if (!replay)
+    {
+        fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LEN, trace->fp);
+        fwrite(header, sizeof(header), 1, trace->fp);
+        return trace;
+    }
+    if (fread(magic, 1, TRACE_MAGIC_LEN, trace->fp) != TRACE_MAGIC_LEN ||
+        memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0 || fread(stored, sizeof(stored), 1, trace->fp) != 1)
+    {
+        fprintf(stderr, "APEX_Error: %s is not an APEX trace\n", filename);
+        fclose(trace->fp);
+        free(trace);
+        return NULL;
+    }
+    if (memcmp(stored, header, sizeof(header)) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Trace %s was recorded from another program\n", filename);
+        fclose(trace->fp);
+        free(trace);
+        return NULL;
+    }
+    return trace;
+}
+
+/* Producer thread of a live replay, one record per instruction of the committed path */
+static void *
+produce(void *arg)
+{
+    APEX_Trace *trace = arg;
+    int pc = 4000;
+
+    while (pc >= 4000 && pc % 4 == 0 && (pc - 4000) / 4 < trace->code_size)
+    {
+        const APEX_Instruction *ins = &trace->code[(pc - 4000) / 4];
+        const int *regs = trace->producer->regs;
+        APEX_TraceRecord rec = {pc, APEX_oracle_address(trace->producer, ins), 0, 0, 0};
+        int next;
+
+        /* CMP writes no register and a store its source, both are read before they execute */
+        if (ins->opcode == OPCODE_CMP)
+        {
+            rec.result = regs[ins->rs1] - regs[ins->rs2];
+        }
+        else if (ins->opcode == OPCODE_STORE || ins->opcode == OPCODE_STR)
+        {
+            rec.result = regs[ins->rs1];
+        }
+        next = APEX_oracle_fetch(trace->producer, ins, pc);
+        switch (ins->opcode)
+        {
+        case OPCODE_ADD:
+        case OPCODE_SUB:
+        case OPCODE_ADDL:
+        case OPCODE_SUBL:
+        case OPCODE_MUL:
+        case OPCODE_AND:
+        case OPCODE_OR:
+        case OPCODE_XOR:
+        case OPCODE_MOVC:
+        case OPCODE_LOAD:
+        case OPCODE_LDR:
+        {
+            rec.result = regs[ins->rd];
+            break;
+        }
+        }
+
+        if (ins->opcode == OPCODE_JUMP || ins->opcode == OPCODE_JAL)
+        {
+            rec.target = next;
+        }
+        /* Every point of the pipeline decides a branch as it commits */
+        if ((ins->opcode == OPCODE_BZ || ins->opcode == OPCODE_BNZ) && next != pc + 4)
+        {
+            rec.taken = 1 << BRANCH_AT_JBU1 | 1 << BRANCH_AT_JBU2 | 1 << BRANCH_AT_COMMIT;
+        }
+        if (APEX_ring_push(trace->ring, &rec) < 0 || ins->opcode == OPCODE_HALT)
+        {
+            break;
+        }
+        pc = next;
+    }
+    APEX_ring_close(trace->ring);
+    return NULL;
+}
+
+/*
+ * Starts a replay whose records come from the functional model, run from
+ * the initial state of cpu on a thread of its own at most ahead instructions
+ * before the pipeline
+ *
+ * Returns the trace, NULL on failure
+ */
+APEX_Trace *
+APEX_trace_open_live(const APEX_CPU *cpu, int ahead)
+{
+    APEX_Trace *trace = calloc(1, sizeof(APEX_Trace));
+
+    if (!trace || !(trace->ring = APEX_ring_create(ahead)) || !(trace->producer = APEX_oracle_create(cpu)))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate trace\n");
+        if (trace)
+        {
+            APEX_ring_free(trace->ring);
+        }
+        free(trace);
+        return NULL;
+    }
+    trace->filename = "of the functional model";
+    trace->replay = TRUE;
+    trace->code = cpu->code_memory;
+    trace->code_size = cpu->code_memory_size;
+    if (pthread_create(&trace->thread, NULL, produce, trace) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to start the functional model thread\n");
+        APEX_oracle_free(trace->producer);
+        APEX_ring_free(trace->ring);
+        free(trace);
+        return NULL;
+    }
+    return trace;
+}
+
+/*
+ * Finishes the trace, a replay fails when the pipeline left the recorded path
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int
+APEX_trace_close(APEX_Trace *trace)
+{
+    int ret = 0;
+
+    if (!trace)
+    {
+        return 0;
+    }
+    if (trace->ring)
+    {
+        /* The producer may wait on a full ring the pipeline no longer drains */
+        APEX_ring_stop(trace->ring);
+        pthread_join(trace->thread, NULL);
+        APEX_oracle_free(trace->producer);
+        APEX_ring_free(trace->ring);
+    }
+    else if (!trace->replay)
+    {
+        flush_run(trace);
+    }
+    if (trace->fp && fclose(trace->fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write trace %s\n", trace->filename);
+        ret = -1;
+    }
+    if (trace->replay && trace->diverged)
+    {
+        fprintf(stderr, "APEX_Error: %ld commits diverged from trace %s\n", trace->diverged, trace->filename);
+        ret = -1;
+    }
+    free(trace);
+    return ret;
+}
+
+/*
+ * Decodes the next record into the window
+ *
+ * Returns 0 on success, -1 at the end of the trace
+ */
+static int
+decode_record(APEX_Trace *trace)
+{
+    APEX_TraceRecord *rec = &trace->window[trace->records % TRACE_WINDOW];
+    int flags, delta;
+
+    if (trace->ring)
+    {
+        if (APEX_ring_pop(trace->ring, rec) < 0)
+        {
+            return -1;
+        }
+        trace->records++;
+        return 0;
+    }
+    memset(rec, 0, sizeof(APEX_TraceRecord));
+    if (trace->run)
+    {
+        trace->run--;
+        rec->pc = trace->last_pc += 4;
+        trace->records++;
+        return 0;
+    }
+    if ((flags = getc(trace->fp)) == EOF)
+    {
+        return -1;
+    }
+    if (flags & TRACE_RUN)
+    {
+        trace->run = flags & TRACE_RUN_MAX;
+        return trace->run ? decode_record(trace) : -1;
+    }
+
+    delta = 0;
+    if ((flags & TRACE_NONSEQ) && get_varint(trace->fp, &delta) < 0)
+    {
+        return -1;
+    }
+    rec->pc = trace->last_pc += 4 + 4 * delta;
+    if (flags & TRACE_ADDR)
+    {
+        if (get_varint(trace->fp, &delta) < 0)
+        {
+            return -1;
+        }
+        rec->address = trace->last_address += delta;
+    }
+    if (flags & TRACE_TARGET)
+    {
+        if (get_varint(trace->fp, &delta) < 0)
+        {
+            return -1;
+        }
+        rec->target = rec->pc + delta;
+    }
+    rec->taken = flags >> TRACE_TAKEN_SHIFT & 0x7;
+    trace->records++;
+    return 0;
+}
+
+/* Attaches the next record to an instruction entering the ROB */
+void
+APEX_trace_dispatch(APEX_Trace *trace, ROB_ENTRY *rob_entry)
+{
+    rob_entry->trace_index = -1;
+    if (!trace->replay)
+    {
+        return;
+    }
+    while (trace->records <= trace->dispatched && decode_record(trace) == 0)
+    {
+    }
+    if (trace->dispatched < trace->records &&
+        trace->window[trace->dispatched % TRACE_WINDOW].pc == rob_entry->pc)
+    {
+        rob_entry->trace_index = trace->dispatched++;
+    }
+}
+
+/* Record attached to an instruction, NULL when not replaying or off the trace */
+const APEX_TraceRecord *
+APEX_trace_record(const APEX_Trace *trace, const ROB_ENTRY *rob_entry)
+{
+    if (!trace || !trace->replay || rob_entry->trace_index < 0 || rob_entry->trace_index >= trace->records ||
+        rob_entry->trace_index < trace->records - TRACE_WINDOW)
+    {
+        return NULL;
+    }
+    return &trace->window[rob_entry->trace_index % TRACE_WINDOW];
+}
+
+/*
+ * Value the functional model computed for an instruction, only records of
+ * a live replay carry one
+ *
+ * Returns TRUE when value is set, FALSE otherwise
+ */
+int
+APEX_trace_result(const APEX_Trace *trace, const ROB_ENTRY *rob_entry, int *value)
+{
+    const APEX_TraceRecord *rec = trace->ring ? APEX_trace_record(trace, rob_entry) : NULL;
+
+    if (!rec)
+    {
+        return FALSE;
+    }
+    *value = rec->result;
+    return TRUE;
+}
+
+/*
+ * Called for every instruction leaving the ROB, before a flush it causes
+ * clears the entry
+ */
+void
+APEX_trace_commit(APEX_Trace *trace, const ROB_ENTRY *rob_entry)
+{
+    int type = rob_entry->instruction_type;
+    int flushes = type == OPCODE_JUMP || type == OPCODE_JAL ||
+                  ((type == OPCODE_BZ || type == OPCODE_BNZ) && (rob_entry->branch_outcome >> BRANCH_AT_COMMIT & 1));
+    int flags = 0;
+
+    if (trace->replay)
+    {
+        if (rob_entry->trace_index != trace->committed)
+        {
+            trace->diverged++;
+        }
+        trace->committed++;
+        /* Instructions dispatched behind a flush get their records again */
+        if (flushes)
+        {
+            trace->dispatched = trace->committed;
+        }
+        return;
+    }
+
+    if (rob_entry->pc != trace->last_pc + 4)
+    {
+        flags |= TRACE_NONSEQ;
+    }
+    if (type == OPCODE_LOAD || type == OPCODE_LDR || type == OPCODE_STORE || type == OPCODE_STR)
+    {
+        flags |= TRACE_ADDR;
+    }
+    if (type == OPCODE_JUMP || type == OPCODE_JAL)
+    {
+        flags |= TRACE_TARGET;
+    }
+    if (type == OPCODE_BZ || type == OPCODE_BNZ)
+    {
+        flags |= (rob_entry->branch_outcome & 0x7) << TRACE_TAKEN_SHIFT;
+    }
+
+    if (!flags)
+    {
+        trace->last_pc += 4;
+        if (++trace->run == TRACE_RUN_MAX)
+        {
+            flush_run(trace);
+        }
+        trace->records++;
+        return;
+    }
+    flush_run(trace);
+    putc(flags, trace->fp);
+    if (flags & TRACE_NONSEQ)
+    {
+        put_varint(trace->fp, (rob_entry->pc - trace->last_pc - 4) / 4);
+    }
+    trace->last_pc = rob_entry->pc;
+    if (flags & TRACE_ADDR)
+    {
+        put_varint(trace->fp, rob_entry->mem_address - trace->last_address);
+        trace->last_address = rob_entry->mem_address;
+    }
+    if (flags & TRACE_TARGET)
+    {
+        put_varint(trace->fp, rob_entry->result - rob_entry->pc);
+    }
+    trace->records++;
+}
@@ -0,0 +1,91 @@
+/*
+ * apex_trace.h
+ * Contains declarations to record the committed instruction stream and to
+ * drive the timing pipeline from such a trace
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_TRACE_H_
+#define _APEX_TRACE_H_
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "apex_cpu.h"
+
+/*
+ * Trace file:
+ *
+ * TRACE_MAGIC, uint32 code memory size, uint32 hash of the program, then one
+ * record per committed instruction. A record starts with a byte:
+ *
+ * 0x80 | n         n (1 to 127) plain records: next pc, no payload
+ * TRACE_NONSEQ     zigzag varint (pc - (previous pc + 4)) / 4 follows
+ * TRACE_ADDR       zigzag varint delta to the previous effective address follows
+ * TRACE_TARGET     zigzag varint (jump target - pc) follows
+ * TRACE_TAKEN_*    BZ/BNZ taken when resolved in JBU1, in JBU2 and at commit
+ *
+ * Payloads follow in the order of the bits. All fields are in host byte
+ * order.
+ */
+#define TRACE_MAGIC "APEXTRC1"
+#define TRACE_MAGIC_LEN 8
+
+#define TRACE_NONSEQ 0x01
+#define TRACE_ADDR 0x02
+#define TRACE_TARGET 0x04
+#define TRACE_TAKEN_SHIFT 3
+#define TRACE_RUN 0x80
+#define TRACE_RUN_MAX 127
+
+/* Records kept while replaying, covers every instruction in flight */
+#define TRACE_WINDOW (2 * ROB_CAPACITY)
+
+/* Points where the pipeline decides a BZ/BNZ */
+enum
+{
+    BRANCH_AT_JBU1,
+    BRANCH_AT_JBU2,
+    BRANCH_AT_COMMIT
+};
+
+/* One committed instruction */
+typedef struct APEX_TraceRecord
+{
+    int pc;
+    int address; /* Effective address of loads and stores */
+    int target;  /* Target of JUMP and JAL */
+    int taken;   /* 1 << BRANCH_AT_* for each point a BZ/BNZ was taken at */
+    int result;  /* Value of rd, of CMP or stored, live replay only */
+} APEX_TraceRecord;
+
+typedef struct APEX_Trace
+{
+    FILE *fp;
+    const char *filename;
+    struct APEX_Ring *ring;        /* Records of a live replay, from the producer thread */
+    struct APEX_Oracle *producer;  /* Functional model the producer thread runs */
+    const APEX_Instruction *code;
+    int code_size;
+    pthread_t thread;
+    int replay;            /* Driving the pipeline, recording otherwise */
+    int last_pc;           /* Delta bases of the encoding */
+    int last_address;
+    long records;          /* Records written or decoded */
+    int run;               /* Plain records not written yet, or left to decode */
+    long dispatched;       /* Next record to attach to a dispatched instruction */
+    long committed;        /* Next record to commit */
+    long diverged;         /* Commits which did not match the trace */
+    APEX_TraceRecord window[TRACE_WINDOW];
+} APEX_Trace;
+
+APEX_Trace *APEX_trace_open(const char *filename, const APEX_CPU *cpu, int replay);
+APEX_Trace *APEX_trace_open_live(const APEX_CPU *cpu, int ahead);
+int APEX_trace_close(APEX_Trace *trace);
+void APEX_trace_dispatch(APEX_Trace *trace, ROB_ENTRY *rob_entry);
+void APEX_trace_commit(APEX_Trace *trace, const ROB_ENTRY *rob_entry);
+const APEX_TraceRecord *APEX_trace_record(const APEX_Trace *trace, const ROB_ENTRY *rob_entry);
+int APEX_trace_result(const APEX_Trace *trace, const ROB_ENTRY *rob_entry, int *value);
+#endif
@@ -0,0 +1,89 @@
+/*
+ * observer_counts.c
+ * Example observer plugin: counts the commits of every instruction of code
+ * memory, the loads and stores among them and the flushes, and prints them
+ * once the run is over
+ *
+ * Build with make examples, then run
+ *
+ *     ./apex_sim input.asm simulate --observer=./examples/observer_counts.so
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cpu.h"
+#include "apex_observer.h"
+
+typedef struct Counts
+{
+    long *commits;  /* Per code memory index */
+    long memory;    /* Loads and stores at MEM2, squashed ones included */
+    long flushes;
+    long squashed;  /* ROB entries discarded by the flushes */
+} Counts;
+
+/* The plugin watches a single CPU */
+static Counts counts;
+
+static void
+on_event(void *arg, const APEX_ObsView *view, const APEX_CPU *cpu)
+{
+    Counts *c = arg;
+    int index = (view->pc - 4000) / 4;
+
+    switch (view->event)
+    {
+    case OBS_COMMIT:
+    {
+        if (view->pc >= 4000 && index < cpu->code_memory_size)
+        {
+            c->commits[index]++;
+        }
+        break;
+    }
+    case OBS_MEMORY:
+    {
+        c->memory++;
+        break;
+    }
+    case OBS_FLUSH:
+    {
+        c->flushes++;
+        c->squashed += view->squashed;
+        break;
+    }
+    }
+}
+
+int
+APEX_observer_init(APEX_CPU *cpu)
+{
+    if (!(counts.commits = calloc(cpu->code_memory_size, sizeof(long))))
+    {
+        fprintf(stderr, "observer_counts: Unable to allocate counters\n");
+        return -1;
+    }
+    if (APEX_observer_add(cpu, OBS_MASK(OBS_COMMIT) | OBS_MASK(OBS_MEMORY) | OBS_MASK(OBS_FLUSH), on_event,
+                          &counts) < 0)
+    {
+        free(counts.commits);
+        return -1;
+    }
+    return 0;
+}
+
+void
+APEX_observer_fini(APEX_CPU *cpu)
+{
+    printf("observer_counts: %ld memory accesses, %ld flushes discarding %ld ROB entries\n", counts.memory,
+           counts.flushes, counts.squashed);
+    for (int i = 0; i < cpu->code_memory_size; i++)
+    {
+        printf("observer_counts: %-5d %9ld  %s\n", 4000 + 4 * i, counts.commits[i], cpu->code_memory[i].opcode_str);
+    }
+    free(counts.commits);
+}
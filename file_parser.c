@@ -301,14 +301,14 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
 }
 
 /*
- * This function is related to parsing input file
+ * Parses the program read from fp, which must be seekable, one instruction
+ * per line
  *
- * Note : You are not supposed to edit this function
+ * Returns the code memory, NULL when fp holds no line
  */
 APEX_Instruction *
-create_code_memory(const char *filename, int *size)
+read_code_memory(FILE *fp, int *size)
 {
-    FILE *fp;
     ssize_t nread;
     size_t len = 0;
     char *line = NULL;
@@ -316,17 +316,6 @@ create_code_memory(const char *filename, int *size)
     int current_instruction = 0;
     APEX_Instruction *code_memory;
 
-    if (!filename)
-    {
-        return NULL;
-    }
-
-    fp = fopen(filename, "r");
-    if (!fp)
-    {
-        return NULL;
-    }
-
     while ((nread = getline(&line, &len, fp)) != -1)
     {
         code_memory_size++;
@@ -334,14 +323,14 @@ create_code_memory(const char *filename, int *size)
     *size = code_memory_size;
     if (!code_memory_size)
     {
-        fclose(fp);
+        free(line);
         return NULL;
     }
 
     code_memory = calloc(code_memory_size, sizeof(APEX_Instruction));
     if (!code_memory)
     {
-        fclose(fp);
+        free(line);
         return NULL;
     }
 
@@ -353,6 +342,82 @@ create_code_memory(const char *filename, int *size)
     }
 
     free(line);
+    return code_memory;
+}
+
+/*
+ * This function is related to parsing input file
+ *
+ * Note : You are not supposed to edit this function
+ */
+APEX_Instruction *
+create_code_memory(const char *filename, int *size)
+{
+    FILE *fp;
+    APEX_Instruction *code_memory;
+
+    if (!filename)
+    {
+        return NULL;
+    }
+
+    fp = fopen(filename, "r");
+    if (!fp)
+    {
+        return NULL;
+    }
+    code_memory = read_code_memory(fp, size);
     fclose(fp);
     return code_memory;
-}
\ No newline at end of file
+}
+/*
+ * Writes an instruction into buf in the syntax of the input file
+ *
+ * Returns buf
+ */
+char *
+APEX_format_instruction(const APEX_Instruction *ins, char *buf, size_t size)
+{
+    switch (ins->opcode)
+    {
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_MUL:
+    case OPCODE_DIV:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_LDR:
+        snprintf(buf, size, "%s R%d,R%d,R%d", ins->opcode_str, ins->rd, ins->rs1, ins->rs2);
+        break;
+    case OPCODE_STR:
+        snprintf(buf, size, "%s R%d,R%d,R%d", ins->opcode_str, ins->rs1, ins->rs2, ins->rs3);
+        break;
+    case OPCODE_MOVC:
+        snprintf(buf, size, "%s R%d,#%d", ins->opcode_str, ins->rd, ins->imm);
+        break;
+    case OPCODE_ADDL:
+    case OPCODE_SUBL:
+    case OPCODE_LOAD:
+    case OPCODE_JAL:
+        snprintf(buf, size, "%s R%d,R%d,#%d", ins->opcode_str, ins->rd, ins->rs1, ins->imm);
+        break;
+    case OPCODE_STORE:
+        snprintf(buf, size, "%s R%d,R%d,#%d", ins->opcode_str, ins->rs1, ins->rs2, ins->imm);
+        break;
+    case OPCODE_CMP:
+        snprintf(buf, size, "%s R%d,R%d", ins->opcode_str, ins->rs1, ins->rs2);
+        break;
+    case OPCODE_JUMP:
+        snprintf(buf, size, "%s R%d,#%d", ins->opcode_str, ins->rs1, ins->imm);
+        break;
+    case OPCODE_BZ:
+    case OPCODE_BNZ:
+        snprintf(buf, size, "%s #%d", ins->opcode_str, ins->imm);
+        break;
+    default:
+        snprintf(buf, size, "%s", ins->opcode_str);
+        break;
+    }
+    return buf;
+}
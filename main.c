@@ -7,30 +7,318 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "apex_batch.h"
+#include "apex_branchprof.h"
+#include "apex_cache.h"
+#include "apex_checkpoint.h"
+#include "apex_cpistack.h"
 #include "apex_cpu.h"
+#include "apex_critpath.h"
+#include "apex_debug.h"
+#include "apex_estimate.h"
+#include "apex_explore.h"
+#include "apex_hostprof.h"
+#include "apex_memimage.h"
+#include "apex_memprofile.h"
+#include "apex_observer.h"
+#include "apex_options.h"
+#include "apex_profile.h"
+#include "apex_runctl.h"
+#include "apex_schedule.h"
+#include "apex_server.h"
+#include "apex_simpoint.h"
+#include "apex_telemetry.h"
+#include "apex_trace.h"
 
 int
 main(int argc, char const *argv[])
 {
     APEX_CPU *cpu;
+    APEX_Options opts;
+    const char *args[3] = {NULL, NULL, "NA"};
+    int nargs = 0;
+    int failed, cached, halted;
+    APEX_CacheKey key;
+    APEX_CacheEntry entry;
+    APEX_RunCtl runctl;
 
     fprintf(stderr, "APEX CPU Pipeline Simulator v%0.1lf\n", VERSION);
 
-    if (argc < 3)
+    /* Positional arguments come first, --name=value options may follow */
+    APEX_options_init(&opts);
+    for (int i = 1; i < argc; i++)
     {
-        fprintf(stderr, "APEX_Help: Usage %s <input_file>\n", argv[0]);
+        if (strncmp(argv[i], "--", 2) == 0)
+        {
+            if (APEX_options_parse(&opts, argv[i]) < 0)
+            {
+                fprintf(stderr, "APEX_Error: Invalid option %s\n", argv[i]);
+                APEX_options_usage();
+                exit(1);
+            }
+        }
+        else if (nargs < 3)
+        {
+            args[nargs++] = argv[i];
+        }
+    }
+
+    if (APEX_options_check(&opts) < 0)
+    {
+        exit(1);
+    }
+
+    /* Jobs carry their own input file and options */
+    if (opts.server_endpoint)
+    {
+        return APEX_server_run(opts.server_endpoint) < 0 ? 1 : 0;
+    }
+
+    if (nargs < 2)
+    {
+        fprintf(stderr, "APEX_Help: Usage %s <input_file> <simulate|display|single_step|debug|batch> [cycles] [options]\n", argv[0]);
+        fprintf(stderr, "APEX_Help: Usage %s <input_file> schedule <output_file> [options]\n", argv[0]);
+        fprintf(stderr, "APEX_Help: Usage %s <input_file> simpoint <instructions> --simpoints=<file> [options]\n", argv[0]);
+        fprintf(stderr, "APEX_Help: Usage %s <input_file> sample --simpoints=<file> [options]\n", argv[0]);
+        fprintf(stderr, "APEX_Help: Usage %s <input_file> explore <cycles> [--kernels=<file>] [--space=<file>] [options]\n", argv[0]);
+        fprintf(stderr, "APEX_Help: Usage %s <input_file> estimate <instructions> [--kernels=<file>] [--space=<file>] [options]\n", argv[0]);
+        fprintf(stderr, "APEX_Help: Usage %s --server=<socket|->\n", argv[0]);
+        APEX_options_usage();
         exit(1);
     }
 
-    cpu = APEX_cpu_init(argv[1]);
+    cpu = APEX_cpu_init(args[0], &opts);
     if (!cpu)
     {
         fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
         exit(1);
     }
 
-    APEX_cpu_run(cpu, argv[2], argc == 3 ? "NA" : argv[3]);
+    /* The batch runs functionally, it has no pipeline to analyse */
+    if (strcmp(args[1], "batch") == 0)
+    {
+        if (!opts.batch_file || APEX_options_any_analysis(&opts))
+        {
+            fprintf(stderr, "APEX_Error: batch needs --batch-inputs and takes no pipeline analysis\n");
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        failed = APEX_batch_run(cpu, &opts, args[2]) < 0;
+        APEX_cpu_stop(cpu);
+        return failed ? 1 : 0;
+    }
+
+    /* Both programs run to completion, the comparison is the only output */
+    if (strcmp(args[1], "schedule") == 0)
+    {
+        if (nargs < 3 || APEX_options_any_analysis(&opts))
+        {
+            fprintf(stderr, "APEX_Error: schedule needs an output file and takes no pipeline analysis\n");
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        failed = APEX_schedule_run(cpu, &opts, args[2]) < 0;
+        APEX_cpu_stop(cpu);
+        return failed ? 1 : 0;
+    }
+
+    /* The profile runs functionally, the sampled run on CPUs of its own */
+    if (strcmp(args[1], "simpoint") == 0 || strcmp(args[1], "sample") == 0)
+    {
+        int profiling = strcmp(args[1], "simpoint") == 0;
+
+        if (!opts.simpoint_file || (profiling && nargs < 3) || APEX_options_any_analysis(&opts))
+        {
+            fprintf(stderr, "APEX_Error: %s needs %s--simpoints and takes no pipeline analysis\n", args[1],
+                    profiling ? "an instruction count, " : "");
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        failed = (profiling ? APEX_simpoint_run(cpu, &opts, args[2]) : APEX_simpoint_sample(cpu, &opts)) < 0;
+        APEX_cpu_stop(cpu);
+        return failed ? 1 : 0;
+    }
+
+    /* Every candidate runs on CPUs of its own */
+    if (strcmp(args[1], "explore") == 0)
+    {
+        if (nargs < 3 || APEX_options_any_analysis(&opts))
+        {
+            fprintf(stderr, "APEX_Error: explore needs a cycle budget and takes no pipeline analysis\n");
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        failed = APEX_explore_run(cpu, &opts, args[0], args[2]) < 0;
+        APEX_cpu_stop(cpu);
+        return failed ? 1 : 0;
+    }
+
+    /* The estimates come from a functional pass, the detailed runs they are
+     * checked against from a CPU of their own */
+    if (strcmp(args[1], "estimate") == 0)
+    {
+        if (nargs < 3 || APEX_options_any_analysis(&opts))
+        {
+            fprintf(stderr, "APEX_Error: estimate needs an instruction count and takes no pipeline analysis\n");
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        failed = APEX_estimate_run(cpu, &opts, args[0], args[2]) < 0;
+        APEX_cpu_stop(cpu);
+        return failed ? 1 : 0;
+    }
+
+    /* Reverse execution would count replayed cycles twice and rewind no trace
+     * nor the functional model of the branch oracle */
+    if ((APEX_options_any_analysis(&opts) || ORACLE(cpu, ORACLE_BRANCH)) && strcmp(args[1], "debug") == 0)
+    {
+        fprintf(stderr, "APEX_Error: --profile, --critical-path, --cpi-stack, --mem-profile, --branch-profile, traces, telemetry, observers and the branch oracle are not available in debug mode\n");
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+    if (opts.profile_file && !(cpu->profile = APEX_profile_create(cpu->code_memory_size)))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate profile\n");
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+    if (opts.critpath_file && !(cpu->critpath = APEX_critpath_create()))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate critical path analysis\n");
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+    if (opts.cpistack_file && !(cpu->cpistack = APEX_cpistack_create(opts.cpistack_interval)))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate CPI stack\n");
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+    if (opts.memprofile_file &&
+        !(cpu->memprofile = APEX_memprofile_create(cpu->code_memory_size, opts.memprofile_block,
+                                                   opts.memprofile_interval)))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate memory profile\n");
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+    if (opts.branchprof_file && !(cpu->branchprof = APEX_branchprof_create(cpu->code_memory_size)))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate branch profile\n");
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+
+    if (opts.trace_file && !(cpu->trace = APEX_trace_open(opts.trace_file, cpu, opts.trace_replay)))
+    {
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+    if (opts.decoupled && !(cpu->trace = APEX_trace_open_live(cpu, opts.decoupled)))
+    {
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+
+    if (opts.telemetry_name && !(cpu->telemetry = APEX_telemetry_open(opts.telemetry_name, args[0], cpu)))
+    {
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+    if (opts.observer_file && APEX_observer_load(cpu, opts.observer_file) < 0)
+    {
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
+
+    /* Only the final stats of a plain simulate run are kept */
+    cached = opts.cache_dir && strcmp(args[1], "simulate") == 0 && !opts.mem_dump_file && !cpu->profile &&
+             !cpu->critpath && !cpu->cpistack && !cpu->memprofile && !cpu->branchprof && !cpu->trace &&
+             !cpu->telemetry && !cpu->observers;
+    if (cached)
+    {
+        APEX_cache_key(cpu, atoi(args[2]), &key);
+        if (APEX_cache_lookup(opts.cache_dir, &key, &entry))
+        {
+            printf("APEX_CPU: Simulation %s, cycles = %d instructions = %d (cached)\n",
+                   entry.halted ? "Complete" : "Stopped", entry.cycles, entry.insns);
+            APEX_config_print(&cpu->config);
+            APEX_cpu_stop(cpu);
+            return 0;
+        }
+    }
+
+    /* A snapshot restores the machine, not the state of an analysis or of the
+     * functional model of the branch oracle */
+    if (opts.checkpoint_file)
+    {
+        if (strcmp(args[1], "simulate") != 0 || cpu->profile || cpu->critpath || cpu->cpistack || cpu->memprofile ||
+            cpu->branchprof || cpu->trace || cpu->telemetry || cpu->observers || ORACLE(cpu, ORACLE_BRANCH))
+        {
+            fprintf(stderr, "APEX_Error: --checkpoints needs simulate mode and takes no analysis nor branch oracle\n");
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        if (!APEX_checkpoints_open(opts.checkpoint_file, cpu, opts.snapshot_interval, atoi(args[2])))
+        {
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+    }
+
+    /* A watched run which stops early still prints its state and writes its analyses */
+    APEX_runctl_start(&runctl, &opts, cpu);
+    if (strcmp(args[1], "simulate") == 0 || strcmp(args[1], "display") == 0)
+    {
+        APEX_runctl_catch_signals();
+        cpu->runctl = &runctl;
+    }
+
+    HOSTPROF_START();
+    if (strcmp(args[1], "debug") == 0)
+    {
+        APEX_debug_run(cpu, stdin, opts.snapshot_interval);
+    }
+    else
+    {
+        halted = APEX_cpu_run(cpu, args[1], args[2]);
+        if (runctl.stopped)
+        {
+            APEX_runctl_report(stderr, &runctl, cpu);
+        }
+        /* A result which cannot be stored is still a result, a run stopped
+         * early is none */
+        if (cached && !runctl.stopped)
+        {
+            APEX_cache_store(opts.cache_dir, &key, halted, cpu->clock, cpu->insn_completed, opts.cache_size);
+        }
+    }
+    if (cpu->checkpoints)
+    {
+        failed = APEX_checkpoints_close(cpu->checkpoints, cpu, opts.checkpoint_file) < 0;
+        cpu->checkpoints = NULL;
+        if (failed)
+        {
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+    }
+    HOSTPROF_REPORT(stderr);
+    /* Closing checks that a replay stayed on its trace */
+    failed = APEX_trace_close(cpu->trace) < 0;
+    cpu->trace = NULL;
+    if (failed || (opts.mem_dump_file && APEX_memimage_dump(cpu, opts.mem_dump_file, opts.mem_dump_format) < 0) ||
+        (cpu->profile && APEX_profile_write(cpu->profile, cpu, opts.profile_file) < 0) ||
+        (cpu->critpath && APEX_critpath_write(cpu->critpath, cpu, opts.critpath_file) < 0) ||
+        (cpu->cpistack && APEX_cpistack_write(cpu->cpistack, opts.cpistack_file) < 0) ||
+        (cpu->memprofile && APEX_memprofile_write(cpu->memprofile, cpu, opts.memprofile_file) < 0) ||
+        (cpu->branchprof && APEX_branchprof_write(cpu->branchprof, cpu, opts.branchprof_file) < 0))
+    {
+        APEX_cpu_stop(cpu);
+        exit(1);
+    }
     APEX_cpu_stop(cpu);
-    return 0;
-}
\ No newline at end of file
+    return runctl.stopped ? 1 : 0;
+}